@@ -0,0 +1,133 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <chrono>
+
+#include "accounting_pipeline.h"
+#include "logger.h"
+
+AccountingPipeline::AccountingPipeline(int num_workers, int queue_size, Sender record_sender) :
+    sender(record_sender), stopping(false), submitting(0), submitted(0), dropped(0), sent(0), failed(0) {
+    if (num_workers < 1) {
+        num_workers = 1;
+    }
+    size_t worker_queue_size = queue_size > num_workers ? queue_size / num_workers : 1;
+    for (int i = 0; i < num_workers; i++) {
+        workers.push_back(new Worker(worker_queue_size));
+    }
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i]->thread = std::thread(&AccountingPipeline::WorkerLoop, this, workers[i]);
+    }
+}
+
+AccountingPipeline::~AccountingPipeline() {
+    Stop();
+    for (size_t i = 0; i < workers.size(); i++) {
+        delete workers[i];
+    }
+}
+
+bool AccountingPipeline::Submit(AccountingRecord* record) {
+    Worker* worker = workers[(unsigned)record->task_id % workers.size()];
+    // Announced before stopping is looked at: Stop either sees this call
+    // and waits for its push, or this call sees Stop
+    submitting++;
+    bool queued = !stopping.load() && worker->queue.Push(record);
+    submitting--;
+    if (!queued) {
+        dropped++;
+        LOG_F(WARNING, "Accounting %s, dropping record of task %d", stopping.load() ? "stopped" : "queue full",
+                record->task_id);
+        if (record->done) {
+            record->done(false);
+        }
+        delete record;
+        return false;
+    }
+    submitted++;
+
+    if (worker->idle.load()) {
+        std::lock_guard<std::mutex> guard(worker->lock);
+        worker->cond.notify_one();
+    }
+    return true;
+}
+
+size_t AccountingPipeline::QueueDepth() {
+    size_t depth = 0;
+    for (size_t i = 0; i < workers.size(); i++) {
+        depth += workers[i]->queue.Size();
+    }
+    return depth;
+}
+
+void AccountingPipeline::WorkerLoop(Worker* worker) {
+    AccountingRecord* record;
+    for (;;) {
+        while (worker->queue.Pop(&record)) {
+            Deliver(record);
+        }
+
+        std::unique_lock<std::mutex> guard(worker->lock);
+        if (stopping.load()) {
+            if (worker->queue.Size() == 0) {
+                break;
+            }
+            continue;
+        }
+        // A producer that pushed before seeing idle set finds the record
+        // picked up by this re-check, one that pushed after notifies
+        worker->idle.store(true);
+        if (worker->queue.Size() == 0) {
+            worker->cond.wait_for(guard, std::chrono::milliseconds(100));
+        }
+        worker->idle.store(false);
+    }
+}
+
+void AccountingPipeline::Deliver(AccountingRecord* record) {
+    bool delivered = sender(*record) >= 0;
+    if (delivered) {
+        sent++;
+    } else {
+        failed++;
+    }
+    if (record->done) {
+        record->done(delivered);
+    }
+    delete record;
+}
+
+void AccountingPipeline::Stop() {
+    if (stopping.exchange(true)) {
+        return;
+    }
+    for (size_t i = 0; i < workers.size(); i++) {
+        {
+            std::lock_guard<std::mutex> guard(workers[i]->lock);
+            workers[i]->cond.notify_one();
+        }
+        workers[i]->thread.join();
+    }
+
+    // Records pushed after their worker's last look at its queue
+    while (submitting.load() != 0) {
+        std::this_thread::yield();
+    }
+    AccountingRecord* record;
+    for (size_t i = 0; i < workers.size(); i++) {
+        while (workers[i]->queue.Pop(&record)) {
+            Deliver(record);
+        }
+    }
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ACCOUNTING_PIPELINE_H_
+#define ACCOUNTING_PIPELINE_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+#include "bounded_queue.h"
+
+class MethodMetrics;
+
+// One accounting request, START or STOP, ready to be sent
+struct AccountingRecord {
+    uint8_t flags;
+    int task_id;
+    std::string username;
+    std::string remote_addr;
+    std::vector<std::string> args;
+    // Optional, told whether the record was delivered or spooled once the
+    // pipeline is done with it, dropped records included
+    std::function<void(bool delivered)> done;
+    // Delivery latency is recorded here when set
+    MethodMetrics* metrics = NULL;
+};
+
+// Sends accounting records in the background so that calls never wait for
+// the TACACS+ server to acknowledge them.
+//
+// Records are spread over the workers by task_id: START and STOP of one call
+// go through the same FIFO and reach the server in order. Each worker drains
+// its queue back to back over a pooled connection. When a queue is full the
+// record is dropped and counted rather than blocking the caller.
+class AccountingPipeline {
+    public:
+    // Returns a negative value if the record could not be delivered
+    typedef std::function<int(const AccountingRecord&)> Sender;
+
+    private:
+    struct Worker {
+        BoundedQueue<AccountingRecord*> queue;
+        std::mutex lock;
+        std::condition_variable cond;
+        std::atomic<bool> idle;
+        std::thread thread;
+
+        Worker(size_t queue_size) : queue(queue_size), idle(false) {}
+    };
+
+    Sender sender;
+    std::vector<Worker*> workers;
+    std::atomic<bool> stopping;
+    // Submit calls that may still push, Stop waits for them before draining
+    std::atomic<int> submitting;
+
+    void WorkerLoop(Worker* worker);
+    // Sends record, settles its done callback and frees it
+    void Deliver(AccountingRecord* record);
+
+    public:
+    std::atomic<unsigned long> submitted;
+    std::atomic<unsigned long> dropped;
+    std::atomic<unsigned long> sent;
+    std::atomic<unsigned long> failed;
+
+    AccountingPipeline(int num_workers, int queue_size, Sender sender);
+    ~AccountingPipeline();
+
+    // Takes ownership of the record. False if it had to be dropped.
+    bool Submit(AccountingRecord* record);
+
+    // Records waiting to be sent
+    size_t QueueDepth();
+
+    // Joins the workers and sends what is queued, records submitted
+    // concurrently included
+    void Stop();
+};
+
+#endif
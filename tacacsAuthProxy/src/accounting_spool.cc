@@ -0,0 +1,434 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <vector>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "accounting_spool.h"
+#include "logger.h"
+
+#define SPOOL_SEGMENT_SIZE (4 * 1024 * 1024)
+#define SPOOL_FILE_MAGIC "TACSPL01"
+#define SPOOL_FILE_HDR_SIZE 16
+#define SPOOL_RECORD_MAGIC 0x52434341
+#define SPOOL_MAX_BACKOFF_SEC 30
+
+enum {
+    SPOOL_STATE_PENDING = 0,
+    SPOOL_STATE_DELIVERED = 1
+};
+
+// Precedes every record. The delivered state is updated in place and is not
+// covered by the checksum.
+struct SpoolRecordHeader {
+    uint32_t magic;             // written last, marks the record complete
+    uint32_t length;
+    uint32_t crc;
+    uint32_t state;
+};
+
+struct Crc32Table {
+    uint32_t entries[256];
+
+    Crc32Table() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+            }
+            entries[i] = c;
+        }
+    }
+};
+
+static uint32_t Crc32(const char* data, size_t len) {
+    static const Crc32Table table;
+
+    uint32_t crc = 0xffffffff;
+    for (size_t i = 0; i < len; i++) {
+        crc = table.entries[(crc ^ (unsigned char)data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return crc ^ 0xffffffff;
+}
+
+static size_t RecordSize(uint32_t length) {
+    return sizeof(SpoolRecordHeader) + ((length + 3) & ~3u);
+}
+
+static void PutString(std::string* out, const std::string& s) {
+    uint16_t len = s.size() > 0xffff ? 0xffff : s.size();
+    out->append((const char*)&len, sizeof(len));
+    out->append(s.data(), len);
+}
+
+static bool GetString(const char** p, const char* end, std::string* s) {
+    uint16_t len;
+    if (end - *p < (ptrdiff_t)sizeof(len)) {
+        return false;
+    }
+    memcpy(&len, *p, sizeof(len));
+    *p += sizeof(len);
+    if (end - *p < len) {
+        return false;
+    }
+    s->assign(*p, len);
+    *p += len;
+    return true;
+}
+
+static std::string SerializeRecord(const AccountingRecord& record) {
+    std::string out;
+    out.push_back((char)record.flags);
+    out.append((const char*)&record.task_id, sizeof(record.task_id));
+    PutString(&out, record.username);
+    PutString(&out, record.remote_addr);
+    uint16_t nargs = record.args.size();
+    out.append((const char*)&nargs, sizeof(nargs));
+    for (uint16_t i = 0; i < nargs; i++) {
+        PutString(&out, record.args[i]);
+    }
+    return out;
+}
+
+static bool ParseRecord(const char* p, size_t len, AccountingRecord* record) {
+    const char* end = p + len;
+    uint16_t nargs;
+    if (len < 1 + sizeof(record->task_id)) {
+        return false;
+    }
+    record->flags = (uint8_t)*p++;
+    memcpy(&record->task_id, p, sizeof(record->task_id));
+    p += sizeof(record->task_id);
+    if (!GetString(&p, end, &record->username) || !GetString(&p, end, &record->remote_addr)) {
+        return false;
+    }
+    if (end - p < (ptrdiff_t)sizeof(nargs)) {
+        return false;
+    }
+    memcpy(&nargs, p, sizeof(nargs));
+    p += sizeof(nargs);
+    record->args.resize(nargs);
+    for (uint16_t i = 0; i < nargs; i++) {
+        if (!GetString(&p, end, &record->args[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+AccountingSpool::AccountingSpool(const std::string& spool_dir, size_t max_bytes, AccountingPipeline::Sender record_sender) :
+    dir(spool_dir), segmentSize(SPOOL_SEGMENT_SIZE), sender(record_sender), readOffset(SPOOL_FILE_HDR_SIZE),
+    nextSeq(1), stopping(false), pending(0), spooled(0), replayed(0), dropped(0), corrupted(0) {
+    maxSegments = std::max((size_t)2, max_bytes / segmentSize);
+}
+
+AccountingSpool::~AccountingSpool() {
+    Stop();
+    while (!segments.empty()) {
+        UnmapSegment(segments.front(), false);
+        segments.pop_front();
+    }
+}
+
+void AccountingSpool::Stop() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    cond.notify_all();
+    if (replayer.joinable()) {
+        replayer.join();
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    for (size_t i = 0; i < segments.size(); i++) {
+        msync(segments[i]->base, segments[i]->size, MS_SYNC);
+    }
+}
+
+AccountingSpool::Segment* AccountingSpool::MapSegment(uint64_t seq, bool create) {
+    char name[64];
+    snprintf(name, sizeof(name), "acct-%020llu.spool", (unsigned long long)seq);
+    std::string path = dir + "/" + name;
+
+    int fd = open(path.c_str(), create ? (O_RDWR | O_CREAT | O_EXCL) : O_RDWR, 0600);
+    if (fd < 0) {
+        LOG_F(ERROR, "Unable to open accounting spool segment %s: %s", path.c_str(), strerror(errno));
+        return NULL;
+    }
+
+    size_t size = segmentSize;
+    if (create) {
+        if (ftruncate(fd, size) < 0) {
+            LOG_F(ERROR, "Unable to size accounting spool segment %s: %s", path.c_str(), strerror(errno));
+            close(fd);
+            unlink(path.c_str());
+            return NULL;
+        }
+    } else {
+        struct stat st;
+        if (fstat(fd, &st) < 0 || st.st_size < SPOOL_FILE_HDR_SIZE) {
+            LOG_F(WARNING, "Ignoring truncated accounting spool segment %s", path.c_str());
+            close(fd);
+            return NULL;
+        }
+        size = st.st_size;
+    }
+
+    void* base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        LOG_F(ERROR, "Unable to map accounting spool segment %s: %s", path.c_str(), strerror(errno));
+        if (create) {
+            unlink(path.c_str());
+        }
+        return NULL;
+    }
+
+    if (create) {
+        memcpy(base, SPOOL_FILE_MAGIC, strlen(SPOOL_FILE_MAGIC));
+    } else if (memcmp(base, SPOOL_FILE_MAGIC, strlen(SPOOL_FILE_MAGIC)) != 0) {
+        LOG_F(WARNING, "Ignoring accounting spool segment %s with unknown format", path.c_str());
+        munmap(base, size);
+        return NULL;
+    }
+
+    Segment* segment = new Segment();
+    segment->seq = seq;
+    segment->path = path;
+    segment->base = (char*)base;
+    segment->size = size;
+    segment->end = SPOOL_FILE_HDR_SIZE;
+    segment->pending = 0;
+    return segment;
+}
+
+void AccountingSpool::UnmapSegment(Segment* segment, bool remove) {
+    msync(segment->base, segment->size, MS_SYNC);
+    munmap(segment->base, segment->size);
+    if (remove) {
+        unlink(segment->path.c_str());
+    }
+    delete segment;
+}
+
+// Finds the end of the records of a segment written by an earlier run and
+// counts the pending ones. Records failing their checksum are skipped.
+void AccountingSpool::ScanSegment(Segment* segment) {
+    size_t offset = SPOOL_FILE_HDR_SIZE;
+    while (offset + sizeof(SpoolRecordHeader) <= segment->size) {
+        SpoolRecordHeader* hdr = (SpoolRecordHeader*)(segment->base + offset);
+        if (hdr->magic != SPOOL_RECORD_MAGIC) {
+            break;
+        }
+        if (offset + RecordSize(hdr->length) > segment->size) {
+            LOG_F(WARNING, "Accounting spool segment %s is corrupted at offset %zu", segment->path.c_str(), offset);
+            corrupted++;
+            break;
+        }
+        if (hdr->state == SPOOL_STATE_PENDING) {
+            if (Crc32(segment->base + offset + sizeof(SpoolRecordHeader), hdr->length) != hdr->crc) {
+                LOG_F(WARNING, "Dropping accounting record with bad checksum in %s", segment->path.c_str());
+                hdr->state = SPOOL_STATE_DELIVERED;
+                corrupted++;
+            } else {
+                segment->pending++;
+            }
+        }
+        offset += RecordSize(hdr->length);
+    }
+    segment->end = offset;
+}
+
+bool AccountingSpool::Open() {
+    if (mkdir(dir.c_str(), 0700) < 0 && errno != EEXIST) {
+        LOG_F(ERROR, "Unable to create accounting spool directory %s: %s", dir.c_str(), strerror(errno));
+        return false;
+    }
+
+    DIR* d = opendir(dir.c_str());
+    if (d == NULL) {
+        LOG_F(ERROR, "Unable to read accounting spool directory %s: %s", dir.c_str(), strerror(errno));
+        return false;
+    }
+    std::vector<uint64_t> seqs;
+    struct dirent* entry;
+    while ((entry = readdir(d)) != NULL) {
+        unsigned long long seq;
+        char suffix[8];
+        if (sscanf(entry->d_name, "acct-%20llu.%7s", &seq, suffix) == 2 && strcmp(suffix, "spool") == 0) {
+            seqs.push_back(seq);
+        }
+    }
+    closedir(d);
+    std::sort(seqs.begin(), seqs.end());
+
+    std::lock_guard<std::mutex> guard(lock);
+    for (size_t i = 0; i < seqs.size(); i++) {
+        nextSeq = seqs[i] + 1;
+        Segment* segment = MapSegment(seqs[i], false);
+        if (segment == NULL) {
+            continue;
+        }
+        ScanSegment(segment);
+        if (segment->pending == 0) {
+            UnmapSegment(segment, true);
+            continue;
+        }
+        pending += segment->pending;
+        segments.push_back(segment);
+    }
+
+    // Appends always start on a fresh segment
+    Segment* segment = MapSegment(nextSeq++, true);
+    if (segment == NULL) {
+        return false;
+    }
+    segments.push_back(segment);
+
+    if (pending.load() > 0) {
+        LOG_F(INFO, "Accounting spool holds %zu undelivered records", pending.load());
+    }
+    replayer = std::thread(&AccountingSpool::ReplayLoop, this);
+    return true;
+}
+
+bool AccountingSpool::Append(const AccountingRecord& record) {
+    std::string payload = SerializeRecord(record);
+    size_t size = RecordSize(payload.size());
+    if (size > segmentSize - SPOOL_FILE_HDR_SIZE) {
+        dropped++;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    if (segments.empty()) {
+        dropped++;
+        return false;
+    }
+
+    Segment* segment = segments.back();
+    if (segment->end + size > segment->size) {
+        if (segments.size() >= maxSegments) {
+            LOG_F(WARNING, "Accounting spool full, dropping record of task %d", record.task_id);
+            dropped++;
+            return false;
+        }
+        Segment* fresh = MapSegment(nextSeq++, true);
+        if (fresh == NULL) {
+            dropped++;
+            return false;
+        }
+        msync(segment->base, segment->size, MS_ASYNC);
+        segments.push_back(fresh);
+
+        // The segment being left may already be fully replayed
+        if (segments.front() == segment && segment->pending == 0) {
+            segments.pop_front();
+            UnmapSegment(segment, true);
+            readOffset = SPOOL_FILE_HDR_SIZE;
+        }
+        segment = fresh;
+    }
+
+    SpoolRecordHeader* hdr = (SpoolRecordHeader*)(segment->base + segment->end);
+    hdr->length = payload.size();
+    hdr->crc = Crc32(payload.data(), payload.size());
+    hdr->state = SPOOL_STATE_PENDING;
+    memcpy(segment->base + segment->end + sizeof(SpoolRecordHeader), payload.data(), payload.size());
+    std::atomic_thread_fence(std::memory_order_release);
+    hdr->magic = SPOOL_RECORD_MAGIC;
+
+    segment->end += size;
+    segment->pending++;
+    pending++;
+    spooled++;
+    cond.notify_one();
+    return true;
+}
+
+// Called with the lock held. Leaves readOffset on the returned record until
+// the replay thread marks it delivered.
+bool AccountingSpool::NextPending(AccountingRecord* record, uint32_t** state) {
+    while (!segments.empty()) {
+        Segment* segment = segments.front();
+        while (readOffset < segment->end) {
+            SpoolRecordHeader* hdr = (SpoolRecordHeader*)(segment->base + readOffset);
+            if (hdr->state == SPOOL_STATE_PENDING) {
+                const char* payload = segment->base + readOffset + sizeof(SpoolRecordHeader);
+                if (Crc32(payload, hdr->length) == hdr->crc && ParseRecord(payload, hdr->length, record)) {
+                    *state = &hdr->state;
+                    return true;
+                }
+                LOG_F(WARNING, "Dropping unreadable accounting record in %s", segment->path.c_str());
+                hdr->state = SPOOL_STATE_DELIVERED;
+                segment->pending--;
+                pending--;
+                corrupted++;
+            }
+            readOffset += RecordSize(hdr->length);
+        }
+
+        if (segment == segments.back()) {
+            return false;
+        }
+        segments.pop_front();
+        UnmapSegment(segment, true);
+        readOffset = SPOOL_FILE_HDR_SIZE;
+    }
+    return false;
+}
+
+void AccountingSpool::ReplayLoop() {
+    int backoff = 0;
+    std::unique_lock<std::mutex> guard(lock);
+    while (!stopping) {
+        AccountingRecord record;
+        uint32_t* state;
+        if (!NextPending(&record, &state)) {
+            cond.wait_for(guard, std::chrono::seconds(1));
+            continue;
+        }
+
+        guard.unlock();
+        int ret = sender(record);
+        guard.lock();
+
+        if (ret < 0) {
+            backoff = (backoff == 0) ? 1 : std::min(backoff * 2, SPOOL_MAX_BACKOFF_SEC);
+            LOG_F(MAX, "Accounting server still unreachable, %zu records spooled, retrying in %d sec", pending.load(), backoff);
+            // Appends notify the condition too, they must not cut the backoff short
+            std::chrono::steady_clock::time_point retry = std::chrono::steady_clock::now() + std::chrono::seconds(backoff);
+            while (!stopping && cond.wait_until(guard, retry) != std::cv_status::timeout) {
+            }
+            continue;
+        }
+
+        if (backoff != 0) {
+            LOG_F(INFO, "Accounting server reachable again, replaying %zu spooled records", pending.load());
+            backoff = 0;
+        }
+        // Appends never drop the oldest segment while it has pending records
+        *state = SPOOL_STATE_DELIVERED;
+        segments.front()->pending--;
+        pending--;
+        replayed++;
+    }
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ACCOUNTING_SPOOL_H_
+#define ACCOUNTING_SPOOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <stdint.h>
+
+#include "accounting_pipeline.h"
+
+// Accounting records that could not be delivered, kept on disk until the
+// TACACS+ server is back.
+//
+// The spool is a directory of fixed size, memory-mapped segment files that
+// are only ever appended to. Each record carries a CRC32 of its payload and a
+// delivered mark that is set in place once the server acknowledged it, so a
+// restart replays exactly the records still pending (a record whose
+// acknowledgement raced the restart may be sent twice). A replay thread sends
+// pending records oldest first, backing off while the server is unreachable,
+// and deletes segments once all of their records are delivered.
+class AccountingSpool {
+    struct Segment {
+        uint64_t seq;
+        std::string path;
+        char* base;
+        size_t size;
+        size_t end;             // offset past the last record
+        size_t pending;
+    };
+
+    std::string dir;
+    size_t segmentSize;
+    size_t maxSegments;
+    AccountingPipeline::Sender sender;
+
+    std::mutex lock;
+    std::condition_variable cond;
+    std::deque<Segment*> segments;  // oldest first, the last one takes appends
+    size_t readOffset;              // next record to replay in the oldest segment
+    uint64_t nextSeq;
+    bool stopping;
+    std::thread replayer;
+
+    Segment* MapSegment(uint64_t seq, bool create);
+    void UnmapSegment(Segment* segment, bool remove);
+    void ScanSegment(Segment* segment);
+    bool NextPending(AccountingRecord* record, uint32_t** state);
+    void ReplayLoop();
+
+    public:
+    std::atomic<size_t> pending;
+    std::atomic<unsigned long> spooled;
+    std::atomic<unsigned long> replayed;
+    std::atomic<unsigned long> dropped;
+    std::atomic<unsigned long> corrupted;
+
+    AccountingSpool(const std::string& dir, size_t max_bytes, AccountingPipeline::Sender sender);
+    ~AccountingSpool();
+
+    // Loads the records left by a previous run and starts replaying.
+    // False if the spool directory cannot be used.
+    bool Open();
+
+    // False if the spool is full or the record could not be written
+    bool Append(const AccountingRecord& record);
+
+    // Records are waiting for replay. New records should then be appended
+    // too, so that they reach the server after the older ones.
+    bool Pending() { return pending.load() > 0; }
+
+    // Ends the replay and writes the segments back to disk, the pending
+    // records are replayed by the next run
+    void Stop();
+};
+
+#endif
@@ -0,0 +1,182 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+
+#include "admission_control.h"
+#include "metrics.h"
+#include "logger.h"
+
+// Slots looked at for a key before giving up on tracking it
+#define ADMISSION_PROBES 16
+
+static const char* key_names[ADMISSION_KEY_COUNT] = { "user", "peer" };
+
+AdmissionLimits::AdmissionLimits() {
+    for (int i = 0; i < PRIORITY_CLASS_COUNT; i++) {
+        rate[i] = 0;
+        burst[i] = 0;
+    }
+}
+
+AdmissionControl::Slot::Slot() : key(0) {
+    for (int i = 0; i < PRIORITY_CLASS_COUNT; i++) {
+        full[i] = 0;
+    }
+}
+
+AdmissionControl::AdmissionControl(const AdmissionOptions& options) {
+    size_t size = 1;
+    while (size < (size_t)std::max(options.max_keys, ADMISSION_PROBES)) {
+        size <<= 1;
+    }
+    for (int k = 0; k < ADMISSION_KEY_COUNT; k++) {
+        Table& table = tables[k];
+        bool enabled = false;
+        for (int i = 0; i < PRIORITY_CLASS_COUNT; i++) {
+            int rate = options.limits[k].rate[i];
+            int burst = options.limits[k].burst[i] > 0 ? options.limits[k].burst[i] : rate;
+            table.interval[i] = rate > 0 ? 1000000000LL / rate : 0;
+            table.tolerance[i] = rate > 0 ? (burst - 1) * table.interval[i] : 0;
+            table.rejected[i] = 0;
+            if (rate > 0) {
+                enabled = true;
+                LOG_F(INFO, "Admitting %d %s calls per second per %s, bursts of %d", rate,
+                        PriorityClassName((PriorityClass)i), key_names[k], burst);
+            }
+        }
+        table.mask = enabled ? size - 1 : 0;
+        if (enabled) {
+            table.slots.reset(new Slot[size]);
+        }
+        table.tracked = 0;
+        table.reclaimed = 0;
+        table.untracked = 0;
+    }
+    metricsCollector = ProxyMetrics::Instance().AddCollector(
+            std::bind(&AdmissionControl::CollectMetrics, this, std::placeholders::_1));
+}
+
+AdmissionControl::~AdmissionControl() {
+    ProxyMetrics::Instance().RemoveCollector(metricsCollector);
+}
+
+bool AdmissionControl::Enabled(AdmissionKey kind) {
+    return tables[kind].slots != nullptr;
+}
+
+AdmissionControl::Slot* AdmissionControl::Find(Table& table, const std::string& key, int64_t now) {
+    uint64_t hash = std::hash<std::string>()(key);
+    if (hash == 0) {
+        hash = 1;
+    }
+    Slot* idle = NULL;
+    uint64_t idleOwner = 0;
+    for (size_t i = 0; i < ADMISSION_PROBES; i++) {
+        Slot* slot = &table.slots[(hash + i) & table.mask];
+        uint64_t owner = slot->key.load(std::memory_order_acquire);
+        if (owner == 0) {
+            // Whoever claims the slot first owns it, possibly another
+            // thread admitting a call of the same key
+            if (slot->key.compare_exchange_strong(owner, hash, std::memory_order_acq_rel)) {
+                table.tracked++;
+                return slot;
+            }
+        }
+        if (owner == hash) {
+            return slot;
+        }
+        if (idle == NULL) {
+            bool full = true;
+            for (int c = 0; c < PRIORITY_CLASS_COUNT && full; c++) {
+                full = slot->full[c].load(std::memory_order_relaxed) <= now;
+            }
+            if (full) {
+                idle = slot;
+                idleOwner = owner;
+            }
+        }
+    }
+    // The key is not in the table: take over a slot whose buckets are full.
+    // A call of the previous key racing with this may be charged to the new
+    // one, which errs on the side of limiting.
+    if (idle != NULL && idle->key.compare_exchange_strong(idleOwner, hash, std::memory_order_acq_rel)) {
+        table.reclaimed++;
+        return idle;
+    }
+    return NULL;
+}
+
+bool AdmissionControl::Admit(AdmissionKey kind, const std::string& key, PriorityClass cls) {
+    Table& table = tables[kind];
+    int64_t interval = table.interval[cls];
+    if (interval == 0 || !table.slots) {
+        return true;
+    }
+
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    Slot* slot = Find(table, key, now);
+    if (slot == NULL) {
+        table.untracked++;
+        slot = &table.overflow;
+    }
+
+    int64_t full = slot->full[cls].load(std::memory_order_relaxed);
+    for (;;) {
+        // The bucket holds fewer tokens than the burst the further its
+        // refill time lies ahead, none once beyond the tolerance
+        int64_t start = std::max(full, now);
+        if (start - now > table.tolerance[cls]) {
+            table.rejected[cls]++;
+            return false;
+        }
+        if (slot->full[cls].compare_exchange_weak(full, start + interval, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+}
+
+void AdmissionControl::CollectMetrics(std::string* out) {
+    typedef std::vector<std::pair<const char*, std::string> > Labels;
+    MetricsFamily(out, "tacacs_proxy_admission_rejected_total", "counter",
+            "Calls rejected for exceeding the rate of their user or peer host, per priority class");
+    for (int k = 0; k < ADMISSION_KEY_COUNT; k++) {
+        for (int i = 0; i < PRIORITY_CLASS_COUNT; i++) {
+            Labels labels;
+            labels.push_back(std::make_pair("key", key_names[k]));
+            labels.push_back(std::make_pair("class", PriorityClassName((PriorityClass)i)));
+            MetricsSample(out, "tacacs_proxy_admission_rejected_total", labels, tables[k].rejected[i]);
+        }
+    }
+    MetricsFamily(out, "tacacs_proxy_admission_tracked_keys", "gauge", "Users and peer hosts with rate limits");
+    for (int k = 0; k < ADMISSION_KEY_COUNT; k++) {
+        MetricsSample(out, "tacacs_proxy_admission_tracked_keys", Labels(1, std::make_pair("key", key_names[k])),
+                tables[k].tracked);
+    }
+    MetricsFamily(out, "tacacs_proxy_admission_reclaimed_total", "counter",
+            "Slots of idle users and peer hosts taken over by new ones");
+    for (int k = 0; k < ADMISSION_KEY_COUNT; k++) {
+        MetricsSample(out, "tacacs_proxy_admission_reclaimed_total", Labels(1, std::make_pair("key", key_names[k])),
+                tables[k].reclaimed);
+    }
+    MetricsFamily(out, "tacacs_proxy_admission_untracked_total", "counter",
+            "Calls limited by the shared overflow bucket because the table of their key was full");
+    for (int k = 0; k < ADMISSION_KEY_COUNT; k++) {
+        MetricsSample(out, "tacacs_proxy_admission_untracked_total", Labels(1, std::make_pair("key", key_names[k])),
+                tables[k].untracked);
+    }
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef ADMISSION_CONTROL_H_
+#define ADMISSION_CONTROL_H_
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <stdint.h>
+
+#include "priority_scheduler.h"
+
+// Clients are told apart by the user TACACS+ authenticated and by the host
+// they call from
+enum AdmissionKey {
+    ADMISSION_USER,
+    ADMISSION_PEER,
+    ADMISSION_KEY_COUNT
+};
+
+// Sustained calls per second and burst per priority class, 0 for no limit.
+// A burst of 0 allows one second worth of calls at once.
+struct AdmissionLimits {
+    int rate[PRIORITY_CLASS_COUNT];
+    int burst[PRIORITY_CLASS_COUNT];
+
+    AdmissionLimits();
+};
+
+struct AdmissionOptions {
+    AdmissionLimits limits[ADMISSION_KEY_COUNT];
+    // Users and hosts tracked per key, rounded up to a power of two
+    int max_keys;
+
+    AdmissionOptions() : max_keys(4096) {}
+};
+
+// Rate limits of the calls of every user and every peer host, per priority
+// class of the method, so that one misbehaving client cannot flood the agent
+// with flow or OMCI configuration at the expense of the others.
+//
+// Each limit is a token bucket, kept as the single timestamp of the generic
+// cell rate algorithm: the bucket is full again at that time and a call
+// takes a token by moving it one interval ahead, with a compare and swap.
+// Buckets live in a fixed table of slots, found by probing from the hash of
+// the key and claimed by compare and swap as well, so admitting a call never
+// locks or allocates. A slot whose buckets are all full again is as good as
+// free and goes to the next new key that probes it; should its key come
+// back, it starts over with full buckets just the same. Keys that find no
+// such slot share one overflow bucket per table and are counted as
+// untracked.
+class AdmissionControl {
+    struct Slot {
+        std::atomic<uint64_t> key;      // hash of the key, 0 while free
+        std::atomic<int64_t> full[PRIORITY_CLASS_COUNT];
+
+        Slot();
+    };
+
+    struct Table {
+        // Nanoseconds per call and burst tolerance, interval 0 for no limit
+        int64_t interval[PRIORITY_CLASS_COUNT];
+        int64_t tolerance[PRIORITY_CLASS_COUNT];
+        std::unique_ptr<Slot[]> slots;
+        size_t mask;
+        Slot overflow;
+        std::atomic<unsigned long> tracked;
+        std::atomic<unsigned long> reclaimed;
+        std::atomic<unsigned long> untracked;
+        std::atomic<unsigned long> rejected[PRIORITY_CLASS_COUNT];
+    };
+
+    Table tables[ADMISSION_KEY_COUNT];
+    int metricsCollector;
+
+    // Slot of key, claimed if need be; NULL if none of the probed slots is
+    // free or reclaimable at now
+    Slot* Find(Table& table, const std::string& key, int64_t now);
+
+    public:
+    AdmissionControl(const AdmissionOptions& options);
+    ~AdmissionControl();
+
+    // Whether any class is limited per key
+    bool Enabled(AdmissionKey kind);
+
+    // Takes a token from the bucket of key for cls. False if it is empty,
+    // the call is then to be rejected.
+    bool Admit(AdmissionKey kind, const std::string& key, PriorityClass cls);
+
+    void CollectMetrics(std::string* out);
+};
+
+#endif
@@ -0,0 +1,300 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "async_log.h"
+#include "metrics.h"
+#include "logger.h"
+
+// Message text kept in the ring; longer messages are copied to the heap
+#define ASYNC_LOG_TEXT_SIZE 256
+// Longest the writer sleeps before draining the rings
+#define ASYNC_LOG_DRAIN_MS 10
+
+struct LogRecord {
+    loguru::Verbosity verbosity;
+    const char* file;
+    unsigned line;
+    long long ms_since_epoch;
+    char* longText;
+    char text[ASYNC_LOG_TEXT_SIZE];
+
+    const char* Text() const { return longText != NULL ? longText : text; }
+};
+
+// Messages of one logging thread. The thread only moves tail and the writer
+// only moves head, so neither needs more than acquire/release ordering.
+struct LogRing {
+    std::unique_ptr<LogRecord[]> records;
+    size_t mask;
+    char threadName[LOGURU_THREADNAME_WIDTH + 1];
+    char pad0[64];
+    std::atomic<size_t> head;
+    char pad1[64];
+    std::atomic<size_t> tail;
+    char pad2[64];
+    std::atomic<unsigned long> dropped;
+    // Set once the thread exited; the writer frees the ring when drained
+    std::atomic<bool> orphaned;
+
+    LogRing(size_t capacity) : head(0), tail(0), dropped(0), orphaned(false) {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        records.reset(new LogRecord[size]);
+        mask = size - 1;
+        loguru::get_thread_name(threadName, sizeof(threadName), true);
+    }
+};
+
+// Hands the ring of a thread over to the writer when the thread exits
+struct LogRingOwner {
+    LogRing* ring;
+
+    LogRingOwner() : ring(NULL) {}
+    ~LogRingOwner() {
+        if (ring != NULL) {
+            ring->orphaned = true;
+            ring = NULL;
+        }
+    }
+};
+
+static std::atomic<bool> running(false);
+static size_t ringSize;
+static LogOverflowPolicy overflowPolicy;
+static std::mutex ringsLock;
+static std::vector<LogRing*> rings;
+static std::mutex drainLock;
+static std::vector<std::pair<LogRecord*, LogRing*> > batch;
+static std::mutex wakeLock;
+static std::condition_variable wakeCond;
+static std::thread writer;
+static std::atomic<unsigned long> droppedTotal(0);
+static std::atomic<unsigned long> writtenTotal(0);
+static thread_local LogRingOwner localRing;
+// Set on a thread draining the rings, whose own messages must not go to them
+static thread_local bool draining = false;
+
+bool ParseLogOverflowPolicy(const char* name, LogOverflowPolicy* policy) {
+    if (strcmp(name, "drop") == 0) {
+        *policy = LOG_OVERFLOW_DROP;
+    } else if (strcmp(name, "block") == 0) {
+        *policy = LOG_OVERFLOW_BLOCK;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static LogRing* LocalRing() {
+    if (localRing.ring == NULL) {
+        LogRing* ring = new LogRing(ringSize);
+        std::lock_guard<std::mutex> guard(ringsLock);
+        rings.push_back(ring);
+        localRing.ring = ring;
+    }
+    return localRing.ring;
+}
+
+static void WakeWriter() {
+    wakeCond.notify_one();
+}
+
+// Writes out everything buffered so far. Called with drainLock held.
+static void DrainRings() {
+    std::vector<LogRing*> current;
+    {
+        std::lock_guard<std::mutex> guard(ringsLock);
+        current = rings;
+    }
+    std::vector<size_t> ends(current.size());
+    std::vector<bool> done(current.size());
+    batch.clear();
+    for (size_t i = 0; i < current.size(); i++) {
+        LogRing* ring = current[i];
+        // An orphaned ring gets no more messages after those read here
+        done[i] = ring->orphaned;
+        ends[i] = ring->tail.load(std::memory_order_acquire);
+        for (size_t pos = ring->head.load(std::memory_order_relaxed); pos != ends[i]; pos++) {
+            batch.push_back(std::make_pair(&ring->records[pos & ring->mask], ring));
+        }
+    }
+
+    // Interleave the threads by time, each thread keeping its own order
+    std::stable_sort(batch.begin(), batch.end(), [](const std::pair<LogRecord*, LogRing*>& a,
+                const std::pair<LogRecord*, LogRing*>& b) {
+        return a.first->ms_since_epoch < b.first->ms_since_epoch;
+    });
+    for (size_t i = 0; i < batch.size(); i++) {
+        LogRecord* record = batch[i].first;
+        loguru::log_deferred(record->verbosity, record->file, record->line, record->ms_since_epoch,
+                batch[i].second->threadName, record->Text());
+        free(record->longText);
+        record->longText = NULL;
+    }
+    writtenTotal += batch.size();
+
+    long long now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    for (size_t i = 0; i < current.size(); i++) {
+        LogRing* ring = current[i];
+        ring->head.store(ends[i], std::memory_order_release);
+        unsigned long dropped = ring->dropped.exchange(0);
+        if (dropped > 0) {
+            char text[96];
+            snprintf(text, sizeof(text), "%lu log messages dropped, the log writer fell behind", dropped);
+            loguru::log_deferred(loguru::Verbosity_WARNING, __FILE__, __LINE__, now_ms, ring->threadName, text);
+        }
+    }
+    if (!batch.empty()) {
+        loguru::flush();
+    }
+
+    for (size_t i = 0; i < current.size(); i++) {
+        if (done[i]) {
+            std::lock_guard<std::mutex> guard(ringsLock);
+            rings.erase(std::find(rings.begin(), rings.end(), current[i]));
+            delete current[i];
+        }
+    }
+}
+
+static void Drain() {
+    if (draining) {
+        return;
+    }
+    std::lock_guard<std::mutex> guard(drainLock);
+    draining = true;
+    DrainRings();
+    draining = false;
+}
+
+static bool Intercept(loguru::Verbosity verbosity, const char* file, unsigned line, const char* format,
+        va_list vlist) {
+    if (!running || draining) {
+        return false;
+    }
+    LogRing* ring = LocalRing();
+    size_t tail = ring->tail.load(std::memory_order_relaxed);
+    while (tail - ring->head.load(std::memory_order_acquire) > ring->mask) {
+        if (overflowPolicy == LOG_OVERFLOW_DROP) {
+            ring->dropped++;
+            droppedTotal++;
+            return true;
+        }
+        WakeWriter();
+        std::this_thread::yield();
+        if (!running) {
+            return false;
+        }
+    }
+
+    LogRecord* record = &ring->records[tail & ring->mask];
+    record->verbosity = verbosity;
+    record->file = file;
+    record->line = line;
+    record->ms_since_epoch = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    record->longText = NULL;
+    va_list retry;
+    va_copy(retry, vlist);
+    int len = vsnprintf(record->text, sizeof(record->text), format, vlist);
+    if (len >= (int)sizeof(record->text)) {
+        record->longText = (char*)malloc(len + 1);
+        if (record->longText != NULL) {
+            vsnprintf(record->longText, len + 1, format, retry);
+        }
+    }
+    va_end(retry);
+    ring->tail.store(tail + 1, std::memory_order_release);
+
+    // Do not wait for the next round when the ring is filling up
+    if (tail + 1 - ring->head.load(std::memory_order_relaxed) > ring->mask / 2) {
+        WakeWriter();
+    }
+    return true;
+}
+
+static void WriteLoop() {
+    loguru::set_thread_name("log writer");
+    while (running) {
+        {
+            std::unique_lock<std::mutex> guard(wakeLock);
+            wakeCond.wait_for(guard, std::chrono::milliseconds(ASYNC_LOG_DRAIN_MS));
+        }
+        Drain();
+    }
+}
+
+void AsyncLog::Start(int ring_size, LogOverflowPolicy policy) {
+    if (running) {
+        return;
+    }
+    ringSize = ring_size > 0 ? ring_size : 1;
+    overflowPolicy = policy;
+    running = true;
+    writer = std::thread(WriteLoop);
+    loguru::set_async_backend(Intercept, Drain);
+    std::atexit(AsyncLog::Stop);
+    ProxyMetrics::Instance().AddCollector(AsyncLog::CollectMetrics);
+}
+
+void AsyncLog::Stop() {
+    if (!running.exchange(false)) {
+        return;
+    }
+    loguru::set_async_backend(NULL, NULL);
+    WakeWriter();
+    if (writer.joinable()) {
+        writer.join();
+    }
+    // Messages of threads that were still inside a log call
+    Drain();
+}
+
+void AsyncLog::CollectMetrics(std::string* out) {
+    typedef std::vector<std::pair<const char*, std::string> > Labels;
+    size_t pending = 0;
+    size_t count;
+    {
+        std::lock_guard<std::mutex> guard(ringsLock);
+        count = rings.size();
+        for (size_t i = 0; i < rings.size(); i++) {
+            pending += rings[i]->tail.load(std::memory_order_relaxed) - rings[i]->head.load(std::memory_order_relaxed);
+        }
+    }
+    MetricsFamily(out, "tacacs_proxy_log_messages_written_total", "counter",
+            "Log messages written by the background log writer");
+    MetricsSample(out, "tacacs_proxy_log_messages_written_total", Labels(), writtenTotal);
+    MetricsFamily(out, "tacacs_proxy_log_messages_dropped_total", "counter",
+            "Log messages dropped because the ring of the logging thread was full");
+    MetricsSample(out, "tacacs_proxy_log_messages_dropped_total", Labels(), droppedTotal);
+    MetricsFamily(out, "tacacs_proxy_log_messages_pending", "gauge", "Log messages waiting for the log writer");
+    MetricsSample(out, "tacacs_proxy_log_messages_pending", Labels(), pending);
+    MetricsFamily(out, "tacacs_proxy_log_rings", "gauge", "Threads with a log ring");
+    MetricsSample(out, "tacacs_proxy_log_rings", Labels(), count);
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef ASYNC_LOG_H_
+#define ASYNC_LOG_H_
+
+#include <string>
+
+// What a logging thread does when its ring is full
+enum LogOverflowPolicy {
+    LOG_OVERFLOW_DROP,      // the message is dropped and counted
+    LOG_OVERFLOW_BLOCK      // the thread waits for the writer to make room
+};
+
+// Parses drop or block. False if unknown.
+bool ParseLogOverflowPolicy(const char* name, LogOverflowPolicy* policy);
+
+// Asynchronous backend for the LOG_F macros.
+//
+// Loguru formats, writes and flushes every message under a global mutex on
+// the logging thread. Once started, messages below FATAL are instead copied
+// into a single-producer/single-consumer ring of the logging thread, with
+// only the message text formatted there. A background writer drains the
+// rings every few milliseconds, formats the preambles and writes the whole
+// batch before flushing once. FATAL messages stay synchronous and first
+// drain the rings, so nothing logged before them is lost.
+class AsyncLog {
+    public:
+    // ring_size is the number of messages buffered per logging thread,
+    // rounded up to a power of two
+    static void Start(int ring_size, LogOverflowPolicy policy);
+    // Writes out the buffered messages and logs synchronously again
+    static void Stop();
+
+    static void CollectMetrics(std::string* out);
+};
+
+#endif
@@ -0,0 +1,807 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <grpcpp/alarm.h>
+#include <grpcpp/health_check_service_interface.h>
+
+#include "async_proxy_server.h"
+#include "proxy_common.h"
+#include "proxy_methods.h"
+#include "metrics.h"
+#include "logger.h"
+
+using grpc::ServerAsyncResponseWriter;
+using grpc::ServerAsyncWriter;
+using grpc::ClientAsyncResponseReader;
+using grpc::ClientAsyncReader;
+using grpc::ByteBuffer;
+using grpc::GenericServerContext;
+using grpc::GenericServerAsyncReaderWriter;
+using grpc::GenericClientAsyncReaderWriter;
+
+// Base of the per-call state machines. The object itself is the tag of the
+// single operation outstanding on its completion queue at any time.
+// Accounting START of a call on the TACACS+ engine. Shared with the START
+// callback, which may come after the call stopped waiting and went away.
+struct StartWait {
+    std::mutex lock;
+    AsyncProxyCall* call;       // NULL once the call no longer waits
+    bool started;
+    bool authenticated;
+
+    StartWait(AsyncProxyCall* waiting) : call(waiting), started(false), authenticated(false) {}
+};
+
+class AsyncProxyCall {
+    public:
+    AsyncProxyCall(AsyncProxyServer* proxy, ServerCompletionQueue* queue, const ProxyMethod* proxy_method) :
+        server(proxy), cq(queue), method(proxy_method), state(LISTEN), accounting(false), overCap(false),
+        batched(0), flushing(false) {}
+    virtual ~AsyncProxyCall() {}
+
+    // Advances the state machine on completion of the outstanding operation
+    virtual void Proceed(bool ok) = 0;
+
+    protected:
+    enum CallState {
+        LISTEN,
+        READ_REQUEST,
+        AUTHENTICATE,
+        FORWARD,
+        STREAM_START,
+        STREAM_SEND,
+        STREAM_READ,
+        STREAM_WRITE,
+        STREAM_FINISH,
+        FINISH
+    };
+
+    AsyncProxyServer* server;
+    ServerCompletionQueue* cq;
+    const ProxyMethod* method;
+    CallState state;
+    // Created on forwarding, from the server context
+    unique_ptr<ClientContext> clientCtx;
+    UpstreamLease upstreamLease;
+    TacacsContext tacCtx;
+    Status status;
+    bool accounting;
+    // Accepted over the in-flight cap, answered without being processed
+    bool overCap;
+    std::shared_ptr<StartWait> startWait;
+    unique_ptr<grpc::Alarm> alarm;
+    // Set once accepted, recording when the call object goes away
+    unique_ptr<CallTracker> tracker;
+    unique_ptr<PhaseTimer> upstreamTimer;
+    // Indication streams read from the shared upstream stream of the hub
+    std::shared_ptr<IndicationSubscriber> subscriber;
+    IndicationPtr indication;
+    // Indications written since the last flush, and when the first of them was
+    int batched;
+    bool flushing;
+    std::chrono::steady_clock::time_point batchStart;
+
+    AsyncProxyService* Service() { return &server->service; }
+    // Stubs of the channel leased by UpstreamCall
+    openolt::Openolt::Stub* Stub() { return upstreamLease.Stub(); }
+    grpc::AsyncGenericService* GenericService() { return &server->genericService; }
+    grpc::GenericStub* GenericStub() { return upstreamLease.GenericStub(); }
+
+    virtual ServerContext* Context() = 0;
+    // Context of the upstream call, tied to the deadline and cancellation of the client
+    ClientContext* UpstreamCall(bool streaming);
+    void Subscribe();
+    // Takes the next indication. Without one, Proceed runs again once there
+    // is one or the subscriber got closed.
+    bool NextIndication();
+    // Options for writing the current indication: buffered while more are
+    // queued behind it, up to INDICATION_BATCH_MAX
+    grpc::WriteOptions IndicationWriteOptions();
+    // Accounts a completed indication write
+    void IndicationWritten();
+    // Returns a function posting a fresh listener for this method and queue
+    virtual std::function<void()> Listener() = 0;
+    // Sends the request to the openolt agent
+    virtual void Forward() = 0;
+    // Completes the call towards the client with the current status
+    virtual void FinishCall() = 0;
+
+    bool Rearm();
+    void Accept();
+    void Authenticate();
+    void OnAuthenticated();
+    void Reply(const Status& reply_status);
+    void Done();
+
+    private:
+    // Hands the call back to its queue, after delay
+    void ResumeOnQueue(std::chrono::milliseconds delay = std::chrono::milliseconds(0));
+};
+
+// Re-arms the listener for this method, false if the call is over the cap
+bool AsyncProxyCall::Rearm() {
+    return server->CallAccepted(Listener());
+}
+
+void AsyncProxyCall::Accept() {
+    overCap = !Rearm();
+    LOG_F(INFO, "%s invoked", method->name);
+    tracker.reset(new CallTracker(ProxyMetrics::Instance().Method(method->name)));
+}
+
+ClientContext* AsyncProxyCall::UpstreamCall(bool streaming) {
+    clientCtx = UpstreamContext(Context(), streaming);
+    upstreamLease = streaming ? server->channelPool->AcquireStreaming() : server->channelPool->Acquire();
+    if (tracker) {
+        upstreamTimer.reset(new PhaseTimer(tracker->Method(), METRICS_PHASE_UPSTREAM));
+    }
+    return clientCtx.get();
+}
+
+void AsyncProxyCall::Subscribe() {
+    subscriber = server->indicationHub->Subscribe(Context()->peer());
+    if (tracker) {
+        upstreamTimer.reset(new PhaseTimer(tracker->Method(), METRICS_PHASE_UPSTREAM));
+    }
+}
+
+bool AsyncProxyCall::NextIndication() {
+    return subscriber->TryNext(&indication, [this]() {
+        ResumeOnQueue();
+    });
+}
+
+grpc::WriteOptions AsyncProxyCall::IndicationWriteOptions() {
+    if (batched++ == 0) {
+        batchStart = std::chrono::steady_clock::now();
+    }
+    grpc::WriteOptions options;
+    flushing = batched >= INDICATION_BATCH_MAX || subscriber->Pending() == 0;
+    if (!flushing) {
+        options.set_buffer_hint();
+    }
+    return options;
+}
+
+void AsyncProxyCall::IndicationWritten() {
+    if (flushing) {
+        server->indicationHub->RecordFlush(batched, std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - batchStart).count());
+        batched = 0;
+    }
+}
+
+void AsyncProxyCall::Authenticate() {
+    TaccController* taccController = server->taccController;
+    if (overCap) {
+        Reply(Status(grpc::RESOURCE_EXHAUSTED, "Too many calls, retry later"));
+        return;
+    }
+    if (!taccController->IsTacacsEnabled()) {
+        LOG_F(INFO, "Tacacs disabled.. Calling %s", method->name);
+        Forward();
+        return;
+    }
+
+    tacCtx = ExtractTacacsContext(Context());
+    if (tacCtx.username.empty()) {
+        Reply(Status(grpc::INVALID_ARGUMENT,"Unable to find or extract credentials from incoming gRPC request"));
+        return;
+    }
+
+    tacCtx.method_name = method->tacacs_cmd;
+    tacCtx.metrics = tracker ? tracker->Method() : NULL;
+    Status rejected;
+    if (DeadlineExpired(&tacCtx, &rejected) ||
+            AdmissionRejected(ADMISSION_PEER, server->scheduler, method->name, &tacCtx, &rejected)) {
+        Reply(rejected);
+        return;
+    }
+    taccController->AllotBudget(&tacCtx);
+    accounting = true;
+    state = AUTHENTICATE;
+    if (taccController->HasEngine()) {
+        // Accounting START and the TACACS+ exchanges run concurrently, on the
+        // accounting workers and the engine's I/O threads, nothing here waits
+        // on the network. The call resumes once both are settled, or once an
+        // authorized call waited out AccountingStartWait for START.
+        std::shared_ptr<StartWait> wait = std::make_shared<StartWait>(this);
+        startWait = wait;
+        int task_id = tacCtx.task_id;
+        taccController->StartAccounting(&tacCtx, [wait, task_id](bool delivered) {
+            if (!delivered) {
+                LOG_F(WARNING, "Accounting START of task %d could not be delivered", task_id);
+            }
+            std::lock_guard<std::mutex> guard(wait->lock);
+            wait->started = true;
+            if (wait->call != NULL && wait->authenticated && wait->call->alarm) {
+                // A cancelled alarm fires at once
+                wait->call->alarm->Cancel();
+            }
+        });
+        ProcessTacacsAuthAsync(taccController, &tacCtx, [this, wait](const Status& auth_status) {
+            status = auth_status;
+            std::lock_guard<std::mutex> guard(wait->lock);
+            wait->authenticated = true;
+            if (wait->started || status.error_code() != StatusCode::OK) {
+                ResumeOnQueue();
+            } else {
+                ResumeOnQueue(AccountingStartWait(&tacCtx));
+            }
+        });
+        return;
+    }
+    server->scheduler->Submit(method->name, [this, taccController]() {
+        status = ProcessTacacsRequest(taccController, NULL, method->name, NULL, &tacCtx);
+        ResumeOnQueue();
+    });
+}
+
+void AsyncProxyCall::OnAuthenticated() {
+    if (startWait) {
+        // A START record still to come is no longer waited for
+        std::lock_guard<std::mutex> guard(startWait->lock);
+        if (!startWait->started && status.error_code() == StatusCode::OK) {
+            LOG_F(WARNING, "Accounting START of task %d still pending, proceeding", tacCtx.task_id);
+        }
+        startWait->call = NULL;
+    }
+    if(status.error_code() == StatusCode::OK && tacCtx.deadline <= TaccClock::now()) {
+        LOG_F(WARNING, "Deadline of %s call expired during the TACACS+ checks", method->name);
+        status = Status(DEADLINE_EXCEEDED, "Deadline expired during the TACACS+ checks");
+    }
+    if(status.error_code() == StatusCode::OK) {
+        AdmissionRejected(ADMISSION_USER, server->scheduler, method->name, &tacCtx, &status);
+    }
+    if(status.error_code() == StatusCode::OK) {
+        AttachSessionToken(Context(), &tacCtx);
+        LOG_F(INFO, "Calling %s", method->name);
+        Forward();
+    } else {
+        Reply(status);
+    }
+}
+
+void AsyncProxyCall::Reply(const Status& reply_status) {
+    status = reply_status;
+    upstreamTimer.reset();
+    upstreamLease.Release();
+    if (subscriber) {
+        server->indicationHub->Unsubscribe(subscriber);
+    }
+    if (accounting) {
+        string error_msg = "no error";
+        if(status.error_code() != StatusCode::OK) {
+            error_msg = status.error_message();
+        }
+        // Only queues the record, cheap enough for the completion queue thread
+        server->taccController->StopAccounting(&tacCtx, error_msg);
+    }
+    state = FINISH;
+    FinishCall();
+}
+
+void AsyncProxyCall::Done() {
+    server->CallFinished();
+    delete this;
+}
+
+// Called from an auth worker or the indication hub; hands the call back to its completion queue.
+// Once the queues are shut down the call is dropped instead: the server
+// cancelled it towards the client already and the process is going away,
+// while freeing it here could pull it from under a caller still on the stack.
+void AsyncProxyCall::ResumeOnQueue(std::chrono::milliseconds delay) {
+    std::lock_guard<std::mutex> guard(server->callLock);
+    if (server->queuesShutDown) {
+        LOG_F(MAX, "%s call resumed after shutdown, dropped", method->name);
+        return;
+    }
+    alarm.reset(new grpc::Alarm());
+    alarm->Set(cq, gpr_time_add(gpr_now(GPR_CLOCK_MONOTONIC), gpr_time_from_millis(delay.count(), GPR_TIMESPAN)), this);
+}
+
+template <class Req, class Resp>
+class AsyncUnaryCall : public AsyncProxyCall {
+    public:
+    typedef void (AsyncProxyService::*RequestMethod)(ServerContext*, Req*, ServerAsyncResponseWriter<Resp>*,
+            grpc::CompletionQueue*, ServerCompletionQueue*, void*);
+    typedef unique_ptr<ClientAsyncResponseReader<Resp> > (openolt::Openolt::Stub::*ForwardMethod)(ClientContext*,
+            const Req&, grpc::CompletionQueue*);
+
+    AsyncUnaryCall(AsyncProxyServer* proxy, ServerCompletionQueue* queue, const ProxyMethod* proxy_method,
+            RequestMethod request_method, ForwardMethod forward_method) :
+        AsyncProxyCall(proxy, queue, proxy_method), requestMethod(request_method),
+        forwardMethod(forward_method), responder(&serverCtx) {
+        (Service()->*requestMethod)(&serverCtx, &request, &responder, cq, cq, this);
+    }
+
+    void Proceed(bool ok) override {
+        switch (state) {
+            case LISTEN:
+                if (!ok) {
+                    // Server is shutting down
+                    delete this;
+                    return;
+                }
+                Accept();
+                Authenticate();
+                break;
+            case AUTHENTICATE:
+                OnAuthenticated();
+                break;
+            case FORWARD:
+                Reply(status);
+                break;
+            case FINISH:
+                Done();
+                break;
+            default:
+                LOG_F(ERROR, "%s: unexpected call state %d", method->name, state);
+                break;
+        }
+    }
+
+    protected:
+    ServerContext* Context() override {
+        return &serverCtx;
+    }
+
+    std::function<void()> Listener() override {
+        AsyncProxyServer* proxy = server;
+        ServerCompletionQueue* queue = cq;
+        const ProxyMethod* proxy_method = method;
+        RequestMethod request_method = requestMethod;
+        ForwardMethod forward_method = forwardMethod;
+        return [proxy, queue, proxy_method, request_method, forward_method]() {
+            new AsyncUnaryCall<Req, Resp>(proxy, queue, proxy_method, request_method, forward_method);
+        };
+    }
+
+    void Forward() override {
+        state = FORWARD;
+        ClientContext* ctx = UpstreamCall(false);
+        upstream = (Stub()->*forwardMethod)(ctx, request, cq);
+        upstream->StartCall();
+        upstream->Finish(&response, &status, this);
+    }
+
+    void FinishCall() override {
+        if(status.error_code() == StatusCode::OK) {
+            responder.Finish(response, status, this);
+        } else {
+            responder.FinishWithError(status, this);
+        }
+    }
+
+    private:
+    RequestMethod requestMethod;
+    ForwardMethod forwardMethod;
+    ServerContext serverCtx;
+    Req request;
+    Resp response;
+    ServerAsyncResponseWriter<Resp> responder;
+    unique_ptr<ClientAsyncResponseReader<Resp> > upstream;
+};
+
+// EnableIndication: relays the indications of the shared upstream stream
+// one message at a time
+class AsyncIndicationCall : public AsyncProxyCall {
+    public:
+    AsyncIndicationCall(AsyncProxyServer* proxy, ServerCompletionQueue* queue) :
+        AsyncProxyCall(proxy, queue, FindProxyMethod("EnableIndication")), writer(&serverCtx) {
+        Service()->RequestEnableIndication(&serverCtx, &request, &writer, cq, cq, this);
+    }
+
+    void Proceed(bool ok) override {
+        switch (state) {
+            case LISTEN:
+                if (!ok) {
+                    delete this;
+                    return;
+                }
+                Accept();
+                Authenticate();
+                break;
+            case AUTHENTICATE:
+                OnAuthenticated();
+                break;
+            case STREAM_READ:
+                RelayNext();
+                break;
+            case STREAM_WRITE:
+                if (ok) {
+                    IndicationWritten();
+                    RelayNext();
+                } else {
+                    LOG_F(WARNING, "Grpc Stream broken while sending out Indication");
+                    Reply(Status(grpc::CANCELLED, "Client stream broken"));
+                }
+                break;
+            case FINISH:
+                Done();
+                break;
+            default:
+                LOG_F(ERROR, "%s: unexpected call state %d", method->name, state);
+                break;
+        }
+    }
+
+    protected:
+    ServerContext* Context() override {
+        return &serverCtx;
+    }
+
+    std::function<void()> Listener() override {
+        AsyncProxyServer* proxy = server;
+        ServerCompletionQueue* queue = cq;
+        return [proxy, queue]() {
+            new AsyncIndicationCall(proxy, queue);
+        };
+    }
+
+    void Forward() override {
+        Subscribe();
+        RelayNext();
+    }
+
+    void FinishCall() override {
+        writer.Finish(status, this);
+    }
+
+    private:
+    ServerContext serverCtx;
+    openolt::Empty request;
+    ServerAsyncWriter<openolt::Indication> writer;
+
+    void RelayNext() {
+        state = STREAM_READ;
+        if (NextIndication()) {
+            LOG_F(MAX, "Sending out Indication type %d", indication->data_case());
+            state = STREAM_WRITE;
+            writer.Write(*indication, IndicationWriteOptions(), this);
+        } else if (subscriber->Closed()) {
+            Reply(subscriber->ClosedStatus());
+        }
+    }
+};
+
+// Opaque forwarding of any proxied method. The request and the response
+// messages are relayed as ByteBuffers without being parsed.
+class GenericProxyCall : public AsyncProxyCall {
+    public:
+    GenericProxyCall(AsyncProxyServer* proxy, ServerCompletionQueue* queue) :
+        AsyncProxyCall(proxy, queue, NULL), stream(&serverCtx), haveResponse(false) {
+        GenericService()->RequestCall(&serverCtx, &stream, cq, cq, this);
+    }
+
+    void Proceed(bool ok) override {
+        switch (state) {
+            case LISTEN:
+                if (!ok) {
+                    delete this;
+                    return;
+                }
+                method = FindProxyMethodByPath(serverCtx.method());
+                if (method == NULL) {
+                    Rearm();
+                    LOG_F(WARNING, "Rejecting call to unsupported method %s", serverCtx.method().c_str());
+                    Reply(Status(grpc::UNIMPLEMENTED, "Method not supported by TACACS Proxy"));
+                    return;
+                }
+                Accept();
+                state = READ_REQUEST;
+                stream.Read(&request, this);
+                break;
+            case READ_REQUEST:
+                if (!ok) {
+                    Reply(Status(grpc::INVALID_ARGUMENT, "Missing request message"));
+                    return;
+                }
+                Authenticate();
+                break;
+            case AUTHENTICATE:
+                OnAuthenticated();
+                break;
+            case STREAM_START:
+                if (ok) {
+                    state = STREAM_SEND;
+                    upstream->WriteLast(request, grpc::WriteOptions(), this);
+                } else {
+                    FinishUpstream();
+                }
+                break;
+            case STREAM_SEND:
+                if (ok) {
+                    state = STREAM_READ;
+                    upstream->Read(&response, this);
+                } else {
+                    FinishUpstream();
+                }
+                break;
+            case STREAM_READ:
+                if (subscriber) {
+                    RelayNextIndication();
+                } else if (ok && method->server_streaming) {
+                    LOG_F(MAX, "Relaying %s message", method->name);
+                    state = STREAM_WRITE;
+                    stream.Write(response, this);
+                } else {
+                    haveResponse = ok;
+                    FinishUpstream();
+                }
+                break;
+            case STREAM_WRITE:
+                if (ok && subscriber) {
+                    IndicationWritten();
+                    RelayNextIndication();
+                } else if (ok) {
+                    state = STREAM_READ;
+                    upstream->Read(&response, this);
+                } else if (subscriber) {
+                    LOG_F(WARNING, "Grpc Stream broken while relaying %s", method->name);
+                    Reply(Status(grpc::CANCELLED, "Client stream broken"));
+                } else {
+                    LOG_F(WARNING, "Grpc Stream broken while relaying %s", method->name);
+                    clientCtx->TryCancel();
+                    FinishUpstream();
+                }
+                break;
+            case STREAM_FINISH:
+                Reply(status);
+                break;
+            case FINISH:
+                Done();
+                break;
+            default:
+                LOG_F(ERROR, "%s: unexpected call state %d", serverCtx.method().c_str(), state);
+                break;
+        }
+    }
+
+    protected:
+    ServerContext* Context() override {
+        return &serverCtx;
+    }
+
+    std::function<void()> Listener() override {
+        AsyncProxyServer* proxy = server;
+        ServerCompletionQueue* queue = cq;
+        return [proxy, queue]() {
+            new GenericProxyCall(proxy, queue);
+        };
+    }
+
+    void Forward() override {
+        if (strcmp(method->name, "EnableIndication") == 0) {
+            // Indications come from the shared upstream stream like in the typed mode
+            Subscribe();
+            RelayNextIndication();
+            return;
+        }
+        state = STREAM_START;
+        ClientContext* ctx = UpstreamCall(method->server_streaming);
+        upstream = GenericStub()->PrepareCall(ctx, method->path, cq);
+        upstream->StartCall(this);
+    }
+
+    void FinishCall() override {
+        if (haveResponse && status.error_code() == StatusCode::OK) {
+            stream.WriteAndFinish(response, grpc::WriteOptions(), status, this);
+        } else {
+            stream.Finish(status, this);
+        }
+    }
+
+    private:
+    GenericServerContext serverCtx;
+    GenericServerAsyncReaderWriter stream;
+    unique_ptr<GenericClientAsyncReaderWriter> upstream;
+    ByteBuffer request;
+    ByteBuffer response;
+    // Unary response held back so it goes out together with the status
+    bool haveResponse;
+
+    void FinishUpstream() {
+        state = STREAM_FINISH;
+        upstream->Finish(&status, this);
+    }
+
+    void RelayNextIndication() {
+        state = STREAM_READ;
+        if (NextIndication()) {
+            bool own_buffer;
+            grpc::SerializationTraits<openolt::Indication>::Serialize(*indication, &response, &own_buffer);
+            state = STREAM_WRITE;
+            stream.Write(response, IndicationWriteOptions(), this);
+        } else if (subscriber->Closed()) {
+            Reply(subscriber->ClosedStatus());
+        }
+    }
+};
+
+template <class Req, class Resp>
+static void ListenUnary(AsyncProxyServer* proxy, ServerCompletionQueue* cq, const char* name,
+        typename AsyncUnaryCall<Req, Resp>::RequestMethod request_method,
+        typename AsyncUnaryCall<Req, Resp>::ForwardMethod forward_method) {
+    new AsyncUnaryCall<Req, Resp>(proxy, cq, FindProxyMethod(name), request_method, forward_method);
+}
+
+AsyncProxyServer::AsyncProxyServer(TaccController* tacctrl, UpstreamChannelPool* pool, IndicationHub* hub, PriorityScheduler* priority_scheduler, bool opaque_forwarding, int cq_threads, int max_inflight_calls) :
+    taccController(tacctrl), channelPool(pool), indicationHub(hub), opaque(opaque_forwarding), scheduler(priority_scheduler), inflightCalls(0), shuttingDown(false), queuesShutDown(false) {
+    numCqThreads = (cq_threads > 0) ? cq_threads : 1;
+    maxInflightCalls = (max_inflight_calls > 0) ? max_inflight_calls : 1;
+}
+
+void AsyncProxyServer::ListenAll(ServerCompletionQueue* cq) {
+    typedef openolt::Openolt::Stub Stub;
+
+    if (opaque) {
+        new GenericProxyCall(this, cq);
+        return;
+    }
+
+    ListenUnary<openolt::Empty, openolt::Empty>(this, cq, "DisableOlt",
+            &AsyncProxyService::RequestDisableOlt, &Stub::PrepareAsyncDisableOlt);
+    ListenUnary<openolt::Empty, openolt::Empty>(this, cq, "ReenableOlt",
+            &AsyncProxyService::RequestReenableOlt, &Stub::PrepareAsyncReenableOlt);
+    ListenUnary<openolt::Onu, openolt::Empty>(this, cq, "ActivateOnu",
+            &AsyncProxyService::RequestActivateOnu, &Stub::PrepareAsyncActivateOnu);
+    ListenUnary<openolt::Onu, openolt::Empty>(this, cq, "DeactivateOnu",
+            &AsyncProxyService::RequestDeactivateOnu, &Stub::PrepareAsyncDeactivateOnu);
+    ListenUnary<openolt::Onu, openolt::Empty>(this, cq, "DeleteOnu",
+            &AsyncProxyService::RequestDeleteOnu, &Stub::PrepareAsyncDeleteOnu);
+    ListenUnary<openolt::OmciMsg, openolt::Empty>(this, cq, "OmciMsgOut",
+            &AsyncProxyService::RequestOmciMsgOut, &Stub::PrepareAsyncOmciMsgOut);
+    ListenUnary<openolt::OnuPacket, openolt::Empty>(this, cq, "OnuPacketOut",
+            &AsyncProxyService::RequestOnuPacketOut, &Stub::PrepareAsyncOnuPacketOut);
+    ListenUnary<openolt::UplinkPacket, openolt::Empty>(this, cq, "UplinkPacketOut",
+            &AsyncProxyService::RequestUplinkPacketOut, &Stub::PrepareAsyncUplinkPacketOut);
+    ListenUnary<openolt::Flow, openolt::Empty>(this, cq, "FlowAdd",
+            &AsyncProxyService::RequestFlowAdd, &Stub::PrepareAsyncFlowAdd);
+    ListenUnary<openolt::Flow, openolt::Empty>(this, cq, "FlowRemove",
+            &AsyncProxyService::RequestFlowRemove, &Stub::PrepareAsyncFlowRemove);
+    new AsyncIndicationCall(this, cq);
+    ListenUnary<openolt::Empty, openolt::Heartbeat>(this, cq, "HeartbeatCheck",
+            &AsyncProxyService::RequestHeartbeatCheck, &Stub::PrepareAsyncHeartbeatCheck);
+    ListenUnary<openolt::Interface, openolt::Empty>(this, cq, "EnablePonIf",
+            &AsyncProxyService::RequestEnablePonIf, &Stub::PrepareAsyncEnablePonIf);
+    ListenUnary<openolt::Interface, openolt::Empty>(this, cq, "DisablePonIf",
+            &AsyncProxyService::RequestDisablePonIf, &Stub::PrepareAsyncDisablePonIf);
+    ListenUnary<openolt::Empty, openolt::Empty>(this, cq, "CollectStatistics",
+            &AsyncProxyService::RequestCollectStatistics, &Stub::PrepareAsyncCollectStatistics);
+    ListenUnary<openolt::Empty, openolt::Empty>(this, cq, "Reboot",
+            &AsyncProxyService::RequestReboot, &Stub::PrepareAsyncReboot);
+    ListenUnary<openolt::Empty, openolt::DeviceInfo>(this, cq, "GetDeviceInfo",
+            &AsyncProxyService::RequestGetDeviceInfo, &Stub::PrepareAsyncGetDeviceInfo);
+    ListenUnary<tech_profile::TrafficSchedulers, openolt::Empty>(this, cq, "CreateTrafficSchedulers",
+            &AsyncProxyService::RequestCreateTrafficSchedulers, &Stub::PrepareAsyncCreateTrafficSchedulers);
+    ListenUnary<tech_profile::TrafficSchedulers, openolt::Empty>(this, cq, "RemoveTrafficSchedulers",
+            &AsyncProxyService::RequestRemoveTrafficSchedulers, &Stub::PrepareAsyncRemoveTrafficSchedulers);
+    ListenUnary<tech_profile::TrafficQueues, openolt::Empty>(this, cq, "CreateTrafficQueues",
+            &AsyncProxyService::RequestCreateTrafficQueues, &Stub::PrepareAsyncCreateTrafficQueues);
+    ListenUnary<tech_profile::TrafficQueues, openolt::Empty>(this, cq, "RemoveTrafficQueues",
+            &AsyncProxyService::RequestRemoveTrafficQueues, &Stub::PrepareAsyncRemoveTrafficQueues);
+    ListenUnary<openolt::Group, openolt::Empty>(this, cq, "PerformGroupOperation",
+            &AsyncProxyService::RequestPerformGroupOperation, &Stub::PrepareAsyncPerformGroupOperation);
+    ListenUnary<openolt::Group, openolt::Empty>(this, cq, "DeleteGroup",
+            &AsyncProxyService::RequestDeleteGroup, &Stub::PrepareAsyncDeleteGroup);
+    ListenUnary<config::OnuItuPonAlarm, openolt::Empty>(this, cq, "OnuItuPonAlarmSet",
+            &AsyncProxyService::RequestOnuItuPonAlarmSet, &Stub::PrepareAsyncOnuItuPonAlarmSet);
+    ListenUnary<openolt::Onu, openolt::OnuLogicalDistance>(this, cq, "GetLogicalOnuDistanceZero",
+            &AsyncProxyService::RequestGetLogicalOnuDistanceZero, &Stub::PrepareAsyncGetLogicalOnuDistanceZero);
+    ListenUnary<openolt::Onu, openolt::OnuLogicalDistance>(this, cq, "GetLogicalOnuDistance",
+            &AsyncProxyService::RequestGetLogicalOnuDistance, &Stub::PrepareAsyncGetLogicalOnuDistance);
+}
+
+void AsyncProxyServer::HandleRpcs(ServerCompletionQueue* cq) {
+    void* tag;
+    bool ok;
+    while (cq->Next(&tag, &ok)) {
+        static_cast<AsyncProxyCall*>(tag)->Proceed(ok);
+    }
+}
+
+// A listener is reposted as soon as its call is accepted, unless that call
+// takes the proxy to the in-flight cap. In that case it is parked until a
+// call finishes, and further calls of that method queue up inside gRPC.
+// Listeners of the other methods stay posted: the calls they accept past the
+// cap are refused, and as each refused call finishes it reposts a parked
+// listener in the order they were parked.
+bool AsyncProxyServer::CallAccepted(std::function<void()> listen) {
+    std::unique_lock<std::mutex> guard(callLock);
+    inflightCalls++;
+    if (shuttingDown) {
+        return true;
+    }
+    if (inflightCalls == maxInflightCalls) {
+        LOG_F(MAX, "In-flight call limit %d reached", maxInflightCalls);
+        deferredListeners.push_back(listen);
+        return true;
+    }
+    bool admitted = (inflightCalls < maxInflightCalls);
+    guard.unlock();
+    listen();
+    return admitted;
+}
+
+void AsyncProxyServer::CallFinished() {
+    std::function<void()> listen;
+    {
+        std::unique_lock<std::mutex> guard(callLock);
+        inflightCalls--;
+        if (shuttingDown || deferredListeners.empty()) {
+            return;
+        }
+        listen = deferredListeners.front();
+        deferredListeners.pop_front();
+    }
+    listen();
+}
+
+void AsyncProxyServer::Run(const char* interface_address) {
+    grpc::EnableDefaultHealthCheckService(true);
+    ServerBuilder builder;
+
+    LOG_F(INFO, "Starting Async Proxy Server (%s) with %d completion queues, in-flight limit %d",
+            opaque ? "opaque forwarding" : "typed", numCqThreads, maxInflightCalls);
+    builder.AddListeningPort(interface_address, grpc::InsecureServerCredentials());
+    if (opaque) {
+        builder.RegisterAsyncGenericService(&genericService);
+    } else {
+        builder.RegisterService(&service);
+    }
+    for (int i = 0; i < numCqThreads; i++) {
+        cqs.push_back(builder.AddCompletionQueue());
+    }
+
+    server = builder.BuildAndStart();
+    if (!server) {
+        LOG_F(FATAL, "Unable to start Async Proxy Server on %s", interface_address);
+        return;
+    }
+
+    for (size_t i = 0; i < cqs.size(); i++) {
+        ListenAll(cqs[i].get());
+    }
+
+    LOG_F(INFO, "TACACS Proxy listening on %s", interface_address);
+    for (size_t i = 0; i < cqs.size(); i++) {
+        cqThreads.push_back(std::thread(&AsyncProxyServer::HandleRpcs, this, cqs[i].get()));
+    }
+    for (size_t i = 0; i < cqThreads.size(); i++) {
+        cqThreads[i].join();
+    }
+}
+
+void AsyncProxyServer::Shutdown() {
+    {
+        std::unique_lock<std::mutex> guard(callLock);
+        shuttingDown = true;
+        deferredListeners.clear();
+    }
+
+    if (server) {
+        // Indication streams never end on their own, so give up on them after a grace period
+        server->Shutdown(std::chrono::system_clock::now() + std::chrono::seconds(2));
+    }
+    // Calls still with the TACACS+ workers, the engine or the indication hub
+    // no longer come back: an alarm set on a shut down queue aborts
+    std::unique_lock<std::mutex> guard(callLock);
+    queuesShutDown = true;
+    for (size_t i = 0; i < cqs.size(); i++) {
+        cqs[i]->Shutdown();
+    }
+}
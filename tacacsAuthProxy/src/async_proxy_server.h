@@ -0,0 +1,115 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ASYNC_PROXY_SERVER_H_
+#define ASYNC_PROXY_SERVER_H_
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <grpcpp/grpcpp.h>
+#include <grpcpp/generic/async_generic_service.h>
+#include <grpcpp/generic/generic_stub.h>
+
+#include <voltha_protos/openolt.grpc.pb.h>
+
+#include "tacacs_controller.h"
+#include "upstream_channel_pool.h"
+#include "indication_hub.h"
+#include "priority_scheduler.h"
+
+// Openolt service with every proxied method switched to the async API.
+// Methods not listed here stay on the generated sync UNIMPLEMENTED handler.
+typedef openolt::Openolt::WithAsyncMethod_DisableOlt<
+        openolt::Openolt::WithAsyncMethod_ReenableOlt<
+        openolt::Openolt::WithAsyncMethod_ActivateOnu<
+        openolt::Openolt::WithAsyncMethod_DeactivateOnu<
+        openolt::Openolt::WithAsyncMethod_DeleteOnu<
+        openolt::Openolt::WithAsyncMethod_OmciMsgOut<
+        openolt::Openolt::WithAsyncMethod_OnuPacketOut<
+        openolt::Openolt::WithAsyncMethod_UplinkPacketOut<
+        openolt::Openolt::WithAsyncMethod_FlowAdd<
+        openolt::Openolt::WithAsyncMethod_FlowRemove<
+        openolt::Openolt::WithAsyncMethod_EnableIndication<
+        openolt::Openolt::WithAsyncMethod_HeartbeatCheck<
+        openolt::Openolt::WithAsyncMethod_EnablePonIf<
+        openolt::Openolt::WithAsyncMethod_DisablePonIf<
+        openolt::Openolt::WithAsyncMethod_GetDeviceInfo<
+        openolt::Openolt::WithAsyncMethod_Reboot<
+        openolt::Openolt::WithAsyncMethod_CollectStatistics<
+        openolt::Openolt::WithAsyncMethod_CreateTrafficSchedulers<
+        openolt::Openolt::WithAsyncMethod_RemoveTrafficSchedulers<
+        openolt::Openolt::WithAsyncMethod_CreateTrafficQueues<
+        openolt::Openolt::WithAsyncMethod_RemoveTrafficQueues<
+        openolt::Openolt::WithAsyncMethod_PerformGroupOperation<
+        openolt::Openolt::WithAsyncMethod_DeleteGroup<
+        openolt::Openolt::WithAsyncMethod_OnuItuPonAlarmSet<
+        openolt::Openolt::WithAsyncMethod_GetLogicalOnuDistanceZero<
+        openolt::Openolt::WithAsyncMethod_GetLogicalOnuDistance<
+        openolt::Openolt::Service
+        > > > > > > > > > > > > > > > > > > > > > > > > > > AsyncProxyService;
+
+class AsyncProxyCall;
+
+// Completion queue driven proxy. Every incoming call is a small state machine
+// (extract credentials, authenticate + authorize, forward, account) and no
+// gRPC thread waits on the upstream agent. The TACACS+ exchanges run on the
+// non-blocking TACACS+ engine, or on the workers of the priority scheduler
+// when the engine is disabled, which hand the call back to its completion
+// queue once done.
+//
+// In opaque mode the typed service is replaced by an AsyncGenericService and
+// a GenericStub: payloads are relayed as raw ByteBuffers and only the method
+// path is looked at, to find the TACACS+ cmd attribute.
+class AsyncProxyServer {
+    friend class AsyncProxyCall;
+
+    TaccController* taccController;
+    UpstreamChannelPool* channelPool;
+    IndicationHub* indicationHub;
+    AsyncProxyService service;
+    grpc::AsyncGenericService genericService;
+    bool opaque;
+    unique_ptr<Server> server;
+    vector<unique_ptr<ServerCompletionQueue> > cqs;
+    vector<std::thread> cqThreads;
+    PriorityScheduler* scheduler;
+
+    int numCqThreads;
+    int maxInflightCalls;
+
+    // Accepted calls not yet finished, and listeners held back while at the cap
+    std::mutex callLock;
+    int inflightCalls;
+    bool shuttingDown;
+    // Calls resume on their queue only until then
+    bool queuesShutDown;
+    std::deque<std::function<void()> > deferredListeners;
+
+    void ListenAll(ServerCompletionQueue* cq);
+    void HandleRpcs(ServerCompletionQueue* cq);
+    // False if the call takes the proxy over the cap and must be refused
+    bool CallAccepted(std::function<void()> listen);
+    void CallFinished();
+
+    public:
+    AsyncProxyServer(TaccController* tacctrl, UpstreamChannelPool* pool, IndicationHub* hub, PriorityScheduler* priority_scheduler, bool opaque_forwarding, int cq_threads, int max_inflight_calls);
+
+    void Run(const char* interface_address);
+    void Shutdown();
+};
+
+#endif
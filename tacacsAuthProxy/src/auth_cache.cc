@@ -0,0 +1,107 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <openssl/rand.h>
+#include <openssl/sha.h>
+
+#include "auth_cache.h"
+#include "logger.h"
+
+#define AUTH_CACHE_SALT_SIZE 16
+
+static_assert(AUTH_CACHE_DIGEST_SIZE == SHA256_DIGEST_LENGTH, "AuthCache::Digest holds a SHA-256");
+
+AuthCache::AuthCache(int positive_ttl_sec, int negative_ttl_sec, int max_entries) :
+    positiveTtl(positive_ttl_sec > 0 ? positive_ttl_sec : 0),
+    negativeTtl(negative_ttl_sec > 0 ? negative_ttl_sec : 0),
+    maxEntries(max_entries > 0 ? max_entries : 0), generation(0), hits(0), misses(0) {
+    unsigned char buf[AUTH_CACHE_SALT_SIZE];
+    if (RAND_bytes(buf, sizeof(buf)) != 1) {
+        LOG_F(WARNING, "Unable to generate a random salt, disabling authentication cache");
+        maxEntries = 0;
+    }
+    salt.assign((const char*)buf, sizeof(buf));
+}
+
+AuthCache::Digest AuthCache::Key(const char* username, size_t username_len, const char* password,
+        size_t password_len, const std::string& peer) {
+    Digest digest;
+    SHA256_CTX ctx;
+    SHA256_Init(&ctx);
+    SHA256_Update(&ctx, salt.data(), salt.size());
+    SHA256_Update(&ctx, username, username_len);
+    SHA256_Update(&ctx, ":", 1);
+    SHA256_Update(&ctx, password, password_len);
+    // NUL cannot appear in the credentials, so it keeps the peer apart
+    SHA256_Update(&ctx, "", 1);
+    SHA256_Update(&ctx, peer.data(), peer.size());
+    SHA256_Final(digest.bytes, &ctx);
+    return digest;
+}
+
+bool AuthCache::Lookup(const Digest& key, bool* passed) {
+    if (!Enabled()) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    std::unordered_map<Digest, std::list<Entry>::iterator, DigestHash>::iterator it = entries.find(key);
+    if (it == entries.end()) {
+        misses++;
+        return false;
+    }
+
+    if (it->second->expiry <= Clock::now() || it->second->generation != generation.load()) {
+        lru.erase(it->second);
+        entries.erase(it);
+        misses++;
+        return false;
+    }
+
+    lru.splice(lru.begin(), lru, it->second);
+    *passed = it->second->passed;
+    hits++;
+    return true;
+}
+
+void AuthCache::Insert(const Digest& key, bool passed) {
+    std::chrono::seconds ttl = passed ? positiveTtl : negativeTtl;
+    if (!Enabled() || ttl.count() == 0) {
+        return;
+    }
+
+    Clock::time_point expiry = Clock::now() + ttl;
+
+    std::lock_guard<std::mutex> guard(lock);
+    std::unordered_map<Digest, std::list<Entry>::iterator, DigestHash>::iterator it = entries.find(key);
+    if (it != entries.end()) {
+        it->second->passed = passed;
+        it->second->generation = generation.load();
+        it->second->expiry = expiry;
+        lru.splice(lru.begin(), lru, it->second);
+        return;
+    }
+
+    while (entries.size() >= maxEntries) {
+        entries.erase(lru.back().key);
+        lru.pop_back();
+    }
+
+    Entry entry;
+    entry.key = key;
+    entry.passed = passed;
+    entry.generation = generation.load();
+    entry.expiry = expiry;
+    lru.push_front(entry);
+    entries[key] = lru.begin();
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AUTH_CACHE_H_
+#define AUTH_CACHE_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#define AUTH_CACHE_DIGEST_SIZE 32
+
+// Recent TACACS+ authentication results, so that the credentials a client
+// sends on every call are checked against the server only once per TTL.
+//
+// Entries are keyed by a salted SHA-256 of username:password and the peer
+// address; the cache never holds a password in clear. The salt is random per
+// process. Passed authentications live for the positive TTL, rejected ones
+// for the (usually shorter) negative TTL. The least recently used entry is
+// evicted when the cache is full.
+class AuthCache {
+    public:
+    // Salted SHA-256 keying an entry, fixed size so that a lookup allocates nothing
+    struct Digest {
+        unsigned char bytes[AUTH_CACHE_DIGEST_SIZE];
+
+        bool operator==(const Digest& other) const { return memcmp(bytes, other.bytes, sizeof(bytes)) == 0; }
+    };
+
+    private:
+    typedef std::chrono::steady_clock Clock;
+
+    // The digest is uniformly distributed already
+    struct DigestHash {
+        size_t operator()(const Digest& digest) const {
+            size_t hash;
+            memcpy(&hash, digest.bytes, sizeof(hash));
+            return hash;
+        }
+    };
+
+    struct Entry {
+        Digest key;
+        bool passed;
+        unsigned generation;
+        Clock::time_point expiry;
+    };
+
+    std::chrono::seconds positiveTtl;
+    std::chrono::seconds negativeTtl;
+    size_t maxEntries;
+    std::string salt;
+    std::atomic<unsigned> generation;
+
+    std::mutex lock;
+    std::list<Entry> lru;       // most recently used first
+    std::unordered_map<Digest, std::list<Entry>::iterator, DigestHash> entries;
+
+    public:
+    std::atomic<unsigned long> hits;
+    std::atomic<unsigned long> misses;
+
+    AuthCache(int positive_ttl_sec, int negative_ttl_sec, int max_entries);
+
+    bool Enabled() { return maxEntries > 0 && (positiveTtl.count() > 0 || negativeTtl.count() > 0); }
+
+    // Key of the credentials presented from peer
+    Digest Key(const char* username, size_t username_len, const char* password, size_t password_len,
+            const std::string& peer);
+
+    // True if a live entry exists, *passed then holds the cached result
+    bool Lookup(const Digest& key, bool* passed);
+    void Insert(const Digest& key, bool passed);
+
+    bool Lookup(const std::string& username, const std::string& password, const std::string& peer, bool* passed) {
+        return Lookup(Key(username.data(), username.size(), password.data(), password.size(), peer), passed);
+    }
+    void Insert(const std::string& username, const std::string& password, const std::string& peer, bool passed) {
+        Insert(Key(username.data(), username.size(), password.data(), password.size(), peer), passed);
+    }
+
+    // Invalidates every entry. Only touches an atomic, so it is safe to call
+    // from a signal handler.
+    void Flush() { generation++; }
+};
+
+#endif
@@ -0,0 +1,96 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <functional>
+
+#include "author_cache.h"
+
+AuthorCache::AuthorCache(int pass_ttl_sec, int fail_ttl_sec, int max_entries, bool background_refresh) :
+    passTtl(pass_ttl_sec > 0 ? pass_ttl_sec : 0),
+    failTtl(fail_ttl_sec > 0 ? fail_ttl_sec : 0),
+    maxShardEntries(max_entries > 0 ? (max_entries + AUTHOR_CACHE_SHARDS - 1) / AUTHOR_CACHE_SHARDS : 0),
+    refresh(background_refresh), generation(0), hits(0), misses(0), refreshes(0) {
+}
+
+AuthorCache::Shard& AuthorCache::ShardFor(const std::string& key) {
+    return shards[std::hash<std::string>()(key) % AUTHOR_CACHE_SHARDS];
+}
+
+int AuthorCache::Lookup(const std::string& user, const std::string& cmd, bool* passed) {
+    if (!Enabled()) {
+        return MISS;
+    }
+
+    std::string key = user + '\0' + cmd;
+    Shard& shard = ShardFor(key);
+    Clock::time_point now = Clock::now();
+
+    std::lock_guard<std::mutex> guard(shard.lock);
+    std::unordered_map<std::string, Entry>::iterator it = shard.entries.find(key);
+    if (it == shard.entries.end()) {
+        misses++;
+        return MISS;
+    }
+
+    Entry& entry = it->second;
+    if (entry.expiry <= now || entry.generation != generation.load()) {
+        shard.entries.erase(it);
+        misses++;
+        return MISS;
+    }
+
+    hits++;
+    *passed = entry.passed;
+    if (refresh && !entry.refreshing && entry.refreshAt <= now) {
+        entry.refreshing = true;
+        refreshes++;
+        return HIT_REFRESH;
+    }
+    return HIT;
+}
+
+void AuthorCache::Insert(const std::string& user, const std::string& cmd, bool passed) {
+    std::chrono::seconds ttl = passed ? passTtl : failTtl;
+    if (!Enabled() || ttl.count() == 0) {
+        return;
+    }
+
+    std::string key = user + '\0' + cmd;
+    Shard& shard = ShardFor(key);
+    Clock::time_point now = Clock::now();
+
+    Entry entry;
+    entry.passed = passed;
+    entry.refreshing = false;
+    entry.generation = generation.load();
+    entry.refreshAt = now + ttl * 4 / 5;
+    entry.expiry = now + ttl;
+
+    std::lock_guard<std::mutex> guard(shard.lock);
+    if (shard.entries.size() >= maxShardEntries && shard.entries.find(key) == shard.entries.end()) {
+        std::unordered_map<std::string, Entry>::iterator it = shard.entries.begin();
+        while (it != shard.entries.end()) {
+            if (it->second.expiry <= now || it->second.generation != entry.generation) {
+                it = shard.entries.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        // Everything is live: the set of (user, command) pairs in use is
+        // larger than the cache, dropping any entry is as good as another
+        if (shard.entries.size() >= maxShardEntries) {
+            shard.entries.erase(shard.entries.begin());
+        }
+    }
+    shard.entries[key] = entry;
+}
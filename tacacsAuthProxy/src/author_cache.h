@@ -0,0 +1,80 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AUTHOR_CACHE_H_
+#define AUTHOR_CACHE_H_
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#define AUTHOR_CACHE_SHARDS 16
+
+// TACACS+ authorization decisions per (user, command).
+//
+// The table is split in shards with a lock each so that concurrent calls for
+// different commands do not contend. Permitted and denied decisions have their
+// own TTL. With refresh enabled, a hit in the last fifth of an entry's life
+// asks its caller, and only that one caller, to query the server again in the
+// background, so that commands in steady use never miss.
+class AuthorCache {
+    typedef std::chrono::steady_clock Clock;
+
+    struct Entry {
+        bool passed;
+        bool refreshing;
+        unsigned generation;
+        Clock::time_point refreshAt;
+        Clock::time_point expiry;
+    };
+
+    struct Shard {
+        std::mutex lock;
+        std::unordered_map<std::string, Entry> entries;
+    };
+
+    std::chrono::seconds passTtl;
+    std::chrono::seconds failTtl;
+    size_t maxShardEntries;
+    bool refresh;
+    std::atomic<unsigned> generation;
+    Shard shards[AUTHOR_CACHE_SHARDS];
+
+    Shard& ShardFor(const std::string& key);
+
+    public:
+    enum {
+        MISS,
+        HIT,
+        HIT_REFRESH         // valid, but the caller should refresh the entry
+    };
+
+    std::atomic<unsigned long> hits;
+    std::atomic<unsigned long> misses;
+    std::atomic<unsigned long> refreshes;
+
+    AuthorCache(int pass_ttl_sec, int fail_ttl_sec, int max_entries, bool background_refresh);
+
+    bool Enabled() { return maxShardEntries > 0 && (passTtl.count() > 0 || failTtl.count() > 0); }
+
+    int Lookup(const std::string& user, const std::string& cmd, bool* passed);
+    void Insert(const std::string& user, const std::string& cmd, bool passed);
+
+    // Invalidates every entry. Only touches an atomic, so it is safe to call
+    // from a signal handler.
+    void Flush() { generation++; }
+};
+
+#endif
@@ -0,0 +1,132 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "circuit_breaker.h"
+#include "logger.h"
+
+static const char* StateName(int state) {
+    switch (state) {
+        case CircuitBreaker::CLOSED: return "CLOSED";
+        case CircuitBreaker::OPEN: return "OPEN";
+        default: return "HALF_OPEN";
+    }
+}
+
+CircuitBreaker::CircuitBreaker(const std::string& server_name, int failure_threshold, int latency_threshold_ms,
+        int open_interval_sec) :
+    name(server_name), failureThreshold(failure_threshold), latencyThresholdMs(latency_threshold_ms),
+    openInterval(open_interval_sec > 0 ? open_interval_sec : 1), state(CLOSED), consecutiveFailures(0),
+    trialInFlight(false), opens(0), halfOpens(0), closes(0), rejected(0) {
+}
+
+// Called with the lock held
+void CircuitBreaker::TransitionTo(State next) {
+    int previous = state.load();
+    if (previous == next) {
+        return;
+    }
+
+    state.store(next);
+    trialInFlight = false;
+    consecutiveFailures.store(0);
+    if (next == OPEN) {
+        openedAt = Clock::now();
+        opens++;
+        LOG_F(WARNING, "TACACS+ server %s unavailable, circuit breaker %s -> OPEN, applying fallback", name.c_str(), StateName(previous));
+    } else if (next == HALF_OPEN) {
+        halfOpens++;
+        LOG_F(INFO, "TACACS+ server %s answered probe, circuit breaker %s -> HALF_OPEN", name.c_str(), StateName(previous));
+    } else {
+        closes++;
+        LOG_F(INFO, "TACACS+ server %s available, circuit breaker %s -> CLOSED", name.c_str(), StateName(previous));
+    }
+}
+
+bool CircuitBreaker::Allow() {
+    if (failureThreshold <= 0 || state.load() == CLOSED) {
+        return true;
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    if (state.load() == CLOSED) {
+        return true;
+    }
+    // A trial whose outcome never got reported does not block the breaker forever
+    if (state.load() == HALF_OPEN && (!trialInFlight || Clock::now() - trialStarted > openInterval)) {
+        trialInFlight = true;
+        trialStarted = Clock::now();
+        return true;
+    }
+    rejected++;
+    return false;
+}
+
+void CircuitBreaker::RecordSuccess(int latency_ms) {
+    if (failureThreshold <= 0) {
+        return;
+    }
+    if (latencyThresholdMs > 0 && latency_ms > latencyThresholdMs) {
+        LOG_F(MAX, "TACACS+ server %s answered in %d ms", name.c_str(), latency_ms);
+        RecordFailure();
+        return;
+    }
+
+    if (state.load() == CLOSED) {
+        if (consecutiveFailures.load(std::memory_order_relaxed) != 0) {
+            consecutiveFailures.store(0);
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    if (state.load() == HALF_OPEN) {
+        TransitionTo(CLOSED);
+    }
+}
+
+void CircuitBreaker::RecordFailure() {
+    if (failureThreshold <= 0) {
+        return;
+    }
+    if (state.load() == CLOSED && consecutiveFailures.fetch_add(1) + 1 < failureThreshold) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    // Late failures of requests sent before the breaker opened change nothing
+    if (state.load() != OPEN) {
+        TransitionTo(OPEN);
+    }
+}
+
+bool CircuitBreaker::ProbeDue() {
+    if (state.load() != OPEN) {
+        return false;
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    return state.load() == OPEN && Clock::now() - openedAt >= openInterval;
+}
+
+void CircuitBreaker::ProbeSucceeded() {
+    std::lock_guard<std::mutex> guard(lock);
+    if (state.load() == OPEN) {
+        TransitionTo(HALF_OPEN);
+    }
+}
+
+void CircuitBreaker::ProbeFailed() {
+    std::lock_guard<std::mutex> guard(lock);
+    if (state.load() == OPEN) {
+        openedAt = Clock::now();
+    }
+}
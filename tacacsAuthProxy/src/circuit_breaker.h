@@ -0,0 +1,78 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CIRCUIT_BREAKER_H_
+#define CIRCUIT_BREAKER_H_
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+
+// Stops sending requests to a TACACS+ server that keeps failing.
+//
+// CLOSED: requests flow; N consecutive failures, where an exchange slower
+// than the latency threshold counts as a failure, open the breaker.
+// OPEN: requests are refused at once so callers apply their fallback
+// decision without waiting for a timeout. The owner probes the server in the
+// background once the open interval has passed; a successful probe moves to
+// HALF_OPEN: a single trial request goes through. Its success closes the
+// breaker, its failure opens it again.
+class CircuitBreaker {
+    public:
+    enum State {
+        CLOSED = 0,
+        OPEN = 1,
+        HALF_OPEN = 2
+    };
+
+    private:
+    typedef std::chrono::steady_clock Clock;
+
+    std::string name;
+    int failureThreshold;
+    int latencyThresholdMs;
+    std::chrono::seconds openInterval;
+
+    std::mutex lock;
+    std::atomic<int> state;
+    std::atomic<int> consecutiveFailures;
+    bool trialInFlight;
+    Clock::time_point trialStarted;
+    Clock::time_point openedAt;
+
+    void TransitionTo(State next);
+
+    public:
+    std::atomic<unsigned long> opens;
+    std::atomic<unsigned long> halfOpens;
+    std::atomic<unsigned long> closes;
+    std::atomic<unsigned long> rejected;
+
+    // A threshold of 0 disables the breaker, one of latency disables slow call detection
+    CircuitBreaker(const std::string& name, int failure_threshold, int latency_threshold_ms, int open_interval_sec);
+
+    // False while the server is considered down
+    bool Allow();
+    void RecordSuccess(int latency_ms);
+    void RecordFailure();
+
+    // Background probing while open
+    bool ProbeDue();
+    void ProbeSucceeded();
+    void ProbeFailed();
+
+    State GetState() { return (State)state.load(); }
+};
+
+#endif
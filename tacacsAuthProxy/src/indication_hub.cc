@@ -0,0 +1,332 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "indication_hub.h"
+#include "metrics.h"
+#include "logger.h"
+
+// Delay before reopening a failed upstream stream, doubling up to the maximum
+#define INDICATION_RETRY_MIN_MS 500
+#define INDICATION_RETRY_MAX_MS 16000
+
+bool ParseIndicationSlowPolicy(const char* name, IndicationSlowPolicy* policy) {
+    if (strcmp(name, "drop_oldest") == 0) {
+        *policy = INDICATION_DROP_OLDEST;
+    } else if (strcmp(name, "drop_newest") == 0) {
+        *policy = INDICATION_DROP_NEWEST;
+    } else if (strcmp(name, "disconnect") == 0) {
+        *policy = INDICATION_DISCONNECT;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+IndicationSubscriber::IndicationSubscriber(const std::string& peer_addr, size_t capacity,
+        IndicationSlowPolicy slow_policy) :
+    ring(capacity), policy(slow_policy), closed(false), fellBehind(false), waiting(false), peer(peer_addr),
+    delivered(0), dropped(0) {}
+
+bool IndicationSubscriber::Push(const IndicationPtr& indication) {
+    if (closed) {
+        // Being unsubscribed
+        return true;
+    }
+    if (!ring.Push(indication)) {
+        if (policy == INDICATION_DROP_NEWEST) {
+            dropped++;
+            return true;
+        } else if (policy == INDICATION_DISCONNECT) {
+            dropped++;
+            fellBehind = true;
+            Close();
+            return false;
+        }
+        // The writer may have taken the oldest meanwhile, then there is room anyway
+        IndicationPtr oldest;
+        if (ring.Pop(&oldest)) {
+            dropped++;
+        }
+        ring.Push(indication);
+    }
+    // Pairs with the fence of a parking writer: either it sees the new
+    // indication or the hub sees it waiting
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiting) {
+        Wake();
+    }
+    return true;
+}
+
+void IndicationSubscriber::Wake() {
+    std::function<void()> to_wake;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (!waiting.exchange(false)) {
+            return;
+        }
+        to_wake.swap(wake);
+    }
+    cond.notify_all();
+    if (to_wake) {
+        to_wake();
+    }
+}
+
+void IndicationSubscriber::Close() {
+    closed = true;
+    std::function<void()> to_wake;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        waiting = false;
+        to_wake.swap(wake);
+    }
+    cond.notify_all();
+    if (to_wake) {
+        to_wake();
+    }
+}
+
+bool IndicationSubscriber::Next(IndicationPtr* indication, int timeout_ms) {
+    if (!ring.Pop(indication)) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            waiting = true;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            cond.wait_for(guard, std::chrono::milliseconds(timeout_ms), [this] {
+                return ring.Size() > 0 || closed;
+            });
+            waiting = false;
+        }
+        if (!ring.Pop(indication)) {
+            return false;
+        }
+    }
+    delivered++;
+    return true;
+}
+
+bool IndicationSubscriber::TryNext(IndicationPtr* indication) {
+    if (!ring.Pop(indication)) {
+        return false;
+    }
+    delivered++;
+    return true;
+}
+
+bool IndicationSubscriber::TryNext(IndicationPtr* indication, std::function<void()> wake_fn) {
+    if (TryNext(indication)) {
+        return true;
+    }
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (closed) {
+            return false;
+        }
+        wake = wake_fn;
+        waiting = true;
+    }
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (ring.Size() > 0 || closed) {
+        // Raced with the hub, which may have missed the waiting flag
+        Wake();
+    }
+    return false;
+}
+
+bool IndicationSubscriber::Closed() {
+    return closed;
+}
+
+grpc::Status IndicationSubscriber::ClosedStatus() {
+    if (fellBehind) {
+        return grpc::Status(grpc::RESOURCE_EXHAUSTED, "Indication stream fell behind");
+    }
+    return grpc::Status(grpc::UNAVAILABLE, "Indication stream closed");
+}
+
+IndicationHub::IndicationHub(std::shared_ptr<grpc::Channel> channel, int queue_size,
+        IndicationSlowPolicy slow_policy) :
+    stub(openolt::Openolt::NewStub(channel)), queueSize(queue_size > 0 ? queue_size : 1), slowPolicy(slow_policy),
+    upstreamCtx(NULL), started(false), stopping(false), received(0), written(0), flushes(0), writeStallUs(0),
+    upstreamConnects(0), upstreamConnected(false) {
+    metricsCollector = ProxyMetrics::Instance().AddCollector(
+            std::bind(&IndicationHub::CollectMetrics, this, std::placeholders::_1));
+}
+
+IndicationHub::~IndicationHub() {
+    ProxyMetrics::Instance().RemoveCollector(metricsCollector);
+    Stop();
+}
+
+std::shared_ptr<IndicationSubscriber> IndicationHub::Subscribe(const std::string& peer) {
+    std::shared_ptr<IndicationSubscriber> subscriber = std::make_shared<IndicationSubscriber>(peer, queueSize,
+            slowPolicy);
+    std::lock_guard<std::mutex> guard(lock);
+    if (stopping) {
+        subscriber->Close();
+        return subscriber;
+    }
+    subscribers.push_back(subscriber);
+    LOG_F(INFO, "Indication subscriber %s added, %zu subscribed", peer.c_str(), subscribers.size());
+    if (!started) {
+        started = true;
+        reader = std::thread(&IndicationHub::ReadLoop, this);
+    }
+    return subscriber;
+}
+
+void IndicationHub::Unsubscribe(const std::shared_ptr<IndicationSubscriber>& subscriber) {
+    subscriber->Close();
+    std::lock_guard<std::mutex> guard(lock);
+    std::vector<std::shared_ptr<IndicationSubscriber> >::iterator it =
+        std::find(subscribers.begin(), subscribers.end(), subscriber);
+    if (it != subscribers.end()) {
+        subscribers.erase(it);
+        LOG_F(INFO, "Indication subscriber %s removed after %lu indications, %lu dropped, %zu subscribed",
+                subscriber->peer.c_str(), subscriber->delivered.load(), subscriber->dropped.load(),
+                subscribers.size());
+    }
+}
+
+// Subscribers are few, a copy per indication under the lock is cheap next
+// to the gRPC write of each of them
+void IndicationHub::Publish(const IndicationPtr& indication) {
+    received++;
+    std::lock_guard<std::mutex> guard(lock);
+    for (size_t i = 0; i < subscribers.size(); ) {
+        if (subscribers[i]->Push(indication)) {
+            i++;
+            continue;
+        }
+        LOG_F(WARNING, "Indication subscriber %s fell %zu indications behind, disconnecting it",
+                subscribers[i]->peer.c_str(), subscribers[i]->ring.Capacity());
+        subscribers.erase(subscribers.begin() + i);
+    }
+}
+
+void IndicationHub::ReadLoop() {
+    int retry_ms = INDICATION_RETRY_MIN_MS;
+    for (;;) {
+        grpc::ClientContext ctx;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (stopping) {
+                break;
+            }
+            upstreamCtx = &ctx;
+        }
+
+        LOG_F(INFO, "Opening the upstream indication stream");
+        upstreamConnects++;
+        std::unique_ptr<grpc::ClientReader<openolt::Indication> > stream =
+            stub->EnableIndication(&ctx, openolt::Empty());
+        openolt::Indication indication;
+        while (stream->Read(&indication)) {
+            upstreamConnected = true;
+            retry_ms = INDICATION_RETRY_MIN_MS;
+            Publish(std::make_shared<const openolt::Indication>(indication));
+        }
+        upstreamConnected = false;
+        grpc::Status status = stream->Finish();
+
+        std::unique_lock<std::mutex> guard(lock);
+        upstreamCtx = NULL;
+        if (stopping) {
+            break;
+        }
+        LOG_F(WARNING, "Upstream indication stream ended: %s, reopening in %d ms", status.error_message().c_str(),
+                retry_ms);
+        // Stop does not wait out the backoff
+        if (stopped.wait_for(guard, std::chrono::milliseconds(retry_ms), [this] { return stopping; })) {
+            break;
+        }
+        guard.unlock();
+        retry_ms = std::min(retry_ms * 2, INDICATION_RETRY_MAX_MS);
+    }
+}
+
+void IndicationHub::Stop() {
+    std::vector<std::shared_ptr<IndicationSubscriber> > closing;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+        if (upstreamCtx != NULL) {
+            upstreamCtx->TryCancel();
+        }
+        closing.swap(subscribers);
+    }
+    stopped.notify_all();
+    for (size_t i = 0; i < closing.size(); i++) {
+        closing[i]->Close();
+    }
+    if (reader.joinable()) {
+        reader.join();
+    }
+}
+
+void IndicationHub::RecordFlush(int indications, long stall_us) {
+    written += indications;
+    flushes++;
+    writeStallUs += stall_us;
+}
+
+void IndicationHub::CollectMetrics(std::string* out) {
+    typedef std::vector<std::pair<const char*, std::string> > Labels;
+    unsigned long dropped = 0;
+    size_t count;
+    size_t depth = 0;
+    size_t maxDepth = 0;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        count = subscribers.size();
+        for (size_t i = 0; i < subscribers.size(); i++) {
+            dropped += subscribers[i]->dropped;
+            size_t pending = subscribers[i]->Pending();
+            depth += pending;
+            maxDepth = std::max(maxDepth, pending);
+        }
+    }
+    MetricsFamily(out, "tacacs_proxy_indications_received_total", "counter",
+            "Indications read from the upstream stream");
+    MetricsSample(out, "tacacs_proxy_indications_received_total", Labels(), received);
+    MetricsFamily(out, "tacacs_proxy_indication_subscribers", "gauge", "Clients subscribed to indications");
+    MetricsSample(out, "tacacs_proxy_indication_subscribers", Labels(), count);
+    MetricsFamily(out, "tacacs_proxy_indications_dropped", "gauge",
+            "Indications dropped for the current subscribers because they fell behind");
+    MetricsSample(out, "tacacs_proxy_indications_dropped", Labels(), dropped);
+    MetricsFamily(out, "tacacs_proxy_indication_queue_depth", "gauge",
+            "Indications queued for the writers of all subscribers");
+    MetricsSample(out, "tacacs_proxy_indication_queue_depth", Labels(), depth);
+    MetricsFamily(out, "tacacs_proxy_indication_queue_depth_max", "gauge",
+            "Indications queued for the writer of the subscriber furthest behind");
+    MetricsSample(out, "tacacs_proxy_indication_queue_depth_max", Labels(), maxDepth);
+    MetricsFamily(out, "tacacs_proxy_indications_written_total", "counter", "Indications written to subscribers");
+    MetricsSample(out, "tacacs_proxy_indications_written_total", Labels(), written);
+    MetricsFamily(out, "tacacs_proxy_indication_flushes_total", "counter",
+            "Batches of indications flushed to subscribers");
+    MetricsSample(out, "tacacs_proxy_indication_flushes_total", Labels(), flushes);
+    MetricsFamily(out, "tacacs_proxy_indication_write_stall_seconds_total", "counter",
+            "Time writers spent blocked writing indications to slow subscribers");
+    MetricsSample(out, "tacacs_proxy_indication_write_stall_seconds_total", Labels(), writeStallUs / 1e6);
+    MetricsFamily(out, "tacacs_proxy_indication_upstream_connected", "gauge",
+            "Whether the upstream indication stream is delivering");
+    MetricsSample(out, "tacacs_proxy_indication_upstream_connected", Labels(), upstreamConnected ? 1 : 0);
+    MetricsFamily(out, "tacacs_proxy_indication_upstream_connects_total", "counter",
+            "Times the upstream indication stream was opened");
+    MetricsSample(out, "tacacs_proxy_indication_upstream_connects_total", Labels(), upstreamConnects);
+}
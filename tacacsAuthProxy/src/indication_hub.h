@@ -0,0 +1,154 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INDICATION_HUB_H_
+#define INDICATION_HUB_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <grpcpp/grpcpp.h>
+
+#include <voltha_protos/openolt.grpc.pb.h>
+
+#include "bounded_queue.h"
+
+// Most indications a writer buffers before flushing them to the client
+#define INDICATION_BATCH_MAX 32
+
+typedef std::shared_ptr<const openolt::Indication> IndicationPtr;
+
+// What happens to a subscriber whose buffer is full when an indication arrives
+enum IndicationSlowPolicy {
+    INDICATION_DROP_OLDEST,     // the oldest buffered indication makes room
+    INDICATION_DROP_NEWEST,     // the new indication is not delivered to it
+    INDICATION_DISCONNECT       // its stream ends, the client reconnects and resyncs
+};
+
+// Parses drop_oldest, drop_newest or disconnect. False if unknown.
+bool ParseIndicationSlowPolicy(const char* name, IndicationSlowPolicy* policy);
+
+// One downstream EnableIndication stream: the bounded ring of indications
+// between the hub's reader thread and the writer serving the client.
+//
+// The hub thread is the only producer and the writer the only consumer, so
+// neither side locks while the ring is neither empty nor full. The hub also
+// pops to make room under the drop_oldest policy, which the lock-free queue
+// allows. The lock and the waiting flag are only used to park and wake an
+// idle writer.
+class IndicationSubscriber {
+    friend class IndicationHub;
+
+    BoundedQueue<IndicationPtr> ring;
+    IndicationSlowPolicy policy;
+    std::atomic<bool> closed;
+    std::atomic<bool> fellBehind;
+    // Set by a writer about to park on an empty ring
+    std::atomic<bool> waiting;
+    std::mutex lock;
+    std::condition_variable cond;
+    std::function<void()> wake;
+
+    // Called by the hub. False if the subscriber got disconnected for falling behind.
+    bool Push(const IndicationPtr& indication);
+    void Close();
+    // Wakes the writer if it is parked on the empty ring
+    void Wake();
+
+    public:
+    const std::string peer;
+    std::atomic<unsigned long> delivered;
+    std::atomic<unsigned long> dropped;
+
+    // Capacity is rounded up to a power of two
+    IndicationSubscriber(const std::string& peer_addr, size_t capacity, IndicationSlowPolicy slow_policy);
+
+    // Waits up to timeout_ms for the next indication. False on timeout or
+    // once the subscriber was closed and its ring is drained.
+    bool Next(IndicationPtr* indication, int timeout_ms);
+
+    // Takes the next indication if one is queued
+    bool TryNext(IndicationPtr* indication);
+
+    // Takes the next indication without waiting. When there is none and the
+    // subscriber is still open, wake is called once, from the hub thread, as
+    // soon as there is one or the subscriber gets closed.
+    bool TryNext(IndicationPtr* indication, std::function<void()> wake);
+
+    // Indications queued for the writer
+    size_t Pending() { return ring.Size(); }
+
+    // Disconnected by the hub, because it fell behind or the hub stopped
+    bool Closed();
+    // Status ending the stream of a closed subscriber
+    grpc::Status ClosedStatus();
+};
+
+// Fan-out of the openolt indication stream.
+//
+// The agent drains a single indication queue into whichever EnableIndication
+// stream reads it, so separate upstream streams per client would split the
+// indications between them. The hub keeps exactly one upstream stream, opened
+// on the first subscription and kept open from then on, and copies every
+// indication into the ring of each subscriber. Clients come and go without
+// the upstream stream noticing. A slow subscriber only affects itself, as
+// set by the slow policy.
+class IndicationHub {
+    std::unique_ptr<openolt::Openolt::Stub> stub;
+    size_t queueSize;
+    IndicationSlowPolicy slowPolicy;
+
+    std::mutex lock;
+    std::vector<std::shared_ptr<IndicationSubscriber> > subscribers;
+    grpc::ClientContext* upstreamCtx;
+    bool started;
+    bool stopping;
+    // Signalled by Stop, cuts the reconnect backoff short
+    std::condition_variable stopped;
+    std::thread reader;
+    int metricsCollector;
+
+    void ReadLoop();
+    void Publish(const IndicationPtr& indication);
+
+    public:
+    std::atomic<unsigned long> received;
+    std::atomic<unsigned long> written;
+    std::atomic<unsigned long> flushes;
+    std::atomic<unsigned long> writeStallUs;
+    std::atomic<unsigned long> upstreamConnects;
+    std::atomic<bool> upstreamConnected;
+
+    IndicationHub(std::shared_ptr<grpc::Channel> channel, int queue_size, IndicationSlowPolicy slow_policy);
+    ~IndicationHub();
+
+    // Adds a subscriber, starting the upstream stream if not yet done
+    std::shared_ptr<IndicationSubscriber> Subscribe(const std::string& peer);
+    void Unsubscribe(const std::shared_ptr<IndicationSubscriber>& subscriber);
+
+    // Ends the upstream stream and closes every subscriber
+    void Stop();
+
+    // Accounts the indications a writer sent in one flush to its client
+    // and the time it was blocked writing them
+    void RecordFlush(int indications, long stall_us);
+
+    void CollectMetrics(std::string* out);
+};
+
+#endif
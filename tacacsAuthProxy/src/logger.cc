@@ -193,6 +193,8 @@ namespace loguru
     static char                  s_current_dir[PATH_MAX];
     static CallbackVec           s_callbacks;
     static fatal_handler_t       s_fatal_handler   = nullptr;
+    static log_interceptor_t     s_log_interceptor = nullptr;
+    static log_drain_t           s_log_drain       = nullptr;
     static verbosity_to_name_t   s_verbosity_to_name_callback = nullptr;
     static name_to_verbosity_t   s_name_to_verbosity_callback = nullptr;
     static StringPairList        s_user_stack_cleanups;
@@ -805,6 +807,12 @@ namespace loguru
                     return s_fatal_handler;
                 }
 
+                void set_async_backend(log_interceptor_t interceptor, log_drain_t drain)
+                {
+                    s_log_drain = drain;
+                    s_log_interceptor = interceptor;
+                }
+
                 void set_verbosity_to_name_callback(verbosity_to_name_t callback)
                 {
                     s_verbosity_to_name_callback = callback;
@@ -1182,22 +1190,18 @@ namespace loguru
                     }
                 }
 
-                static void print_preamble(char* out_buff, size_t out_buff_size, Verbosity verbosity, const char* file, unsigned line)
+                static void print_preamble_at(char* out_buff, size_t out_buff_size, Verbosity verbosity, const char* file, unsigned line,
+                        long long ms_since_epoch, long long uptime_ms, const char* thread_name)
                 {
                     if (out_buff_size == 0) { return; }
                     out_buff[0] = '\0';
                     if (!g_preamble) { return; }
-                    long long ms_since_epoch = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
                     time_t sec_since_epoch = time_t(ms_since_epoch / 1000);
                     tm time_info;
                     localtime_r(&sec_since_epoch, &time_info);
 
-                    auto uptime_ms = duration_cast<milliseconds>(steady_clock::now() - s_start_time).count();
                     auto uptime_sec = static_cast<double> (uptime_ms) / 1000.0;
 
-                    char thread_name[LOGURU_THREADNAME_WIDTH + 1] = {0};
-                    get_thread_name(thread_name, LOGURU_THREADNAME_WIDTH + 1, true);
-
                     if (s_strip_file_path) {
                         file = filename(file);
                     }
@@ -1243,10 +1247,26 @@ namespace loguru
                     }
                 }
 
+                static void print_preamble(char* out_buff, size_t out_buff_size, Verbosity verbosity, const char* file, unsigned line)
+                {
+                    long long ms_since_epoch = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+                    auto uptime_ms = duration_cast<milliseconds>(steady_clock::now() - s_start_time).count();
+
+                    char thread_name[LOGURU_THREADNAME_WIDTH + 1] = {0};
+                    get_thread_name(thread_name, LOGURU_THREADNAME_WIDTH + 1, true);
+
+                    print_preamble_at(out_buff, out_buff_size, verbosity, file, line, ms_since_epoch, uptime_ms, thread_name);
+                }
+
                 // stack_trace_skip is just if verbosity == FATAL.
-                static void log_message(int stack_trace_skip, Message& message, bool with_indentation, bool abort_if_fatal)
+                static void log_message(int stack_trace_skip, Message& message, bool with_indentation, bool abort_if_fatal,
+                        bool flush_now = true)
                 {
                     const auto verbosity = message.verbosity;
+                    if (verbosity == Verbosity_FATAL && s_log_drain) {
+                        // Before taking the lock, the backend may be waiting for it
+                        s_log_drain();
+                    }
                     std::lock_guard<std::recursive_mutex> lock(s_mutex);
 
                     if (message.verbosity == Verbosity_FATAL) {
@@ -1292,7 +1312,7 @@ namespace loguru
                                     message.preamble, message.indentation, message.prefix, message.message);
                         }
 
-                        if (g_flush_interval_ms == 0) {
+                        if (g_flush_interval_ms == 0 && flush_now) {
                             fflush(stderr);
                         } else {
                             s_needs_flushing = true;
@@ -1305,7 +1325,7 @@ namespace loguru
                                 message.indentation = indentation(p.indentation);
                             }
                             p.callback(p.user_data, message);
-                            if (g_flush_interval_ms == 0) {
+                            if (g_flush_interval_ms == 0 && flush_now) {
                                 if (p.flush) { p.flush(p.user_data); }
                             } else {
                                 s_needs_flushing = true;
@@ -1355,6 +1375,18 @@ namespace loguru
                     log_message(stack_trace_skip + 1, message, true, true);
                 }
 
+                void log_deferred(Verbosity verbosity, const char* file, unsigned line,
+                        long long ms_since_epoch, const char* thread_name, const char* buff)
+                {
+                    // Uptime when the message was logged, not now
+                    long long now_ms = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+                    auto uptime_ms = duration_cast<milliseconds>(steady_clock::now() - s_start_time).count() - (now_ms - ms_since_epoch);
+                    char preamble_buff[LOGURU_PREAMBLE_WIDTH];
+                    print_preamble_at(preamble_buff, sizeof(preamble_buff), verbosity, file, line, ms_since_epoch, uptime_ms, thread_name);
+                    auto message = Message{verbosity, file, line, preamble_buff, "", "", buff};
+                    log_message(1, message, true, true, false);
+                }
+
 #if LOGURU_USE_FMTLIB
                 void vlog(Verbosity verbosity, const char* file, unsigned line, const char* format, fmt::format_args args)
                 {
@@ -1372,6 +1404,14 @@ namespace loguru
                 void log(Verbosity verbosity, const char* file, unsigned line, const char* format, ...)
                 {
                     va_list vlist;
+                    if (s_log_interceptor && verbosity != Verbosity_FATAL) {
+                        va_start(vlist, format);
+                        bool taken = s_log_interceptor(verbosity, file, line, format, vlist);
+                        va_end(vlist);
+                        if (taken) {
+                            return;
+                        }
+                    }
                     va_start(vlist, format);
                     auto buff = vtextprintf(format, vlist);
                     log_to_everywhere(1, verbosity, file, line, "", buff.c_str());
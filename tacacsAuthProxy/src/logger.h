@@ -236,6 +236,8 @@ Website: www.ilikebigbits.com
     #define LOGURU_FMT(x) "%" #x
 #endif
 
+#include <cstdarg>
+
 #ifdef _WIN32
     #define STRDUP(str) _strdup(str)
 #else
@@ -548,6 +550,22 @@ namespace loguru
     LOGURU_EXPORT
     fatal_handler_t get_fatal_handler();
 
+    /*  Lets an asynchronous backend take over the log() calls below FATAL.
+        The interceptor returns false to have the message logged right away instead.
+        drain must write out every message the backend still holds. It is called
+        before any FATAL message is logged, so that nothing logged earlier is lost. */
+    typedef bool (*log_interceptor_t)(Verbosity verbosity, const char* file, unsigned line,
+                                      const char* format, va_list vlist);
+    typedef void (*log_drain_t)();
+    LOGURU_EXPORT
+    void set_async_backend(log_interceptor_t interceptor, log_drain_t drain);
+
+    /*  Writes a message taken over by an asynchronous backend, with the time and the
+        thread it was logged from. Flushing is left to the caller, see flush(). */
+    LOGURU_EXPORT
+    void log_deferred(Verbosity verbosity, const char* file, unsigned line,
+                      long long ms_since_epoch, const char* thread_name, const char* message);
+
     /*  Will be called on each log messages with a verbosity less or equal to the given one.
         Useful for displaying messages on-screen in a game, for example.
         The given on_close is also expected to flush (if desired).
@@ -25,6 +25,7 @@ int main(int argc, char** argv) {
     signal(SIGINT, StopServer);
     signal(SIGQUIT, StopServer);
     signal(SIGTERM, StopServer);
+    signal(SIGHUP, FlushCaches);
 
     RunServer(argc, argv);
 
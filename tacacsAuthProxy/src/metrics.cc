@@ -0,0 +1,384 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "metrics.h"
+#include "proxy_methods.h"
+#include "logger.h"
+
+// Interval at which the metrics server checks for shutdown
+#define METRICS_POLL_MS 500
+#define METRICS_IO_TIMEOUT_SEC 2
+
+static const char* phase_names[METRICS_PHASE_COUNT] = { "authen", "author", "accounting", "upstream", "total" };
+
+static unsigned ThreadStripe() {
+    static std::atomic<unsigned> next(0);
+    static thread_local unsigned stripe = next.fetch_add(1, std::memory_order_relaxed) % METRICS_STRIPES;
+    return stripe;
+}
+
+LatencyHistogram::LatencyHistogram() {
+    for (int s = 0; s < METRICS_STRIPES; s++) {
+        for (int i = 0; i < BUCKETS; i++) {
+            stripes[s].buckets[i].store(0, std::memory_order_relaxed);
+        }
+        stripes[s].sum_us.store(0, std::memory_order_relaxed);
+    }
+}
+
+int LatencyHistogram::BucketIndex(uint64_t us) {
+    if (us < SUB_BUCKETS) {
+        return (int)us;
+    }
+    int magnitude = 63 - __builtin_clzll(us);
+    int idx = (magnitude - SUB_BUCKET_BITS + 1) * SUB_BUCKETS +
+        (int)((us >> (magnitude - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1));
+    return (idx < BUCKETS) ? idx : BUCKETS - 1;
+}
+
+uint64_t LatencyHistogram::BucketUpperBound(int idx) {
+    if (idx < SUB_BUCKETS) {
+        return idx + 1;
+    }
+    int shift = idx / SUB_BUCKETS - 1;
+    uint64_t sub = idx % SUB_BUCKETS;
+    return (SUB_BUCKETS + sub + 1) << shift;
+}
+
+void LatencyHistogram::Record(long us) {
+    Stripe& stripe = stripes[ThreadStripe()];
+    uint64_t value = (us > 0) ? us : 0;
+    stripe.buckets[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    stripe.sum_us.fetch_add(value, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::Read(Snapshot* snapshot) const {
+    memset(snapshot, 0, sizeof(*snapshot));
+    for (int s = 0; s < METRICS_STRIPES; s++) {
+        for (int i = 0; i < BUCKETS; i++) {
+            uint64_t n = stripes[s].buckets[i].load(std::memory_order_relaxed);
+            snapshot->buckets[i] += n;
+            snapshot->count += n;
+        }
+        snapshot->sum_us += stripes[s].sum_us.load(std::memory_order_relaxed);
+    }
+}
+
+PhaseTimer::~PhaseTimer() {
+    if (metrics != NULL) {
+        metrics->Record(phase, std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - start).count());
+    }
+}
+
+CallTracker::CallTracker(MethodMetrics* method_metrics) : metrics(method_metrics),
+    total(method_metrics, METRICS_PHASE_TOTAL) {
+    if (metrics != NULL) {
+        metrics->inflight.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+CallTracker::~CallTracker() {
+    if (metrics != NULL) {
+        metrics->inflight.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+ProxyMetrics::ProxyMetrics() : nextCollector(1), connectFailures(0) {
+    for (int i = 0; i < METRICS_PHASE_COUNT; i++) {
+        fallbackPass[i] = 0;
+        cacheHits[i] = 0;
+        cacheMisses[i] = 0;
+    }
+    for (int i = 0; i < ProxyMethodCount(); i++) {
+        MethodMetrics* metrics = new MethodMetrics(ProxyMethodAt(i)->name);
+        methods[metrics->name] = metrics;
+        ordered.push_back(metrics);
+    }
+}
+
+ProxyMetrics& ProxyMetrics::Instance() {
+    static ProxyMetrics instance;
+    return instance;
+}
+
+MethodMetrics* ProxyMetrics::Method(const std::string& name) {
+    std::unordered_map<std::string, MethodMetrics*>::const_iterator it = methods.find(name);
+    return (it != methods.end()) ? it->second : NULL;
+}
+
+int ProxyMetrics::AddCollector(Collector collector) {
+    std::lock_guard<std::mutex> guard(collectorLock);
+    collectors.push_back(std::make_pair(nextCollector, collector));
+    return nextCollector++;
+}
+
+void ProxyMetrics::RemoveCollector(int id) {
+    std::lock_guard<std::mutex> guard(collectorLock);
+    for (size_t i = 0; i < collectors.size(); i++) {
+        if (collectors[i].first == id) {
+            collectors.erase(collectors.begin() + i);
+            return;
+        }
+    }
+}
+
+static std::string EscapeLabel(const std::string& value) {
+    std::string escaped;
+    for (size_t i = 0; i < value.size(); i++) {
+        if (value[i] == '\\' || value[i] == '"') {
+            escaped += '\\';
+            escaped += value[i];
+        } else if (value[i] == '\n') {
+            escaped += "\\n";
+        } else {
+            escaped += value[i];
+        }
+    }
+    return escaped;
+}
+
+void MetricsSample(std::string* out, const char* name, const std::vector<std::pair<const char*, std::string> >& labels,
+        double value) {
+    char buf[64];
+    *out += name;
+    if (!labels.empty()) {
+        *out += '{';
+        for (size_t i = 0; i < labels.size(); i++) {
+            if (i > 0) {
+                *out += ',';
+            }
+            *out += labels[i].first;
+            *out += "=\"";
+            *out += EscapeLabel(labels[i].second);
+            *out += '"';
+        }
+        *out += '}';
+    }
+    snprintf(buf, sizeof buf, " %.12g\n", value);
+    *out += buf;
+}
+
+void MetricsFamily(std::string* out, const char* name, const char* type, const char* help) {
+    *out += std::string("# HELP ") + name + " " + help + "\n";
+    *out += std::string("# TYPE ") + name + " " + type + "\n";
+}
+
+static void RenderCounter(std::string* out, const char* name, const char* help, const char* label,
+        const std::atomic<unsigned long>* values) {
+    MetricsFamily(out, name, "counter", help);
+    for (int phase = METRICS_PHASE_AUTHEN; phase <= METRICS_PHASE_AUTHOR; phase++) {
+        std::vector<std::pair<const char*, std::string> > labels;
+        labels.push_back(std::make_pair(label, std::string(phase_names[phase])));
+        MetricsSample(out, name, labels, values[phase].load(std::memory_order_relaxed));
+    }
+}
+
+// Buckets are exported at every power of two microseconds, which fall on
+// bucket boundaries, so the cumulative counts are exact
+void MetricsHistogram(std::string* out, const char* name, std::vector<std::pair<const char*, std::string> > labels,
+        const LatencyHistogram::Snapshot& snapshot) {
+    size_t le_label = labels.size();
+    labels.push_back(std::make_pair("le", std::string()));
+    std::string bucket_name = std::string(name) + "_bucket";
+
+    uint64_t cumulative = 0;
+    int idx = 0;
+    char le[32];
+    for (uint64_t bound = 1; idx < LatencyHistogram::BUCKETS; bound <<= 1) {
+        while (idx < LatencyHistogram::BUCKETS && LatencyHistogram::BucketUpperBound(idx) <= bound) {
+            cumulative += snapshot.buckets[idx++];
+        }
+        if (idx == LatencyHistogram::BUCKETS) {
+            break;
+        }
+        snprintf(le, sizeof le, "%.9g", bound / 1e6);
+        labels[le_label].second = le;
+        MetricsSample(out, bucket_name.c_str(), labels, cumulative);
+    }
+    labels[le_label].second = "+Inf";
+    MetricsSample(out, bucket_name.c_str(), labels, snapshot.count);
+    labels.pop_back();
+    MetricsSample(out, (std::string(name) + "_sum").c_str(), labels, snapshot.sum_us / 1e6);
+    MetricsSample(out, (std::string(name) + "_count").c_str(), labels, snapshot.count);
+}
+
+std::string ProxyMetrics::Render() {
+    std::string out;
+    LatencyHistogram::Snapshot snapshot;
+
+    // Methods and phases without any sample are left out
+    const char* histogram = "tacacs_proxy_phase_duration_seconds";
+    MetricsFamily(&out, histogram, "histogram", "Time spent per RPC method and processing phase");
+    for (size_t i = 0; i < ordered.size(); i++) {
+        for (int phase = 0; phase < METRICS_PHASE_COUNT; phase++) {
+            ordered[i]->phases[phase].Read(&snapshot);
+            if (snapshot.count > 0) {
+                std::vector<std::pair<const char*, std::string> > labels;
+                labels.push_back(std::make_pair("method", ordered[i]->name));
+                labels.push_back(std::make_pair("phase", std::string(phase_names[phase])));
+                MetricsHistogram(&out, histogram, labels, snapshot);
+            }
+        }
+    }
+
+    MetricsFamily(&out, "tacacs_proxy_inflight_calls", "gauge", "Calls being processed per RPC method");
+    for (size_t i = 0; i < ordered.size(); i++) {
+        std::vector<std::pair<const char*, std::string> > labels;
+        labels.push_back(std::make_pair("method", ordered[i]->name));
+        MetricsSample(&out, "tacacs_proxy_inflight_calls", labels, ordered[i]->inflight.load(std::memory_order_relaxed));
+    }
+
+    RenderCounter(&out, "tacacs_proxy_fallback_pass_total",
+            "Calls let through by TACACS_FALLBACK_PASS because no TACACS+ server answered", "phase", fallbackPass);
+    RenderCounter(&out, "tacacs_proxy_cache_hits_total", "TACACS+ decisions taken from the cache", "cache", cacheHits);
+    RenderCounter(&out, "tacacs_proxy_cache_misses_total", "TACACS+ decisions not found in the cache", "cache",
+            cacheMisses);
+    MetricsFamily(&out, "tacacs_proxy_connect_failures_total", "counter",
+            "TACACS+ checks for which no server could be connected to");
+    MetricsSample(&out, "tacacs_proxy_connect_failures_total", std::vector<std::pair<const char*, std::string> >(),
+            connectFailures.load(std::memory_order_relaxed));
+
+    std::lock_guard<std::mutex> guard(collectorLock);
+    for (size_t i = 0; i < collectors.size(); i++) {
+        collectors[i].second(&out);
+    }
+    return out;
+}
+
+MetricsServer::~MetricsServer() {
+    Stop();
+}
+
+bool MetricsServer::Start(const char* address) {
+    std::string s(address);
+    size_t pos = s.rfind(':');
+    if (pos == std::string::npos) {
+        LOG_F(ERROR, "Metrics address %s is not host:port", address);
+        return false;
+    }
+    std::string host = s.substr(0, pos);
+    std::string port = s.substr(pos + 1);
+    if (host.size() > 1 && host[0] == '[' && host[host.size() - 1] == ']') {
+        host = host.substr(1, host.size() - 2);
+    }
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof hints);
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    struct addrinfo* res = NULL;
+    int ret = getaddrinfo(host.empty() ? NULL : host.c_str(), port.c_str(), &hints, &res);
+    if (ret != 0) {
+        LOG_F(ERROR, "Error: resolving metrics address %s: %s", address, gai_strerror(ret));
+        return false;
+    }
+
+    fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    int one = 1;
+    if (fd < 0 || setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one) < 0 ||
+            bind(fd, res->ai_addr, res->ai_addrlen) < 0 || listen(fd, 16) < 0) {
+        LOG_F(ERROR, "Unable to serve metrics on %s: %s", address, strerror(errno));
+        freeaddrinfo(res);
+        if (fd >= 0) {
+            close(fd);
+            fd = -1;
+        }
+        return false;
+    }
+    freeaddrinfo(res);
+
+    acceptor = std::thread(&MetricsServer::Serve, this);
+    LOG_F(INFO, "Serving metrics on http://%s/metrics", address);
+    return true;
+}
+
+void MetricsServer::Stop() {
+    stopping = true;
+    if (acceptor.joinable()) {
+        acceptor.join();
+    }
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+// Scrapes are rare, one at a time is plenty
+void MetricsServer::Serve() {
+    while (!stopping) {
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        if (poll(&pfd, 1, METRICS_POLL_MS) <= 0) {
+            continue;
+        }
+        int client = accept(fd, NULL, NULL);
+        if (client < 0) {
+            continue;
+        }
+        Respond(client);
+        close(client);
+    }
+}
+
+void MetricsServer::Respond(int client) {
+    struct timeval tv;
+    tv.tv_sec = METRICS_IO_TIMEOUT_SEC;
+    tv.tv_usec = 0;
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof tv);
+    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof tv);
+
+    // Only the request line matters
+    std::string request;
+    char buf[1024];
+    while (request.find("\r\n") == std::string::npos && request.size() < sizeof buf * 4) {
+        ssize_t n = recv(client, buf, sizeof buf, 0);
+        if (n <= 0) {
+            return;
+        }
+        request.append(buf, n);
+    }
+
+    std::string body;
+    std::string response;
+    if (request.compare(0, 13, "GET /metrics ") == 0 || request.compare(0, 6, "GET / ") == 0) {
+        body = ProxyMetrics::Instance().Render();
+        response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n";
+    } else {
+        body = "Not found\n";
+        response = "HTTP/1.0 404 Not Found\r\nContent-Type: text/plain\r\n";
+    }
+    snprintf(buf, sizeof buf, "Content-Length: %zu\r\nConnection: close\r\n\r\n", body.size());
+    response += buf;
+    response += body;
+
+    size_t sent = 0;
+    while (sent < response.size()) {
+        ssize_t n = send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return;
+        }
+        sent += n;
+    }
+}
@@ -0,0 +1,180 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef METRICS_H_
+#define METRICS_H_
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+
+// Threads update one of METRICS_STRIPES copies of every histogram, so that
+// concurrent calls rarely touch the same cache lines
+#define METRICS_STRIPES 8
+
+// Processing phases of a proxied call
+enum MetricsPhase {
+    METRICS_PHASE_AUTHEN,       // TACACS+ authentication exchange, failover included
+    METRICS_PHASE_AUTHOR,       // TACACS+ authorization exchange
+    METRICS_PHASE_ACCOUNTING,   // delivery of an accounting record, in the background
+    METRICS_PHASE_UPSTREAM,     // forwarded call to the openolt agent
+    METRICS_PHASE_TOTAL,        // whole call as seen by the client
+    METRICS_PHASE_COUNT
+};
+
+// Latency distribution in microseconds, with log-linear buckets in the
+// manner of HdrHistogram: every power of two is split into 8 sub-buckets,
+// keeping the relative error under 12.5% from 1 us to over a minute.
+// Recording is a couple of relaxed atomic increments on the stripe of the
+// calling thread, no locks.
+class LatencyHistogram {
+    public:
+    static const int SUB_BUCKET_BITS = 3;
+    static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static const int MAGNITUDES = 24;
+    static const int BUCKETS = (MAGNITUDES + 1) * SUB_BUCKETS;
+
+    struct Snapshot {
+        uint64_t buckets[BUCKETS];
+        uint64_t count;
+        uint64_t sum_us;
+    };
+
+    private:
+    struct Stripe {
+        std::atomic<uint64_t> buckets[BUCKETS];
+        std::atomic<uint64_t> sum_us;
+        char pad[64];
+    };
+    Stripe stripes[METRICS_STRIPES];
+
+    public:
+    LatencyHistogram();
+
+    void Record(long us);
+    // Merges the stripes. Concurrent updates may or may not be included.
+    void Read(Snapshot* snapshot) const;
+
+    static int BucketIndex(uint64_t us);
+    // Values of bucket idx are below this bound
+    static uint64_t BucketUpperBound(int idx);
+};
+
+// Histograms and in-flight gauge of one RPC method
+class MethodMetrics {
+    public:
+    std::string name;
+    LatencyHistogram phases[METRICS_PHASE_COUNT];
+    std::atomic<long> inflight;
+
+    MethodMetrics(const std::string& method_name) : name(method_name), inflight(0) {}
+
+    void Record(MetricsPhase phase, long us) { phases[phase].Record(us); }
+};
+
+// Records the lifetime of a scope into a phase, unless metrics is NULL
+class PhaseTimer {
+    MethodMetrics* metrics;
+    MetricsPhase phase;
+    std::chrono::steady_clock::time_point start;
+
+    public:
+    PhaseTimer(MethodMetrics* method_metrics, MetricsPhase timed_phase) :
+        metrics(method_metrics), phase(timed_phase), start(std::chrono::steady_clock::now()) {}
+    ~PhaseTimer();
+};
+
+// Counts a call in flight and records its total duration
+class CallTracker {
+    MethodMetrics* metrics;
+    PhaseTimer total;
+
+    public:
+    CallTracker(MethodMetrics* method_metrics);
+    ~CallTracker();
+
+    MethodMetrics* Method() { return metrics; }
+};
+
+// Registry of the proxy's metrics, rendered in the Prometheus text format.
+//
+// Per-method metrics are created up front for every proxied method, lookups
+// never lock. Components owning their own statistics, like connection pools
+// and queues, add a collector that appends them when the metrics are read.
+class ProxyMetrics {
+    public:
+    typedef std::function<void(std::string* out)> Collector;
+
+    private:
+    std::unordered_map<std::string, MethodMetrics*> methods;
+    std::vector<MethodMetrics*> ordered;
+    std::mutex collectorLock;
+    std::vector<std::pair<int, Collector> > collectors;
+    int nextCollector;
+
+    ProxyMetrics();
+
+    public:
+    // TACACS+ decisions, indexed by METRICS_PHASE_AUTHEN or METRICS_PHASE_AUTHOR
+    std::atomic<unsigned long> fallbackPass[METRICS_PHASE_COUNT];
+    std::atomic<unsigned long> cacheHits[METRICS_PHASE_COUNT];
+    std::atomic<unsigned long> cacheMisses[METRICS_PHASE_COUNT];
+    std::atomic<unsigned long> connectFailures;
+
+    static ProxyMetrics& Instance();
+
+    // Metrics of an RPC method by name, NULL for methods that are not proxied
+    MethodMetrics* Method(const std::string& name);
+
+    // Returns the id to remove the collector by, which its owner must do
+    // before it goes away
+    int AddCollector(Collector collector);
+    void RemoveCollector(int id);
+
+    std::string Render();
+};
+
+// Appends one sample line, label values are escaped
+void MetricsSample(std::string* out, const char* name, const std::vector<std::pair<const char*, std::string> >& labels,
+        double value);
+// Appends the HELP and TYPE lines of a metric family
+void MetricsFamily(std::string* out, const char* name, const char* type, const char* help);
+// Appends the bucket, sum and count samples of a latency histogram in seconds
+void MetricsHistogram(std::string* out, const char* name, std::vector<std::pair<const char*, std::string> > labels,
+        const LatencyHistogram::Snapshot& snapshot);
+
+// Serves GET /metrics over plain HTTP, meant for a local address
+class MetricsServer {
+    int fd;
+    std::atomic<bool> stopping;
+    std::thread acceptor;
+
+    void Serve();
+    void Respond(int client);
+
+    public:
+    MetricsServer() : fd(-1), stopping(false) {}
+    ~MetricsServer();
+
+    // address is host:port. False if it cannot be listened on.
+    bool Start(const char* address);
+    void Stop();
+};
+
+#endif
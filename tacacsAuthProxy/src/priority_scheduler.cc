@@ -0,0 +1,253 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+#include "priority_scheduler.h"
+#include "logger.h"
+
+static const char* class_names[PRIORITY_CLASS_COUNT] = { "critical", "normal", "bulk" };
+
+// Methods outside the normal class unless configured otherwise
+static const struct {
+    const char* method;
+    PriorityClass cls;
+} default_classes[] = {
+    { "HeartbeatCheck", PRIORITY_CRITICAL },
+    { "EnableIndication", PRIORITY_CRITICAL },
+    { "OmciMsgOut", PRIORITY_CRITICAL },
+    { "FlowAdd", PRIORITY_BULK },
+    { "FlowRemove", PRIORITY_BULK },
+    { "CreateTrafficSchedulers", PRIORITY_BULK },
+    { "RemoveTrafficSchedulers", PRIORITY_BULK },
+    { "CreateTrafficQueues", PRIORITY_BULK },
+    { "RemoveTrafficQueues", PRIORITY_BULK },
+    { "PerformGroupOperation", PRIORITY_BULK },
+    { "DeleteGroup", PRIORITY_BULK },
+};
+
+PriorityOptions::PriorityOptions() : methods(NULL) {
+    workers[PRIORITY_CRITICAL] = 4;
+    workers[PRIORITY_NORMAL] = 16;
+    workers[PRIORITY_BULK] = 8;
+    budget[PRIORITY_CRITICAL] = 0;
+    budget[PRIORITY_NORMAL] = 0;
+    budget[PRIORITY_BULK] = 0;
+}
+
+bool ParsePriorityClass(const char* name, PriorityClass* cls) {
+    for (int i = 0; i < PRIORITY_CLASS_COUNT; i++) {
+        if (strcmp(name, class_names[i]) == 0) {
+            *cls = (PriorityClass)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* PriorityClassName(PriorityClass cls) {
+    return class_names[cls];
+}
+
+bool ParsePriorityValues(const char* spec, int* values) {
+    std::istringstream in(spec);
+    std::string item;
+    bool ok = true;
+    while (std::getline(in, item, ',')) {
+        size_t eq = item.find('=');
+        PriorityClass cls;
+        if (eq == std::string::npos || !ParsePriorityClass(item.substr(0, eq).c_str(), &cls)) {
+            ok = false;
+            continue;
+        }
+        values[cls] = atoi(item.c_str() + eq + 1);
+    }
+    return ok;
+}
+
+PriorityScheduler::PriorityScheduler(const PriorityOptions& options) : stopping(false) {
+    for (size_t i = 0; i < sizeof(default_classes) / sizeof(default_classes[0]); i++) {
+        methodClass[default_classes[i].method] = default_classes[i].cls;
+    }
+    if (options.methods != NULL) {
+        std::istringstream in(options.methods);
+        std::string item;
+        while (std::getline(in, item, ',')) {
+            size_t eq = item.find('=');
+            PriorityClass cls;
+            if (eq == std::string::npos || !ParsePriorityClass(item.substr(eq + 1).c_str(), &cls)) {
+                LOG_F(WARNING, "Ignoring priority class setting %s", item.c_str());
+                continue;
+            }
+            methodClass[item.substr(0, eq)] = cls;
+        }
+    }
+
+    for (int i = 0; i < PRIORITY_CLASS_COUNT; i++) {
+        int count = options.workers[i] > 0 ? options.workers[i] : 1;
+        classes[i].budget = options.budget[i] > 0 ? options.budget[i] : 0;
+        LOG_F(INFO, "Priority class %s: %d workers, budget %d", class_names[i], count, classes[i].budget);
+        for (int w = 0; w < count; w++) {
+            workers.push_back(std::thread(&PriorityScheduler::WorkerLoop, this, (PriorityClass)i));
+        }
+    }
+    metricsCollector = ProxyMetrics::Instance().AddCollector(
+            std::bind(&PriorityScheduler::CollectMetrics, this, std::placeholders::_1));
+}
+
+PriorityScheduler::~PriorityScheduler() {
+    ProxyMetrics::Instance().RemoveCollector(metricsCollector);
+    Stop();
+}
+
+PriorityClass PriorityScheduler::ClassOf(const std::string& method) {
+    std::unordered_map<std::string, PriorityClass>::const_iterator it = methodClass.find(method);
+    return it != methodClass.end() ? it->second : PRIORITY_NORMAL;
+}
+
+void PriorityScheduler::Notify(int cls) {
+    // Workers of the class itself first, they serve nothing more urgent
+    for (int i = cls; i < PRIORITY_CLASS_COUNT; i++) {
+        classes[i].cond.notify_one();
+    }
+}
+
+void PriorityScheduler::Submit(const std::string& method, std::function<void()> task) {
+    int cls = ClassOf(method);
+    Task queued;
+    queued.run = std::move(task);
+    queued.queued = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (!stopping) {
+            classes[cls].queue.push_back(std::move(queued));
+            queued.run = nullptr;
+        }
+    }
+    if (queued.run) {
+        // No workers left to run it
+        queued.run();
+        return;
+    }
+    Notify(cls);
+}
+
+void PriorityScheduler::Run(const std::string& method, std::function<void()> task) {
+    std::mutex doneLock;
+    std::condition_variable doneCond;
+    bool done = false;
+    Submit(method, [&]() {
+        task();
+        std::lock_guard<std::mutex> guard(doneLock);
+        done = true;
+        doneCond.notify_one();
+    });
+    std::unique_lock<std::mutex> guard(doneLock);
+    doneCond.wait(guard, [&done] { return done; });
+}
+
+int PriorityScheduler::PickClass(PriorityClass own) {
+    for (int i = 0; i <= own; i++) {
+        if (!classes[i].queue.empty() && (classes[i].budget == 0 || classes[i].running < classes[i].budget)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void PriorityScheduler::WorkerLoop(PriorityClass own) {
+    std::unique_lock<std::mutex> guard(lock);
+    for (;;) {
+        int cls;
+        classes[own].cond.wait(guard, [this, own, &cls] {
+            cls = PickClass(own);
+            return stopping || cls >= 0;
+        });
+        if (cls < 0) {
+            // Stopping with nothing left that this worker may run
+            return;
+        }
+        Task task = std::move(classes[cls].queue.front());
+        classes[cls].queue.pop_front();
+        classes[cls].running++;
+        guard.unlock();
+
+        classes[cls].queueWait.Record(std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - task.queued).count());
+        task.run();
+        classes[cls].completed++;
+
+        guard.lock();
+        classes[cls].running--;
+        if (classes[cls].budget > 0 && !classes[cls].queue.empty()) {
+            // A task held back by the budget may run now
+            Notify(cls);
+        }
+    }
+}
+
+// Lets queued tasks run to completion and joins the workers
+void PriorityScheduler::Stop() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (stopping) {
+            return;
+        }
+        stopping = true;
+    }
+    for (int i = 0; i < PRIORITY_CLASS_COUNT; i++) {
+        classes[i].cond.notify_all();
+    }
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i].join();
+    }
+}
+
+void PriorityScheduler::CollectMetrics(std::string* out) {
+    typedef std::vector<std::pair<const char*, std::string> > Labels;
+    size_t depth[PRIORITY_CLASS_COUNT];
+    int running[PRIORITY_CLASS_COUNT];
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        for (int i = 0; i < PRIORITY_CLASS_COUNT; i++) {
+            depth[i] = classes[i].queue.size();
+            running[i] = classes[i].running;
+        }
+    }
+    MetricsFamily(out, "tacacs_proxy_priority_queue_depth", "gauge", "Calls waiting for a worker per priority class");
+    for (int i = 0; i < PRIORITY_CLASS_COUNT; i++) {
+        MetricsSample(out, "tacacs_proxy_priority_queue_depth", Labels(1, std::make_pair("class", class_names[i])),
+                depth[i]);
+    }
+    MetricsFamily(out, "tacacs_proxy_priority_running", "gauge", "Calls being processed per priority class");
+    for (int i = 0; i < PRIORITY_CLASS_COUNT; i++) {
+        MetricsSample(out, "tacacs_proxy_priority_running", Labels(1, std::make_pair("class", class_names[i])),
+                running[i]);
+    }
+    MetricsFamily(out, "tacacs_proxy_priority_completed_total", "counter", "Calls processed per priority class");
+    for (int i = 0; i < PRIORITY_CLASS_COUNT; i++) {
+        MetricsSample(out, "tacacs_proxy_priority_completed_total", Labels(1, std::make_pair("class", class_names[i])),
+                classes[i].completed);
+    }
+
+    const char* histogram = "tacacs_proxy_priority_queue_wait_seconds";
+    MetricsFamily(out, histogram, "histogram", "Time calls waited for a worker per priority class");
+    LatencyHistogram::Snapshot snapshot;
+    for (int i = 0; i < PRIORITY_CLASS_COUNT; i++) {
+        classes[i].queueWait.Read(&snapshot);
+        MetricsHistogram(out, histogram, Labels(1, std::make_pair("class", class_names[i])), snapshot);
+    }
+}
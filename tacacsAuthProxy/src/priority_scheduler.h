@@ -0,0 +1,107 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef PRIORITY_SCHEDULER_H_
+#define PRIORITY_SCHEDULER_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "metrics.h"
+
+// Priority classes, from the most urgent down
+enum PriorityClass {
+    PRIORITY_CRITICAL,      // heartbeat, indications and OMCI, which VOLTHA times out on
+    PRIORITY_NORMAL,
+    PRIORITY_BULK,          // flow and traffic scheduler configuration bursts
+    PRIORITY_CLASS_COUNT
+};
+
+// Workers and concurrency budget of the priority classes
+struct PriorityOptions {
+    int workers[PRIORITY_CLASS_COUNT];
+    // Most tasks of a class running at once, 0 for no limit beyond the workers
+    int budget[PRIORITY_CLASS_COUNT];
+    // method=class overrides of the default classes, comma separated
+    const char* methods;
+
+    PriorityOptions();
+};
+
+bool ParsePriorityClass(const char* name, PriorityClass* cls);
+const char* PriorityClassName(PriorityClass cls);
+// Parses class=value pairs, e.g. critical=4,bulk=2, into values indexed by class
+bool ParsePriorityValues(const char* spec, int* values);
+
+// Runs the TACACS+ processing of calls by priority class of their method.
+//
+// Every class has a FIFO queue and workers of its own. A worker serves its
+// own class and any more urgent one, always the most urgent queued task
+// first, so critical calls never wait behind bulk ones while bulk workers
+// cannot take the critical workers away. The budget of a class caps how
+// many of its tasks run at once on all workers together.
+class PriorityScheduler {
+    struct Task {
+        std::function<void()> run;
+        std::chrono::steady_clock::time_point queued;
+    };
+
+    struct ClassState {
+        std::deque<Task> queue;
+        int budget;
+        int running;
+        // Workers of this class wait here
+        std::condition_variable cond;
+        LatencyHistogram queueWait;
+        std::atomic<unsigned long> completed;
+
+        ClassState() : budget(0), running(0), completed(0) {}
+    };
+
+    ClassState classes[PRIORITY_CLASS_COUNT];
+    std::unordered_map<std::string, PriorityClass> methodClass;
+    std::mutex lock;
+    std::vector<std::thread> workers;
+    bool stopping;
+    int metricsCollector;
+
+    void WorkerLoop(PriorityClass own);
+    // Most urgent class a worker of class own can run now, or -1
+    int PickClass(PriorityClass own);
+    // Wakes a worker able to run a task of class cls
+    void Notify(int cls);
+
+    public:
+    PriorityScheduler(const PriorityOptions& options);
+    ~PriorityScheduler();
+
+    PriorityClass ClassOf(const std::string& method);
+
+    void Submit(const std::string& method, std::function<void()> task);
+    // Runs the task on a worker and waits for it
+    void Run(const std::string& method, std::function<void()> task);
+    void Stop();
+
+    void CollectMetrics(std::string* out);
+};
+
+#endif
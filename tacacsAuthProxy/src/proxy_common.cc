@@ -0,0 +1,344 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <strings.h>
+
+#include "proxy_common.h"
+#include "logger.h"
+
+// Value of every base64 character, BASE64_INVALID for the others
+#define BASE64_INVALID 0x80
+static const unsigned char base64_values[256] = {
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x3e, 0x80, 0x80, 0x80, 0x3f,
+    0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x3b, 0x3c, 0x3d, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
+    0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f, 0x30, 0x31, 0x32, 0x33, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80
+};
+
+// Longest credentials TACACS+ carries: the user and the password fields
+// are 255 bytes at most each
+#define CREDENTIALS_MAX (255 + 1 + 255)
+#define CREDENTIALS_ENCODED_MAX ((CREDENTIALS_MAX + 2) / 3 * 4)
+
+// Decodes len base64 characters, padding optional, into out, which holds
+// at least len / 4 * 3 + 2 bytes. Every character costs the same table
+// lookup, valid or not, so the time taken depends on the length only.
+static bool base64_decode(const char* in, size_t len, char* out, size_t* out_len) {
+    if (len >= 4 && len % 4 == 0 && in[len - 1] == '=') {
+        len -= (in[len - 2] == '=') ? 2 : 1;
+    }
+    if (len % 4 == 1) {
+        return false;
+    }
+    unsigned invalid = 0;
+    size_t o = 0;
+    size_t i = 0;
+    for (; i + 4 <= len; i += 4) {
+        unsigned a = base64_values[(unsigned char)in[i]];
+        unsigned b = base64_values[(unsigned char)in[i + 1]];
+        unsigned c = base64_values[(unsigned char)in[i + 2]];
+        unsigned d = base64_values[(unsigned char)in[i + 3]];
+        invalid |= a | b | c | d;
+        unsigned v = (a << 18) | (b << 12) | (c << 6) | d;
+        out[o++] = (char)(v >> 16);
+        out[o++] = (char)(v >> 8);
+        out[o++] = (char)v;
+    }
+    if (i < len) {
+        unsigned a = base64_values[(unsigned char)in[i]];
+        unsigned b = base64_values[(unsigned char)in[i + 1]];
+        unsigned c = (i + 2 < len) ? base64_values[(unsigned char)in[i + 2]] : 0;
+        invalid |= a | b | c;
+        unsigned v = (a << 18) | (b << 12) | (c << 6);
+        out[o++] = (char)(v >> 16);
+        if (i + 2 < len) {
+            out[o++] = (char)(v >> 8);
+        }
+    }
+    *out_len = o;
+    return (invalid & BASE64_INVALID) == 0;
+}
+
+bool ParseBasicCredentials(const grpc::string_ref& header, BasicCredentials* credentials) {
+    // Decoded credentials of the last call parsed on this thread
+    static thread_local char scratch[CREDENTIALS_ENCODED_MAX / 4 * 3 + 2];
+
+    if (header.length() <= 6 || strncasecmp(header.data(), "Basic ", 6) != 0 ||
+            header.length() - 6 > CREDENTIALS_ENCODED_MAX) {
+        return false;
+    }
+    size_t len;
+    if (!base64_decode(header.data() + 6, header.length() - 6, scratch, &len)) {
+        return false;
+    }
+    const char* colon = (const char*)memchr(scratch, ':', len);
+    if (colon == NULL) {
+        return false;
+    }
+    credentials->username = scratch;
+    credentials->username_len = colon - scratch;
+    credentials->password = colon + 1;
+    credentials->password_len = len - credentials->username_len - 1;
+    return true;
+}
+
+static std::atomic<int> UpstreamTimeoutMs(0);
+static SessionTokens* Tokens = NULL;
+
+void SetSessionTokens(SessionTokens* tokens) {
+    Tokens = tokens;
+}
+
+static AdmissionControl* Admission = NULL;
+
+void SetAdmissionControl(AdmissionControl* admission) {
+    Admission = admission;
+}
+
+static AuthCache* CredentialsCache = NULL;
+
+void SetCredentialsCache(AuthCache* cache) {
+    CredentialsCache = cache;
+}
+
+void SetUpstreamTimeout(int timeout_ms) {
+    UpstreamTimeoutMs = (timeout_ms > 0) ? timeout_ms : 0;
+}
+
+std::unique_ptr<ClientContext> UpstreamContext(const ServerContext* context, bool streaming) {
+    std::unique_ptr<ClientContext> ctx = ClientContext::FromServerContext(*context);
+    int timeout_ms = UpstreamTimeoutMs;
+    if (!streaming && timeout_ms > 0) {
+        std::chrono::system_clock::time_point cap =
+            std::chrono::system_clock::now() + std::chrono::milliseconds(timeout_ms);
+        if (cap < context->deadline()) {
+            ctx->set_deadline(cap);
+        }
+    }
+    return ctx;
+}
+
+bool DeadlineExpired(const TacacsContext* tacCtx, Status* status) {
+    if (tacCtx->deadline > TaccClock::now()) {
+        return false;
+    }
+    LOG_F(WARNING, "Deadline of %s call from %s expired before it was processed", tacCtx->method_name.c_str(),
+            tacCtx->remote_addr.c_str());
+    *status = Status(DEADLINE_EXCEEDED, "Deadline expired before the call was processed");
+    return true;
+}
+
+bool AdmissionRejected(AdmissionKey kind, PriorityScheduler* scheduler, const char* method,
+        const TacacsContext* tacCtx, Status* status) {
+    if (Admission == NULL || !Admission->Enabled(kind)) {
+        return false;
+    }
+    std::string key = (kind == ADMISSION_USER) ? tacCtx->username : SessionTokens::PeerHost(tacCtx->remote_addr);
+    if (Admission->Admit(kind, key, scheduler->ClassOf(method))) {
+        return false;
+    }
+    LOG_F(INFO, "Rejecting %s call of %s from %s, over the rate of its %s", method, tacCtx->username.c_str(),
+            tacCtx->remote_addr.c_str(), kind == ADMISSION_USER ? "user" : "host");
+    *status = Status(RESOURCE_EXHAUSTED, "Too many calls, retry later");
+    return true;
+}
+
+TacacsContext ExtractTacacsContext(ServerContext* context) {
+    LOG_F(MAX, "Extracting the gRPC credentials");
+    const std::multimap<grpc::string_ref, grpc::string_ref>& metadata = context->client_metadata();
+    std::multimap<grpc::string_ref, grpc::string_ref>::const_iterator data_iter = metadata.find("authorization");
+
+    TacacsContext tacCtx;
+
+    // Moved to the steady clock, the rest of the proxy does not care about wall clock jumps
+    std::chrono::system_clock::time_point deadline = context->deadline();
+    if (deadline != std::chrono::system_clock::time_point::max()) {
+        tacCtx.deadline = TaccClock::now() +
+            std::chrono::duration_cast<TaccClock::duration>(deadline - std::chrono::system_clock::now());
+    }
+
+    if(data_iter != metadata.end() && data_iter->second.starts_with("Bearer ")) {
+        std::string token(data_iter->second.data() + 7, data_iter->second.length() - 7);
+        SessionTokenClaims claims;
+        tacCtx.remote_addr = context->peer();
+        if (Tokens != NULL && Tokens->Validate(token, tacCtx.remote_addr, &claims)) {
+            tacCtx.username = claims.username;
+            tacCtx.token_authenticated = true;
+            tacCtx.token_expiry = claims.expiry;
+            tacCtx.token_commands.swap(claims.commands);
+            LOG_F(INFO, "Received session token of username=%s from Remote %s", tacCtx.username.c_str(),
+                    tacCtx.remote_addr.c_str());
+        } else {
+            LOG_F(WARNING, "Rejected session token from Remote %s", tacCtx.remote_addr.c_str());
+        }
+    } else if(data_iter != metadata.end()) {
+        BasicCredentials credentials;
+        tacCtx.remote_addr = context->peer();
+        if (!ParseBasicCredentials(data_iter->second, &credentials)) {
+            LOG_F(WARNING, "Malformed Basic credentials from Remote %s", tacCtx.remote_addr.c_str());
+            return tacCtx;
+        }
+        // Straight from the scratch buffer, the password is not even copied
+        // when the cache knows the credentials
+        AuthCache* cache = CredentialsCache;
+        if (cache != NULL && cache->Enabled()) {
+            bool passed;
+            tacCtx.credentials_digest = cache->Key(credentials.username, credentials.username_len,
+                    credentials.password, credentials.password_len, tacCtx.remote_addr);
+            tacCtx.credentials_digested = true;
+            if (!cache->Lookup(tacCtx.credentials_digest, &passed)) {
+                tacCtx.credentials_lookup = CREDENTIALS_MISS;
+            } else {
+                tacCtx.credentials_lookup = passed ? CREDENTIALS_CACHED_PASS : CREDENTIALS_CACHED_FAIL;
+            }
+        }
+        tacCtx.username.assign(credentials.username, credentials.username_len);
+        if (tacCtx.credentials_lookup == CREDENTIALS_NOT_LOOKED_UP || tacCtx.credentials_lookup == CREDENTIALS_MISS) {
+            tacCtx.password.assign(credentials.password, credentials.password_len);
+        }
+        LOG_F(INFO, "Received gRPC credentials username=%s from Remote %s", tacCtx.username.c_str(),
+                tacCtx.remote_addr.c_str());
+    } else {
+        LOG_F(WARNING, "Unable to find or extract credentials from incoming gRPC request");
+        tacCtx.username = "";
+    }
+
+    return tacCtx;
+}
+
+void AttachSessionToken(ServerContext* context, TacacsContext* tacCtx) {
+    if (Tokens == NULL || !Tokens->Enabled() || tacCtx->unverified_pass) {
+        return;
+    }
+    SessionTokenClaims claims;
+    claims.username = tacCtx->username;
+    claims.expiry = 0;
+    if (tacCtx->token_authenticated) {
+        if (std::find(tacCtx->token_commands.begin(), tacCtx->token_commands.end(), tacCtx->method_name) !=
+                tacCtx->token_commands.end()) {
+            return;
+        }
+        // The server authorized one more command, the token grows but
+        // does not live longer than the authentication behind it
+        claims.expiry = tacCtx->token_expiry;
+        claims.commands = tacCtx->token_commands;
+    }
+    claims.commands.push_back(tacCtx->method_name);
+    std::string token = Tokens->Issue(tacCtx->remote_addr, claims);
+    if (!token.empty()) {
+        context->AddInitialMetadata(SESSION_TOKEN_METADATA, token);
+    }
+}
+
+Status ProcessTacacsAuth(TaccController* taccController, TacacsContext* tacCtx) {
+    LOG_F(MAX, "Calling AuthenticateAndAuthorize");
+    return taccController->AuthenticateAndAuthorize(tacCtx);
+}
+
+// Bound on waiting for the START record once authorized, the call is
+// forwarded anyway past it
+#define ACCOUNTING_START_WAIT_MS 5000
+
+std::chrono::milliseconds AccountingStartWait(const TacacsContext* tacCtx) {
+    std::chrono::milliseconds wait(ACCOUNTING_START_WAIT_MS);
+    if (tacCtx->deadline != TaccClock::time_point::max()) {
+        TaccClock::duration remaining = std::max(tacCtx->deadline - TaccClock::now(), TaccClock::duration::zero());
+        wait = std::min(wait, std::chrono::duration_cast<std::chrono::milliseconds>(remaining));
+    }
+    return wait;
+}
+
+Status ProcessTacacsRequest(TaccController* taccController, PriorityScheduler* scheduler, const char* method,
+        ServerContext* context, TacacsContext* tacCtx) {
+    Status status;
+    if (DeadlineExpired(tacCtx, &status)) {
+        return status;
+    }
+    taccController->AllotBudget(tacCtx);
+
+    // The promise outlives this call should the wait give up
+    std::shared_ptr<std::promise<bool> > started = std::make_shared<std::promise<bool> >();
+    std::future<bool> accounted = started->get_future();
+    taccController->StartAccounting(tacCtx, [started](bool delivered) {
+        started->set_value(delivered);
+    });
+
+    status = ProcessTacacsAuth(taccController, tacCtx);
+    if(status.error_code() != StatusCode::OK) {
+        return status;
+    }
+    if (context != NULL && context->IsCancelled()) {
+        LOG_F(INFO, "%s call cancelled by the client during the TACACS+ checks", tacCtx->method_name.c_str());
+        return Status(CANCELLED, "Call cancelled by the client");
+    }
+    // Before any session token goes out, a rejected call must not get one
+    if (scheduler != NULL && AdmissionRejected(ADMISSION_USER, scheduler, method, tacCtx, &status)) {
+        return status;
+    }
+
+    if (accounted.wait_for(AccountingStartWait(tacCtx)) != std::future_status::ready) {
+        LOG_F(WARNING, "Accounting START of task %d still pending, proceeding", tacCtx->task_id);
+    } else if (!accounted.get()) {
+        LOG_F(WARNING, "Accounting START of task %d could not be delivered", tacCtx->task_id);
+    }
+    if (tacCtx->deadline <= TaccClock::now()) {
+        LOG_F(WARNING, "Deadline of %s call expired during the TACACS+ checks", tacCtx->method_name.c_str());
+        return Status(DEADLINE_EXCEEDED, "Deadline expired during the TACACS+ checks");
+    }
+    if (context != NULL) {
+        AttachSessionToken(context, tacCtx);
+    }
+    return status;
+}
+
+Status ScheduleTacacsRequest(PriorityScheduler* scheduler, const char* method, TaccController* taccController,
+        ServerContext* context, TacacsContext* tacCtx) {
+    Status status;
+    if (AdmissionRejected(ADMISSION_PEER, scheduler, method, tacCtx, &status)) {
+        return status;
+    }
+    scheduler->Run(method, [&]() {
+        status = ProcessTacacsRequest(taccController, scheduler, method, context, tacCtx);
+    });
+    return status;
+}
+
+void ProcessTacacsAuthAsync(TaccController* taccController, TacacsContext* tacCtx, TaccCallback done) {
+    LOG_F(MAX, "Calling Authenticate");
+    taccController->AuthenticateAsync(tacCtx, [taccController, tacCtx, done](const Status& status) {
+        if(status.error_code() != StatusCode::OK) {
+            done(status);
+            return;
+        }
+        LOG_F(MAX, "Calling Authorize");
+        taccController->AuthorizeAsync(tacCtx, done);
+    });
+}
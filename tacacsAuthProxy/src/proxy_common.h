@@ -0,0 +1,106 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROXY_COMMON_H_
+#define PROXY_COMMON_H_
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include "grpcpp/grpcpp.h"
+
+#include "tacacs_controller.h"
+#include "priority_scheduler.h"
+#include "session_token.h"
+#include "admission_control.h"
+
+// Helpers shared by the sync and async proxy server implementations
+
+// Credentials of a Basic authorization header, pointing into a buffer of the
+// calling thread that the next parse on that thread overwrites
+struct BasicCredentials {
+    const char* username;
+    size_t username_len;
+    const char* password;
+    size_t password_len;
+};
+
+// Checks the "Basic " scheme and the ':' separator and decodes the
+// credentials without allocating. False if the header is not usable.
+bool ParseBasicCredentials(const grpc::string_ref& header, BasicCredentials* credentials);
+
+// Extracts the Basic credentials or the session token, peer address and
+// deadline of an incoming call. Username is left empty when no usable
+// credentials are present, a token that is not accepted included.
+TacacsContext ExtractTacacsContext(ServerContext* context);
+
+// Authentication cache the credentials of calls are looked up in as they
+// are extracted, NULL to leave the lookup to the TACACS+ controller
+void SetCredentialsCache(AuthCache* cache);
+
+// Session tokens issued and accepted by the proxy, NULL or disabled to
+// accept Basic credentials only
+void SetSessionTokens(SessionTokens* tokens);
+
+// Response metadata carrying the session token
+#define SESSION_TOKEN_METADATA "tacacs-session-token"
+
+// Hands the client of an authorized call a session token, unless the call
+// was let through without a verdict of the TACACS+ server or the token it
+// presented already covers the command. Must run before the initial
+// metadata of the call is sent.
+void AttachSessionToken(ServerContext* context, TacacsContext* tacCtx);
+
+// Upper bound of forwarded unary calls, in milliseconds, applied on top of
+// the deadline of the client. 0 leaves them bounded by the client only.
+void SetUpstreamTimeout(int timeout_ms);
+
+// Context of the call forwarded to the openolt agent on behalf of context:
+// it inherits the deadline of the client and is cancelled along with it.
+// The upstream timeout does not apply to streaming calls.
+std::unique_ptr<ClientContext> UpstreamContext(const ServerContext* context, bool streaming = false);
+
+// Rejects a call whose deadline passed already, before any TACACS+ traffic
+bool DeadlineExpired(const TacacsContext* tacCtx, Status* status);
+
+// Rate limits of users and peer hosts, NULL to admit every call
+void SetAdmissionControl(AdmissionControl* admission);
+
+// Rejects a call of method over the rate of the peer host of tacCtx or, once
+// authenticated, of its user with RESOURCE_EXHAUSTED
+bool AdmissionRejected(AdmissionKey kind, PriorityScheduler* scheduler, const char* method,
+        const TacacsContext* tacCtx, Status* status);
+
+// How long an authorized call waits for its accounting START record before
+// it is forwarded anyway, never past the deadline of the call
+std::chrono::milliseconds AccountingStartWait(const TacacsContext* tacCtx);
+
+// Runs TACACS+ Authentication followed by Authorization
+Status ProcessTacacsAuth(TaccController* taccController, TacacsContext* tacCtx);
+// Starts accounting and runs the TACACS+ checks concurrently. When the call
+// may proceed, also waits for the START record to be delivered so that the
+// audit trail precedes the operation. The checks get their share of the
+// call deadline, calls that expired or were cancelled meanwhile are not
+// let through, nor are calls of method over the rate of their user. Without
+// a scheduler the rate of the user and without a context the session token
+// are left to the caller.
+Status ProcessTacacsRequest(TaccController* taccController, PriorityScheduler* scheduler, const char* method,
+        ServerContext* context, TacacsContext* tacCtx);
+// Same, run by a worker of the priority class of method while the caller
+// waits, within the rates of the peer host and the user
+Status ScheduleTacacsRequest(PriorityScheduler* scheduler, const char* method, TaccController* taccController,
+        ServerContext* context, TacacsContext* tacCtx);
+// Same without blocking; done runs once authorization is settled
+void ProcessTacacsAuthAsync(TaccController* taccController, TacacsContext* tacCtx, TaccCallback done);
+
+#endif
@@ -0,0 +1,82 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <unordered_map>
+
+#include "proxy_methods.h"
+
+static const ProxyMethod proxy_methods[] = {
+    { "DisableOlt",                  "/openolt.Openolt/DisableOlt",                 "disableolt",                  false },
+    { "ReenableOlt",                 "/openolt.Openolt/ReenableOlt",                "reenableolt",                 false },
+    { "ActivateOnu",                 "/openolt.Openolt/ActivateOnu",                "activateonu",                 false },
+    { "DeactivateOnu",               "/openolt.Openolt/DeactivateOnu",              "deactivateonu",               false },
+    { "DeleteOnu",                   "/openolt.Openolt/DeleteOnu",                  "deleteonu",                   false },
+    { "OmciMsgOut",                  "/openolt.Openolt/OmciMsgOut",                 "omcimsgout",                  false },
+    { "OnuPacketOut",                "/openolt.Openolt/OnuPacketOut",               "onupacketout",                false },
+    { "UplinkPacketOut",             "/openolt.Openolt/UplinkPacketOut",            "uplinkpacketout",             false },
+    { "FlowAdd",                     "/openolt.Openolt/FlowAdd",                    "flowadd",                     false },
+    { "FlowRemove",                  "/openolt.Openolt/FlowRemove",                 "flowremove",                  false },
+    { "EnableIndication",            "/openolt.Openolt/EnableIndication",           "enableindication",            true },
+    { "HeartbeatCheck",              "/openolt.Openolt/HeartbeatCheck",             "heartbeatcheck",              false },
+    { "EnablePonIf",                 "/openolt.Openolt/EnablePonIf",                "enableponif",                 false },
+    { "DisablePonIf",                "/openolt.Openolt/DisablePonIf",               "disableponif",                false },
+    { "GetDeviceInfo",               "/openolt.Openolt/GetDeviceInfo",              "getdeviceinfo",               false },
+    { "Reboot",                      "/openolt.Openolt/Reboot",                     "reboot",                      false },
+    { "CollectStatistics",           "/openolt.Openolt/CollectStatistics",          "collectstatistics",           false },
+    { "CreateTrafficSchedulers",     "/openolt.Openolt/CreateTrafficSchedulers",    "createtrafficschedulers",     false },
+    { "RemoveTrafficSchedulers",     "/openolt.Openolt/RemoveTrafficSchedulers",    "removetrafficschedulers",     false },
+    { "CreateTrafficQueues",         "/openolt.Openolt/CreateTrafficQueues",        "createtrafficqueues",         false },
+    { "RemoveTrafficQueues",         "/openolt.Openolt/RemoveTrafficQueues",        "removetrafficqueues",         false },
+    { "PerformGroupOperation",       "/openolt.Openolt/PerformGroupOperation",      "performgroupoperation",       false },
+    { "DeleteGroup",                 "/openolt.Openolt/DeleteGroup",                "deletegroup",                 false },
+    { "OnuItuPonAlarmSet",           "/openolt.Openolt/OnuItuPonAlarmSet",          "onuituponalarmset",           false },
+    { "GetLogicalOnuDistanceZero",   "/openolt.Openolt/GetLogicalOnuDistanceZero",  "getlogicalonudistancezero",   false },
+    { "GetLogicalOnuDistance",       "/openolt.Openolt/GetLogicalOnuDistance",      "getlogicalonudistance",       false },
+};
+
+static const int num_proxy_methods = sizeof(proxy_methods) / sizeof(proxy_methods[0]);
+
+typedef std::unordered_map<std::string, const ProxyMethod*> ProxyMethodIndex;
+
+static ProxyMethodIndex BuildIndex(bool by_path) {
+    ProxyMethodIndex index;
+    for (int i = 0; i < num_proxy_methods; i++) {
+        index[by_path ? proxy_methods[i].path : proxy_methods[i].name] = &proxy_methods[i];
+    }
+    return index;
+}
+
+const ProxyMethod* FindProxyMethodByPath(const std::string& path) {
+    static const ProxyMethodIndex by_path = BuildIndex(true);
+    ProxyMethodIndex::const_iterator it = by_path.find(path);
+    return (it != by_path.end()) ? it->second : NULL;
+}
+
+const ProxyMethod* FindProxyMethod(const std::string& name) {
+    static const ProxyMethodIndex by_name = BuildIndex(false);
+    ProxyMethodIndex::const_iterator it = by_name.find(name);
+    return (it != by_name.end()) ? it->second : NULL;
+}
+
+int ProxyMethodCount() {
+    return num_proxy_methods;
+}
+
+const ProxyMethod* ProxyMethodAt(int index) {
+    return &proxy_methods[index];
+}
+
+const char* TacacsCommand(const std::string& name) {
+    const ProxyMethod* method = FindProxyMethod(name);
+    return method ? method->tacacs_cmd : "";
+}
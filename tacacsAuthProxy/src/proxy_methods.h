@@ -0,0 +1,40 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROXY_METHODS_H_
+#define PROXY_METHODS_H_
+
+#include <string>
+
+// Openolt RPC proxied through TACACS+ AAA
+struct ProxyMethod {
+    const char* name;          // RPC name, e.g. FlowAdd
+    const char* path;          // gRPC method path, e.g. /openolt.Openolt/FlowAdd
+    const char* tacacs_cmd;    // value sent as the TACACS+ cmd attribute
+    bool server_streaming;
+};
+
+// Lookup by gRPC method path. Returns NULL for methods that are not proxied.
+const ProxyMethod* FindProxyMethodByPath(const std::string& path);
+
+// Lookup by RPC name. Returns NULL for methods that are not proxied.
+const ProxyMethod* FindProxyMethod(const std::string& name);
+
+// All proxied methods, for index in [0, ProxyMethodCount())
+int ProxyMethodCount();
+const ProxyMethod* ProxyMethodAt(int index);
+
+// TACACS+ cmd attribute for an RPC name
+const char* TacacsCommand(const std::string& name);
+
+#endif
@@ -11,10 +11,16 @@
  * limitations under the License.
  */
 
+#include <cerrno>
+#include <chrono>
+#include <csignal>
 #include <iostream>
 #include <memory>
 #include <string>
 #include <sstream>
+#include <thread>
+#include <sys/eventfd.h>
+#include <unistd.h>
 #include <grpcpp/health_check_service_interface.h>
 #include <grpcpp/ext/proto_server_reflection_plugin.h>
 #include <grpcpp/grpcpp.h>
@@ -24,6 +30,13 @@
 #include <voltha_protos/ext_config.grpc.pb.h>
 
 #include "tacacs_controller.h"
+#include "proxy_common.h"
+#include "proxy_methods.h"
+#include "metrics.h"
+#include "upstream_channel_pool.h"
+#include "indication_hub.h"
+#include "async_log.h"
+#include "async_proxy_server.h"
 #include "logger.h"
 
 using grpc::Channel;
@@ -37,79 +50,93 @@ using grpc::ClientContext;
 
 using namespace std;
 
-static const std::string base64_chars =
-"ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-"abcdefghijklmnopqrstuvwxyz"
-"0123456789+/";
-
-static inline bool is_base64(unsigned char c) {
-    return (isalnum(c) || (c == '+') || (c == '/'));
-}
-
 static Server* ServerInstance;
+static AsyncProxyServer* AsyncServerInstance;
+static TaccController* TaccControllerInstance;
+static IndicationHub* IndicationHubInstance;
 
-std::string base64_decode(std::string const& encoded_string);
+// StopServer only posts the signal here, the shutdown runs on ShutdownThread
+static int ShutdownFd = -1;
+static volatile sig_atomic_t ShutdownSignal = 0;
+static std::thread ShutdownThread;
+
+// How often a stream waiting for indications checks whether its client went away
+#define INDICATION_POLL_MS 1000
 
 class ProxyServiceImpl final : public openolt::Openolt::Service  {
 
     TaccController *taccController;
-    unique_ptr<openolt::Openolt::Stub> openoltClientStub;
-
-    public:
-    TacacsContext extractDataFromGrpc(ServerContext* context) {
-        LOG_F(MAX, "Extracting the gRPC credentials");
-        const std::multimap<grpc::string_ref, grpc::string_ref> metadata = context->client_metadata();
-        std::multimap<grpc::string_ref, grpc::string_ref>::const_iterator data_iter = metadata.find("authorization");
-
-        TacacsContext tacCtx;
-
-        if(data_iter != metadata.end()) {
-            string str_withBasic((data_iter->second).data(),(data_iter->second).length());
-            std::string str_withoutBasic = str_withBasic.substr(6);
-            std::string decoded_str = base64_decode(str_withoutBasic);
-            int pos = decoded_str.find(":");
-            tacCtx.username = decoded_str.substr(0,pos);
-            tacCtx.password = decoded_str.substr(pos+1);
-            tacCtx.remote_addr = context->peer();
-            LOG_F(INFO, "Received gRPC credentials username=%s, password=%s from Remote %s", tacCtx.username.c_str(), tacCtx.password.c_str(), tacCtx.remote_addr.c_str());
-        } else {
-            LOG_F(WARNING, "Unable to find or extract credentials from incoming gRPC request");
-            tacCtx.username = "";
-        }
-
-        return tacCtx;
-    }
-
-    Status processTacacsAuth(TacacsContext* tacCtx){
-        LOG_F(MAX, "Calling Authenticate");
-        Status status = taccController->Authenticate(tacCtx);
-        if(status.error_code() == StatusCode::OK) {
-            LOG_F(MAX, "Calling Authorize");
-            status = taccController->Authorize(tacCtx);
+    UpstreamChannelPool* channelPool;
+    IndicationHub* indicationHub;
+    PriorityScheduler* scheduler;
+
+    // Writer stage of the indication relay: the hub thread reads the upstream
+    // stream into the subscriber's ring, this thread drains it to the client.
+    // Indications already queued behind the one being written are buffered
+    // by gRPC and flushed together, up to INDICATION_BATCH_MAX at a time.
+    Status RelayIndications(ServerContext* context, ServerWriter<openolt::Indication>* writer) {
+        std::shared_ptr<IndicationSubscriber> subscriber = indicationHub->Subscribe(context->peer());
+        Status status;
+        IndicationPtr indication;
+        IndicationPtr next;
+        bool broken = false;
+        while (!broken && !context->IsCancelled()) {
+            if (!subscriber->Next(&indication, INDICATION_POLL_MS)) {
+                if (subscriber->Closed()) {
+                    status = subscriber->ClosedStatus();
+                    break;
+                }
+                continue;
+            }
+            int batched = 0;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for (;;) {
+                LOG_F(MAX, "Sending out Indication type %d", indication->data_case());
+                batched++;
+                bool more = batched < INDICATION_BATCH_MAX && subscriber->TryNext(&next);
+                grpc::WriteOptions options;
+                if (more) {
+                    options.set_buffer_hint();
+                }
+                if( !writer->Write(*indication, options) ) {
+                    LOG_F(WARNING, "Grpc Stream broken while sending out Indication");
+                    broken = true;
+                    break;
+                }
+                if (!more) {
+                    break;
+                }
+                indication.swap(next);
+            }
+            indicationHub->RecordFlush(batched, std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - start).count());
         }
+        indicationHub->Unsubscribe(subscriber);
         return status;
     }
 
+    public:
     Status DisableOlt(
             ServerContext* context,
             const openolt::Empty* request,
             openolt::Empty* response) override {
         LOG_F(INFO, "DisableOlt invoked");
+        CallTracker tracker(ProxyMetrics::Instance().Method("DisableOlt"));
 
         if (taccController->IsTacacsEnabled()) {
-            TacacsContext tacCtx = extractDataFromGrpc(context);
+            TacacsContext tacCtx = ExtractTacacsContext(context);
             if (tacCtx.username.empty()) {
                 return Status(grpc::INVALID_ARGUMENT,"Unable to find or extract credentials from incoming gRPC request");
             }
 
-            tacCtx.method_name = "disableolt";
-            taccController->StartAccounting(&tacCtx);
-
-            Status status = processTacacsAuth(&tacCtx);
+            tacCtx.method_name = TacacsCommand("DisableOlt");
+            tacCtx.metrics = tracker.Method();
+            Status status = ScheduleTacacsRequest(scheduler, "DisableOlt", taccController, context, &tacCtx);
             if(status.error_code() == StatusCode::OK) {
-                ClientContext ctx;
+                std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+                PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
                 LOG_F(INFO, "Calling DisableOlt");
-                status = openoltClientStub->DisableOlt(&ctx, *request, response);
+                status = channelPool->Acquire().Stub()->DisableOlt(ctx.get(), *request, response);
             }
             string error_msg = "no error";
             if(status.error_code() != StatusCode::OK) {
@@ -118,9 +145,10 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             taccController->StopAccounting(&tacCtx, error_msg);
             return status;
         } else {
-            ClientContext ctx;
+            std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+            PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
             LOG_F(INFO, "Tacacs disabled.. Calling DisableOlt");
-            return openoltClientStub->DisableOlt(&ctx, *request, response);
+            return channelPool->Acquire().Stub()->DisableOlt(ctx.get(), *request, response);
         }
     }
 
@@ -129,21 +157,22 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             const openolt::Empty* request,
             openolt::Empty* response) override {
         LOG_F(INFO, "ReenableOlt invoked");
+        CallTracker tracker(ProxyMetrics::Instance().Method("ReenableOlt"));
 
         if (taccController->IsTacacsEnabled()) {
-            TacacsContext tacCtx = extractDataFromGrpc(context);
+            TacacsContext tacCtx = ExtractTacacsContext(context);
             if (tacCtx.username.empty()) {
                 return Status(grpc::INVALID_ARGUMENT,"Unable to find or extract credentials from incoming gRPC request");
             }
 
-            tacCtx.method_name = "reenableolt";
-            taccController->StartAccounting(&tacCtx);
-
-            Status status = processTacacsAuth(&tacCtx);
+            tacCtx.method_name = TacacsCommand("ReenableOlt");
+            tacCtx.metrics = tracker.Method();
+            Status status = ScheduleTacacsRequest(scheduler, "ReenableOlt", taccController, context, &tacCtx);
             if(status.error_code() == StatusCode::OK) {
-                ClientContext ctx;
+                std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+                PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
                 LOG_F(INFO, "Calling ReenableOlt");
-                status = openoltClientStub->ReenableOlt(&ctx, *request, response);
+                status = channelPool->Acquire().Stub()->ReenableOlt(ctx.get(), *request, response);
             }
             string error_msg = "no error";
             if(status.error_code() != StatusCode::OK) {
@@ -152,9 +181,10 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             taccController->StopAccounting(&tacCtx, error_msg);
             return status;
         } else {
-            ClientContext ctx;
+            std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+            PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
             LOG_F(INFO, "Tacacs disabled.. Calling ReenableOlt");
-            return openoltClientStub->ReenableOlt(&ctx, *request, response);
+            return channelPool->Acquire().Stub()->ReenableOlt(ctx.get(), *request, response);
         }
     }
 
@@ -163,21 +193,22 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             const openolt::Onu* request,
             openolt::Empty* response) override {
         LOG_F(INFO, "ActivateOnu invoked");
+        CallTracker tracker(ProxyMetrics::Instance().Method("ActivateOnu"));
 
         if (taccController->IsTacacsEnabled()) {
-            TacacsContext tacCtx = extractDataFromGrpc(context);
+            TacacsContext tacCtx = ExtractTacacsContext(context);
             if (tacCtx.username.empty()) {
                 return Status(grpc::INVALID_ARGUMENT,"Unable to find or extract credentials from incoming gRPC request");
             }
 
-            tacCtx.method_name = "activateonu";
-            taccController->StartAccounting(&tacCtx);
-
-            Status status = processTacacsAuth(&tacCtx);
+            tacCtx.method_name = TacacsCommand("ActivateOnu");
+            tacCtx.metrics = tracker.Method();
+            Status status = ScheduleTacacsRequest(scheduler, "ActivateOnu", taccController, context, &tacCtx);
             if(status.error_code() == StatusCode::OK) {
-                ClientContext ctx;
+                std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+                PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
                 LOG_F(INFO, "Calling ActivateOnu");
-                status = openoltClientStub->ActivateOnu(&ctx, *request, response);
+                status = channelPool->Acquire().Stub()->ActivateOnu(ctx.get(), *request, response);
             }
             string error_msg = "no error";
             if(status.error_code() != StatusCode::OK) {
@@ -186,9 +217,10 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             taccController->StopAccounting(&tacCtx, error_msg);
             return status;
         } else {
-            ClientContext ctx;
+            std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+            PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
             LOG_F(INFO, "Tacacs disabled.. Calling ActivateOnu");
-            return openoltClientStub->ActivateOnu(&ctx, *request, response);
+            return channelPool->Acquire().Stub()->ActivateOnu(ctx.get(), *request, response);
         }
     }
 
@@ -197,21 +229,22 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             const openolt::Onu* request,
             openolt::Empty* response) override {
         LOG_F(INFO, "DeactivateOnu invoked");
+        CallTracker tracker(ProxyMetrics::Instance().Method("DeactivateOnu"));
 
         if (taccController->IsTacacsEnabled()) {
-            TacacsContext tacCtx = extractDataFromGrpc(context);
+            TacacsContext tacCtx = ExtractTacacsContext(context);
             if (tacCtx.username.empty()) {
                 return Status(grpc::INVALID_ARGUMENT,"Unable to find or extract credentials from incoming gRPC request");
             }
 
-            tacCtx.method_name = "deactivateonu";
-            taccController->StartAccounting(&tacCtx);
-
-            Status status = processTacacsAuth(&tacCtx);
+            tacCtx.method_name = TacacsCommand("DeactivateOnu");
+            tacCtx.metrics = tracker.Method();
+            Status status = ScheduleTacacsRequest(scheduler, "DeactivateOnu", taccController, context, &tacCtx);
             if(status.error_code() == StatusCode::OK) {
-                ClientContext ctx;
+                std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+                PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
                 LOG_F(INFO, "Calling DeactivateOnu");
-                status = openoltClientStub->DeactivateOnu(&ctx, *request, response);
+                status = channelPool->Acquire().Stub()->DeactivateOnu(ctx.get(), *request, response);
             }
             string error_msg = "no error";
             if(status.error_code() != StatusCode::OK) {
@@ -220,9 +253,10 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             taccController->StopAccounting(&tacCtx, error_msg);
             return status;
         } else {
-            ClientContext ctx;
+            std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+            PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
             LOG_F(INFO, "Tacacs disabled.. Calling DeactivateOnu");
-            return openoltClientStub->DeactivateOnu(&ctx, *request, response);
+            return channelPool->Acquire().Stub()->DeactivateOnu(ctx.get(), *request, response);
         }
     }
 
@@ -231,21 +265,22 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             const openolt::Onu* request,
             openolt::Empty* response) override {
         LOG_F(INFO, "DeleteOnu invoked");
+        CallTracker tracker(ProxyMetrics::Instance().Method("DeleteOnu"));
 
         if (taccController->IsTacacsEnabled()) {
-            TacacsContext tacCtx = extractDataFromGrpc(context);
+            TacacsContext tacCtx = ExtractTacacsContext(context);
             if (tacCtx.username.empty()) {
                 return Status(grpc::INVALID_ARGUMENT,"Unable to find or extract credentials from incoming gRPC request");
             }
 
-            tacCtx.method_name = "deleteonu";
-            taccController->StartAccounting(&tacCtx);
-
-            Status status = processTacacsAuth(&tacCtx);
+            tacCtx.method_name = TacacsCommand("DeleteOnu");
+            tacCtx.metrics = tracker.Method();
+            Status status = ScheduleTacacsRequest(scheduler, "DeleteOnu", taccController, context, &tacCtx);
             if(status.error_code() == StatusCode::OK) {
-                ClientContext ctx;
+                std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+                PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
                 LOG_F(INFO, "Calling DeleteOnu");
-                status = openoltClientStub->DeleteOnu(&ctx, *request, response);
+                status = channelPool->Acquire().Stub()->DeleteOnu(ctx.get(), *request, response);
             }
             string error_msg = "no error";
             if(status.error_code() != StatusCode::OK) {
@@ -254,9 +289,10 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             taccController->StopAccounting(&tacCtx, error_msg);
             return status;
         } else {
-            ClientContext ctx;
+            std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+            PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
             LOG_F(INFO, "Tacacs disabled.. Calling DeleteOnu");
-            return openoltClientStub->DeleteOnu(&ctx, *request, response);
+            return channelPool->Acquire().Stub()->DeleteOnu(ctx.get(), *request, response);
         }
     }
 
@@ -265,21 +301,22 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             const openolt::OmciMsg* request,
             openolt::Empty* response) override {
         LOG_F(INFO, "OmciMsgOut invoked");
+        CallTracker tracker(ProxyMetrics::Instance().Method("OmciMsgOut"));
 
         if (taccController->IsTacacsEnabled()) {
-            TacacsContext tacCtx = extractDataFromGrpc(context);
+            TacacsContext tacCtx = ExtractTacacsContext(context);
             if (tacCtx.username.empty()) {
                 return Status(grpc::INVALID_ARGUMENT,"Unable to find or extract credentials from incoming gRPC request");
             }
 
-            tacCtx.method_name = "omcimsgout";
-            taccController->StartAccounting(&tacCtx);
-
-            Status status = processTacacsAuth(&tacCtx);
+            tacCtx.method_name = TacacsCommand("OmciMsgOut");
+            tacCtx.metrics = tracker.Method();
+            Status status = ScheduleTacacsRequest(scheduler, "OmciMsgOut", taccController, context, &tacCtx);
             if(status.error_code() == StatusCode::OK) {
-                ClientContext ctx;
+                std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+                PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
                 LOG_F(INFO, "Calling OmciMsgOut");
-                status = openoltClientStub->OmciMsgOut(&ctx, *request, response);
+                status = channelPool->Acquire().Stub()->OmciMsgOut(ctx.get(), *request, response);
             }
             string error_msg = "no error";
             if(status.error_code() != StatusCode::OK) {
@@ -288,9 +325,10 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             taccController->StopAccounting(&tacCtx, error_msg);
             return status;
         } else {
-            ClientContext ctx;
+            std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+            PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
             LOG_F(INFO, "Tacacs disabled.. Calling OmciMsgOut");
-            return openoltClientStub->OmciMsgOut(&ctx, *request, response);
+            return channelPool->Acquire().Stub()->OmciMsgOut(ctx.get(), *request, response);
         }
     }
 
@@ -299,21 +337,22 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             const openolt::OnuPacket* request,
             openolt::Empty* response) override {
         LOG_F(INFO, "OnuPacketOut invoked");
+        CallTracker tracker(ProxyMetrics::Instance().Method("OnuPacketOut"));
 
         if (taccController->IsTacacsEnabled()) {
-            TacacsContext tacCtx = extractDataFromGrpc(context);
+            TacacsContext tacCtx = ExtractTacacsContext(context);
             if (tacCtx.username.empty()) {
                 return Status(grpc::INVALID_ARGUMENT,"Unable to find or extract credentials from incoming gRPC request");
             }
 
-            tacCtx.method_name = "onupacketout";
-            taccController->StartAccounting(&tacCtx);
-
-            Status status = processTacacsAuth(&tacCtx);
+            tacCtx.method_name = TacacsCommand("OnuPacketOut");
+            tacCtx.metrics = tracker.Method();
+            Status status = ScheduleTacacsRequest(scheduler, "OnuPacketOut", taccController, context, &tacCtx);
             if(status.error_code() == StatusCode::OK) {
-                ClientContext ctx;
+                std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+                PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
                 LOG_F(INFO, "Calling OnuPacketOut");
-                status = openoltClientStub->OnuPacketOut(&ctx, *request, response);
+                status = channelPool->Acquire().Stub()->OnuPacketOut(ctx.get(), *request, response);
             }
             string error_msg = "no error";
             if(status.error_code() != StatusCode::OK) {
@@ -322,9 +361,10 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             taccController->StopAccounting(&tacCtx, error_msg);
             return status;
         } else {
-            ClientContext ctx;
+            std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+            PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
             LOG_F(INFO, "Tacacs disabled.. Calling OnuPacketOut");
-            return openoltClientStub->OnuPacketOut(&ctx, *request, response);
+            return channelPool->Acquire().Stub()->OnuPacketOut(ctx.get(), *request, response);
         }
     }
 
@@ -333,21 +373,22 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             const openolt::UplinkPacket* request,
             openolt::Empty* response) override {
         LOG_F(INFO, "UplinkPacketOut invoked");
+        CallTracker tracker(ProxyMetrics::Instance().Method("UplinkPacketOut"));
 
         if (taccController->IsTacacsEnabled()) {
-            TacacsContext tacCtx = extractDataFromGrpc(context);
+            TacacsContext tacCtx = ExtractTacacsContext(context);
             if (tacCtx.username.empty()) {
                 return Status(grpc::INVALID_ARGUMENT,"Unable to find or extract credentials from incoming gRPC request");
             }
 
-            tacCtx.method_name = "uplinkpacketout";
-            taccController->StartAccounting(&tacCtx);
-
-            Status status = processTacacsAuth(&tacCtx);
+            tacCtx.method_name = TacacsCommand("UplinkPacketOut");
+            tacCtx.metrics = tracker.Method();
+            Status status = ScheduleTacacsRequest(scheduler, "UplinkPacketOut", taccController, context, &tacCtx);
             if(status.error_code() == StatusCode::OK) {
-                ClientContext ctx;
+                std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+                PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
                 LOG_F(INFO, "Calling UplinkPacketOut");
-                status = openoltClientStub->UplinkPacketOut(&ctx, *request, response);
+                status = channelPool->Acquire().Stub()->UplinkPacketOut(ctx.get(), *request, response);
             }
             string error_msg = "no error";
             if(status.error_code() != StatusCode::OK) {
@@ -356,9 +397,10 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             taccController->StopAccounting(&tacCtx, error_msg);
             return status;
         } else {
-            ClientContext ctx;
+            std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+            PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
             LOG_F(INFO, "Tacacs disabled.. Calling UplinkPacketOut");
-            return openoltClientStub->UplinkPacketOut(&ctx, *request, response);
+            return channelPool->Acquire().Stub()->UplinkPacketOut(ctx.get(), *request, response);
         }
     }
 
@@ -367,21 +409,22 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             const openolt::Flow* request,
             openolt::Empty* response) override {
         LOG_F(INFO, "FlowAdd invoked");
+        CallTracker tracker(ProxyMetrics::Instance().Method("FlowAdd"));
 
         if (taccController->IsTacacsEnabled()) {
-            TacacsContext tacCtx = extractDataFromGrpc(context);
+            TacacsContext tacCtx = ExtractTacacsContext(context);
             if (tacCtx.username.empty()) {
                 return Status(grpc::INVALID_ARGUMENT,"Unable to find or extract credentials from incoming gRPC request");
             }
 
-            tacCtx.method_name = "flowadd";
-            taccController->StartAccounting(&tacCtx);
-
-            Status status = processTacacsAuth(&tacCtx);
+            tacCtx.method_name = TacacsCommand("FlowAdd");
+            tacCtx.metrics = tracker.Method();
+            Status status = ScheduleTacacsRequest(scheduler, "FlowAdd", taccController, context, &tacCtx);
             if(status.error_code() == StatusCode::OK) {
-                ClientContext ctx;
+                std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+                PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
                 LOG_F(INFO, "Calling FlowAdd");
-                status = openoltClientStub->FlowAdd(&ctx, *request, response);
+                status = channelPool->Acquire().Stub()->FlowAdd(ctx.get(), *request, response);
             }
             string error_msg = "no error";
             if(status.error_code() != StatusCode::OK) {
@@ -390,9 +433,10 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             taccController->StopAccounting(&tacCtx, error_msg);
             return status;
         } else {
-            ClientContext ctx;
+            std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+            PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
             LOG_F(INFO, "Tacacs disabled.. Calling FlowAdd");
-            return openoltClientStub->FlowAdd(&ctx, *request, response);
+            return channelPool->Acquire().Stub()->FlowAdd(ctx.get(), *request, response);
         }
     }
 
@@ -401,21 +445,22 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             const openolt::Flow* request,
             openolt::Empty* response) override {
         LOG_F(INFO, "FlowRemove invoked");
+        CallTracker tracker(ProxyMetrics::Instance().Method("FlowRemove"));
 
         if (taccController->IsTacacsEnabled()) {
-            TacacsContext tacCtx = extractDataFromGrpc(context);
+            TacacsContext tacCtx = ExtractTacacsContext(context);
             if (tacCtx.username.empty()) {
                 return Status(grpc::INVALID_ARGUMENT,"Unable to find or extract credentials from incoming gRPC request");
             }
 
-            tacCtx.method_name = "flowremove";
-            taccController->StartAccounting(&tacCtx);
-
-            Status status = processTacacsAuth(&tacCtx);
+            tacCtx.method_name = TacacsCommand("FlowRemove");
+            tacCtx.metrics = tracker.Method();
+            Status status = ScheduleTacacsRequest(scheduler, "FlowRemove", taccController, context, &tacCtx);
             if(status.error_code() == StatusCode::OK) {
-                ClientContext ctx;
+                std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+                PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
                 LOG_F(INFO, "Calling FlowRemove");
-                status = openoltClientStub->FlowRemove(&ctx, *request, response);
+                status = channelPool->Acquire().Stub()->FlowRemove(ctx.get(), *request, response);
             }
             string error_msg = "no error";
             if(status.error_code() != StatusCode::OK) {
@@ -424,9 +469,10 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             taccController->StopAccounting(&tacCtx, error_msg);
             return status;
         } else {
-            ClientContext ctx;
+            std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+            PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
             LOG_F(INFO, "Tacacs disabled.. Calling FlowRemove");
-            return openoltClientStub->FlowRemove(&ctx, *request, response);
+            return channelPool->Acquire().Stub()->FlowRemove(ctx.get(), *request, response);
         }
     }
 
@@ -435,30 +481,21 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             const ::openolt::Empty* request,
             ServerWriter<openolt::Indication>* writer) override {
         LOG_F(INFO, "EnableIndication invoked");
+        CallTracker tracker(ProxyMetrics::Instance().Method("EnableIndication"));
 
         if (taccController->IsTacacsEnabled()) {
-            TacacsContext tacCtx = extractDataFromGrpc(context);
+            TacacsContext tacCtx = ExtractTacacsContext(context);
             if (tacCtx.username.empty()) {
                 return Status(grpc::INVALID_ARGUMENT,"Unable to find or extract credentials from incoming gRPC request");
             }
 
-            tacCtx.method_name = "enableindication";
-            taccController->StartAccounting(&tacCtx);
-
-            Status status = processTacacsAuth(&tacCtx);
+            tacCtx.method_name = TacacsCommand("EnableIndication");
+            tacCtx.metrics = tracker.Method();
+            Status status = ScheduleTacacsRequest(scheduler, "EnableIndication", taccController, context, &tacCtx);
             if(status.error_code() == StatusCode::OK) {
-                ClientContext ctx;
+                PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
                 LOG_F(INFO, "Calling EnableIndication");
-                std::unique_ptr<ClientReader<openolt::Indication> > reader = openoltClientStub->EnableIndication(&ctx, *request);
-                openolt::Indication indication;
-                while( reader->Read(&indication) ) {
-                    LOG_F(INFO, "Sending out Indication type %d", indication.data_case());
-                    if( !writer->Write(indication) ) {
-                        LOG_F(WARNING, "Grpc Stream broken while sending out Indication");
-                        break;
-                    }
-                }
-                status = reader->Finish();
+                status = RelayIndications(context, writer);
             }
             string error_msg = "no error";
             if(status.error_code() != StatusCode::OK) {
@@ -467,18 +504,9 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             taccController->StopAccounting(&tacCtx, error_msg);
             return status;
         } else {
-            ClientContext ctx;
+            PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
             LOG_F(INFO, "Tacacs disabled.. Calling EnableIndication");
-            std::unique_ptr<ClientReader<openolt::Indication> > reader = openoltClientStub->EnableIndication(&ctx, *request);
-            openolt::Indication indication;
-            while( reader->Read(&indication) ) {
-                LOG_F(INFO, "Sending out Indication type %d", indication.data_case());
-                if( !writer->Write(indication) ) {
-                    LOG_F(WARNING, "Grpc Stream broken while sending out Indication");
-                    break;
-                }
-            }
-            return reader->Finish();
+            return RelayIndications(context, writer);
         }
     }
 
@@ -487,21 +515,22 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             const openolt::Empty* request,
             openolt::Heartbeat* response) override {
         LOG_F(INFO, "HeartbeatCheck invoked");
+        CallTracker tracker(ProxyMetrics::Instance().Method("HeartbeatCheck"));
 
         if (taccController->IsTacacsEnabled()) {
-            TacacsContext tacCtx = extractDataFromGrpc(context);
+            TacacsContext tacCtx = ExtractTacacsContext(context);
             if (tacCtx.username.empty()) {
                 return Status(grpc::INVALID_ARGUMENT,"Unable to find or extract credentials from incoming gRPC request");
             }
 
-            tacCtx.method_name = "heartbeatcheck";
-            taccController->StartAccounting(&tacCtx);
-
-            Status status = processTacacsAuth(&tacCtx);
+            tacCtx.method_name = TacacsCommand("HeartbeatCheck");
+            tacCtx.metrics = tracker.Method();
+            Status status = ScheduleTacacsRequest(scheduler, "HeartbeatCheck", taccController, context, &tacCtx);
             if(status.error_code() == StatusCode::OK) {
-                ClientContext ctx;
+                std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+                PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
                 LOG_F(INFO, "Calling HeartbeatCheck");
-                status = openoltClientStub->HeartbeatCheck(&ctx, *request, response);
+                status = channelPool->Acquire().Stub()->HeartbeatCheck(ctx.get(), *request, response);
             }
             string error_msg = "no error";
             if(status.error_code() != StatusCode::OK) {
@@ -510,9 +539,10 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             taccController->StopAccounting(&tacCtx, error_msg);
             return status;
         } else {
-            ClientContext ctx;
+            std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+            PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
             LOG_F(INFO, "Tacacs disabled.. Calling HeartbeatCheck");
-            return openoltClientStub->HeartbeatCheck(&ctx, *request, response);
+            return channelPool->Acquire().Stub()->HeartbeatCheck(ctx.get(), *request, response);
         }
     }
 
@@ -521,21 +551,22 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             const openolt::Interface* request,
             openolt::Empty* response) override {
         LOG_F(INFO, "EnablePonIf invoked");
+        CallTracker tracker(ProxyMetrics::Instance().Method("EnablePonIf"));
 
         if (taccController->IsTacacsEnabled()) {
-            TacacsContext tacCtx = extractDataFromGrpc(context);
+            TacacsContext tacCtx = ExtractTacacsContext(context);
             if (tacCtx.username.empty()) {
                 return Status(grpc::INVALID_ARGUMENT,"Unable to find or extract credentials from incoming gRPC request");
             }
 
-            tacCtx.method_name = "enableponif";
-            taccController->StartAccounting(&tacCtx);
-
-            Status status = processTacacsAuth(&tacCtx);
+            tacCtx.method_name = TacacsCommand("EnablePonIf");
+            tacCtx.metrics = tracker.Method();
+            Status status = ScheduleTacacsRequest(scheduler, "EnablePonIf", taccController, context, &tacCtx);
             if(status.error_code() == StatusCode::OK) {
-                ClientContext ctx;
+                std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+                PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
                 LOG_F(INFO, "Calling EnablePonIf");
-                status = openoltClientStub->EnablePonIf(&ctx, *request, response);
+                status = channelPool->Acquire().Stub()->EnablePonIf(ctx.get(), *request, response);
             }
             string error_msg = "no error";
             if(status.error_code() != StatusCode::OK) {
@@ -544,9 +575,10 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             taccController->StopAccounting(&tacCtx, error_msg);
             return status;
         } else {
-            ClientContext ctx;
+            std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+            PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
             LOG_F(INFO, "Tacacs disabled.. Calling EnablePonIf");
-            return openoltClientStub->EnablePonIf(&ctx, *request, response);
+            return channelPool->Acquire().Stub()->EnablePonIf(ctx.get(), *request, response);
         }
     }
 
@@ -555,21 +587,22 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             const openolt::Interface* request,
             openolt::Empty* response) override {
         LOG_F(INFO, "DisablePonIf invoked");
+        CallTracker tracker(ProxyMetrics::Instance().Method("DisablePonIf"));
 
         if (taccController->IsTacacsEnabled()) {
-            TacacsContext tacCtx = extractDataFromGrpc(context);
+            TacacsContext tacCtx = ExtractTacacsContext(context);
             if (tacCtx.username.empty()) {
                 return Status(grpc::INVALID_ARGUMENT,"Unable to find or extract credentials from incoming gRPC request");
             }
 
-            tacCtx.method_name = "disableponif";
-            taccController->StartAccounting(&tacCtx);
-
-            Status status = processTacacsAuth(&tacCtx);
+            tacCtx.method_name = TacacsCommand("DisablePonIf");
+            tacCtx.metrics = tracker.Method();
+            Status status = ScheduleTacacsRequest(scheduler, "DisablePonIf", taccController, context, &tacCtx);
             if(status.error_code() == StatusCode::OK) {
-                ClientContext ctx;
+                std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+                PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
                 LOG_F(INFO, "Calling DisablePonIf");
-                status = openoltClientStub->DisablePonIf(&ctx, *request, response);
+                status = channelPool->Acquire().Stub()->DisablePonIf(ctx.get(), *request, response);
             }
             string error_msg = "no error";
             if(status.error_code() != StatusCode::OK) {
@@ -578,9 +611,10 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             taccController->StopAccounting(&tacCtx, error_msg);
             return status;
         } else {
-            ClientContext ctx;
+            std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+            PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
             LOG_F(INFO, "Tacacs disabled.. Calling DisablePonIf");
-            return openoltClientStub->DisablePonIf(&ctx, *request, response);
+            return channelPool->Acquire().Stub()->DisablePonIf(ctx.get(), *request, response);
         }
     }
 
@@ -589,21 +623,22 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             const openolt::Empty* request,
             openolt::Empty* response) override {
         LOG_F(INFO, "CollectStatistics invoked");
+        CallTracker tracker(ProxyMetrics::Instance().Method("CollectStatistics"));
 
         if (taccController->IsTacacsEnabled()) {
-            TacacsContext tacCtx = extractDataFromGrpc(context);
+            TacacsContext tacCtx = ExtractTacacsContext(context);
             if (tacCtx.username.empty()) {
                 return Status(grpc::INVALID_ARGUMENT,"Unable to find or extract credentials from incoming gRPC request");
             }
 
-            tacCtx.method_name = "collectstatistics";
-            taccController->StartAccounting(&tacCtx);
-
-            Status status = processTacacsAuth(&tacCtx);
+            tacCtx.method_name = TacacsCommand("CollectStatistics");
+            tacCtx.metrics = tracker.Method();
+            Status status = ScheduleTacacsRequest(scheduler, "CollectStatistics", taccController, context, &tacCtx);
             if(status.error_code() == StatusCode::OK) {
-                ClientContext ctx;
+                std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+                PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
                 LOG_F(INFO, "Calling CollectStatistics");
-                status = openoltClientStub->CollectStatistics(&ctx, *request, response);
+                status = channelPool->Acquire().Stub()->CollectStatistics(ctx.get(), *request, response);
             }
             string error_msg = "no error";
             if(status.error_code() != StatusCode::OK) {
@@ -612,9 +647,10 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             taccController->StopAccounting(&tacCtx, error_msg);
             return status;
         } else {
-            ClientContext ctx;
+            std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+            PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
             LOG_F(INFO, "Tacacs disabled.. Calling CollectStatistics");
-            return openoltClientStub->CollectStatistics(&ctx, *request, response);
+            return channelPool->Acquire().Stub()->CollectStatistics(ctx.get(), *request, response);
         }
     }
 
@@ -623,21 +659,22 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             const openolt::Empty* request,
             openolt::Empty* response) override {
         LOG_F(INFO, "Reboot invoked");
+        CallTracker tracker(ProxyMetrics::Instance().Method("Reboot"));
 
         if (taccController->IsTacacsEnabled()) {
-            TacacsContext tacCtx = extractDataFromGrpc(context);
+            TacacsContext tacCtx = ExtractTacacsContext(context);
             if (tacCtx.username.empty()) {
                 return Status(grpc::INVALID_ARGUMENT,"Unable to find or extract credentials from incoming gRPC request");
             }
 
-            tacCtx.method_name = "reboot";
-            taccController->StartAccounting(&tacCtx);
-
-            Status status = processTacacsAuth(&tacCtx);
+            tacCtx.method_name = TacacsCommand("Reboot");
+            tacCtx.metrics = tracker.Method();
+            Status status = ScheduleTacacsRequest(scheduler, "Reboot", taccController, context, &tacCtx);
             if(status.error_code() == StatusCode::OK) {
-                ClientContext ctx;
+                std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+                PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
                 LOG_F(INFO, "Calling Reboot");
-                status = openoltClientStub->Reboot(&ctx, *request, response);
+                status = channelPool->Acquire().Stub()->Reboot(ctx.get(), *request, response);
             }
             string error_msg = "no error";
             if(status.error_code() != StatusCode::OK) {
@@ -646,9 +683,10 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             taccController->StopAccounting(&tacCtx, error_msg);
             return status;
         } else {
-            ClientContext ctx;
+            std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+            PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
             LOG_F(INFO, "Tacacs disabled.. Calling Reboot");
-            return openoltClientStub->Reboot(&ctx, *request, response);
+            return channelPool->Acquire().Stub()->Reboot(ctx.get(), *request, response);
         }
     }
 
@@ -657,21 +695,22 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             const openolt::Empty* request,
             openolt::DeviceInfo* response) override {
         LOG_F(MAX, "GetDeviceInfo invoked");
+        CallTracker tracker(ProxyMetrics::Instance().Method("GetDeviceInfo"));
 
         if (taccController->IsTacacsEnabled()) {
-            TacacsContext tacCtx = extractDataFromGrpc(context);
+            TacacsContext tacCtx = ExtractTacacsContext(context);
             if (tacCtx.username.empty()) {
                 return Status(grpc::INVALID_ARGUMENT,"Unable to find or extract credentials from incoming gRPC request");
             }
 
-            tacCtx.method_name = "getdeviceinfo";
-            taccController->StartAccounting(&tacCtx);
-
-            Status status = processTacacsAuth(&tacCtx);
+            tacCtx.method_name = TacacsCommand("GetDeviceInfo");
+            tacCtx.metrics = tracker.Method();
+            Status status = ScheduleTacacsRequest(scheduler, "GetDeviceInfo", taccController, context, &tacCtx);
             if(status.error_code() == StatusCode::OK) {
-                ClientContext ctx;
+                std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+                PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
                 LOG_F(INFO, "Calling GetDeviceInfo");
-                status = openoltClientStub->GetDeviceInfo(&ctx, *request, response);
+                status = channelPool->Acquire().Stub()->GetDeviceInfo(ctx.get(), *request, response);
             }
             string error_msg = "no error";
             if(status.error_code() != StatusCode::OK) {
@@ -680,9 +719,10 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             taccController->StopAccounting(&tacCtx, error_msg);
             return status;
         } else {
-            ClientContext ctx;
+            std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+            PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
             LOG_F(INFO, "Tacacs disabled.. Calling GetDeviceInfo");
-            return openoltClientStub->GetDeviceInfo(&ctx, *request, response);
+            return channelPool->Acquire().Stub()->GetDeviceInfo(ctx.get(), *request, response);
         }
     }
 
@@ -691,21 +731,22 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             const tech_profile::TrafficSchedulers* request,
             openolt::Empty* response) override {
         LOG_F(INFO, "CreateTrafficSchedulers invoked");
+        CallTracker tracker(ProxyMetrics::Instance().Method("CreateTrafficSchedulers"));
 
         if (taccController->IsTacacsEnabled()) {
-            TacacsContext tacCtx = extractDataFromGrpc(context);
+            TacacsContext tacCtx = ExtractTacacsContext(context);
             if (tacCtx.username.empty()) {
                 return Status(grpc::INVALID_ARGUMENT,"Unable to find or extract credentials from incoming gRPC request");
             }
 
-            tacCtx.method_name = "createtrafficschedulers";
-            taccController->StartAccounting(&tacCtx);
-
-            Status status = processTacacsAuth(&tacCtx);
+            tacCtx.method_name = TacacsCommand("CreateTrafficSchedulers");
+            tacCtx.metrics = tracker.Method();
+            Status status = ScheduleTacacsRequest(scheduler, "CreateTrafficSchedulers", taccController, context, &tacCtx);
             if(status.error_code() == StatusCode::OK) {
-                ClientContext ctx;
+                std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+                PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
                 LOG_F(INFO, "Calling CreateTrafficSchedulers");
-                status = openoltClientStub->CreateTrafficSchedulers(&ctx, *request, response);
+                status = channelPool->Acquire().Stub()->CreateTrafficSchedulers(ctx.get(), *request, response);
             }
             string error_msg = "no error";
             if(status.error_code() != StatusCode::OK) {
@@ -714,9 +755,10 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             taccController->StopAccounting(&tacCtx, error_msg);
             return status;
         } else {
-            ClientContext ctx;
+            std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+            PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
             LOG_F(INFO, "Tacacs disabled.. Calling CreateTrafficSchedulers");
-            return openoltClientStub->CreateTrafficSchedulers(&ctx, *request, response);
+            return channelPool->Acquire().Stub()->CreateTrafficSchedulers(ctx.get(), *request, response);
         }
     }
 
@@ -725,21 +767,22 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             const tech_profile::TrafficSchedulers* request,
             openolt::Empty* response) override {
         LOG_F(INFO, "RemoveTrafficSchedulers invoked");
+        CallTracker tracker(ProxyMetrics::Instance().Method("RemoveTrafficSchedulers"));
 
         if (taccController->IsTacacsEnabled()) {
-            TacacsContext tacCtx = extractDataFromGrpc(context);
+            TacacsContext tacCtx = ExtractTacacsContext(context);
             if (tacCtx.username.empty()) {
                 return Status(grpc::INVALID_ARGUMENT,"Unable to find or extract credentials from incoming gRPC request");
             }
 
-            tacCtx.method_name = "removetrafficschedulers";
-            taccController->StartAccounting(&tacCtx);
-
-            Status status = processTacacsAuth(&tacCtx);
+            tacCtx.method_name = TacacsCommand("RemoveTrafficSchedulers");
+            tacCtx.metrics = tracker.Method();
+            Status status = ScheduleTacacsRequest(scheduler, "RemoveTrafficSchedulers", taccController, context, &tacCtx);
             if(status.error_code() == StatusCode::OK) {
-                ClientContext ctx;
+                std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+                PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
                 LOG_F(INFO, "Calling RemoveTrafficSchedulers");
-                status = openoltClientStub->RemoveTrafficSchedulers(&ctx, *request, response);
+                status = channelPool->Acquire().Stub()->RemoveTrafficSchedulers(ctx.get(), *request, response);
             }
             string error_msg = "no error";
             if(status.error_code() != StatusCode::OK) {
@@ -748,9 +791,10 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             taccController->StopAccounting(&tacCtx, error_msg);
             return status;
         } else {
-            ClientContext ctx;
+            std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+            PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
             LOG_F(INFO, "Tacacs disabled.. Calling RemoveTrafficSchedulers");
-            return openoltClientStub->RemoveTrafficSchedulers(&ctx, *request, response);
+            return channelPool->Acquire().Stub()->RemoveTrafficSchedulers(ctx.get(), *request, response);
         }
     }
 
@@ -759,21 +803,22 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             const tech_profile::TrafficQueues* request,
             openolt::Empty* response) override {
         LOG_F(INFO, "CreateTrafficQueues invoked");
+        CallTracker tracker(ProxyMetrics::Instance().Method("CreateTrafficQueues"));
 
         if (taccController->IsTacacsEnabled()) {
-            TacacsContext tacCtx = extractDataFromGrpc(context);
+            TacacsContext tacCtx = ExtractTacacsContext(context);
             if (tacCtx.username.empty()) {
                 return Status(grpc::INVALID_ARGUMENT,"Unable to find or extract credentials from incoming gRPC request");
             }
 
-            tacCtx.method_name = "createtrafficqueues";
-            taccController->StartAccounting(&tacCtx);
-
-            Status status = processTacacsAuth(&tacCtx);
+            tacCtx.method_name = TacacsCommand("CreateTrafficQueues");
+            tacCtx.metrics = tracker.Method();
+            Status status = ScheduleTacacsRequest(scheduler, "CreateTrafficQueues", taccController, context, &tacCtx);
             if(status.error_code() == StatusCode::OK) {
-                ClientContext ctx;
+                std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+                PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
                 LOG_F(INFO, "Calling CreateTrafficQueues");
-                status = openoltClientStub->CreateTrafficQueues(&ctx, *request, response);
+                status = channelPool->Acquire().Stub()->CreateTrafficQueues(ctx.get(), *request, response);
             }
             string error_msg = "no error";
             if(status.error_code() != StatusCode::OK) {
@@ -782,9 +827,10 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             taccController->StopAccounting(&tacCtx, error_msg);
             return status;
         } else {
-            ClientContext ctx;
+            std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+            PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
             LOG_F(INFO, "Tacacs disabled.. Calling CreateTrafficQueues");
-            return openoltClientStub->CreateTrafficQueues(&ctx, *request, response);
+            return channelPool->Acquire().Stub()->CreateTrafficQueues(ctx.get(), *request, response);
         }
     }
 
@@ -793,21 +839,22 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             const tech_profile::TrafficQueues* request,
             openolt::Empty* response) override {
         LOG_F(INFO, "RemoveTrafficQueues invoked");
+        CallTracker tracker(ProxyMetrics::Instance().Method("RemoveTrafficQueues"));
 
         if (taccController->IsTacacsEnabled()) {
-            TacacsContext tacCtx = extractDataFromGrpc(context);
+            TacacsContext tacCtx = ExtractTacacsContext(context);
             if (tacCtx.username.empty()) {
                 return Status(grpc::INVALID_ARGUMENT,"Unable to find or extract credentials from incoming gRPC request");
             }
 
-            tacCtx.method_name = "removetrafficqueues";
-            taccController->StartAccounting(&tacCtx);
-
-            Status status = processTacacsAuth(&tacCtx);
+            tacCtx.method_name = TacacsCommand("RemoveTrafficQueues");
+            tacCtx.metrics = tracker.Method();
+            Status status = ScheduleTacacsRequest(scheduler, "RemoveTrafficQueues", taccController, context, &tacCtx);
             if(status.error_code() == StatusCode::OK) {
-                ClientContext ctx;
+                std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+                PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
                 LOG_F(INFO, "Calling RemoveTrafficQueues");
-                status = openoltClientStub->RemoveTrafficQueues(&ctx, *request, response);
+                status = channelPool->Acquire().Stub()->RemoveTrafficQueues(ctx.get(), *request, response);
             }
             string error_msg = "no error";
             if(status.error_code() != StatusCode::OK) {
@@ -816,9 +863,10 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             taccController->StopAccounting(&tacCtx, error_msg);
             return status;
         } else {
-            ClientContext ctx;
+            std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+            PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
             LOG_F(INFO, "Tacacs disabled.. Calling RemoveTrafficQueues");
-            return openoltClientStub->RemoveTrafficQueues(&ctx, *request, response);
+            return channelPool->Acquire().Stub()->RemoveTrafficQueues(ctx.get(), *request, response);
         }
     }
 
@@ -827,21 +875,22 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             const openolt::Group* request,
             openolt::Empty* response) override {
         LOG_F(INFO, "PerformGroupOperation invoked");
+        CallTracker tracker(ProxyMetrics::Instance().Method("PerformGroupOperation"));
 
         if (taccController->IsTacacsEnabled()) {
-            TacacsContext tacCtx = extractDataFromGrpc(context);
+            TacacsContext tacCtx = ExtractTacacsContext(context);
             if (tacCtx.username.empty()) {
                 return Status(grpc::INVALID_ARGUMENT,"Unable to find or extract credentials from incoming gRPC request");
             }
 
-            tacCtx.method_name = "performgroupoperation";
-            taccController->StartAccounting(&tacCtx);
-
-            Status status = processTacacsAuth(&tacCtx);
+            tacCtx.method_name = TacacsCommand("PerformGroupOperation");
+            tacCtx.metrics = tracker.Method();
+            Status status = ScheduleTacacsRequest(scheduler, "PerformGroupOperation", taccController, context, &tacCtx);
             if(status.error_code() == StatusCode::OK) {
-                ClientContext ctx;
+                std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+                PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
                 LOG_F(INFO, "Calling PerformGroupOperation");
-                status = openoltClientStub->PerformGroupOperation(&ctx, *request, response);
+                status = channelPool->Acquire().Stub()->PerformGroupOperation(ctx.get(), *request, response);
             }
             string error_msg = "no error";
             if(status.error_code() != StatusCode::OK) {
@@ -850,9 +899,10 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             taccController->StopAccounting(&tacCtx, error_msg);
             return status;
         } else {
-            ClientContext ctx;
+            std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+            PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
             LOG_F(INFO, "Tacacs disabled.. Calling PerformGroupOperation");
-            return openoltClientStub->PerformGroupOperation(&ctx, *request, response);
+            return channelPool->Acquire().Stub()->PerformGroupOperation(ctx.get(), *request, response);
         }
     }
 
@@ -861,21 +911,22 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             const openolt::Group* request,
             openolt::Empty* response) override {
         LOG_F(INFO, "DeleteGroup invoked");
+        CallTracker tracker(ProxyMetrics::Instance().Method("DeleteGroup"));
 
         if (taccController->IsTacacsEnabled()) {
-            TacacsContext tacCtx = extractDataFromGrpc(context);
+            TacacsContext tacCtx = ExtractTacacsContext(context);
             if (tacCtx.username.empty()) {
                 return Status(grpc::INVALID_ARGUMENT,"Unable to find or extract credentials from incoming gRPC request");
             }
 
-            tacCtx.method_name = "deletegroup";
-            taccController->StartAccounting(&tacCtx);
-
-            Status status = processTacacsAuth(&tacCtx);
+            tacCtx.method_name = TacacsCommand("DeleteGroup");
+            tacCtx.metrics = tracker.Method();
+            Status status = ScheduleTacacsRequest(scheduler, "DeleteGroup", taccController, context, &tacCtx);
             if(status.error_code() == StatusCode::OK) {
-                ClientContext ctx;
+                std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+                PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
                 LOG_F(INFO, "Calling DeleteGroup");
-                status = openoltClientStub->DeleteGroup(&ctx, *request, response);
+                status = channelPool->Acquire().Stub()->DeleteGroup(ctx.get(), *request, response);
             }
             string error_msg = "no error";
             if(status.error_code() != StatusCode::OK) {
@@ -884,9 +935,10 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             taccController->StopAccounting(&tacCtx, error_msg);
             return status;
         } else {
-            ClientContext ctx;
+            std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+            PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
             LOG_F(INFO, "Tacacs disabled.. Calling DeleteGroup");
-            return openoltClientStub->DeleteGroup(&ctx, *request, response);
+            return channelPool->Acquire().Stub()->DeleteGroup(ctx.get(), *request, response);
         }
     }
 
@@ -895,21 +947,22 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
 	    const config::OnuItuPonAlarm* request,
             openolt::Empty* response) override {
         LOG_F(INFO, "OnuItuPonAlarmSet invoked");
+        CallTracker tracker(ProxyMetrics::Instance().Method("OnuItuPonAlarmSet"));
 
         if (taccController->IsTacacsEnabled()) {
-            TacacsContext tacCtx = extractDataFromGrpc(context);
+            TacacsContext tacCtx = ExtractTacacsContext(context);
             if (tacCtx.username.empty()) {
                 return Status(grpc::INVALID_ARGUMENT,"Unable to find or extract credentials from incoming gRPC request");
             }
 
-            tacCtx.method_name = "onuituponalarmset";
-            taccController->StartAccounting(&tacCtx);
-
-            Status status = processTacacsAuth(&tacCtx);
+            tacCtx.method_name = TacacsCommand("OnuItuPonAlarmSet");
+            tacCtx.metrics = tracker.Method();
+            Status status = ScheduleTacacsRequest(scheduler, "OnuItuPonAlarmSet", taccController, context, &tacCtx);
             if(status.error_code() == StatusCode::OK) {
-                ClientContext ctx;
+                std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+                PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
                 LOG_F(INFO, "Calling OnuItuPonAlarmSet");
-                status = openoltClientStub->OnuItuPonAlarmSet(&ctx, *request, response);
+                status = channelPool->Acquire().Stub()->OnuItuPonAlarmSet(ctx.get(), *request, response);
             }
             string error_msg = "no error";
             if(status.error_code() != StatusCode::OK) {
@@ -918,9 +971,10 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             taccController->StopAccounting(&tacCtx, error_msg);
             return status;
         } else {
-            ClientContext ctx;
+            std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+            PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
             LOG_F(INFO, "Tacacs disabled.. Calling OnuItuPonAlarmSet");
-            return openoltClientStub->OnuItuPonAlarmSet(&ctx, *request, response);
+            return channelPool->Acquire().Stub()->OnuItuPonAlarmSet(ctx.get(), *request, response);
         }
     }
 
@@ -929,21 +983,22 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             const openolt::Onu* request,
             openolt::OnuLogicalDistance* response) override {
         LOG_F(INFO, "GetLogicalOnuDistanceZero invoked");
+        CallTracker tracker(ProxyMetrics::Instance().Method("GetLogicalOnuDistanceZero"));
 
         if (taccController->IsTacacsEnabled()) {
-            TacacsContext tacCtx = extractDataFromGrpc(context);
+            TacacsContext tacCtx = ExtractTacacsContext(context);
             if (tacCtx.username.empty()) {
                 return Status(grpc::INVALID_ARGUMENT,"Unable to find or extract credentials from incoming gRPC request");
             }
 
-            tacCtx.method_name = "getlogicalonudistancezero";
-            taccController->StartAccounting(&tacCtx);
-
-            Status status = processTacacsAuth(&tacCtx);
+            tacCtx.method_name = TacacsCommand("GetLogicalOnuDistanceZero");
+            tacCtx.metrics = tracker.Method();
+            Status status = ScheduleTacacsRequest(scheduler, "GetLogicalOnuDistanceZero", taccController, context, &tacCtx);
             if(status.error_code() == StatusCode::OK) {
-                ClientContext ctx;
+                std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+                PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
                 LOG_F(INFO, "Calling GetLogicalOnuDistanceZero");
-                status = openoltClientStub->GetLogicalOnuDistanceZero(&ctx, *request, response);
+                status = channelPool->Acquire().Stub()->GetLogicalOnuDistanceZero(ctx.get(), *request, response);
             }
             string error_msg = "no error";
             if(status.error_code() != StatusCode::OK) {
@@ -952,9 +1007,10 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             taccController->StopAccounting(&tacCtx, error_msg);
             return status;
         } else {
-            ClientContext ctx;
+            std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+            PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
             LOG_F(INFO, "Tacacs disabled.. Calling GetLogicalOnuDistanceZero");
-            return openoltClientStub->GetLogicalOnuDistanceZero(&ctx, *request, response);
+            return channelPool->Acquire().Stub()->GetLogicalOnuDistanceZero(ctx.get(), *request, response);
         }
     }
 
@@ -963,21 +1019,22 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             const openolt::Onu* request,
             openolt::OnuLogicalDistance* response) override {
         LOG_F(INFO, "GetLogicalOnuDistance invoked");
+        CallTracker tracker(ProxyMetrics::Instance().Method("GetLogicalOnuDistance"));
 
         if (taccController->IsTacacsEnabled()) {
-            TacacsContext tacCtx = extractDataFromGrpc(context);
+            TacacsContext tacCtx = ExtractTacacsContext(context);
             if (tacCtx.username.empty()) {
                 return Status(grpc::INVALID_ARGUMENT,"Unable to find or extract credentials from incoming gRPC request");
             }
 
-            tacCtx.method_name = "getlogicalonudistance";
-            taccController->StartAccounting(&tacCtx);
-
-            Status status = processTacacsAuth(&tacCtx);
+            tacCtx.method_name = TacacsCommand("GetLogicalOnuDistance");
+            tacCtx.metrics = tracker.Method();
+            Status status = ScheduleTacacsRequest(scheduler, "GetLogicalOnuDistance", taccController, context, &tacCtx);
             if(status.error_code() == StatusCode::OK) {
-                ClientContext ctx;
+                std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+                PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
                 LOG_F(INFO, "Calling GetLogicalOnuDistance");
-                status = openoltClientStub->GetLogicalOnuDistance(&ctx, *request, response);
+                status = channelPool->Acquire().Stub()->GetLogicalOnuDistance(ctx.get(), *request, response);
             }
             string error_msg = "no error";
             if(status.error_code() != StatusCode::OK) {
@@ -986,60 +1043,69 @@ class ProxyServiceImpl final : public openolt::Openolt::Service  {
             taccController->StopAccounting(&tacCtx, error_msg);
             return status;
         } else {
-            ClientContext ctx;
+            std::unique_ptr<ClientContext> ctx = UpstreamContext(context);
+            PhaseTimer upstreamTimer(tracker.Method(), METRICS_PHASE_UPSTREAM);
             LOG_F(INFO, "Tacacs disabled.. Calling GetLogicalOnuDistance");
-            return openoltClientStub->GetLogicalOnuDistance(&ctx, *request, response);
+            return channelPool->Acquire().Stub()->GetLogicalOnuDistance(ctx.get(), *request, response);
         }
     }
 
-    ProxyServiceImpl(TaccController* tacctrl, const char* addr) {
+    ProxyServiceImpl(TaccController* tacctrl, UpstreamChannelPool* pool, IndicationHub* hub,
+            PriorityScheduler* priority_scheduler) {
         taccController = tacctrl;
-
-        LOG_F(INFO, "Creating GRPC Channel to Openolt Agent on %s", addr);
-        openoltClientStub = openolt::Openolt::NewStub(grpc::CreateChannel(addr, grpc::InsecureChannelCredentials()));
+        channelPool = pool;
+        indicationHub = hub;
+        scheduler = priority_scheduler;
     }
 
 };
 
-std::string base64_decode(std::string const& encoded_string) {
-    int in_len = encoded_string.size();
-    int i = 0;
-    int j = 0;
-    int in_ = 0;
-    unsigned char char_array_4[4], char_array_3[3];
-    std::string ret;
-
-    while (in_len-- && ( encoded_string[in_] != '=') && is_base64(encoded_string[in_])) {
-        char_array_4[i++] = encoded_string[in_]; in_++;
-        if (i ==4) {
-            for (i = 0; i <4; i++)
-                char_array_4[i] = base64_chars.find(char_array_4[i]);
-
-            char_array_3[0] = (char_array_4[0] << 2) + ((char_array_4[1] & 0x30) >> 4);
-            char_array_3[1] = ((char_array_4[1] & 0xf) << 4) + ((char_array_4[2] & 0x3c) >> 2);
-            char_array_3[2] = ((char_array_4[2] & 0x3) << 6) + char_array_4[3];
-
-            for (i = 0; (i < 3); i++)
-                ret += char_array_3[i];
-            i = 0;
-        }
+// Runs on ShutdownThread. Returns without shutting down when RunServer
+// wakes it after the server stopped on its own.
+static void ShutdownOnSignal() {
+    uint64_t count;
+    while (read(ShutdownFd, &count, sizeof(count)) < 0 && errno == EINTR) {
     }
+    if (ShutdownSignal == 0) {
+        return;
+    }
+    LOG_F(INFO, "Received Signal %d", (int)ShutdownSignal);
 
-    if (i) {
-        for (j = i; j <4; j++)
-            char_array_4[j] = 0;
-
-        for (j = 0; j <4; j++)
-            char_array_4[j] = base64_chars.find(char_array_4[j]);
+    // Ends the indication streams, which would otherwise hold up the shutdown
+    if( IndicationHubInstance != NULL ) {
+        IndicationHubInstance->Stop();
+    }
 
-        char_array_3[0] = (char_array_4[0] << 2) + ((char_array_4[1] & 0x30) >> 4);
-        char_array_3[1] = ((char_array_4[1] & 0xf) << 4) + ((char_array_4[2] & 0x3c) >> 2);
-        char_array_3[2] = ((char_array_4[2] & 0x3) << 6) + char_array_4[3];
+    if( AsyncServerInstance != NULL ) {
+        LOG_F(INFO, "Shutting down TACACS Proxy");
+        AsyncServerInstance->Shutdown();
+    } else if( ServerInstance != NULL ) {
+        LOG_F(INFO, "Shutting down TACACS Proxy");
+        ServerInstance->Shutdown();
+    }
+}
 
-        for (j = 0; (j < i - 1); j++) ret += char_array_3[j];
+static void StartShutdownThread() {
+    ShutdownFd = eventfd(0, EFD_CLOEXEC);
+    if (ShutdownFd < 0) {
+        LOG_F(ERROR, "Unable to create the shutdown eventfd, signals will not stop the server");
+        return;
     }
+    ShutdownThread = std::thread(ShutdownOnSignal);
+}
 
-    return ret;
+// Waits for a shutdown still in progress, before the servers it uses go away
+static void JoinShutdownThread() {
+    if (ShutdownFd < 0) {
+        return;
+    }
+    uint64_t one = 1;
+    if (write(ShutdownFd, &one, sizeof(one)) < 0) {
+        LOG_F(ERROR, "Unable to wake the shutdown thread");
+    }
+    ShutdownThread.join();
+    close(ShutdownFd);
+    ShutdownFd = -1;
 }
 
 void RunServer(int argc, char** argv) {
@@ -1048,6 +1114,21 @@ void RunServer(int argc, char** argv) {
     bool tacacs_fallback_pass = true;
     const char* interface_address = NULL;
     const char* openolt_agent_address = NULL;
+    const char* proxy_mode = "sync";
+    int async_cq_threads = 2;
+    int max_inflight_calls = 1024;
+    const char* metrics_address = NULL;
+    int upstream_channels = 4;
+    int indication_queue_size = 4096;
+    IndicationSlowPolicy indication_slow_policy = INDICATION_DISCONNECT;
+    bool async_logging = true;
+    int log_ring_size = 1024;
+    LogOverflowPolicy log_overflow = LOG_OVERFLOW_DROP;
+    AdmissionOptions admission_options;
+    int session_token_ttl = 0;
+    const char* session_token_key_file = NULL;
+    TaccOptions tacc_options;
+    PriorityOptions priority_options;
     TaccController* taccController = NULL;
 
     LOG_F(INFO, "Starting up TACACS Proxy");
@@ -1057,15 +1138,129 @@ void RunServer(int argc, char** argv) {
             tacacs_server_address = argv[i];
         } else if(strcmp(argv[i-1], "--tacacs_secure_key") == 0 ) {
             tacacs_secure_key = argv[i];
+        } else if(strcmp(argv[i-1], "--tacacs_server_weights") == 0 ) {
+            tacc_options.server_weights = argv[i];
         } else if(strcmp(argv[i-1], "--tacacs_fallback_pass") == 0 ) {
             tacacs_fallback_pass = ( *argv[i] == '0') ? false : true;
         } else if(strcmp(argv[i-1], "--interface_address") == 0 ) {
             interface_address = argv[i];
         } else if(strcmp(argv[i-1], "--openolt_agent_address") == 0 ) {
             openolt_agent_address = argv[i];
+        } else if(strcmp(argv[i-1], "--proxy_mode") == 0 ) {
+            proxy_mode = argv[i];
+        } else if(strcmp(argv[i-1], "--async_cq_threads") == 0 ) {
+            async_cq_threads = atoi(argv[i]);
+        } else if(strcmp(argv[i-1], "--async_auth_threads") == 0 ) {
+            priority_options.workers[PRIORITY_NORMAL] = atoi(argv[i]);
+        } else if(strcmp(argv[i-1], "--priority_workers") == 0 ) {
+            if(!ParsePriorityValues(argv[i], priority_options.workers)) {
+                LOG_F(WARNING, "Ignoring invalid priority workers in %s", argv[i]);
+            }
+        } else if(strcmp(argv[i-1], "--priority_budgets") == 0 ) {
+            if(!ParsePriorityValues(argv[i], priority_options.budget)) {
+                LOG_F(WARNING, "Ignoring invalid priority budgets in %s", argv[i]);
+            }
+        } else if(strcmp(argv[i-1], "--priority_methods") == 0 ) {
+            priority_options.methods = argv[i];
+        } else if(strcmp(argv[i-1], "--max_inflight_calls") == 0 ) {
+            max_inflight_calls = atoi(argv[i]);
+        } else if(strcmp(argv[i-1], "--tacacs_pool_warm_connections") == 0 ) {
+            tacc_options.pool_warm_connections = atoi(argv[i]);
+        } else if(strcmp(argv[i-1], "--tacacs_pool_max_idle") == 0 ) {
+            tacc_options.pool_max_idle = atoi(argv[i]);
+        } else if(strcmp(argv[i-1], "--tacacs_pool_idle_timeout") == 0 ) {
+            tacc_options.pool_idle_timeout = atoi(argv[i]);
+        } else if(strcmp(argv[i-1], "--auth_cache_ttl") == 0 ) {
+            tacc_options.auth_cache_ttl = atoi(argv[i]);
+        } else if(strcmp(argv[i-1], "--auth_cache_negative_ttl") == 0 ) {
+            tacc_options.auth_cache_negative_ttl = atoi(argv[i]);
+        } else if(strcmp(argv[i-1], "--auth_cache_max_entries") == 0 ) {
+            tacc_options.auth_cache_max_entries = atoi(argv[i]);
+        } else if(strcmp(argv[i-1], "--author_cache_ttl") == 0 ) {
+            tacc_options.author_cache_ttl = atoi(argv[i]);
+        } else if(strcmp(argv[i-1], "--author_cache_negative_ttl") == 0 ) {
+            tacc_options.author_cache_negative_ttl = atoi(argv[i]);
+        } else if(strcmp(argv[i-1], "--author_cache_max_entries") == 0 ) {
+            tacc_options.author_cache_max_entries = atoi(argv[i]);
+        } else if(strcmp(argv[i-1], "--author_cache_refresh") == 0 ) {
+            tacc_options.author_cache_refresh = ( *argv[i] == '0') ? false : true;
+        } else if(strcmp(argv[i-1], "--accounting_workers") == 0 ) {
+            tacc_options.accounting_workers = atoi(argv[i]);
+        } else if(strcmp(argv[i-1], "--accounting_queue_size") == 0 ) {
+            tacc_options.accounting_queue_size = atoi(argv[i]);
+        } else if(strcmp(argv[i-1], "--accounting_spool_dir") == 0 ) {
+            tacc_options.accounting_spool_dir = argv[i];
+        } else if(strcmp(argv[i-1], "--accounting_spool_max_mb") == 0 ) {
+            tacc_options.accounting_spool_max_mb = atoi(argv[i]);
+        } else if(strcmp(argv[i-1], "--breaker_failures") == 0 ) {
+            tacc_options.breaker_failures = atoi(argv[i]);
+        } else if(strcmp(argv[i-1], "--breaker_latency_ms") == 0 ) {
+            tacc_options.breaker_latency_ms = atoi(argv[i]);
+        } else if(strcmp(argv[i-1], "--breaker_open_sec") == 0 ) {
+            tacc_options.breaker_open_sec = atoi(argv[i]);
+        } else if(strcmp(argv[i-1], "--tacacs_engine_threads") == 0 ) {
+            tacc_options.engine_threads = atoi(argv[i]);
+        } else if(strcmp(argv[i-1], "--tacacs_engine_connections") == 0 ) {
+            tacc_options.engine_connections = atoi(argv[i]);
+        } else if(strcmp(argv[i-1], "--tacacs_connect_timeout_ms") == 0 ) {
+            tacc_options.connect_timeout_ms = atoi(argv[i]);
+        } else if(strcmp(argv[i-1], "--tacacs_authen_timeout_ms") == 0 ) {
+            tacc_options.authen_timeout_ms = atoi(argv[i]);
+        } else if(strcmp(argv[i-1], "--tacacs_author_timeout_ms") == 0 ) {
+            tacc_options.author_timeout_ms = atoi(argv[i]);
+        } else if(strcmp(argv[i-1], "--tacacs_acct_timeout_ms") == 0 ) {
+            tacc_options.acct_timeout_ms = atoi(argv[i]);
+        } else if(strcmp(argv[i-1], "--tacacs_budget_percent") == 0 ) {
+            tacc_options.tacacs_budget_percent = atoi(argv[i]);
+        } else if(strcmp(argv[i-1], "--upstream_timeout_ms") == 0 ) {
+            SetUpstreamTimeout(atoi(argv[i]));
+        } else if(strcmp(argv[i-1], "--metrics_address") == 0 ) {
+            metrics_address = argv[i];
+        } else if(strcmp(argv[i-1], "--upstream_channels") == 0 ) {
+            upstream_channels = atoi(argv[i]);
+        } else if(strcmp(argv[i-1], "--indication_queue_size") == 0 ) {
+            indication_queue_size = atoi(argv[i]);
+        } else if(strcmp(argv[i-1], "--indication_slow_policy") == 0 ) {
+            if(!ParseIndicationSlowPolicy(argv[i], &indication_slow_policy)) {
+                LOG_F(WARNING, "Unknown indication slow policy %s, using disconnect", argv[i]);
+            }
+        } else if(strcmp(argv[i-1], "--async_logging") == 0 ) {
+            async_logging = ( *argv[i] == '0') ? false : true;
+        } else if(strcmp(argv[i-1], "--log_ring_size") == 0 ) {
+            log_ring_size = atoi(argv[i]);
+        } else if(strcmp(argv[i-1], "--log_overflow") == 0 ) {
+            if(!ParseLogOverflowPolicy(argv[i], &log_overflow)) {
+                LOG_F(WARNING, "Unknown log overflow policy %s, using drop", argv[i]);
+            }
+        } else if(strcmp(argv[i-1], "--admission_user_rates") == 0 ) {
+            if(!ParsePriorityValues(argv[i], admission_options.limits[ADMISSION_USER].rate)) {
+                LOG_F(WARNING, "Ignoring invalid admission rates in %s", argv[i]);
+            }
+        } else if(strcmp(argv[i-1], "--admission_user_bursts") == 0 ) {
+            if(!ParsePriorityValues(argv[i], admission_options.limits[ADMISSION_USER].burst)) {
+                LOG_F(WARNING, "Ignoring invalid admission bursts in %s", argv[i]);
+            }
+        } else if(strcmp(argv[i-1], "--admission_peer_rates") == 0 ) {
+            if(!ParsePriorityValues(argv[i], admission_options.limits[ADMISSION_PEER].rate)) {
+                LOG_F(WARNING, "Ignoring invalid admission rates in %s", argv[i]);
+            }
+        } else if(strcmp(argv[i-1], "--admission_peer_bursts") == 0 ) {
+            if(!ParsePriorityValues(argv[i], admission_options.limits[ADMISSION_PEER].burst)) {
+                LOG_F(WARNING, "Ignoring invalid admission bursts in %s", argv[i]);
+            }
+        } else if(strcmp(argv[i-1], "--admission_max_keys") == 0 ) {
+            admission_options.max_keys = atoi(argv[i]);
+        } else if(strcmp(argv[i-1], "--session_token_ttl") == 0 ) {
+            session_token_ttl = atoi(argv[i]);
+        } else if(strcmp(argv[i-1], "--session_token_key_file") == 0 ) {
+            session_token_key_file = argv[i];
         }
     }
 
+    if(async_logging) {
+        AsyncLog::Start(log_ring_size, log_overflow);
+    }
+
     if(!interface_address || interface_address == ""){
         LOG_F(FATAL, "Server Interface Bind address is missing. TACACS Proxy startup failed");
         return; 
@@ -1090,10 +1285,52 @@ void RunServer(int argc, char** argv) {
     }
 
     LOG_F(MAX, "Creating TaccController");
-    taccController = new TaccController(tacacs_server_address, tacacs_secure_key, tacacs_fallback_pass);
+    taccController = new TaccController(tacacs_server_address, tacacs_secure_key, tacacs_fallback_pass, tacc_options);
+    TaccControllerInstance = taccController;
+    SetCredentialsCache(taccController->CredentialsCache());
+
+    SessionTokens sessionTokens(session_token_ttl, session_token_key_file);
+    if(sessionTokens.Enabled()) {
+        LOG_F(INFO, "Session tokens enabled, valid for %d seconds", session_token_ttl);
+        SetSessionTokens(&sessionTokens);
+    }
+
+    MetricsServer metricsServer;
+    if(metrics_address && *metrics_address != '\0') {
+        metricsServer.Start(metrics_address);
+    }
+
+    UpstreamChannelPool channelPool(openolt_agent_address, upstream_channels);
+
+    // One upstream indication stream shared by all EnableIndication callers
+    IndicationHub indicationHub(channelPool.StreamingChannel(), indication_queue_size, indication_slow_policy);
+    IndicationHubInstance = &indicationHub;
+    StartShutdownThread();
+
+    // TACACS+ processing of calls, by priority class of their method
+    PriorityScheduler scheduler(priority_options);
+
+    // Rate limits per user and peer host, by the same classes
+    AdmissionControl admission(admission_options);
+    SetAdmissionControl(&admission);
+
+    if(strcmp(proxy_mode, "async") == 0 || strcmp(proxy_mode, "opaque") == 0) {
+        LOG_F(MAX, "Creating Async Proxy Server");
+        bool opaque = (strcmp(proxy_mode, "opaque") == 0);
+        AsyncProxyServer asyncServer(taccController, &channelPool, &indicationHub, &scheduler, opaque, async_cq_threads, max_inflight_calls);
+        AsyncServerInstance = &asyncServer;
+        asyncServer.Run(interface_address);
+        JoinShutdownThread();
+        // Calls still with the TACACS+ engine may hold on to the controller,
+        // so it outlives the server and only accounting is wound up
+        taccController->FlushAccounting();
+        return;
+    } else if(strcmp(proxy_mode, "sync") != 0) {
+        LOG_F(WARNING, "Unknown proxy mode %s, using sync", proxy_mode);
+    }
 
     LOG_F(MAX, "Creating Proxy Server");
-    ProxyServiceImpl service(taccController, openolt_agent_address);
+    ProxyServiceImpl service(taccController, &channelPool, &indicationHub, &scheduler);
 
     grpc::EnableDefaultHealthCheckService(true);
     ServerBuilder builder;
@@ -1108,15 +1345,26 @@ void RunServer(int argc, char** argv) {
 
     LOG_F(INFO, "TACACS Proxy listening on %s", interface_address);
     server->Wait();
+    JoinShutdownThread();
+    // STOP records of the calls the shutdown let finish are still queued
+    taccController->FlushAccounting();
 }
 
 void StopServer(int signum) {
-    LOG_F(INFO, "Received Signal %d", signum);
-
-    if( ServerInstance != NULL ) {
-        LOG_F(INFO, "Shutting down TACACS Proxy");
-        ServerInstance->Shutdown();
+    // Signal context: the hub and the servers take locks and join threads,
+    // so only wake ShutdownThread
+    ShutdownSignal = signum;
+    if( ShutdownFd >= 0 ) {
+        uint64_t one = 1;
+        ssize_t ret = write(ShutdownFd, &one, sizeof(one));
+        (void)ret;
     }
+    // RunServer returns once the server is down, after accounting is flushed
+}
 
-    exit(0);
+void FlushCaches(int signum) {
+    // Nothing but atomic updates here, this runs in signal context
+    if( TaccControllerInstance != NULL ) {
+        TaccControllerInstance->FlushCaches();
+    }
 }
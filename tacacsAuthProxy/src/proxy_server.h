@@ -15,3 +15,4 @@
 
 void RunServer(int argc, char** argv);
 void StopServer(int signum);
+void FlushCaches(int signum);
@@ -0,0 +1,239 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <fstream>
+#include <iterator>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+
+#include "session_token.h"
+#include "metrics.h"
+#include "logger.h"
+
+#define SESSION_TOKEN_VERSION "1"
+#define SESSION_TOKEN_KEY_SIZE 32
+// Shortest key file accepted
+#define SESSION_TOKEN_KEY_MIN 16
+
+static const char base64url_chars[] =
+"ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+"abcdefghijklmnopqrstuvwxyz"
+"0123456789-_";
+
+// Unpadded base64url, tokens travel in metadata as is
+static std::string base64url_encode(const std::string& in) {
+    std::string out;
+    out.reserve((in.size() * 4 + 2) / 3);
+    size_t i = 0;
+    for (; i + 2 < in.size(); i += 3) {
+        unsigned v = ((unsigned char)in[i] << 16) | ((unsigned char)in[i + 1] << 8) | (unsigned char)in[i + 2];
+        out += base64url_chars[(v >> 18) & 0x3f];
+        out += base64url_chars[(v >> 12) & 0x3f];
+        out += base64url_chars[(v >> 6) & 0x3f];
+        out += base64url_chars[v & 0x3f];
+    }
+    if (i < in.size()) {
+        unsigned v = (unsigned char)in[i] << 16;
+        if (i + 1 < in.size()) {
+            v |= (unsigned char)in[i + 1] << 8;
+        }
+        out += base64url_chars[(v >> 18) & 0x3f];
+        out += base64url_chars[(v >> 12) & 0x3f];
+        if (i + 1 < in.size()) {
+            out += base64url_chars[(v >> 6) & 0x3f];
+        }
+    }
+    return out;
+}
+
+static int base64url_value(char c) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '-') return 62;
+    if (c == '_') return 63;
+    return -1;
+}
+
+static bool base64url_decode(const char* in, size_t len, std::string* out) {
+    if (len % 4 == 1) {
+        return false;
+    }
+    out->clear();
+    out->reserve(len * 3 / 4);
+    unsigned v = 0;
+    int bits = 0;
+    for (size_t i = 0; i < len; i++) {
+        int c = base64url_value(in[i]);
+        if (c < 0) {
+            return false;
+        }
+        v = (v << 6) | c;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            *out += (char)((v >> bits) & 0xff);
+        }
+    }
+    return true;
+}
+
+SessionTokens::SessionTokens(int ttl_sec, const char* key_file) :
+    ttl(ttl_sec > 0 ? ttl_sec : 0), issued(0), accepted(0) {
+    for (int i = 0; i < SESSION_TOKEN_REJECTION_COUNT; i++) {
+        rejected[i] = 0;
+    }
+    metricsCollector = ProxyMetrics::Instance().AddCollector(
+            std::bind(&SessionTokens::CollectMetrics, this, std::placeholders::_1));
+    if (ttl == 0) {
+        return;
+    }
+
+    if (key_file && *key_file != '\0') {
+        std::ifstream in(key_file, std::ios::binary);
+        key.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        if (!in.good() && !in.eof()) {
+            key.clear();
+        }
+        if (key.size() < SESSION_TOKEN_KEY_MIN) {
+            LOG_F(ERROR, "Session token key file %s is unreadable or shorter than %d bytes, disabling session tokens",
+                    key_file, SESSION_TOKEN_KEY_MIN);
+            ttl = 0;
+            key.clear();
+        }
+        return;
+    }
+
+    unsigned char buf[SESSION_TOKEN_KEY_SIZE];
+    if (RAND_bytes(buf, sizeof(buf)) != 1) {
+        LOG_F(WARNING, "Unable to generate a random key, disabling session tokens");
+        ttl = 0;
+        return;
+    }
+    key.assign((const char*)buf, sizeof(buf));
+}
+
+SessionTokens::~SessionTokens() {
+    ProxyMetrics::Instance().RemoveCollector(metricsCollector);
+}
+
+std::string SessionTokens::Sign(const std::string& payload) {
+    unsigned char mac[EVP_MAX_MD_SIZE];
+    unsigned int mac_len = 0;
+    HMAC(EVP_sha256(), key.data(), key.size(), (const unsigned char*)payload.data(), payload.size(), mac, &mac_len);
+    return std::string((const char*)mac, mac_len);
+}
+
+std::string SessionTokens::PeerHost(const std::string& peer) {
+    if (peer.compare(0, 5, "ipv4:") != 0 && peer.compare(0, 5, "ipv6:") != 0) {
+        // unix: and the like have no port
+        return peer;
+    }
+    std::string::size_type colon = peer.rfind(':');
+    return colon > 4 ? peer.substr(0, colon) : peer;
+}
+
+// Fields are separated by NUL, which cannot appear in any of them
+std::string SessionTokens::Issue(const std::string& peer, const SessionTokenClaims& claims) {
+    if (!Enabled() || claims.username.find('\0') != std::string::npos) {
+        return "";
+    }
+    time_t expiry = claims.expiry ? claims.expiry : time(NULL) + ttl;
+    std::string payload = SESSION_TOKEN_VERSION;
+    payload += '\0';
+    payload += std::to_string((long long)expiry);
+    payload += '\0';
+    payload += PeerHost(peer);
+    payload += '\0';
+    payload += claims.username;
+    for (size_t i = 0; i < claims.commands.size(); i++) {
+        payload += '\0';
+        payload += claims.commands[i];
+    }
+    issued++;
+    return base64url_encode(payload) + "." + base64url_encode(Sign(payload));
+}
+
+bool SessionTokens::Validate(const std::string& token, const std::string& peer, SessionTokenClaims* claims) {
+    if (!Enabled()) {
+        return false;
+    }
+    std::string payload;
+    std::string mac;
+    std::string::size_type dot = token.find('.');
+    if (dot == std::string::npos || !base64url_decode(token.data(), dot, &payload) ||
+            !base64url_decode(token.data() + dot + 1, token.size() - dot - 1, &mac)) {
+        rejected[SESSION_TOKEN_MALFORMED]++;
+        return false;
+    }
+
+    // The length of a MAC is no secret, its bytes are compared in constant time
+    std::string expected = Sign(payload);
+    if (mac.size() != expected.size() || CRYPTO_memcmp(mac.data(), expected.data(), mac.size()) != 0) {
+        rejected[SESSION_TOKEN_BAD_SIGNATURE]++;
+        return false;
+    }
+
+    std::vector<std::string> fields;
+    std::string::size_type start = 0;
+    for (;;) {
+        std::string::size_type end = payload.find('\0', start);
+        fields.push_back(payload.substr(start, end == std::string::npos ? std::string::npos : end - start));
+        if (end == std::string::npos) {
+            break;
+        }
+        start = end + 1;
+    }
+    // Signed by this key but not in this format, left by an older version
+    if (fields.size() < 4 || fields[0] != SESSION_TOKEN_VERSION) {
+        rejected[SESSION_TOKEN_MALFORMED]++;
+        return false;
+    }
+
+    time_t expiry = (time_t)strtoll(fields[1].c_str(), NULL, 10);
+    if (expiry <= time(NULL)) {
+        rejected[SESSION_TOKEN_EXPIRED]++;
+        return false;
+    }
+    if (fields[2] != PeerHost(peer)) {
+        rejected[SESSION_TOKEN_WRONG_PEER]++;
+        return false;
+    }
+
+    claims->expiry = expiry;
+    claims->username = fields[3];
+    claims->commands.assign(fields.begin() + 4, fields.end());
+    accepted++;
+    return true;
+}
+
+void SessionTokens::CollectMetrics(std::string* out) {
+    typedef std::vector<std::pair<const char*, std::string> > Labels;
+    static const char* reasons[SESSION_TOKEN_REJECTION_COUNT] = { "malformed", "bad_signature", "expired",
+        "wrong_peer" };
+    MetricsFamily(out, "tacacs_proxy_session_tokens_issued_total", "counter",
+            "Session tokens handed out after TACACS+ authentication and authorization");
+    MetricsSample(out, "tacacs_proxy_session_tokens_issued_total", Labels(), issued);
+    MetricsFamily(out, "tacacs_proxy_session_tokens_accepted_total", "counter",
+            "Calls authenticated by a valid session token");
+    MetricsSample(out, "tacacs_proxy_session_tokens_accepted_total", Labels(), accepted);
+    MetricsFamily(out, "tacacs_proxy_session_tokens_rejected_total", "counter",
+            "Session tokens presented but not accepted, by reason");
+    for (int i = 0; i < SESSION_TOKEN_REJECTION_COUNT; i++) {
+        MetricsSample(out, "tacacs_proxy_session_tokens_rejected_total", Labels(1, std::make_pair("reason",
+                        std::string(reasons[i]))), rejected[i]);
+    }
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef SESSION_TOKEN_H_
+#define SESSION_TOKEN_H_
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <time.h>
+
+// What a valid session token vouches for
+struct SessionTokenClaims {
+    std::string username;
+    time_t expiry;
+    // TACACS+ commands the user was authorized for
+    std::vector<std::string> commands;
+};
+
+// Why a presented token was not accepted
+enum SessionTokenRejection {
+    SESSION_TOKEN_MALFORMED,
+    SESSION_TOKEN_BAD_SIGNATURE,
+    SESSION_TOKEN_EXPIRED,
+    SESSION_TOKEN_WRONG_PEER,
+    SESSION_TOKEN_REJECTION_COUNT
+};
+
+// Signed session tokens, letting a client skip the TACACS+ exchanges of its
+// next calls once the server authenticated and authorized it.
+//
+// A token is base64url(payload) "." base64url(HMAC-SHA256(key, payload)).
+// The payload holds the username, the host the client called from, the wall
+// clock expiry and the commands the server authorized, so a token is only
+// good from that host, until then and for those commands. Validation is
+// local: the MAC is compared in constant time and nothing is looked up.
+//
+// The key is read from a file, shared by proxies behind the same address,
+// or random per process, in which case a restart revokes every token. A
+// token cannot be revoked otherwise, the TTL bounds how long a decision the
+// server changed meanwhile still applies.
+class SessionTokens {
+    std::string key;
+    int ttl;
+    int metricsCollector;
+
+    std::string Sign(const std::string& payload);
+
+    public:
+    std::atomic<unsigned long> issued;
+    std::atomic<unsigned long> accepted;
+    std::atomic<unsigned long> rejected[SESSION_TOKEN_REJECTION_COUNT];
+
+    // ttl_sec 0 disables tokens. key_file may be NULL or empty for a random key.
+    SessionTokens(int ttl_sec, const char* key_file);
+    ~SessionTokens();
+
+    bool Enabled() { return ttl > 0; }
+
+    // Token for claims. An expiry of 0 is replaced by now plus the TTL.
+    std::string Issue(const std::string& peer, const SessionTokenClaims& claims);
+
+    // Fills claims and returns true if token is intact, live and was issued
+    // to a client calling from the same host as peer
+    bool Validate(const std::string& token, const std::string& peer, SessionTokenClaims* claims);
+
+    // Host part of a gRPC peer URI such as ipv4:10.0.0.1:50312, the port of
+    // the client differs from one connection to the next
+    static std::string PeerHost(const std::string& peer);
+
+    void CollectMetrics(std::string* out);
+};
+
+#endif
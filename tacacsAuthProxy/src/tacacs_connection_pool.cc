@@ -0,0 +1,184 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <poll.h>
+#include <unistd.h>
+
+#include "tacacs_connection_pool.h"
+#include "tacacs_packet.h"
+#include "logger.h"
+
+#define POOL_MAX_BACKOFF_SEC 30
+// Weight of a new sample in the RTT moving average is 1/2^POOL_RTT_SHIFT
+#define POOL_RTT_SHIFT 3
+
+TacacsConnection::~TacacsConnection() {
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+TacacsConnectionPool::TacacsConnectionPool(const struct addrinfo* tac_server, const char* server_name, int warm_connections,
+        int max_idle, int idle_timeout_sec, int connect_timeout_ms, int breaker_failures, int breaker_latency_ms,
+        int breaker_open_sec) :
+    server(tac_server), name(server_name), warmConnections(warm_connections), maxIdle(max_idle),
+    idleTimeoutSec(idle_timeout_sec), connectTimeoutMs(connect_timeout_ms), stopping(false),
+    backoffSec(0), nextConnectAttempt(0), rttUs(0), connects(0), connectFailures(0), reuses(0),
+    breaker(server_name, breaker_failures, breaker_latency_ms, breaker_open_sec) {
+    if (maxIdle < warmConnections) {
+        maxIdle = warmConnections;
+    }
+    maintainer = std::thread(&TacacsConnectionPool::Maintain, this);
+}
+
+TacacsConnectionPool::~TacacsConnectionPool() {
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        stopping = true;
+    }
+    cond.notify_all();
+    maintainer.join();
+
+    while (!idle.empty()) {
+        delete idle.front();
+        idle.pop_front();
+    }
+}
+
+TacacsConnection* TacacsConnectionPool::Connect() {
+    int fd = TacacsConnect(server, connectTimeoutMs);
+    if (fd < 0) {
+        connectFailures++;
+        return NULL;
+    }
+    connects++;
+    return new TacacsConnection(fd);
+}
+
+// An idle socket must have nothing to read: readiness means the server sent
+// a FIN, reset the connection or sent something unsolicited.
+bool TacacsConnectionPool::IsAlive(TacacsConnection* conn) {
+    struct pollfd pfd;
+    pfd.fd = conn->fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    return poll(&pfd, 1, 0) == 0;
+}
+
+TacacsConnection* TacacsConnectionPool::Acquire() {
+    if (!breaker.Allow()) {
+        return NULL;
+    }
+
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        while (!idle.empty()) {
+            TacacsConnection* conn = idle.back();
+            idle.pop_back();
+            if (IsAlive(conn)) {
+                reuses++;
+                guard.unlock();
+                cond.notify_one();
+                return conn;
+            }
+            LOG_F(MAX, "Dropping stale connection to TACACS+ server %s", name.c_str());
+            delete conn;
+        }
+    }
+
+    // No warm connection left, connect on the caller's time
+    TacacsConnection* conn = Connect();
+    if (conn == NULL) {
+        breaker.RecordFailure();
+    }
+    cond.notify_one();
+    return conn;
+}
+
+void TacacsConnectionPool::Release(TacacsConnection* conn, bool reusable) {
+    if (reusable && conn->single_connect) {
+        std::unique_lock<std::mutex> guard(lock);
+        if (!stopping && (int)idle.size() < maxIdle) {
+            conn->idle_since = time(0);
+            idle.push_back(conn);
+            return;
+        }
+    }
+    delete conn;
+    cond.notify_one();
+}
+
+void TacacsConnectionPool::RecordRtt(long rtt_us) {
+    // Concurrent updates may lose a sample, which the average absorbs
+    long estimate = rttUs.load(std::memory_order_relaxed);
+    if (estimate == 0) {
+        estimate = (rtt_us > 0) ? rtt_us : 1;
+    } else {
+        estimate += (rtt_us - estimate) / (1 << POOL_RTT_SHIFT);
+    }
+    rttUs.store(estimate, std::memory_order_relaxed);
+}
+
+void TacacsConnectionPool::Maintain() {
+    std::unique_lock<std::mutex> guard(lock);
+    while (!stopping) {
+        time_t now = time(0);
+
+        std::deque<TacacsConnection*>::iterator it = idle.begin();
+        while (it != idle.end()) {
+            if (now - (*it)->idle_since > idleTimeoutSec || !IsAlive(*it)) {
+                delete *it;
+                it = idle.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        if (breaker.ProbeDue()) {
+            guard.unlock();
+            TacacsConnection* conn = Connect();
+            guard.lock();
+            if (conn == NULL) {
+                breaker.ProbeFailed();
+            } else {
+                breaker.ProbeSucceeded();
+                conn->idle_since = time(0);
+                idle.push_front(conn);
+            }
+        }
+
+        while ((int)idle.size() < warmConnections && !stopping && now >= nextConnectAttempt &&
+                breaker.GetState() == CircuitBreaker::CLOSED) {
+            guard.unlock();
+            TacacsConnection* conn = Connect();
+            guard.lock();
+            now = time(0);
+            if (conn == NULL) {
+                backoffSec = (backoffSec == 0) ? 1 : std::min(backoffSec * 2, POOL_MAX_BACKOFF_SEC);
+                nextConnectAttempt = now + backoffSec;
+                LOG_F(WARNING, "Unable to pre-connect to TACACS+ server %s, retrying in %d sec", name.c_str(), backoffSec);
+                break;
+            }
+            if (backoffSec != 0) {
+                LOG_F(INFO, "TACACS+ server %s reachable again", name.c_str());
+                backoffSec = 0;
+            }
+            conn->idle_since = now;
+            idle.push_front(conn);
+        }
+
+        cond.wait_for(guard, std::chrono::seconds(1));
+    }
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TACACS_CONNECTION_POOL_H_
+#define TACACS_CONNECTION_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <ctime>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <netdb.h>
+
+#include "circuit_breaker.h"
+
+class TacacsConnection {
+    public:
+    int fd;
+    // Server agreed to run further sessions on this connection
+    bool single_connect;
+    // single_connect was settled by the first reply on the connection
+    bool negotiated;
+    time_t idle_since;
+
+    TacacsConnection(int sock) : fd(sock), single_connect(false), negotiated(false), idle_since(0) {}
+    ~TacacsConnection();
+};
+
+// Warm TCP connections to one TACACS+ server.
+//
+// A background thread keeps a few connected sockets ready so that connection
+// setup stays off the request path, drops idle sockets the server has closed
+// and backs off while the server is unreachable. Connections on which the
+// server accepted single-connect mode go back to the pool after each session.
+// While the server's circuit breaker is open, Acquire fails at once and the
+// background thread probes the server instead.
+class TacacsConnectionPool {
+    const struct addrinfo* server;
+    std::string name;
+    int warmConnections;
+    int maxIdle;
+    int idleTimeoutSec;
+    int connectTimeoutMs;
+
+    std::mutex lock;
+    std::condition_variable cond;
+    std::deque<TacacsConnection*> idle;
+    bool stopping;
+    int backoffSec;
+    time_t nextConnectAttempt;
+    std::thread maintainer;
+    std::atomic<long> rttUs;    // moving average, 0 until the first reply
+
+    TacacsConnection* Connect();
+    bool IsAlive(TacacsConnection* conn);
+    void Maintain();
+
+    public:
+    std::atomic<unsigned long> connects;
+    std::atomic<unsigned long> connectFailures;
+    std::atomic<unsigned long> reuses;
+    CircuitBreaker breaker;
+
+    TacacsConnectionPool(const struct addrinfo* server, const char* name, int warm_connections, int max_idle,
+            int idle_timeout_sec, int connect_timeout_ms, int breaker_failures, int breaker_latency_ms,
+            int breaker_open_sec);
+    ~TacacsConnectionPool();
+
+    // Returns a connected socket, reusing an idle one when possible.
+    // NULL when the server cannot be reached or its breaker is open.
+    TacacsConnection* Acquire();
+
+    // Hands a connection back once its session is over. It is kept for reuse
+    // only if single-connect was negotiated and the session ended cleanly.
+    void Release(TacacsConnection* conn, bool reusable);
+
+    // Round trip time of the server, as an exponentially weighted moving
+    // average of completed exchanges in microseconds. 0 while unknown.
+    void RecordRtt(long rtt_us);
+    long RttEstimate() const { return rttUs.load(std::memory_order_relaxed); }
+};
+
+#endif
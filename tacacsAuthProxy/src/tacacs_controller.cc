@@ -11,6 +11,9 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+#include <climits>
+
 #include "tacacs_controller.h"
 #include "logger.h"
 
@@ -24,10 +27,93 @@ char TAC_ATTR_TASK_ID[] = "task_id";
 char TAC_ATTR_ERR_MSG[] = "err_msg";
 char TAC_ATTR_VALUE_SHELL[] = "shell";
 
-TaccController::TaccController(const char* tacacs_server_address, const char* tacacs_secure_key, bool tacacs_fallback_pass){
+#define TACACS_CONNECT_ERROR -1
+#define TACACS_SEND_ERROR -2
+#define TACACS_DEADLINE_ERROR -3
+
+static string Attribute(const char* name, const string& value) {
+    return string(name) + "=" + value;
+}
+
+static void RecordPhase(MethodMetrics* metrics, MetricsPhase phase, TaccClock::duration elapsed) {
+    if (metrics != NULL) {
+        metrics->Record(phase, std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+    }
+}
+
+// Milliseconds left until deadline, 0 once it passed. Rounded up, so that
+// a wait for them does not end before the deadline.
+static int RemainingMs(TaccClock::time_point deadline) {
+    TaccClock::time_point now = TaccClock::now();
+    if (deadline <= now) {
+        return 0;
+    }
+    long long us = std::chrono::duration_cast<std::chrono::microseconds>(deadline - now).count();
+    long long ms = (us + 999) / 1000;
+    return (ms > INT_MAX) ? INT_MAX : (int)ms;
+}
+
+// Once the budget of the call ran out, a failed query says nothing about
+// the servers: they were not given their configured time. Such a call must
+// not pass in fallback mode, or any client could skip the checks by
+// sending a short deadline.
+static int PhaseResult(const TaccPhase& phase, int ret) {
+    if (ret < 0 && phase.BudgetBound() && RemainingMs(phase.deadline) == 0) {
+        return TACACS_DEADLINE_ERROR;
+    }
+    return ret;
+}
+
+TaccController::TaccController(const char* tacacs_server_address, const char* tacacs_secure_key, bool tacacs_fallback_pass,
+        const TaccOptions& tacc_options) :
+    options(tacc_options),
+    authCache(tacc_options.auth_cache_ttl, tacc_options.auth_cache_negative_ttl, tacc_options.auth_cache_max_entries),
+    authorCache(tacc_options.author_cache_ttl, tacc_options.author_cache_negative_ttl, tacc_options.author_cache_max_entries,
+        tacc_options.author_cache_refresh) {
     server_address = tacacs_server_address;
-    secure_key = tacacs_secure_key;
     fallback_pass = tacacs_fallback_pass;
+    servers = new TacacsServerGroup(tacacs_server_address, tacacs_secure_key, tacc_options.server_weights,
+            std::bind(&TaccController::NewConnectionPool, this, std::placeholders::_1, std::placeholders::_2));
+    refreshPool = NULL;
+    if (tacc_options.author_cache_refresh && authorCache.Enabled()) {
+        refreshPool = new ThreadPool(1);
+    }
+    spool = NULL;
+    if (tacc_options.accounting_spool_dir != NULL && *tacc_options.accounting_spool_dir != '\0') {
+        spool = new AccountingSpool(tacc_options.accounting_spool_dir, (size_t)tacc_options.accounting_spool_max_mb << 20,
+                std::bind(&TaccController::SendAccounting, this, std::placeholders::_1));
+        if (!spool->Open()) {
+            LOG_F(ERROR, "Accounting spool disabled, records will be lost while TACACS server is unreachable");
+            delete spool;
+            spool = NULL;
+        }
+    }
+    accounting = new AccountingPipeline(tacc_options.accounting_workers, tacc_options.accounting_queue_size,
+            std::bind(&TaccController::DeliverAccounting, this, std::placeholders::_1));
+
+    engine = NULL;
+    if (IsTacacsEnabled() && tacc_options.engine_threads > 0) {
+        engine = new TacacsEngine(tacc_options.engine_threads, tacc_options.engine_connections,
+                tacc_options.pool_idle_timeout);
+    }
+
+    // Warm up the connections before the first request
+    if (IsTacacsEnabled()) {
+        servers->Rank();
+    }
+    metricsCollector = ProxyMetrics::Instance().AddCollector(
+            std::bind(&TaccController::CollectMetrics, this, std::placeholders::_1));
+}
+
+TaccController::~TaccController() {
+    ProxyMetrics::Instance().RemoveCollector(metricsCollector);
+    // Each stage feeds on the ones after it: accounting workers spool,
+    // the spool and the refreshes send, sends need the servers
+    delete accounting;
+    delete spool;
+    delete refreshPool;
+    delete engine;
+    delete servers;
 }
 
 bool TaccController::IsTacacsEnabled() {
@@ -39,233 +125,695 @@ bool TaccController::IsTacacsEnabled() {
     }
 } 
 
-struct addrinfo* TaccController::ResolveServerAddress() {
-    if(resolved_server_address != NULL) {
-        return resolved_server_address;
-    }
-
-    struct addrinfo *tac_server = NULL;
-    struct addrinfo hints;
-    memset(&hints, 0, sizeof hints);
-    hints.ai_family = AF_UNSPEC;
-    hints.ai_socktype = SOCK_STREAM;
-    string s(server_address);
-    int pos = s.find(":");
-    string host, port;
-    if (pos > 0){
-        port = s.substr(pos + 1);
-        host = s.substr(0,pos);
-    } else {
-        host = s;
-        port = "49";
-    }
-    int ret = getaddrinfo(host.c_str(), port.c_str(), &hints, &tac_server);
-    if (ret != 0) {
-        LOG_F(WARNING, "Error: resolving name %s: %s", server_address, gai_strerror(ret));
-        return NULL;
+void TaccController::AllotBudget(TacacsContext* tacCtx) {
+    if (tacCtx->deadline == TaccClock::time_point::max()) {
+        tacCtx->tacacs_deadline = TaccClock::time_point::max();
+        return;
     }
+    TaccClock::time_point now = TaccClock::now();
+    TaccClock::duration remaining = (tacCtx->deadline > now) ? tacCtx->deadline - now : TaccClock::duration::zero();
+    tacCtx->tacacs_deadline = now + remaining * options.tacacs_budget_percent / 100;
+}
 
-    resolved_server_address = tac_server;
-    return tac_server;
+TaccPhase TaccController::Phase(const TacacsContext* tacCtx, int timeout_ms) {
+    TaccClock::time_point timeout = TaccClock::now() + std::chrono::milliseconds(timeout_ms);
+    return TaccPhase(std::min(timeout, tacCtx->tacacs_deadline), timeout);
 }
 
-Status TaccController::Authenticate(TacacsContext* tacCtx) {
-    LOG_F(MAX, "Authentication");
+TacacsConnectionPool* TaccController::NewConnectionPool(const struct addrinfo* tac_server, const char* name) {
+    return new TacacsConnectionPool(tac_server, name, options.pool_warm_connections, options.pool_max_idle,
+            options.pool_idle_timeout, options.connect_timeout_ms, options.breaker_failures, options.breaker_latency_ms,
+            options.breaker_open_sec);
+}
+
+// A query returns a negative value when the server could not be reached or
+// did not answer in time, the next server is tried then. Verdicts of a
+// server, including errors it reports, are final. Returns the result of the
+// last server tried, TACACS_CONNECT_ERROR if there was none,
+// TACACS_SEND_ERROR if the deadline passed before a server answered and
+// TACACS_DEADLINE_ERROR if the budget of the call cut that deadline short.
+int TaccController::WithFailover(const char* what, const TaccPhase& phase,
+        const std::function<int(TacacsServer*)>& query) {
+    std::vector<TacacsServer*> ranked = servers->Rank();
+    int ret = TACACS_CONNECT_ERROR;
+    for (size_t i = 0; i < ranked.size(); i++) {
+        if (RemainingMs(phase.deadline) == 0) {
+            LOG_F(WARNING, "%s: deadline passed before TACACS+ server %s was tried", what, ranked[i]->address.c_str());
+            return PhaseResult(phase, TACACS_SEND_ERROR);
+        }
+        ret = query(ranked[i]);
+        if (ret >= 0) {
+            return ret;
+        }
+        if (i + 1 < ranked.size()) {
+            LOG_F(WARNING, "%s: TACACS+ server %s failed, trying %s", what, ranked[i]->address.c_str(),
+                    ranked[i + 1]->address.c_str());
+        }
+    }
+    return PhaseResult(phase, ret);
+}
+
+bool TaccController::AuthenticationShortcut(TacacsContext* tacCtx, Status* status) {
     if(!IsTacacsEnabled() || tacCtx->tacacs_connect_failure) {
-        return Status(OK, "Returning OK as TACACS server is not available");
+        tacCtx->unverified_pass = true;
+        *status = Status(OK, "Returning OK as TACACS server is not available");
+        return true;
+    }
+    if (tacCtx->token_authenticated) {
+        *status = Status(OK, "Authenticated by session token");
+        return true;
     }
 
-    if (ResolveServerAddress() == NULL) {
-        if (fallback_pass){
-            return Status(OK, "Returning OK");
+    bool cached_pass = false;
+    bool cached;
+    if (tacCtx->credentials_lookup == CREDENTIALS_NOT_LOOKED_UP) {
+        cached = authCache.Lookup(tacCtx->username, tacCtx->password, tacCtx->remote_addr, &cached_pass);
+    } else {
+        cached = (tacCtx->credentials_lookup != CREDENTIALS_MISS);
+        cached_pass = (tacCtx->credentials_lookup == CREDENTIALS_CACHED_PASS);
+    }
+    if (cached) {
+        LOG_F(MAX, "Authentication: Using cached result");
+        ProxyMetrics::Instance().cacheHits[METRICS_PHASE_AUTHEN]++;
+        if (cached_pass) {
+            *status = Status(OK, "Authentication OK");
         } else {
-            return Status(UNAVAILABLE, "Error connecting to TACACS Server");
+            *status = Status(UNAUTHENTICATED, "Authentication FAILED");
         }
+        return true;
     }
+    ProxyMetrics::Instance().cacheMisses[METRICS_PHASE_AUTHEN]++;
+    return false;
+}
 
-    LOG_F(MAX, "Authentication: Connect to the server");
-    tac_fd = tac_connect_single(resolved_server_address, secure_key, NULL, 60);
-    if (tac_fd < 0) {
-        LOG_F(WARNING, "Error connecting to TACACS+ server");
+void TaccController::CacheAuthentication(const TacacsContext& tacCtx, bool passed) {
+    if (tacCtx.credentials_digested) {
+        authCache.Insert(tacCtx.credentials_digest, passed);
+    } else {
+        authCache.Insert(tacCtx.username, tacCtx.password, tacCtx.remote_addr, passed);
+    }
+}
+
+Status TaccController::AuthenticationStatus(TacacsContext* tacCtx, int ret, const TacacsReply& reply) {
+    ProxyMetrics& metrics = ProxyMetrics::Instance();
+    if (ret == TACACS_DEADLINE_ERROR) {
+        LOG_F(WARNING, "Authentication: deadline of the call passed before a TACACS+ server answered");
+        return Status(DEADLINE_EXCEEDED, "Deadline expired during the TACACS+ checks");
+    } else if (ret == TACACS_CONNECT_ERROR) {
         tacCtx->tacacs_connect_failure = true;
+        metrics.connectFailures++;
         if (fallback_pass){
+            tacCtx->unverified_pass = true;
+            metrics.fallbackPass[METRICS_PHASE_AUTHEN]++;
             return Status(OK, "Returning OK");
         } else {
             return Status(UNAVAILABLE, "Error connecting to TACACS Server");
         }
-    }
-
-    LOG_F(MAX, "Authentication: Send the authentication request to the server");
-    if (tac_authen_send(tac_fd, tacCtx->getUsername(), tacCtx->getPassword(), TAC_FIELD_TTY, tacCtx->getRemoteAddr(), TAC_PLUS_AUTHEN_LOGIN) < 0) {
-        LOG_F(WARNING, "Error sending query to TACACS+ server");
+    } else if (ret == TACACS_SEND_ERROR) {
         if (fallback_pass){
+            tacCtx->unverified_pass = true;
+            metrics.fallbackPass[METRICS_PHASE_AUTHEN]++;
             return Status(OK, "Returning OK");
         } else {
             return Status(UNAVAILABLE, "Error sending query to TACACS Server");
         }
     }
 
-    LOG_F(MAX, "Authentication: Read the reply from the server");
-    struct areply arep;
-    int ret = tac_authen_read(tac_fd, &arep);
-    if (ret == TAC_PLUS_AUTHEN_STATUS_GETPASS) {
-        if (tac_cont_send(tac_fd, tacCtx->getPassword()) < 0) {
-            LOG_F(WARNING, "Error sending query to TACACS+ server");
-            if (fallback_pass){
-                return Status(OK, "Returning OK");
-            } else {
-                return Status(UNAVAILABLE, "Error sending query to TACACS Server");
-            }
-        }
-        ret = tac_authen_read(tac_fd, &arep);
-    }
+    LOG_F(MAX, "Authentication: Return value from TACACS server: %d, %s", reply.status, reply.server_msg.c_str());
 
-    LOG_F(MAX, "Authentication: Return value from TACACS server: %d, %s", ret, arep.msg);
-
-    if (ret == TAC_PLUS_AUTHEN_STATUS_FAIL) {
-        LOG_F(INFO, "Authentication FAILED: %s", arep.msg);
+    // Only verdicts of the server are cached, never a fallback decision
+    if (reply.status == TAC_PLUS_AUTHEN_STATUS_FAIL) {
+        LOG_F(INFO, "Authentication FAILED: %s", reply.server_msg.c_str());
+        CacheAuthentication(*tacCtx, false);
         return Status(UNAUTHENTICATED, "Authentication FAILED");
-    } else if (ret == TAC_PLUS_AUTHEN_STATUS_PASS) {
+    } else if (reply.status == TAC_PLUS_AUTHEN_STATUS_PASS) {
         LOG_F(INFO, "Authentication OK");
-        close(tac_fd);
+        CacheAuthentication(*tacCtx, true);
         return Status(OK, "Authentication OK");
     } else {
         if (fallback_pass){
             LOG_F(INFO, "Authentication OK in Fallback mode");
-            close(tac_fd);
+            tacCtx->unverified_pass = true;
+            metrics.fallbackPass[METRICS_PHASE_AUTHEN]++;
             return Status(OK, "Authentication OK");
         } else {
             LOG_F(INFO, "Authentication FAILED in Fallback mode");
-            close(tac_fd);
             return Status(UNAUTHENTICATED, "Authentication FAILED");
         }
     }
 }
 
-Status TaccController::Authorize(TacacsContext* tacCtx) {
-    LOG_F(MAX, "Authorize");
-    if(!IsTacacsEnabled() || tacCtx->tacacs_connect_failure) {
-        return Status(OK, "Returning OK as TACACS server is not available");
+Status TaccController::Authenticate(TacacsContext* tacCtx) {
+    LOG_F(MAX, "Authentication");
+    Status status;
+    if (AuthenticationShortcut(tacCtx, &status)) {
+        return status;
     }
 
-    struct tac_attrib *attr = NULL;
+    TacacsReply reply;
+    TaccClock::time_point start = TaccClock::now();
+    TaccPhase phase = Phase(tacCtx, options.authen_timeout_ms);
+    int ret = WithFailover("Authentication", phase, [this, tacCtx, &reply, &phase](TacacsServer* server) {
+        return QueryAuthentication(server, tacCtx, &reply, phase);
+    });
+    RecordPhase(tacCtx->metrics, METRICS_PHASE_AUTHEN, TaccClock::now() - start);
+    return AuthenticationStatus(tacCtx, ret, reply);
+}
 
-    tac_add_attrib(&attr, TAC_ATTR_SERVICE, TAC_ATTR_VALUE_SHELL);
-    char c[tacCtx->method_name.size() + 1];
-    strcpy(c, tacCtx->getMethodName());
-    tac_add_attrib(&attr, TAC_ATTR_CMD, c);
+// Runs an authentication session on one server. Returns 0 once the reply is
+// in, TACACS_CONNECT_ERROR or TACACS_SEND_ERROR otherwise.
+int TaccController::QueryAuthentication(TacacsServer* server, TacacsContext* tacCtx, TacacsReply* reply,
+        const TaccPhase& phase, const std::function<void(TacacsSession*)>& on_pass) {
+    TacacsConnectionPool* pool = servers->GetPool(server);
+    if (pool == NULL) {
+        return TACACS_CONNECT_ERROR;
+    }
 
-    if (ResolveServerAddress() == NULL) {
-        if (fallback_pass){
-            return Status(OK, "Returning OK");
+    // PAP login carries the password in the START packet, so a single round
+    // trip is enough. Servers that still prompt for it get a CONTINUE.
+    TacacsSession session(pool, server->key.c_str(), TAC_PLUS_AUTHEN, TAC_PLUS_MINOR_VER_ONE);
+
+    LOG_F(MAX, "Authentication: Connect to the server %s", server->address.c_str());
+    if (!session.Connect()) {
+        LOG_F(WARNING, "Error connecting to TACACS+ server %s", server->address.c_str());
+        return TACACS_CONNECT_ERROR;
+    }
+
+    LOG_F(MAX, "Authentication: Send the authentication request to the server");
+    int ret = session.Send(TacacsAuthenStartBody(TAC_PLUS_AUTHEN_LOGIN, TAC_PLUS_AUTHEN_TYPE_PAP, tacCtx->username,
+                TAC_FIELD_TTY, tacCtx->remote_addr, tacCtx->password), reply, RemainingMs(phase.deadline),
+                !phase.BudgetBound());
+    if (ret == 0 && reply->status == TAC_PLUS_AUTHEN_STATUS_GETPASS) {
+        ret = session.Send(TacacsAuthenContinueBody(tacCtx->password), reply, RemainingMs(phase.deadline),
+                !phase.BudgetBound());
+    }
+
+    if (ret < 0) {
+        LOG_F(WARNING, "Error sending query to TACACS+ server %s", server->address.c_str());
+        return TACACS_SEND_ERROR;
+    }
+
+    if (reply->status != TAC_PLUS_AUTHEN_STATUS_GETDATA && reply->status != TAC_PLUS_AUTHEN_STATUS_GETUSER &&
+            reply->status != TAC_PLUS_AUTHEN_STATUS_GETPASS) {
+        session.Finish();
+    }
+    if (reply->status == TAC_PLUS_AUTHEN_STATUS_PASS && on_pass) {
+        on_pass(&session);
+    }
+    return 0;
+}
+
+// Runs an authorization session for the context on one server. Returns 0
+// once the reply is in, TACACS_CONNECT_ERROR or TACACS_SEND_ERROR otherwise.
+int TaccController::QueryAuthorization(TacacsServer* server, TacacsContext* tacCtx, TacacsReply* reply,
+        const TaccPhase& phase, TacacsSession* previous) {
+    TacacsConnectionPool* pool = servers->GetPool(server);
+    if (pool == NULL) {
+        return TACACS_CONNECT_ERROR;
+    }
+
+    TacacsSession session(pool, server->key.c_str(), TAC_PLUS_AUTHOR);
+    session.AddAttribute(TAC_ATTR_SERVICE, TAC_ATTR_VALUE_SHELL);
+    session.AddAttribute(TAC_ATTR_CMD, tacCtx->method_name);
+
+    if (previous != NULL && session.Adopt(previous)) {
+        LOG_F(MAX, "Authorize: Continue on the authentication connection");
+    } else if (!session.Connect()) {
+        LOG_F(WARNING, "Error connecting to TACACS+ server %s", server->address.c_str());
+        return TACACS_CONNECT_ERROR;
+    }
+
+    LOG_F(MAX, "Authorize: Send the authorization request to the server");
+    int ret = session.Send(TacacsAuthorRequestBody(tacCtx->username, TAC_FIELD_TTY, tacCtx->remote_addr,
+                session.Attributes()), reply, RemainingMs(phase.deadline), !phase.BudgetBound());
+    if (ret < 0) {
+        LOG_F(INFO, "Error sending authorization query to TACACS+ server %s", server->address.c_str());
+        return TACACS_SEND_ERROR;
+    }
+    session.Finish();
+    CacheAuthorization(*tacCtx, *reply);
+    return 0;
+}
+
+// Only verdicts of the server are cached, never a fallback decision
+void TaccController::CacheAuthorization(const TacacsContext& tacCtx, const TacacsReply& reply) {
+    if (reply.status == TAC_PLUS_AUTHOR_STATUS_PASS_ADD || reply.status == TAC_PLUS_AUTHOR_STATUS_PASS_REPL) {
+        authorCache.Insert(tacCtx.username, tacCtx.method_name, true);
+    } else if (reply.status == TAC_PLUS_AUTHOR_STATUS_FAIL) {
+        authorCache.Insert(tacCtx.username, tacCtx.method_name, false);
+    }
+}
+
+int TaccController::QueryAuthorization(TacacsContext* tacCtx, TacacsReply* reply) {
+    TaccClock::time_point start = TaccClock::now();
+    TaccPhase phase = Phase(tacCtx, options.author_timeout_ms);
+    int ret = WithFailover("Authorize", phase, [this, tacCtx, reply, &phase](TacacsServer* server) {
+        return QueryAuthorization(server, tacCtx, reply, phase);
+    });
+    RecordPhase(tacCtx->metrics, METRICS_PHASE_AUTHOR, TaccClock::now() - start);
+    if (ret == TACACS_CONNECT_ERROR) {
+        tacCtx->tacacs_connect_failure = true;
+    }
+    return ret;
+}
+
+// Queries the server again for a cached decision that is about to expire
+void TaccController::RefreshAuthorization(const TacacsContext& tacCtx) {
+    TacacsContext ctx = tacCtx;
+    // Not bound to the budget of the call that found the entry
+    ctx.tacacs_deadline = TaccClock::time_point::max();
+    refreshPool->Submit([this, ctx]() mutable {
+        TacacsReply reply;
+        LOG_F(MAX, "Refreshing authorization of %s for %s", ctx.username.c_str(), ctx.method_name.c_str());
+        QueryAuthorization(&ctx, &reply);
+    });
+}
+
+bool TaccController::AuthorizationShortcut(TacacsContext* tacCtx, Status* status) {
+    if(!IsTacacsEnabled() || tacCtx->tacacs_connect_failure) {
+        tacCtx->unverified_pass = true;
+        *status = Status(OK, "Returning OK as TACACS server is not available");
+        return true;
+    }
+    // Other commands are authorized for the user of the token as usual
+    if (tacCtx->token_authenticated && std::find(tacCtx->token_commands.begin(), tacCtx->token_commands.end(),
+                tacCtx->method_name) != tacCtx->token_commands.end()) {
+        *status = Status(OK, "Authorized by session token");
+        return true;
+    }
+
+    bool cached_pass;
+    int cached = authorCache.Lookup(tacCtx->username, tacCtx->method_name, &cached_pass);
+    if (cached != AuthorCache::MISS) {
+        LOG_F(MAX, "Authorize: Using cached decision");
+        ProxyMetrics::Instance().cacheHits[METRICS_PHASE_AUTHOR]++;
+        if (cached == AuthorCache::HIT_REFRESH) {
+            RefreshAuthorization(*tacCtx);
+        }
+        if (cached_pass) {
+            *status = Status(OK, "Authorization OK");
         } else {
-            return Status(UNAVAILABLE, "Error connecting to TACACS Server");
+            *status = Status(PERMISSION_DENIED, "Authorization FAILED");
         }
+        return true;
     }
+    ProxyMetrics::Instance().cacheMisses[METRICS_PHASE_AUTHOR]++;
+    return false;
+}
 
-    LOG_F(MAX, "Authorize: Connect to the server");
-    tac_fd = tac_connect_single(resolved_server_address, secure_key, NULL, 60);
-    if (tac_fd < 0) {
-        LOG_F(WARNING, "Error connecting to TACACS+ server");
+Status TaccController::AuthorizationStatus(TacacsContext* tacCtx, int ret, const TacacsReply& reply) {
+    ProxyMetrics& metrics = ProxyMetrics::Instance();
+    if (ret == TACACS_DEADLINE_ERROR) {
+        LOG_F(WARNING, "Authorize: deadline of the call passed before a TACACS+ server answered");
+        return Status(DEADLINE_EXCEEDED, "Deadline expired during the TACACS+ checks");
+    } else if (ret == TACACS_CONNECT_ERROR) {
         tacCtx->tacacs_connect_failure = true;
+        metrics.connectFailures++;
         if (fallback_pass){
+            tacCtx->unverified_pass = true;
+            metrics.fallbackPass[METRICS_PHASE_AUTHOR]++;
             return Status(OK, "Returning OK");
         } else {
             return Status(UNAVAILABLE, "Error connecting to TACACS Server");
         }
-    }
-
-    struct areply arep;
-    LOG_F(MAX, "Authorize: Send the authentication request to the server");
-    if (tac_author_send(tac_fd, tacCtx->getUsername(), TAC_FIELD_TTY, tacCtx->getRemoteAddr(), attr) < 0) {
-        LOG_F(INFO, "Error sending authorization query to TACACS+ server");
+    } else if (ret == TACACS_SEND_ERROR) {
         if (fallback_pass){
+            tacCtx->unverified_pass = true;
+            metrics.fallbackPass[METRICS_PHASE_AUTHOR]++;
             return Status(OK, "Returning OK");
         } else {
             return Status(UNAVAILABLE, "Error sending authorization query to TACACS Server");
         }
     }
 
-    LOG_F(MAX, "Authorize: Read the reply from the server");
-    tac_author_read(tac_fd, &arep);
-
-    if (arep.status == AUTHOR_STATUS_PASS_ADD || arep.status == AUTHOR_STATUS_PASS_REPL) {
-        LOG_F(INFO, "Authorization OK: %s", arep.msg);
+    if (reply.status == TAC_PLUS_AUTHOR_STATUS_PASS_ADD || reply.status == TAC_PLUS_AUTHOR_STATUS_PASS_REPL) {
+        LOG_F(INFO, "Authorization OK: %s", reply.server_msg.c_str());
         return Status(OK, "Authorization OK");
-    } else if (arep.status == AUTHOR_STATUS_FAIL) {
-        LOG_F(INFO, "Authorization FAILED: %s", arep.msg);
+    } else if (reply.status == TAC_PLUS_AUTHOR_STATUS_FAIL) {
+        LOG_F(INFO, "Authorization FAILED: %s", reply.server_msg.c_str());
         return Status(PERMISSION_DENIED, "Authorization FAILED");
     } else {
         if (fallback_pass){
             LOG_F(INFO, "Authorization OK in Fallback mode");
-            close(tac_fd);
-            tac_free_attrib(&attr);
+            tacCtx->unverified_pass = true;
+            metrics.fallbackPass[METRICS_PHASE_AUTHOR]++;
             return Status(OK,"");
         } else {
             LOG_F(INFO, "Authorization FAILED in Fallback mode");
-            close(tac_fd);
             return Status(PERMISSION_DENIED, "Authorization FAILED");
-        } 
+        }
     }
 }
 
-void TaccController::StartAccounting(TacacsContext* tacCtx) {
-    LOG_F(MAX, "StartAccounting");
-    if(!IsTacacsEnabled()) {
-        LOG_F(INFO, "Bypassing Accounting as TACACS server is not available");
-        return;
+Status TaccController::Authorize(TacacsContext* tacCtx) {
+    LOG_F(MAX, "Authorize");
+    Status status;
+    if (AuthorizationShortcut(tacCtx, &status)) {
+        return status;
     }
 
-    struct tac_attrib *attr = NULL;
-    int task_id = 0;
-    time_t t = time(0);
-    struct tm tm;
-    char buf[40];
+    TacacsReply reply;
+    int ret = QueryAuthorization(tacCtx, &reply);
+    return AuthorizationStatus(tacCtx, ret, reply);
+}
 
-    gmtime_r(&t, &tm);
-    strftime(buf, sizeof(buf), "%s", &tm);
-    tac_add_attrib(&attr, TAC_ATTR_START_TIME, buf);
+// Saves a connection setup per call: the authorization session follows the
+// authentication session on its connection, unless the decision is cached.
+// Should the authorization session fail, Authorize starts over with
+// failover like a separate call would.
+Status TaccController::AuthenticateAndAuthorize(TacacsContext* tacCtx) {
+    LOG_F(MAX, "Authentication and authorization");
+    Status status;
+    if (AuthenticationShortcut(tacCtx, &status)) {
+        return status.ok() ? Authorize(tacCtx) : status;
+    }
 
-    srand(time(NULL));
-    long rnd_id = rand();
-    memcpy(&task_id, &rnd_id, sizeof(task_id));
+    TacacsReply reply;
+    Status author_status;
+    bool authorized = false;
+    // The authorization exchange runs within the authentication one, its
+    // time is taken out of the authentication phase
+    TaccClock::time_point start = TaccClock::now();
+    TaccClock::duration author_time = TaccClock::duration::zero();
+    TaccPhase phase = Phase(tacCtx, options.authen_timeout_ms);
+    int ret = WithFailover("Authentication", phase, [&](TacacsServer* server) {
+        return QueryAuthentication(server, tacCtx, &reply, phase, [&](TacacsSession* authen) {
+            if (AuthorizationShortcut(tacCtx, &author_status)) {
+                authorized = true;
+                return;
+            }
+            TacacsReply author_reply;
+            TaccClock::time_point author_start = TaccClock::now();
+            if (QueryAuthorization(server, tacCtx, &author_reply, Phase(tacCtx, options.author_timeout_ms),
+                        authen) == 0) {
+                author_status = AuthorizationStatus(tacCtx, 0, author_reply);
+                authorized = true;
+            }
+            author_time = TaccClock::now() - author_start;
+            if (authorized) {
+                RecordPhase(tacCtx->metrics, METRICS_PHASE_AUTHOR, author_time);
+            }
+        });
+    });
+    RecordPhase(tacCtx->metrics, METRICS_PHASE_AUTHEN, TaccClock::now() - start - author_time);
 
-    sprintf(buf, "%hu", task_id);
-    tac_add_attrib(&attr, TAC_ATTR_TASK_ID, buf);
-    tac_add_attrib(&attr, TAC_ATTR_SERVICE, TAC_ATTR_VALUE_SHELL);
-    char c[tacCtx->method_name.size() + 1];
-    strcpy(c, tacCtx->getMethodName());
-    tac_add_attrib(&attr, TAC_ATTR_CMD, c);
+    status = AuthenticationStatus(tacCtx, ret, reply);
+    if (status.error_code() != OK) {
+        return status;
+    }
+    return authorized ? author_status : Authorize(tacCtx);
+}
 
-    tacCtx->task_id = task_id;
-    tacCtx->start_time = t;
+// A query moving through the ranked servers on the engine
+struct TaccAsyncQuery {
+    const char* what;
+    std::vector<TacacsServer*> ranked;
+    size_t next;
+    TaccPhase phase;
+    TaccClock::time_point start;
+    int result;
+    TacacsEngineRequest request;
+    std::function<void(int ret, const TacacsReply& reply)> done;
+
+    TaccAsyncQuery(const char* query_name, const TaccPhase& query_phase) : what(query_name), next(0),
+        phase(query_phase), start(TaccClock::now()), result(TACACS_CONNECT_ERROR) {}
+};
+
+// Asynchronous counterpart of WithFailover
+void TaccController::RunAsyncQuery(std::shared_ptr<TaccAsyncQuery> query) {
+    while (query->next < query->ranked.size()) {
+        int remaining_ms = RemainingMs(query->phase.deadline);
+        if (remaining_ms == 0) {
+            LOG_F(WARNING, "%s: deadline passed before TACACS+ server %s was tried", query->what,
+                    query->ranked[query->next]->address.c_str());
+            query->result = TACACS_SEND_ERROR;
+            break;
+        }
+        TacacsServer* server = query->ranked[query->next++];
+        TacacsConnectionPool* pool = servers->GetPool(server);
+        if (pool == NULL) {
+            continue;
+        }
 
-    if (ResolveServerAddress() == NULL) {
+        TacacsEngineRequest* request = new TacacsEngineRequest(query->request);
+        request->timeout_ms = remaining_ms;
+        request->server_timeout_ms = RemainingMs(query->phase.timeout);
+        request->done = [this, query, server](int result, const TacacsReply& reply) {
+            if (result == 0) {
+                query->done(0, reply);
+                return;
+            }
+            query->result = (result == TACACS_ENGINE_CONNECT_ERROR) ? TACACS_CONNECT_ERROR : TACACS_SEND_ERROR;
+            if (query->next < query->ranked.size()) {
+                LOG_F(WARNING, "%s: TACACS+ server %s failed, trying %s", query->what, server->address.c_str(),
+                        query->ranked[query->next]->address.c_str());
+            }
+            RunAsyncQuery(query);
+        };
+        engine->Submit(server, pool, request);
         return;
     }
 
-    LOG_F(MAX, "StartAccounting: Connect to the server");
-    tac_fd = tac_connect_single(resolved_server_address, secure_key, NULL, 60);
-    if (tac_fd < 0) {
-	tacCtx->tacacs_connect_failure = true;
-        LOG_F(WARNING, "Error connecting to TACACS+ server");
+    TacacsReply reply;
+    reply.status = 0;
+    reply.flags = 0;
+    query->done(PhaseResult(query->phase, query->result), reply);
+}
+
+void TaccController::AuthenticateAsync(TacacsContext* tacCtx, TaccCallback done) {
+    LOG_F(MAX, "Authentication");
+    Status status;
+    if (AuthenticationShortcut(tacCtx, &status)) {
+        done(status);
+        return;
+    }
+    if (engine == NULL) {
+        done(Authenticate(tacCtx));
         return;
     }
 
-    LOG_F(MAX, "StartAccounting: Send the start accounting request to the server");
-    tac_acct_send(tac_fd, TAC_PLUS_ACCT_FLAG_START, tacCtx->getUsername(), TAC_FIELD_TTY, tacCtx->getRemoteAddr(), attr);
+    // Same PAP exchange as QueryAuthentication
+    std::shared_ptr<TaccAsyncQuery> query = std::make_shared<TaccAsyncQuery>("Authentication",
+            Phase(tacCtx, options.authen_timeout_ms));
+    query->ranked = servers->Rank();
+    query->request.type = TAC_PLUS_AUTHEN;
+    query->request.minor_version = TAC_PLUS_MINOR_VER_ONE;
+    query->request.body = TacacsAuthenStartBody(TAC_PLUS_AUTHEN_LOGIN, TAC_PLUS_AUTHEN_TYPE_PAP, tacCtx->username,
+            TAC_FIELD_TTY, tacCtx->remote_addr, tacCtx->password);
+    query->request.continue_body = TacacsAuthenContinueBody(tacCtx->password);
+    TaccClock::time_point start = query->start;
+    query->done = [this, tacCtx, done, start](int ret, const TacacsReply& reply) {
+        RecordPhase(tacCtx->metrics, METRICS_PHASE_AUTHEN, TaccClock::now() - start);
+        done(AuthenticationStatus(tacCtx, ret, reply));
+    };
+    RunAsyncQuery(query);
+}
 
-    struct areply arep;
-    LOG_F(MAX, "StartAccounting: Read the reply from the server");
-    int ret = tac_acct_read(tac_fd, &arep);
-    if (ret == 0) {
-        LOG_F(INFO, "Accounting: START failed: %s", arep.msg);
+void TaccController::AuthorizeAsync(TacacsContext* tacCtx, TaccCallback done) {
+    LOG_F(MAX, "Authorize");
+    Status status;
+    if (AuthorizationShortcut(tacCtx, &status)) {
+        done(status);
         return;
     }
+    if (engine == NULL) {
+        done(Authorize(tacCtx));
+        return;
+    }
+
+    std::vector<std::string> args;
+    args.push_back(Attribute(TAC_ATTR_SERVICE, TAC_ATTR_VALUE_SHELL));
+    args.push_back(Attribute(TAC_ATTR_CMD, tacCtx->method_name));
+
+    std::shared_ptr<TaccAsyncQuery> query = std::make_shared<TaccAsyncQuery>("Authorize",
+            Phase(tacCtx, options.author_timeout_ms));
+    query->ranked = servers->Rank();
+    query->request.type = TAC_PLUS_AUTHOR;
+    query->request.body = TacacsAuthorRequestBody(tacCtx->username, TAC_FIELD_TTY, tacCtx->remote_addr, args);
+    TaccClock::time_point start = query->start;
+    query->done = [this, tacCtx, done, start](int ret, const TacacsReply& reply) {
+        RecordPhase(tacCtx->metrics, METRICS_PHASE_AUTHOR, TaccClock::now() - start);
+        if (ret == 0) {
+            CacheAuthorization(*tacCtx, reply);
+        }
+        done(AuthorizationStatus(tacCtx, ret, reply));
+    };
+    RunAsyncQuery(query);
+}
+
+void TaccController::CollectMetrics(std::string* out) {
+    typedef std::vector<std::pair<const char*, std::string> > Labels;
+    static const char* families[][3] = {
+        { "tacacs_proxy_server_rtt_seconds", "gauge", "Moving average round trip time of the TACACS+ server" },
+        { "tacacs_proxy_server_breaker_state", "gauge", "Circuit breaker of the TACACS+ server, 0 closed, 1 open, 2 half open" },
+        { "tacacs_proxy_server_connects_total", "counter", "Connections opened to the TACACS+ server by the pool" },
+        { "tacacs_proxy_server_connect_failures_total", "counter", "Failed connection attempts to the TACACS+ server" },
+        { "tacacs_proxy_server_reuses_total", "counter", "Sessions run on a reused single-connect connection" },
+        { "tacacs_proxy_server_breaker_rejected_total", "counter", "Requests the open circuit breaker refused" },
+    };
+    for (int f = 0; f < 6; f++) {
+        MetricsFamily(out, families[f][0], families[f][1], families[f][2]);
+        for (size_t i = 0; i < servers->Size(); i++) {
+            TacacsServer* server = servers->Server(i);
+            TacacsConnectionPool* pool = server->pool.load(std::memory_order_acquire);
+            if (pool == NULL) {
+                continue;
+            }
+            double values[] = { pool->RttEstimate() / 1e6, (double)pool->breaker.GetState(), (double)pool->connects,
+                (double)pool->connectFailures, (double)pool->reuses, (double)pool->breaker.rejected };
+            MetricsSample(out, families[f][0], Labels(1, std::make_pair("server", server->address)), values[f]);
+        }
+    }
+
+    MetricsFamily(out, "tacacs_proxy_server_breaker_transitions_total", "counter",
+            "Circuit breaker state changes of the TACACS+ server, by new state");
+    const char* states[] = { "open", "half_open", "closed" };
+    for (size_t i = 0; i < servers->Size(); i++) {
+        TacacsServer* server = servers->Server(i);
+        TacacsConnectionPool* pool = server->pool.load(std::memory_order_acquire);
+        if (pool == NULL) {
+            continue;
+        }
+        unsigned long transitions[] = { pool->breaker.opens, pool->breaker.halfOpens, pool->breaker.closes };
+        for (int t = 0; t < 3; t++) {
+            Labels labels;
+            labels.push_back(std::make_pair("server", server->address));
+            labels.push_back(std::make_pair("to", states[t]));
+            MetricsSample(out, "tacacs_proxy_server_breaker_transitions_total", labels, transitions[t]);
+        }
+    }
 
-    LOG_F(INFO, "Accounting: START OK");
-    close(tac_fd);
-    tac_free_attrib(&attr);
+    if (engine != NULL) {
+        MetricsFamily(out, "tacacs_proxy_engine_sessions_total", "counter", "Sessions run on the TACACS+ engine");
+        const char* results[] = { "submitted", "completed", "failed", "timeout" };
+        unsigned long counts[] = { engine->submitted, engine->completed, engine->failed, engine->timeouts };
+        for (int i = 0; i < 4; i++) {
+            MetricsSample(out, "tacacs_proxy_engine_sessions_total", Labels(1, std::make_pair("result", results[i])),
+                    counts[i]);
+        }
+        MetricsFamily(out, "tacacs_proxy_engine_connects_total", "counter", "Connections opened by the TACACS+ engine");
+        MetricsSample(out, "tacacs_proxy_engine_connects_total", Labels(), engine->connects);
+    }
+
+    MetricsFamily(out, "tacacs_proxy_accounting_records_total", "counter", "Accounting records by outcome");
+    const char* outcomes[] = { "submitted", "sent", "failed", "dropped" };
+    unsigned long records[] = { accounting->submitted, accounting->sent, accounting->failed, accounting->dropped };
+    for (int i = 0; i < 4; i++) {
+        MetricsSample(out, "tacacs_proxy_accounting_records_total", Labels(1, std::make_pair("outcome", outcomes[i])),
+                records[i]);
+    }
+    MetricsFamily(out, "tacacs_proxy_accounting_queue_depth", "gauge", "Accounting records waiting to be sent");
+    MetricsSample(out, "tacacs_proxy_accounting_queue_depth", Labels(), accounting->QueueDepth());
+    if (spool != NULL) {
+        MetricsFamily(out, "tacacs_proxy_accounting_spool_pending", "gauge", "Accounting records waiting in the spool");
+        MetricsSample(out, "tacacs_proxy_accounting_spool_pending", Labels(), spool->pending);
+    }
+}
+
+void TaccController::FlushCaches() {
+    authCache.Flush();
+    authorCache.Flush();
+}
+
+// Runs on the accounting workers. Returns the accounting status of the
+// reply, -1 if no server could be reached.
+int TaccController::SendAccounting(const AccountingRecord& record) {
+    TaccClock::time_point start = TaccClock::now();
+    TaccClock::time_point deadline = start + std::chrono::milliseconds(options.acct_timeout_ms);
+    int ret = WithFailover("Accounting", TaccPhase(deadline, deadline), [this, &record, deadline](TacacsServer* server) {
+        return SendAccountingTo(server, record, deadline);
+    });
+    RecordPhase(record.metrics, METRICS_PHASE_ACCOUNTING, TaccClock::now() - start);
+    return (ret < 0) ? -1 : ret;
+}
+
+int TaccController::SendAccountingTo(TacacsServer* server, const AccountingRecord& record,
+        TaccClock::time_point deadline) {
+    const char* kind = (record.flags == TAC_PLUS_ACCT_FLAG_START) ? "START" : "STOP";
+
+    TacacsConnectionPool* pool = servers->GetPool(server);
+    if (pool == NULL) {
+        return -1;
+    }
+
+    TacacsSession session(pool, server->key.c_str(), TAC_PLUS_ACCT);
+    if (!session.Connect()) {
+        LOG_F(WARNING, "Error connecting to TACACS+ server %s", server->address.c_str());
+        return -1;
+    }
+
+    TacacsReply reply;
+    int ret = session.Send(TacacsAcctRequestBody(record.flags, record.username, TAC_FIELD_TTY, record.remote_addr,
+                record.args), &reply, RemainingMs(deadline));
+    if (ret < 0) {
+        LOG_F(WARNING, "Accounting: %s failed for task %d", kind, record.task_id);
+        return -1;
+    }
+    session.Finish();
+
+    if (reply.status != TAC_PLUS_ACCT_STATUS_SUCCESS) {
+        LOG_F(WARNING, "Accounting: %s failed for task %d: %s", kind, record.task_id, reply.server_msg.c_str());
+        return reply.status;
+    }
+
+    LOG_F(MAX, "Accounting: %s OK for task %d", kind, record.task_id);
+    return reply.status;
+}
+
+// Accounting pipeline sender. While the spool holds records, new ones are
+// spooled behind them so that the server still sees every task in order.
+int TaccController::DeliverAccounting(const AccountingRecord& record) {
+    if (spool != NULL && spool->Pending()) {
+        return spool->Append(record) ? 0 : -1;
+    }
+
+    int ret = SendAccounting(record);
+    if (ret < 0 && spool != NULL && spool->Append(record)) {
+        LOG_F(MAX, "Accounting: spooled record of task %d", record.task_id);
+        return 0;
+    }
+    return ret;
+}
+
+void TaccController::FlushAccounting() {
+    accounting->Stop();
+    if (spool != NULL) {
+        spool->Stop();
+    }
+}
+
+void TaccController::StartAccounting(TacacsContext* tacCtx, std::function<void(bool delivered)> done) {
+    LOG_F(MAX, "StartAccounting");
+    if(!IsTacacsEnabled()) {
+        LOG_F(INFO, "Bypassing Accounting as TACACS server is not available");
+        if (done) {
+            done(false);
+        }
+        return;
+    }
+
+    time_t t = time(0);
+    char buf[40];
+
+    tacCtx->task_id = TacacsRandom() & 0xffff;
+    tacCtx->start_time = t;
+
+    AccountingRecord* record = new AccountingRecord();
+    record->flags = TAC_PLUS_ACCT_FLAG_START;
+    record->task_id = tacCtx->task_id;
+    record->username = tacCtx->username;
+    record->remote_addr = tacCtx->remote_addr;
+    sprintf(buf, "%ld", (long)t);
+    record->args.push_back(Attribute(TAC_ATTR_START_TIME, buf));
+    sprintf(buf, "%hu", tacCtx->task_id);
+    record->args.push_back(Attribute(TAC_ATTR_TASK_ID, buf));
+    record->args.push_back(Attribute(TAC_ATTR_SERVICE, TAC_ATTR_VALUE_SHELL));
+    record->args.push_back(Attribute(TAC_ATTR_CMD, tacCtx->method_name));
+    record->done = done;
+    record->metrics = tacCtx->metrics;
+
+    LOG_F(MAX, "StartAccounting: Queue the start accounting request");
+    accounting->Submit(record);
 }
 
 void TaccController::StopAccounting(TacacsContext* tacCtx, string err_msg) {
@@ -274,53 +822,34 @@ void TaccController::StopAccounting(TacacsContext* tacCtx, string err_msg) {
         LOG_F(MAX, "Bypassing Accounting as TACACS server is not available");
         return;
     }
+    if (tacCtx->start_time == 0) {
+        LOG_F(MAX, "StopAccounting: No accounting was started for the call");
+        return;
+    }
 
-    struct tac_attrib *attr = NULL;
     time_t t = time(0);
-    struct tm tm;
     char buf[40];
 
-    gmtime_r(&t, &tm);
-    strftime(buf, sizeof(buf), "%s", &tm);
-    tac_add_attrib(&attr, TAC_ATTR_STOP_TIME, buf);
+    AccountingRecord* record = new AccountingRecord();
+    record->flags = TAC_PLUS_ACCT_FLAG_STOP;
+    record->task_id = tacCtx->task_id;
+    record->username = tacCtx->username;
+    record->remote_addr = tacCtx->remote_addr;
+    sprintf(buf, "%ld", (long)t);
+    record->args.push_back(Attribute(TAC_ATTR_STOP_TIME, buf));
     int elapsed_sec = t - tacCtx->start_time;
     sprintf(buf, "%hu", elapsed_sec);
-    tac_add_attrib(&attr, TAC_ATTR_ELAPSED_TIME, buf);
+    record->args.push_back(Attribute(TAC_ATTR_ELAPSED_TIME, buf));
     sprintf(buf, "%hu", tacCtx->task_id);
-    tac_add_attrib(&attr, TAC_ATTR_TASK_ID, buf);
+    record->args.push_back(Attribute(TAC_ATTR_TASK_ID, buf));
 
     if(err_msg != "no error") {
-        char c[err_msg.size() + 1];
-        strcpy(c, err_msg.c_str());
-        tac_add_attrib(&attr, TAC_ATTR_ERR_MSG, c);
+        record->args.push_back(Attribute(TAC_ATTR_ERR_MSG, err_msg));
         LOG_F(INFO, "StopAccounting: Sending error msg as %s", err_msg.c_str());
     }
 
-    if (ResolveServerAddress() == NULL) {
-        return;
-    }
-
-    LOG_F(MAX, "StopAccounting: Connect to the server");
-    tac_fd = tac_connect_single(resolved_server_address, secure_key, NULL, 60);
-    if (tac_fd < 0) {
-        tacCtx->tacacs_connect_failure = true;
-        LOG_F(WARNING, "Error connecting to TACACS+ server");
-        return;
-    }
-
-    LOG_F(MAX, "StopAccounting: Send the stop accounting request to the server");
-    tac_acct_send(tac_fd, TAC_PLUS_ACCT_FLAG_STOP, tacCtx->getUsername(), TAC_FIELD_TTY, tacCtx->getRemoteAddr(), attr);
-    struct areply arep;
-
-    LOG_F(MAX, "StopAccounting: Read the reply from the server");
-    int ret = tac_acct_read(tac_fd, &arep);
-    if (ret == 0) {
-        LOG_F(WARNING, "Accounting: STOP failed: %s", arep.msg);
-        return;
-    }
-
-    LOG_F(INFO, "Accounting: STOP OK");
-    close(tac_fd);
-    tac_free_attrib(&attr);
-}    
+    record->metrics = tacCtx->metrics;
 
+    LOG_F(MAX, "StopAccounting: Queue the stop accounting request");
+    accounting->Submit(record);
+}
@@ -11,31 +11,73 @@
  * limitations under the License.
  */
 
+#ifndef TACACS_CONTROLLER_H_
+#define TACACS_CONTROLLER_H_
+
 #include <iostream>
 #include <stdio.h>
 #include <syslog.h>
 #include <cstring>
 #include <ctime>
+#include <mutex>
 #include "grpcpp/grpcpp.h"
 
-extern "C" {
-#include "libtac/libtac.h"
-#include "libtac/tacplus.h"
-}
-
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include "tacacs_packet.h"
+#include "tacacs_connection_pool.h"
+#include "tacacs_session.h"
+#include "tacacs_server_group.h"
+#include "tacacs_engine.h"
+#include "auth_cache.h"
+#include "author_cache.h"
+#include "thread_pool.h"
+#include "accounting_pipeline.h"
+#include "accounting_spool.h"
+#include "metrics.h"
 
 using namespace std;
 using namespace grpc;
 
+typedef std::chrono::steady_clock TaccClock;
+
+// Authentication cache lookup done while extracting the credentials of a call
+enum CredentialsLookup {
+    CREDENTIALS_NOT_LOOKED_UP,
+    CREDENTIALS_MISS,
+    CREDENTIALS_CACHED_PASS,    // the password is not kept then
+    CREDENTIALS_CACHED_FAIL
+};
+
 class TacacsContext {
     public:
         std::string username;
         std::string password;
         std::string remote_addr;
         std::string method_name;
-        int task_id;
-        time_t start_time;
+        int task_id = 0;
+        time_t start_time = 0;
 	bool tacacs_connect_failure = false;	
+        // Deadline of the gRPC call, and the share of it the TACACS+ checks may use
+        TaccClock::time_point deadline = TaccClock::time_point::max();
+        TaccClock::time_point tacacs_deadline = TaccClock::time_point::max();
+        // Latency of the TACACS+ phases is recorded here when set
+        MethodMetrics* metrics = NULL;
+        // Authentication cache key and verdict, when the credentials were
+        // looked up as they were extracted
+        bool credentials_digested = false;
+        AuthCache::Digest credentials_digest;
+        CredentialsLookup credentials_lookup = CREDENTIALS_NOT_LOOKED_UP;
+        // Let through without a verdict of the server, because TACACS+ is
+        // unreachable and fallback pass is on
+        bool unverified_pass = false;
+        // Authenticated by a session token, which also carries the commands
+        // the user was authorized for
+        bool token_authenticated = false;
+        time_t token_expiry = 0;
+        std::vector<std::string> token_commands;
 
         char* getUsername() {
             return const_cast<char*>(username.c_str());
@@ -55,21 +97,141 @@ class TacacsContext {
 
 };
 
-class TaccController {
-    int tac_fd;
+// Connection pool and cache tunables
+struct TaccOptions {
+    const char* server_weights; // comma separated, one per server, NULL weighs all servers equally
+    int pool_warm_connections;
+    int pool_max_idle;
+    int pool_idle_timeout;      // seconds
+    int auth_cache_ttl;         // seconds, 0 disables caching of passed authentications
+    int auth_cache_negative_ttl;
+    int auth_cache_max_entries;
+    int author_cache_ttl;       // seconds, 0 disables caching of permitted commands
+    int author_cache_negative_ttl;
+    int author_cache_max_entries;
+    bool author_cache_refresh;  // refresh permitted commands in use before they expire
+    int accounting_workers;
+    int accounting_queue_size;
+    const char* accounting_spool_dir;   // NULL or empty disables spooling
+    int accounting_spool_max_mb;
+    int breaker_failures;       // consecutive failures opening the circuit breaker, 0 disables it
+    int breaker_latency_ms;     // slower replies count as failures, 0 disables
+    int breaker_open_sec;       // interval between probes while open
+    int engine_threads;         // I/O threads of the non-blocking TACACS+ engine, 0 disables it
+    int engine_connections;     // shared connections per server and I/O thread
+    int connect_timeout_ms;     // TCP connect to a TACACS+ server
+    int authen_timeout_ms;      // whole authentication phase, failover included
+    int author_timeout_ms;      // whole authorization phase, failover included
+    int acct_timeout_ms;        // delivery of one accounting record, failover included
+    int tacacs_budget_percent;  // share of the remaining call deadline the TACACS+ checks may use
+
+    TaccOptions() : server_weights(NULL), pool_warm_connections(2), pool_max_idle(8), pool_idle_timeout(60),
+        auth_cache_ttl(60), auth_cache_negative_ttl(5), auth_cache_max_entries(1024),
+        author_cache_ttl(300), author_cache_negative_ttl(30), author_cache_max_entries(4096),
+        author_cache_refresh(true), accounting_workers(2), accounting_queue_size(8192),
+        accounting_spool_dir(NULL), accounting_spool_max_mb(256),
+        breaker_failures(3), breaker_latency_ms(5000), breaker_open_sec(5),
+        engine_threads(2), engine_connections(2), connect_timeout_ms(5000), authen_timeout_ms(10000),
+        author_timeout_ms(10000), acct_timeout_ms(10000), tacacs_budget_percent(50) {}
+};
 
+// Time a TACACS+ phase may take: its configured timeout, possibly cut short
+// by the budget of the call
+struct TaccPhase {
+    TaccClock::time_point deadline;     // the call stops waiting for the servers
+    TaccClock::time_point timeout;      // the configured timeout of the phase ends
+
+    TaccPhase(TaccClock::time_point phase_deadline, TaccClock::time_point phase_timeout) :
+        deadline(phase_deadline), timeout(phase_timeout) {}
+    bool BudgetBound() const { return deadline < timeout; }
+};
+
+struct TaccAsyncQuery;
+
+// Completion of a non-blocking authentication or authorization
+typedef std::function<void(const Status&)> TaccCallback;
+
+class TaccController {
     const char* server_address;
-    const char* secure_key;
     bool fallback_pass;
-    struct addrinfo* resolved_server_address = NULL;
+
+    TaccOptions options;
+    AuthCache authCache;
+    AuthorCache authorCache;
+    ThreadPool* refreshPool;
+    AccountingPipeline* accounting;
+    AccountingSpool* spool;
+    TacacsServerGroup* servers;
+    TacacsEngine* engine;
+    int metricsCollector;
+
+    TacacsConnectionPool* NewConnectionPool(const struct addrinfo* tac_server, const char* name);
+    // A TACACS+ phase starting now: its own timeout, capped by the budget of the call
+    TaccPhase Phase(const TacacsContext* tacCtx, int timeout_ms);
+    // Runs query against the ranked servers until one of them answers or the deadline passes
+    int WithFailover(const char* what, const TaccPhase& phase, const std::function<int(TacacsServer*)>& query);
+    void RunAsyncQuery(std::shared_ptr<TaccAsyncQuery> query);
+    // Answer taken without asking the server: TACACS+ disabled or a cached result
+    bool AuthenticationShortcut(TacacsContext* tacCtx, Status* status);
+    bool AuthorizationShortcut(TacacsContext* tacCtx, Status* status);
+    // Maps the outcome of a query to the status of the call
+    Status AuthenticationStatus(TacacsContext* tacCtx, int ret, const TacacsReply& reply);
+    Status AuthorizationStatus(TacacsContext* tacCtx, int ret, const TacacsReply& reply);
+    void CacheAuthentication(const TacacsContext& tacCtx, bool passed);
+    void CacheAuthorization(const TacacsContext& tacCtx, const TacacsReply& reply);
+    // on_pass runs while the connection is still held, once the server accepted the credentials
+    int QueryAuthentication(TacacsServer* server, TacacsContext* tacCtx, TacacsReply* reply,
+            const TaccPhase& phase, const std::function<void(TacacsSession*)>& on_pass = nullptr);
+    // Continues on the connection of previous when given and possible
+    int QueryAuthorization(TacacsServer* server, TacacsContext* tacCtx, TacacsReply* reply,
+            const TaccPhase& phase, TacacsSession* previous = NULL);
+    int QueryAuthorization(TacacsContext* tacCtx, TacacsReply* reply);
+    void RefreshAuthorization(const TacacsContext& tacCtx);
+    int SendAccountingTo(TacacsServer* server, const AccountingRecord& record, TaccClock::time_point deadline);
+    int SendAccounting(const AccountingRecord& record);
+    int DeliverAccounting(const AccountingRecord& record);
+    // Appends the state of the servers, the engine and accounting to the proxy metrics
+    void CollectMetrics(std::string* out);
 
     public:
-    TaccController(const char* server_address, const char* secure_key, bool fallback_pass);
+    // server_address and secure_key may list several servers, see TacacsServerGroup
+    TaccController(const char* server_address, const char* secure_key, bool fallback_pass,
+            const TaccOptions& options = TaccOptions());
+    // Delivers or spools the queued accounting records, fails the sessions
+    // still on the engine and closes every connection
+    ~TaccController();
 
     bool IsTacacsEnabled();
-    struct addrinfo* ResolveServerAddress();
+    // Sets aside the configured share of the time left before the call
+    // deadline for the TACACS+ checks, the rest is left for the forwarded
+    // call. A check the budget cuts short fails with DEADLINE_EXCEEDED,
+    // never in fallback mode.
+    void AllotBudget(TacacsContext* tacCtx);
     Status Authenticate(TacacsContext* tacCtx);
     Status Authorize(TacacsContext* tacCtx);
-    void StartAccounting(TacacsContext* tacCtx);
+    // Both of the above, with the authorization session running right after
+    // the authentication session on the same connection
+    Status AuthenticateAndAuthorize(TacacsContext* tacCtx);
+    // Non-blocking variants running on the TACACS+ engine. done is called
+    // once, either inline or on an engine I/O thread, and tacCtx must stay
+    // valid until then. Without the engine they block like the above.
+    bool HasEngine() { return engine != NULL; }
+    void AuthenticateAsync(TacacsContext* tacCtx, TaccCallback done);
+    void AuthorizeAsync(TacacsContext* tacCtx, TaccCallback done);
+    // Accounting records are queued and sent in the background. done, when
+    // given, learns whether the START record was delivered or spooled.
+    void StartAccounting(TacacsContext* tacCtx, std::function<void(bool delivered)> done = nullptr);
     void StopAccounting(TacacsContext* tacCtx, string err_msg);
+    // Delivers or spools the queued accounting records and drops later
+    // ones, for a shutdown once the calls are done
+    void FlushAccounting();
+
+    // Drops every cached authentication and authorization result.
+    // Safe to call from a signal handler.
+    void FlushCaches();
+
+    // Looked up as credentials are extracted, see CredentialsLookup
+    AuthCache* CredentialsCache() { return &authCache; }
 };
+
+#endif
@@ -0,0 +1,728 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "tacacs_engine.h"
+#include "tacacs_session.h"
+#include "logger.h"
+
+#define ENGINE_MAX_EVENTS 64
+// Interval of the deadline and idle connection checks
+#define ENGINE_SWEEP_MS 100
+#define ENGINE_READ_CHUNK 4096
+// How long a server that refused single-connect gets a connection per
+// session before it is asked again
+#define ENGINE_REFUSAL_SEC 300
+
+typedef std::chrono::steady_clock Clock;
+
+struct EngineConnection;
+
+struct EngineSession {
+    TacacsEngineRequest* request;
+    TacacsServer* server;
+    TacacsConnectionPool* pool;
+    EngineConnection* conn;
+    uint32_t session_id;
+    uint8_t seq_no;             // sequence number of the last packet sent
+    bool continued;
+    bool abandoned;             // done was called, the session waits for its reply to drop it
+    Clock::time_point deadline;
+    Clock::time_point serverDeadline;
+    Clock::time_point sent;
+};
+
+struct EngineConnection {
+    enum State {
+        CONNECTING,
+        NEGOTIATING,            // first session on the wire, single-connect not settled
+        MULTIPLEX,
+        SINGLE                  // single-connect refused, closes after its session
+    };
+
+    int fd;
+    State state;
+    bool dedicated;             // opened for one session, does not ask for single-connect
+    TacacsServer* server;
+    TacacsConnectionPool* pool;
+    std::string out;
+    size_t outOffset;
+    std::string in;
+    bool writeArmed;
+    time_t idleSince;
+    // Sessions on the wire, by session id, and sessions held back until
+    // the server has settled single-connect mode
+    std::unordered_map<uint32_t, EngineSession*> sessions;
+    std::deque<EngineSession*> waiting;
+};
+
+// One epoll loop. Connections and sessions are only touched by the loop
+// thread; other threads hand sessions over through the inbox.
+class TacacsEngineThread {
+    TacacsEngine* engine;
+    int maxConnections;
+    int idleTimeoutSec;
+    int epfd;
+    int wakeFd;
+
+    std::mutex lock;
+    std::vector<EngineSession*> inbox;
+    bool stopping;
+
+    std::unordered_map<TacacsServer*, std::vector<EngineConnection*> > connections;
+    // Closed connections, freed once the current batch of events is handled
+    std::vector<EngineConnection*> closed;
+    std::thread thread;
+
+    void Loop();
+    void Dispatch(EngineSession* s);
+    EngineConnection* Open(TacacsServer* server, TacacsConnectionPool* pool);
+    void Start(EngineConnection* c, EngineSession* s);
+    void Write(EngineConnection* c, const TacacsHeader& hdr, const std::string& body, const std::string& key);
+    void Flush(EngineConnection* c);
+    void UpdateEvents(EngineConnection* c);
+    void OnConnected(EngineConnection* c);
+    void OnReadable(EngineConnection* c);
+    void OnPacket(EngineConnection* c, const TacacsHeader& hdr, std::string* body);
+    EngineSession* NextWaiting(EngineConnection* c);
+    void Complete(EngineSession* s, int result, const TacacsReply& reply);
+    void Abandon(EngineSession* s);
+    void Fail(EngineConnection* c, int result);
+    void Close(EngineConnection* c);
+    void Sweep();
+
+    public:
+    TacacsEngineThread(TacacsEngine* tacacs_engine, int max_connections, int idle_timeout_sec);
+    ~TacacsEngineThread();
+
+    void Post(EngineSession* s);
+};
+
+static TacacsReply NoReply() {
+    TacacsReply reply;
+    reply.status = 0;
+    reply.flags = 0;
+    return reply;
+}
+
+TacacsEngineThread::TacacsEngineThread(TacacsEngine* tacacs_engine, int max_connections, int idle_timeout_sec) :
+    engine(tacacs_engine), maxConnections(max_connections), idleTimeoutSec(idle_timeout_sec), stopping(false) {
+    if (maxConnections < 1) {
+        maxConnections = 1;
+    }
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, wakeFd, &ev);
+    thread = std::thread(&TacacsEngineThread::Loop, this);
+}
+
+TacacsEngineThread::~TacacsEngineThread() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    uint64_t one = 1;
+    ssize_t ret = write(wakeFd, &one, sizeof(one));
+    (void)ret;
+    thread.join();
+    close(wakeFd);
+    close(epfd);
+}
+
+void TacacsEngineThread::Post(EngineSession* s) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (!stopping) {
+            inbox.push_back(s);
+            s = NULL;
+        }
+    }
+    if (s != NULL) {
+        Complete(s, TACACS_ENGINE_CONNECT_ERROR, NoReply());
+        return;
+    }
+    uint64_t one = 1;
+    ssize_t ret = write(wakeFd, &one, sizeof(one));
+    (void)ret;
+}
+
+void TacacsEngineThread::Loop() {
+    struct epoll_event events[ENGINE_MAX_EVENTS];
+    Clock::time_point nextSweep = Clock::now() + std::chrono::milliseconds(ENGINE_SWEEP_MS);
+    std::vector<EngineSession*> posted;
+    bool stop = false;
+
+    while (!stop) {
+        int n = epoll_wait(epfd, events, ENGINE_MAX_EVENTS, ENGINE_SWEEP_MS);
+        for (int i = 0; i < n; i++) {
+            EngineConnection* c = (EngineConnection*)events[i].data.ptr;
+            if (c == NULL) {
+                uint64_t count;
+                ssize_t ret = read(wakeFd, &count, sizeof(count));
+                (void)ret;
+                continue;
+            }
+            if (c->fd < 0) {
+                continue;
+            }
+            if (c->state == EngineConnection::CONNECTING) {
+                OnConnected(c);
+                continue;
+            }
+            if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+                OnReadable(c);
+            }
+            if (c->fd >= 0 && (events[i].events & EPOLLOUT)) {
+                Flush(c);
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            posted.swap(inbox);
+            stop = stopping;
+        }
+        for (size_t i = 0; i < posted.size(); i++) {
+            if (stop) {
+                Complete(posted[i], TACACS_ENGINE_CONNECT_ERROR, NoReply());
+            } else {
+                Dispatch(posted[i]);
+            }
+        }
+        posted.clear();
+
+        Clock::time_point now = Clock::now();
+        if (now >= nextSweep) {
+            Sweep();
+            nextSweep = now + std::chrono::milliseconds(ENGINE_SWEEP_MS);
+        }
+
+        for (size_t i = 0; i < closed.size(); i++) {
+            delete closed[i];
+        }
+        closed.clear();
+    }
+
+    // Sessions still outstanding at shutdown fail over to nothing
+    std::vector<EngineConnection*> remaining;
+    for (std::unordered_map<TacacsServer*, std::vector<EngineConnection*> >::iterator it = connections.begin();
+            it != connections.end(); ++it) {
+        remaining.insert(remaining.end(), it->second.begin(), it->second.end());
+    }
+    for (size_t i = 0; i < remaining.size(); i++) {
+        Fail(remaining[i], TACACS_ENGINE_CONNECT_ERROR);
+    }
+    for (size_t i = 0; i < closed.size(); i++) {
+        delete closed[i];
+    }
+    closed.clear();
+}
+
+// Whether the server refused single-connect lately, to any I/O thread
+static bool Refused(TacacsServer* server) {
+    time_t refused = server->single_connect_refused;
+    return refused != 0 && time(0) - refused < ENGINE_REFUSAL_SEC;
+}
+
+// Picks the connection for a new session: an idle multiplexed connection,
+// else a new one while under the cap, else the least loaded one. Servers
+// refusing single-connect get a connection per session.
+void TacacsEngineThread::Dispatch(EngineSession* s) {
+    if (s->abandoned) {
+        Complete(s, TACACS_ENGINE_SEND_ERROR, NoReply());
+        return;
+    }
+    if (Refused(s->server)) {
+        EngineConnection* c = Open(s->server, s->pool);
+        if (c == NULL) {
+            LOG_F(WARNING, "Error connecting to TACACS+ server %s", s->server->address.c_str());
+            s->pool->breaker.RecordFailure();
+            Complete(s, TACACS_ENGINE_CONNECT_ERROR, NoReply());
+            return;
+        }
+        c->dedicated = true;
+        c->waiting.push_back(s);
+        return;
+    }
+
+    std::vector<EngineConnection*>& list = connections[s->server];
+    EngineConnection* best = NULL;
+    EngineConnection* pending = NULL;
+    int shared = 0;
+    for (size_t i = 0; i < list.size(); i++) {
+        EngineConnection* c = list[i];
+        if (c->state == EngineConnection::SINGLE || c->dedicated) {
+            continue;
+        }
+        shared++;
+        if (c->state == EngineConnection::MULTIPLEX) {
+            if (best == NULL || c->sessions.size() < best->sessions.size()) {
+                best = c;
+            }
+        } else if (pending == NULL || c->waiting.size() < pending->waiting.size()) {
+            pending = c;
+        }
+    }
+
+    if (best != NULL && best->sessions.empty()) {
+        Start(best, s);
+    } else if (shared < maxConnections || (best == NULL && pending == NULL)) {
+        EngineConnection* c = Open(s->server, s->pool);
+        if (c == NULL) {
+            LOG_F(WARNING, "Error connecting to TACACS+ server %s", s->server->address.c_str());
+            s->pool->breaker.RecordFailure();
+            Complete(s, TACACS_ENGINE_CONNECT_ERROR, NoReply());
+            return;
+        }
+        c->waiting.push_back(s);
+    } else if (best != NULL) {
+        Start(best, s);
+    } else {
+        pending->waiting.push_back(s);
+    }
+}
+
+EngineConnection* TacacsEngineThread::Open(TacacsServer* server, TacacsConnectionPool* pool) {
+    int fd = TacacsConnectNonBlocking(server->resolved);
+    if (fd < 0) {
+        return NULL;
+    }
+    engine->connects++;
+
+    EngineConnection* c = new EngineConnection();
+    c->fd = fd;
+    c->state = EngineConnection::CONNECTING;
+    c->dedicated = false;
+    c->server = server;
+    c->pool = pool;
+    c->outOffset = 0;
+    c->writeArmed = true;
+    c->idleSince = time(0);
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLOUT;
+    ev.data.ptr = c;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+    connections[server].push_back(c);
+    return c;
+}
+
+void TacacsEngineThread::OnConnected(EngineConnection* c) {
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if (getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err != 0) {
+        LOG_F(WARNING, "Error connecting to TACACS+ server %s: %s", c->server->address.c_str(), strerror(err));
+        c->pool->breaker.RecordFailure();
+        Fail(c, TACACS_ENGINE_CONNECT_ERROR);
+        return;
+    }
+    EngineSession* s = NextWaiting(c);
+    if (s == NULL) {
+        Close(c);
+        return;
+    }
+
+    // Only the first session goes out until the server answers whether it
+    // accepts single-connect mode
+    c->state = c->dedicated ? EngineConnection::SINGLE : EngineConnection::NEGOTIATING;
+    Start(c, s);
+    UpdateEvents(c);
+}
+
+void TacacsEngineThread::Start(EngineConnection* c, EngineSession* s) {
+    // Session ids must be unique on the connection, and zero is easily
+    // confused with an unset field in server logs
+    do {
+        s->session_id = TacacsRandom();
+    } while (s->session_id == 0 || c->sessions.count(s->session_id) != 0);
+    s->conn = c;
+    s->seq_no = 1;
+    s->sent = Clock::now();
+    c->sessions[s->session_id] = s;
+
+    TacacsHeader hdr;
+    hdr.version = TAC_PLUS_MAJOR_VER | s->request->minor_version;
+    hdr.type = s->request->type;
+    hdr.seq_no = 1;
+    hdr.flags = (c->state == EngineConnection::NEGOTIATING) ? TAC_PLUS_SINGLE_CONNECT_FLAG : 0;
+    hdr.session_id = s->session_id;
+    Write(c, hdr, s->request->body, s->server->key);
+}
+
+void TacacsEngineThread::Write(EngineConnection* c, const TacacsHeader& hdr, const std::string& body,
+        const std::string& key) {
+    c->out.append(TacacsEncodePacket(hdr, body, key));
+    Flush(c);
+}
+
+void TacacsEngineThread::Flush(EngineConnection* c) {
+    while (c->outOffset < c->out.size()) {
+        ssize_t n = send(c->fd, c->out.data() + c->outOffset, c->out.size() - c->outOffset, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            LOG_F(WARNING, "Error sending to TACACS+ server %s: %s", c->server->address.c_str(), strerror(errno));
+            c->pool->breaker.RecordFailure();
+            Fail(c, TACACS_ENGINE_SEND_ERROR);
+            return;
+        }
+        c->outOffset += n;
+    }
+    if (c->outOffset == c->out.size()) {
+        c->out.clear();
+        c->outOffset = 0;
+    }
+    UpdateEvents(c);
+}
+
+void TacacsEngineThread::UpdateEvents(EngineConnection* c) {
+    bool want = c->state == EngineConnection::CONNECTING || c->outOffset < c->out.size();
+    if (want != c->writeArmed) {
+        struct epoll_event ev;
+        ev.events = EPOLLIN | (want ? (uint32_t)EPOLLOUT : 0u);
+        ev.data.ptr = c;
+        epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+        c->writeArmed = want;
+    }
+}
+
+void TacacsEngineThread::OnReadable(EngineConnection* c) {
+    char buf[ENGINE_READ_CHUNK];
+    bool eof = false;
+    while (true) {
+        ssize_t n = recv(c->fd, buf, sizeof(buf), 0);
+        if (n > 0) {
+            c->in.append(buf, n);
+            if (n < (ssize_t)sizeof(buf)) {
+                break;
+            }
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else {
+            eof = true;
+            break;
+        }
+    }
+
+    size_t offset = 0;
+    while (c->fd >= 0 && c->in.size() - offset >= TAC_PLUS_HDR_SIZE) {
+        TacacsHeader hdr;
+        TacacsDecodeHeader((const unsigned char*)c->in.data() + offset, &hdr);
+        if ((hdr.version & 0xf0) != TAC_PLUS_MAJOR_VER || hdr.length > TAC_PLUS_MAX_BODY_SIZE) {
+            LOG_F(WARNING, "Malformed packet from TACACS+ server %s", c->server->address.c_str());
+            c->pool->breaker.RecordFailure();
+            Fail(c, TACACS_ENGINE_SEND_ERROR);
+            return;
+        }
+        if (c->in.size() - offset - TAC_PLUS_HDR_SIZE < hdr.length) {
+            break;
+        }
+        std::string body = c->in.substr(offset + TAC_PLUS_HDR_SIZE, hdr.length);
+        offset += TAC_PLUS_HDR_SIZE + hdr.length;
+        OnPacket(c, hdr, &body);
+    }
+    if (c->fd < 0) {
+        return;
+    }
+    c->in.erase(0, offset);
+
+    if (eof) {
+        if (c->sessions.empty() && c->waiting.empty()) {
+            Close(c);
+        } else {
+            LOG_F(WARNING, "TACACS+ server %s closed the connection", c->server->address.c_str());
+            c->pool->breaker.RecordFailure();
+            Fail(c, TACACS_ENGINE_SEND_ERROR);
+        }
+    }
+}
+
+void TacacsEngineThread::OnPacket(EngineConnection* c, const TacacsHeader& hdr, std::string* body) {
+    std::unordered_map<uint32_t, EngineSession*>::iterator it = c->sessions.find(hdr.session_id);
+    if (it == c->sessions.end()) {
+        LOG_F(MAX, "Dropping reply to unknown TACACS+ session %08x", hdr.session_id);
+        return;
+    }
+    EngineSession* s = it->second;
+    TacacsEngineRequest* request = s->request;
+
+    TacacsReply reply = NoReply();
+    // With a key set, a cleartext reply is a forgery whatever it says
+    bool valid = hdr.type == request->type && hdr.seq_no == s->seq_no + 1 &&
+        (s->server->key.empty() || !(hdr.flags & TAC_PLUS_UNENCRYPTED_FLAG));
+    if (valid) {
+        if (!s->server->key.empty()) {
+            TacacsCrypt(hdr, s->server->key, body);
+        }
+        valid = TacacsParseReply(request->type, *body, &reply);
+    }
+    if (!valid) {
+        LOG_F(WARNING, "Invalid reply in TACACS+ session %08x: type %d, seq_no %d, flags %02x", s->session_id,
+                hdr.type, hdr.seq_no, hdr.flags);
+        c->sessions.erase(it);
+        s->pool->breaker.RecordFailure();
+        Complete(s, TACACS_ENGINE_SEND_ERROR, reply);
+        if (c->state == EngineConnection::NEGOTIATING) {
+            // Single-connect is still unsettled, the held back sessions
+            // start over on other connections
+            std::deque<EngineSession*> redispatch;
+            redispatch.swap(c->waiting);
+            Close(c);
+            for (size_t i = 0; i < redispatch.size(); i++) {
+                Dispatch(redispatch[i]);
+            }
+        } else if (c->state == EngineConnection::SINGLE && c->sessions.empty()) {
+            Close(c);
+        }
+        return;
+    }
+    reply.flags = hdr.flags;
+    s->seq_no = hdr.seq_no;
+
+    long rtt_us = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - s->sent).count();
+    s->pool->breaker.RecordSuccess(rtt_us / 1000);
+    s->pool->RecordRtt(rtt_us);
+
+    // Sessions held back on a refusing server each get their own connection
+    std::deque<EngineSession*> redispatch;
+    bool accepted = false;
+    if (c->state == EngineConnection::NEGOTIATING && hdr.seq_no == 2) {
+        if (hdr.flags & TAC_PLUS_SINGLE_CONNECT_FLAG) {
+            c->state = EngineConnection::MULTIPLEX;
+            accepted = true;
+        } else {
+            LOG_F(INFO, "TACACS+ server %s refused single-connect", c->server->address.c_str());
+            c->state = EngineConnection::SINGLE;
+            c->server->single_connect_refused = time(0);
+            redispatch.swap(c->waiting);
+        }
+    }
+
+    if (request->type == TAC_PLUS_AUTHEN && reply.status == TAC_PLUS_AUTHEN_STATUS_GETPASS && !s->continued &&
+            !s->abandoned && !request->continue_body.empty()) {
+        s->continued = true;
+        TacacsHeader next;
+        next.version = hdr.version;
+        next.type = request->type;
+        next.seq_no = s->seq_no + 1;
+        next.flags = 0;
+        next.session_id = s->session_id;
+        s->seq_no = next.seq_no;
+        s->sent = Clock::now();
+        // A send error fails the connection, this session included
+        Write(c, next, request->continue_body, s->server->key);
+    } else {
+        c->sessions.erase(it);
+        Complete(s, 0, reply);
+        if (c->sessions.empty()) {
+            c->idleSince = time(0);
+            if (c->state == EngineConnection::SINGLE) {
+                Close(c);
+            }
+        }
+    }
+
+    // The held back sessions only go out once this one is settled: a send
+    // error on any of them fails the connection and everything on it
+    while (accepted && c->fd >= 0) {
+        EngineSession* next = NextWaiting(c);
+        if (next == NULL) {
+            break;
+        }
+        Start(c, next);
+    }
+
+    for (size_t i = 0; i < redispatch.size(); i++) {
+        Dispatch(redispatch[i]);
+    }
+}
+
+// Next held back session to start, abandoned ones are dropped on the way
+EngineSession* TacacsEngineThread::NextWaiting(EngineConnection* c) {
+    while (!c->waiting.empty()) {
+        EngineSession* s = c->waiting.front();
+        c->waiting.pop_front();
+        if (!s->abandoned) {
+            return s;
+        }
+        Complete(s, TACACS_ENGINE_SEND_ERROR, NoReply());
+    }
+    return NULL;
+}
+
+// Abandoned sessions were reported already and go quietly
+void TacacsEngineThread::Complete(EngineSession* s, int result, const TacacsReply& reply) {
+    if (!s->abandoned) {
+        if (result == 0) {
+            engine->completed++;
+        } else {
+            engine->failed++;
+        }
+        s->request->done(result, reply);
+    }
+    delete s->request;
+    delete s;
+}
+
+// Fails a session its caller gave up on. It stays on its connection, so
+// that the server still answers within its own timeout, and the reply is
+// dropped once it comes.
+void TacacsEngineThread::Abandon(EngineSession* s) {
+    engine->timeouts++;
+    engine->failed++;
+    s->abandoned = true;
+    s->request->done(TACACS_ENGINE_SEND_ERROR, NoReply());
+    s->request->done = nullptr;
+}
+
+// Fails every session of the connection and closes it. Sessions that never
+// reached the server report a connect error.
+void TacacsEngineThread::Fail(EngineConnection* c, int result) {
+    std::vector<std::pair<EngineSession*, int> > failed;
+    for (std::unordered_map<uint32_t, EngineSession*>::iterator it = c->sessions.begin(); it != c->sessions.end(); ++it) {
+        failed.push_back(std::make_pair(it->second, result));
+    }
+    for (size_t i = 0; i < c->waiting.size(); i++) {
+        failed.push_back(std::make_pair(c->waiting[i], (int)TACACS_ENGINE_CONNECT_ERROR));
+    }
+    c->sessions.clear();
+    c->waiting.clear();
+    Close(c);
+
+    for (size_t i = 0; i < failed.size(); i++) {
+        Complete(failed[i].first, failed[i].second, NoReply());
+    }
+}
+
+void TacacsEngineThread::Close(EngineConnection* c) {
+    epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    c->fd = -1;
+    std::vector<EngineConnection*>& list = connections[c->server];
+    list.erase(std::remove(list.begin(), list.end(), c), list.end());
+    closed.push_back(c);
+}
+
+// A session past its deadline fails on its own, the caller may have cut it
+// short. One past the server timeout takes its connection down with it: the
+// server is stuck or the reply stream can no longer be trusted.
+void TacacsEngineThread::Sweep() {
+    Clock::time_point now = Clock::now();
+    time_t wall = time(0);
+    std::vector<EngineSession*> late;
+    std::vector<EngineConnection*> expired;
+    std::vector<EngineConnection*> idle;
+
+    for (std::unordered_map<TacacsServer*, std::vector<EngineConnection*> >::iterator it = connections.begin();
+            it != connections.end(); ++it) {
+        for (size_t i = 0; i < it->second.size(); i++) {
+            EngineConnection* c = it->second[i];
+            std::vector<EngineSession*> all;
+            for (std::unordered_map<uint32_t, EngineSession*>::iterator s = c->sessions.begin();
+                    s != c->sessions.end(); ++s) {
+                all.push_back(s->second);
+            }
+            all.insert(all.end(), c->waiting.begin(), c->waiting.end());
+            bool stuck = false;
+            for (size_t j = 0; j < all.size(); j++) {
+                if (!all[j]->abandoned && now >= all[j]->deadline) {
+                    late.push_back(all[j]);
+                }
+                stuck = stuck || now >= all[j]->serverDeadline;
+            }
+            if (stuck) {
+                expired.push_back(c);
+            } else if (c->state == EngineConnection::MULTIPLEX && c->sessions.empty() &&
+                    wall - c->idleSince > idleTimeoutSec) {
+                idle.push_back(c);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < late.size(); i++) {
+        Abandon(late[i]);
+    }
+    for (size_t i = 0; i < expired.size(); i++) {
+        EngineConnection* c = expired[i];
+        LOG_F(WARNING, "TACACS+ server %s did not answer in time", c->server->address.c_str());
+        c->pool->breaker.RecordFailure();
+        Fail(c, (c->state == EngineConnection::CONNECTING) ? TACACS_ENGINE_CONNECT_ERROR : TACACS_ENGINE_SEND_ERROR);
+    }
+    for (size_t i = 0; i < idle.size(); i++) {
+        Close(idle[i]);
+    }
+}
+
+TacacsEngine::TacacsEngine(int io_threads, int connections_per_server, int idle_timeout_sec) :
+    nextThread(0), stopping(false), submitted(0), completed(0), failed(0), timeouts(0), connects(0) {
+    if (io_threads < 1) {
+        io_threads = 1;
+    }
+    for (int i = 0; i < io_threads; i++) {
+        threads.push_back(new TacacsEngineThread(this, connections_per_server, idle_timeout_sec));
+    }
+    LOG_F(INFO, "TACACS+ engine started with %d I/O threads", io_threads);
+}
+
+TacacsEngine::~TacacsEngine() {
+    stopping = true;
+    for (size_t i = 0; i < threads.size(); i++) {
+        delete threads[i];
+    }
+}
+
+void TacacsEngine::Submit(TacacsServer* server, TacacsConnectionPool* pool, TacacsEngineRequest* request) {
+    submitted++;
+    if (stopping || !pool->breaker.Allow()) {
+        failed++;
+        request->done(TACACS_ENGINE_CONNECT_ERROR, NoReply());
+        delete request;
+        return;
+    }
+
+    EngineSession* s = new EngineSession();
+    s->request = request;
+    s->server = server;
+    s->pool = pool;
+    s->conn = NULL;
+    s->session_id = 0;
+    s->seq_no = 0;
+    s->continued = false;
+    s->abandoned = false;
+    Clock::time_point now = Clock::now();
+    s->deadline = now + std::chrono::milliseconds(request->timeout_ms);
+    s->serverDeadline = now + std::chrono::milliseconds(std::max(request->timeout_ms, request->server_timeout_ms));
+    threads[nextThread++ % threads.size()]->Post(s);
+}
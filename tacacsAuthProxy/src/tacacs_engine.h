@@ -0,0 +1,87 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TACACS_ENGINE_H_
+#define TACACS_ENGINE_H_
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "tacacs_packet.h"
+#include "tacacs_connection_pool.h"
+#include "tacacs_server_group.h"
+
+// Results passed to TacacsEngineRequest::done besides 0, reply received
+#define TACACS_ENGINE_CONNECT_ERROR -1
+#define TACACS_ENGINE_SEND_ERROR -2
+
+// One TACACS+ session to run on the engine
+struct TacacsEngineRequest {
+    uint8_t type;
+    uint8_t minor_version;
+    std::string body;           // START or REQUEST body of the first packet
+    std::string continue_body;  // answer to a GETPASS prompt, authentication only
+    int timeout_ms;             // the caller gives up on the reply after it
+    int server_timeout_ms;      // the server counts as stuck after it, never before timeout_ms
+    // Runs on an I/O thread and must not block
+    std::function<void(int result, const TacacsReply& reply)> done;
+
+    TacacsEngineRequest() : type(0), minor_version(TAC_PLUS_MINOR_VER_DEFAULT), timeout_ms(0),
+        server_timeout_ms(0) {}
+};
+
+class TacacsEngineThread;
+
+// Non-blocking TACACS+ client.
+//
+// A fixed set of I/O threads, each running an epoll loop, drive per-session
+// state machines. Once a server accepts single-connect mode on a connection,
+// further sessions are written to it without waiting for earlier replies and
+// replies are matched back by session id, so a couple of sockets per server
+// carry any number of outstanding sessions. Servers that refuse
+// single-connect get one connection per session instead. No thread ever
+// waits on a round trip.
+//
+// The server's circuit breaker and RTT estimate are fed like on the blocking
+// path, the connections themselves are separate from its pool. A session
+// whose caller gave up only fails itself; its reply is dropped when it
+// comes. Only a server that lets a session run past server_timeout_ms
+// loses the connection and counts as failing.
+class TacacsEngine {
+    std::vector<TacacsEngineThread*> threads;
+    std::atomic<unsigned> nextThread;
+    std::atomic<bool> stopping;
+
+    public:
+    std::atomic<unsigned long> submitted;
+    std::atomic<unsigned long> completed;
+    std::atomic<unsigned long> failed;
+    std::atomic<unsigned long> timeouts;
+    std::atomic<unsigned long> connects;
+
+    // connections_per_server caps the shared connections each I/O thread
+    // keeps to one server, idle ones close after idle_timeout_sec
+    TacacsEngine(int io_threads, int connections_per_server, int idle_timeout_sec);
+    // Outstanding sessions fail with a connect error, as do sessions their
+    // callbacks submit meanwhile
+    ~TacacsEngine();
+
+    // Takes ownership of the request and starts its session on the server.
+    // done is called exactly once, on the caller's thread if the server's
+    // circuit breaker rejects the request or the engine is stopping.
+    void Submit(TacacsServer* server, TacacsConnectionPool* pool, TacacsEngineRequest* request);
+};
+
+#endif
@@ -0,0 +1,375 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <chrono>
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <openssl/md5.h>
+
+#include "tacacs_packet.h"
+
+static void PutShort(std::string* out, uint16_t value) {
+    out->push_back((char)((value >> 8) & 0xff));
+    out->push_back((char)(value & 0xff));
+}
+
+static uint16_t GetShort(const std::string& in, size_t pos) {
+    return (uint16_t)(((uint8_t)in[pos] << 8) | (uint8_t)in[pos + 1]);
+}
+
+static std::string Truncate(const std::string& field) {
+    return field.size() > 255 ? field.substr(0, 255) : field;
+}
+
+std::string TacacsAuthenStartBody(uint8_t action, uint8_t authen_type, const std::string& user,
+        const std::string& port, const std::string& rem_addr, const std::string& data) {
+    std::string u = Truncate(user), p = Truncate(port), r = Truncate(rem_addr), d = Truncate(data);
+    std::string body;
+    body.reserve(8 + u.size() + p.size() + r.size() + d.size());
+    body.push_back((char)action);
+    body.push_back((char)TAC_PLUS_PRIV_LVL_MIN);
+    body.push_back((char)authen_type);
+    body.push_back((char)TAC_PLUS_AUTHEN_SVC_LOGIN);
+    body.push_back((char)u.size());
+    body.push_back((char)p.size());
+    body.push_back((char)r.size());
+    body.push_back((char)d.size());
+    body += u;
+    body += p;
+    body += r;
+    body += d;
+    return body;
+}
+
+std::string TacacsAuthenContinueBody(const std::string& user_msg) {
+    std::string body;
+    PutShort(&body, (uint16_t)user_msg.size());
+    PutShort(&body, 0);
+    body.push_back(0);
+    body += user_msg;
+    return body;
+}
+
+// Common layout of authorization and accounting requests, after the optional accounting flags
+static void AppendArgsRequest(std::string* body, const std::string& user, const std::string& port,
+        const std::string& rem_addr, const std::vector<std::string>& args) {
+    std::string u = Truncate(user), p = Truncate(port), r = Truncate(rem_addr);
+    size_t arg_cnt = args.size() > 255 ? 255 : args.size();
+
+    body->push_back((char)TAC_PLUS_AUTHEN_METH_TACACSPLUS);
+    body->push_back((char)TAC_PLUS_PRIV_LVL_MIN);
+    body->push_back((char)TAC_PLUS_AUTHEN_TYPE_ASCII);
+    body->push_back((char)TAC_PLUS_AUTHEN_SVC_LOGIN);
+    body->push_back((char)u.size());
+    body->push_back((char)p.size());
+    body->push_back((char)r.size());
+    body->push_back((char)arg_cnt);
+    for (size_t i = 0; i < arg_cnt; i++) {
+        body->push_back((char)Truncate(args[i]).size());
+    }
+    *body += u;
+    *body += p;
+    *body += r;
+    for (size_t i = 0; i < arg_cnt; i++) {
+        *body += Truncate(args[i]);
+    }
+}
+
+std::string TacacsAuthorRequestBody(const std::string& user, const std::string& port,
+        const std::string& rem_addr, const std::vector<std::string>& args) {
+    std::string body;
+    AppendArgsRequest(&body, user, port, rem_addr, args);
+    return body;
+}
+
+std::string TacacsAcctRequestBody(uint8_t acct_flags, const std::string& user, const std::string& port,
+        const std::string& rem_addr, const std::vector<std::string>& args) {
+    std::string body;
+    body.push_back((char)acct_flags);
+    AppendArgsRequest(&body, user, port, rem_addr, args);
+    return body;
+}
+
+bool TacacsParseAuthenReply(const std::string& body, TacacsReply* reply) {
+    if (body.size() < 6) {
+        return false;
+    }
+    size_t msg_len = GetShort(body, 2);
+    size_t data_len = GetShort(body, 4);
+    if (6 + msg_len + data_len > body.size()) {
+        return false;
+    }
+    reply->status = (uint8_t)body[0];
+    reply->server_msg = body.substr(6, msg_len);
+    reply->data = body.substr(6 + msg_len, data_len);
+    reply->args.clear();
+    return true;
+}
+
+bool TacacsParseAuthorResponse(const std::string& body, TacacsReply* reply) {
+    if (body.size() < 6) {
+        return false;
+    }
+    size_t arg_cnt = (uint8_t)body[1];
+    size_t msg_len = GetShort(body, 2);
+    size_t data_len = GetShort(body, 4);
+    size_t pos = 6 + arg_cnt;
+    if (pos > body.size()) {
+        return false;
+    }
+    size_t args_len = 0;
+    for (size_t i = 0; i < arg_cnt; i++) {
+        args_len += (uint8_t)body[6 + i];
+    }
+    if (pos + msg_len + data_len + args_len > body.size()) {
+        return false;
+    }
+    reply->status = (uint8_t)body[0];
+    reply->server_msg = body.substr(pos, msg_len);
+    pos += msg_len;
+    reply->data = body.substr(pos, data_len);
+    pos += data_len;
+    reply->args.clear();
+    for (size_t i = 0; i < arg_cnt; i++) {
+        size_t len = (uint8_t)body[6 + i];
+        reply->args.push_back(body.substr(pos, len));
+        pos += len;
+    }
+    return true;
+}
+
+bool TacacsParseAcctReply(const std::string& body, TacacsReply* reply) {
+    if (body.size() < 5) {
+        return false;
+    }
+    size_t msg_len = GetShort(body, 0);
+    size_t data_len = GetShort(body, 2);
+    if (5 + msg_len + data_len > body.size()) {
+        return false;
+    }
+    reply->status = (uint8_t)body[4];
+    reply->server_msg = body.substr(5, msg_len);
+    reply->data = body.substr(5 + msg_len, data_len);
+    reply->args.clear();
+    return true;
+}
+
+bool TacacsParseReply(uint8_t type, const std::string& body, TacacsReply* reply) {
+    if (type == TAC_PLUS_AUTHEN) {
+        return TacacsParseAuthenReply(body, reply);
+    } else if (type == TAC_PLUS_AUTHOR) {
+        return TacacsParseAuthorResponse(body, reply);
+    } else {
+        return TacacsParseAcctReply(body, reply);
+    }
+}
+
+void TacacsCrypt(const TacacsHeader& hdr, const std::string& key, std::string* body) {
+    // Pad input is session_id, key, version, seq_no and, after the first
+    // block, the previous MD5 digest
+    std::string input;
+    input.reserve(6 + key.size() + MD5_DIGEST_LENGTH);
+    uint32_t session_id = htonl(hdr.session_id);
+    input.append((const char*)&session_id, 4);
+    input += key;
+    input.push_back((char)hdr.version);
+    input.push_back((char)hdr.seq_no);
+    size_t prefix_len = input.size();
+
+    unsigned char pad[MD5_DIGEST_LENGTH];
+    for (size_t pos = 0; pos < body->size(); pos += MD5_DIGEST_LENGTH) {
+        if (pos > 0) {
+            input.resize(prefix_len);
+            input.append((const char*)pad, MD5_DIGEST_LENGTH);
+        }
+        MD5((const unsigned char*)input.data(), input.size(), pad);
+        for (size_t i = 0; i < MD5_DIGEST_LENGTH && pos + i < body->size(); i++) {
+            (*body)[pos + i] ^= pad[i];
+        }
+    }
+}
+
+std::string TacacsEncodePacket(TacacsHeader hdr, std::string body, const std::string& key) {
+    hdr.length = body.size();
+    if (key.empty()) {
+        hdr.flags |= TAC_PLUS_UNENCRYPTED_FLAG;
+    } else {
+        hdr.flags &= ~TAC_PLUS_UNENCRYPTED_FLAG;
+        TacacsCrypt(hdr, key, &body);
+    }
+
+    std::string packet;
+    packet.reserve(TAC_PLUS_HDR_SIZE + body.size());
+    packet.push_back((char)hdr.version);
+    packet.push_back((char)hdr.type);
+    packet.push_back((char)hdr.seq_no);
+    packet.push_back((char)hdr.flags);
+    uint32_t session_id = htonl(hdr.session_id);
+    uint32_t length = htonl(hdr.length);
+    packet.append((const char*)&session_id, 4);
+    packet.append((const char*)&length, 4);
+    packet += body;
+    return packet;
+}
+
+void TacacsDecodeHeader(const unsigned char* buf, TacacsHeader* hdr) {
+    uint32_t session_id, length;
+    hdr->version = buf[0];
+    hdr->type = buf[1];
+    hdr->seq_no = buf[2];
+    hdr->flags = buf[3];
+    memcpy(&session_id, buf + 4, 4);
+    memcpy(&length, buf + 8, 4);
+    hdr->session_id = ntohl(session_id);
+    hdr->length = ntohl(length);
+}
+
+// Rounded up, a wait must not end before the deadline
+static int RemainingMs(std::chrono::steady_clock::time_point deadline) {
+    long long us = std::chrono::duration_cast<std::chrono::microseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+    return us > 0 ? (int)((us + 999) / 1000) : 0;
+}
+
+static int WaitFd(int fd, short events, std::chrono::steady_clock::time_point deadline) {
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = events;
+    pfd.revents = 0;
+    int ret;
+    do {
+        ret = poll(&pfd, 1, RemainingMs(deadline));
+    } while (ret < 0 && errno == EINTR);
+    return ret > 0 ? 0 : -1;
+}
+
+int TacacsConnect(const struct addrinfo* server, int timeout_ms) {
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+
+    for (const struct addrinfo* ai = server; ai != NULL; ai = ai->ai_next) {
+        int fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        int flags = fcntl(fd, F_GETFL, 0);
+        fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+
+        int ret = connect(fd, ai->ai_addr, ai->ai_addrlen);
+        if (ret < 0 && errno == EINPROGRESS && WaitFd(fd, POLLOUT, deadline) == 0) {
+            int err = 0;
+            socklen_t len = sizeof(err);
+            getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len);
+            ret = (err == 0) ? 0 : -1;
+        }
+        if (ret == 0) {
+            int one = 1;
+            fcntl(fd, F_SETFL, flags);
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            return fd;
+        }
+        close(fd);
+    }
+    return -1;
+}
+
+int TacacsConnectNonBlocking(const struct addrinfo* server) {
+    for (const struct addrinfo* ai = server; ai != NULL; ai = ai->ai_next) {
+        int fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        int flags = fcntl(fd, F_GETFL, 0);
+        fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+
+        int ret = connect(fd, ai->ai_addr, ai->ai_addrlen);
+        if (ret == 0 || errno == EINPROGRESS) {
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            return fd;
+        }
+        close(fd);
+    }
+    return -1;
+}
+
+int TacacsWriteAll(int fd, const std::string& data, int timeout_ms) {
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    size_t sent = 0;
+    while (sent < data.size()) {
+        if (WaitFd(fd, POLLOUT, deadline) < 0) {
+            return -1;
+        }
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+            return -1;
+        }
+        sent += n;
+    }
+    return 0;
+}
+
+static int ReadExact(int fd, char* buf, size_t len, std::chrono::steady_clock::time_point deadline) {
+    size_t got = 0;
+    while (got < len) {
+        if (WaitFd(fd, POLLIN, deadline) < 0) {
+            return -1;
+        }
+        ssize_t n = recv(fd, buf + got, len - got, 0);
+        if (n == 0) {
+            return -1;
+        }
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+            return -1;
+        }
+        got += n;
+    }
+    return 0;
+}
+
+int TacacsReadPacket(int fd, TacacsHeader* hdr, std::string* body, const std::string& key, int timeout_ms) {
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    unsigned char buf[TAC_PLUS_HDR_SIZE];
+    if (ReadExact(fd, (char*)buf, TAC_PLUS_HDR_SIZE, deadline) < 0) {
+        return -1;
+    }
+    TacacsDecodeHeader(buf, hdr);
+    if ((hdr->version & 0xf0) != TAC_PLUS_MAJOR_VER || hdr->length > TAC_PLUS_MAX_BODY_SIZE) {
+        return -1;
+    }
+
+    body->resize(hdr->length);
+    if (hdr->length > 0 && ReadExact(fd, &(*body)[0], hdr->length, deadline) < 0) {
+        return -1;
+    }
+    if (!key.empty()) {
+        // With a shared key a cleartext packet can only be a forgery
+        if (hdr->flags & TAC_PLUS_UNENCRYPTED_FLAG) {
+            return -1;
+        }
+        TacacsCrypt(*hdr, key, body);
+    }
+    return 0;
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TACACS_PACKET_H_
+#define TACACS_PACKET_H_
+
+#include <stdint.h>
+#include <netdb.h>
+#include <string>
+#include <vector>
+
+// TACACS+ wire format (RFC 8907): packet framing, body encoding and the MD5
+// pseudo-pad obfuscation. Kept free of any connection or session state.
+
+#define TAC_PLUS_HDR_SIZE 12
+#define TAC_PLUS_MAX_BODY_SIZE 65536
+
+enum {
+    TAC_PLUS_MAJOR_VER = 0xc0,
+    TAC_PLUS_MINOR_VER_DEFAULT = 0x00,
+    TAC_PLUS_MINOR_VER_ONE = 0x01
+};
+
+enum {
+    TAC_PLUS_AUTHEN = 0x01,
+    TAC_PLUS_AUTHOR = 0x02,
+    TAC_PLUS_ACCT = 0x03
+};
+
+enum {
+    TAC_PLUS_UNENCRYPTED_FLAG = 0x01,
+    TAC_PLUS_SINGLE_CONNECT_FLAG = 0x04
+};
+
+enum {
+    TAC_PLUS_AUTHEN_LOGIN = 0x01,
+    TAC_PLUS_AUTHEN_TYPE_ASCII = 0x01,
+    TAC_PLUS_AUTHEN_TYPE_PAP = 0x02,
+    TAC_PLUS_AUTHEN_SVC_LOGIN = 0x01,
+    TAC_PLUS_AUTHEN_METH_TACACSPLUS = 0x06,
+    TAC_PLUS_PRIV_LVL_MIN = 0x00
+};
+
+enum {
+    TAC_PLUS_AUTHEN_STATUS_PASS = 0x01,
+    TAC_PLUS_AUTHEN_STATUS_FAIL = 0x02,
+    TAC_PLUS_AUTHEN_STATUS_GETDATA = 0x03,
+    TAC_PLUS_AUTHEN_STATUS_GETUSER = 0x04,
+    TAC_PLUS_AUTHEN_STATUS_GETPASS = 0x05,
+    TAC_PLUS_AUTHEN_STATUS_RESTART = 0x06,
+    TAC_PLUS_AUTHEN_STATUS_ERROR = 0x07,
+    TAC_PLUS_AUTHEN_STATUS_FOLLOW = 0x21
+};
+
+enum {
+    TAC_PLUS_AUTHOR_STATUS_PASS_ADD = 0x01,
+    TAC_PLUS_AUTHOR_STATUS_PASS_REPL = 0x02,
+    TAC_PLUS_AUTHOR_STATUS_FAIL = 0x10,
+    TAC_PLUS_AUTHOR_STATUS_ERROR = 0x11,
+    TAC_PLUS_AUTHOR_STATUS_FOLLOW = 0x21
+};
+
+enum {
+    TAC_PLUS_ACCT_FLAG_START = 0x02,
+    TAC_PLUS_ACCT_FLAG_STOP = 0x04,
+    TAC_PLUS_ACCT_FLAG_WATCHDOG = 0x08,
+    TAC_PLUS_ACCT_STATUS_SUCCESS = 0x01,
+    TAC_PLUS_ACCT_STATUS_ERROR = 0x02
+};
+
+struct TacacsHeader {
+    uint8_t version;
+    uint8_t type;
+    uint8_t seq_no;
+    uint8_t flags;
+    uint32_t session_id;
+    uint32_t length;
+};
+
+// Decoded reply of any of the three packet types
+struct TacacsReply {
+    int status;
+    uint8_t flags;              // header flags, tells whether single-connect was accepted
+    std::string server_msg;
+    std::string data;
+    std::vector<std::string> args;
+};
+
+// Request bodies
+std::string TacacsAuthenStartBody(uint8_t action, uint8_t authen_type, const std::string& user,
+        const std::string& port, const std::string& rem_addr, const std::string& data);
+std::string TacacsAuthenContinueBody(const std::string& user_msg);
+std::string TacacsAuthorRequestBody(const std::string& user, const std::string& port,
+        const std::string& rem_addr, const std::vector<std::string>& args);
+std::string TacacsAcctRequestBody(uint8_t acct_flags, const std::string& user, const std::string& port,
+        const std::string& rem_addr, const std::vector<std::string>& args);
+
+// Reply bodies. Return false on a malformed body.
+bool TacacsParseAuthenReply(const std::string& body, TacacsReply* reply);
+bool TacacsParseAuthorResponse(const std::string& body, TacacsReply* reply);
+bool TacacsParseAcctReply(const std::string& body, TacacsReply* reply);
+// Parses the reply body of a session of the given packet type
+bool TacacsParseReply(uint8_t type, const std::string& body, TacacsReply* reply);
+
+// XORs body with the MD5 pseudo-pad derived from the header and key.
+// The operation is its own inverse.
+void TacacsCrypt(const TacacsHeader& hdr, const std::string& key, std::string* body);
+
+// Builds a complete packet; sets hdr.length and obfuscates unless the key is empty
+std::string TacacsEncodePacket(TacacsHeader hdr, std::string body, const std::string& key);
+void TacacsDecodeHeader(const unsigned char* buf, TacacsHeader* hdr);
+
+// Blocking socket helpers with a timeout in milliseconds. Return -1 on error or timeout.
+int TacacsConnect(const struct addrinfo* server, int timeout_ms);
+int TacacsWriteAll(int fd, const std::string& data, int timeout_ms);
+// Packets flagged unencrypted are refused when a key is set
+int TacacsReadPacket(int fd, TacacsHeader* hdr, std::string* body, const std::string& key, int timeout_ms);
+
+// Starts a connection without waiting for it. Returns a non-blocking socket,
+// whose connection completes once it turns writable, or -1 on error.
+int TacacsConnectNonBlocking(const struct addrinfo* server);
+
+#endif
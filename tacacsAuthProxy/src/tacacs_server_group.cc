@@ -0,0 +1,175 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+#include "tacacs_server_group.h"
+#include "tacacs_session.h"
+#include "logger.h"
+
+#define TACACS_DEFAULT_PORT "49"
+// One request in TACACS_EXPLORE_RATE goes to a random healthy server first,
+// so that the estimate of a server that fell behind gets refreshed
+#define TACACS_EXPLORE_RATE 32
+
+static std::vector<std::string> SplitList(const char* list) {
+    std::vector<std::string> items;
+    if (list == NULL) {
+        return items;
+    }
+    std::string s(list);
+    size_t start = 0;
+    while (start <= s.size()) {
+        size_t end = s.find(',', start);
+        if (end == std::string::npos) {
+            end = s.size();
+        }
+        std::string item = s.substr(start, end - start);
+        size_t first = item.find_first_not_of(" \t");
+        size_t last = item.find_last_not_of(" \t");
+        items.push_back(first == std::string::npos ? "" : item.substr(first, last - first + 1));
+        start = end + 1;
+    }
+    return items;
+}
+
+TacacsServerGroup::TacacsServerGroup(const char* addresses, const char* keys, const char* weights,
+        PoolFactory pool_factory) : poolFactory(pool_factory) {
+    std::vector<std::string> address_list = SplitList(addresses);
+    std::vector<std::string> key_list = SplitList(keys);
+    std::vector<std::string> weight_list = SplitList(weights);
+
+    for (size_t i = 0; i < address_list.size(); i++) {
+        if (address_list[i].empty()) {
+            continue;
+        }
+        // A single key is shared, otherwise keys follow the order of the servers
+        std::string key;
+        if (key_list.size() == 1) {
+            key = key_list[0];
+        } else if (i < key_list.size()) {
+            key = key_list[i];
+        } else {
+            LOG_F(ERROR, "No secure key for TACACS+ server %s, no encryption will be used", address_list[i].c_str());
+        }
+        int weight = 1;
+        if (i < weight_list.size() && !weight_list[i].empty()) {
+            weight = atoi(weight_list[i].c_str());
+            if (weight <= 0) {
+                LOG_F(WARNING, "Invalid weight %s for TACACS+ server %s, using 1", weight_list[i].c_str(),
+                        address_list[i].c_str());
+                weight = 1;
+            }
+        }
+        LOG_F(INFO, "TACACS+ server %s added with weight %d", address_list[i].c_str(), weight);
+        servers.push_back(new TacacsServer(address_list[i], key, weight));
+    }
+}
+
+TacacsServerGroup::~TacacsServerGroup() {
+    for (size_t i = 0; i < servers.size(); i++) {
+        delete servers[i]->pool.load();
+        if (servers[i]->resolved != NULL) {
+            freeaddrinfo(servers[i]->resolved);
+        }
+        delete servers[i];
+    }
+}
+
+struct addrinfo* TacacsServerGroup::Resolve(TacacsServer* server) {
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof hints);
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    // host, host:port or [v6 address]:port
+    std::string host, port;
+    const std::string& s = server->address;
+    size_t pos = s.rfind(':');
+    if (s[0] == '[') {
+        size_t close = s.find(']');
+        host = s.substr(1, close == std::string::npos ? std::string::npos : close - 1);
+        port = (close != std::string::npos && pos == close + 1) ? s.substr(pos + 1) : TACACS_DEFAULT_PORT;
+    } else if (pos != std::string::npos && pos > 0 && s.find(':') == pos) {
+        host = s.substr(0, pos);
+        port = s.substr(pos + 1);
+    } else {
+        host = s;
+        port = TACACS_DEFAULT_PORT;
+    }
+
+    struct addrinfo* tac_server = NULL;
+    int ret = getaddrinfo(host.c_str(), port.c_str(), &hints, &tac_server);
+    if (ret != 0) {
+        LOG_F(WARNING, "Error: resolving name %s: %s", server->address.c_str(), gai_strerror(ret));
+        return NULL;
+    }
+    return tac_server;
+}
+
+TacacsConnectionPool* TacacsServerGroup::GetPool(TacacsServer* server) {
+    TacacsConnectionPool* pool = server->pool.load(std::memory_order_acquire);
+    if (pool != NULL) {
+        return pool;
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    pool = server->pool.load(std::memory_order_relaxed);
+    if (pool == NULL) {
+        if (server->resolved == NULL) {
+            server->resolved = Resolve(server);
+        }
+        if (server->resolved != NULL) {
+            pool = poolFactory(server->resolved, server->address.c_str());
+            server->pool.store(pool, std::memory_order_release);
+        }
+    }
+    return pool;
+}
+
+std::vector<TacacsServer*> TacacsServerGroup::Rank() {
+    std::vector<std::pair<double, TacacsServer*> > healthy;
+    // Servers being probed or failing come last, their breaker decides
+    // whether a request still gets through
+    std::vector<TacacsServer*> failing;
+    std::vector<TacacsServer*> ranked;
+
+    for (size_t i = 0; i < servers.size(); i++) {
+        TacacsConnectionPool* pool = GetPool(servers[i]);
+        if (pool == NULL) {
+            continue;
+        }
+        if (pool->breaker.GetState() != CircuitBreaker::CLOSED) {
+            failing.push_back(servers[i]);
+            continue;
+        }
+        // Up to 25% of jitter; servers without an estimate yet rank first
+        double jitter = 1.0 + (TacacsRandom() & 0xff) / 1024.0;
+        healthy.push_back(std::make_pair(pool->RttEstimate() * jitter / servers[i]->weight, servers[i]));
+    }
+    std::stable_sort(healthy.begin(), healthy.end(),
+            [](const std::pair<double, TacacsServer*>& a, const std::pair<double, TacacsServer*>& b) {
+                return a.first < b.first;
+            });
+    if (healthy.size() > 1 && TacacsRandom() % TACACS_EXPLORE_RATE == 0) {
+        std::swap(healthy[0], healthy[TacacsRandom() % healthy.size()]);
+    }
+    for (size_t i = 0; i < healthy.size(); i++) {
+        ranked.push_back(healthy[i].second);
+    }
+    ranked.insert(ranked.end(), failing.begin(), failing.end());
+    return ranked;
+}
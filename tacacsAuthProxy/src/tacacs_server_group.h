@@ -0,0 +1,81 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TACACS_SERVER_GROUP_H_
+#define TACACS_SERVER_GROUP_H_
+
+#include <atomic>
+#include <ctime>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <netdb.h>
+
+#include "tacacs_connection_pool.h"
+
+// One configured TACACS+ server
+class TacacsServer {
+    public:
+    std::string address;        // host[:port] as configured
+    std::string key;
+    int weight;
+    struct addrinfo* resolved;
+    // Created on first use, lock free afterwards
+    std::atomic<TacacsConnectionPool*> pool;
+    // When the engine was last refused single-connect, 0 if never
+    std::atomic<time_t> single_connect_refused;
+
+    TacacsServer(const std::string& server_address, const std::string& secure_key, int server_weight) :
+        address(server_address), key(secure_key), weight(server_weight), resolved(NULL), pool(NULL),
+        single_connect_refused(0) {}
+};
+
+// The redundant TACACS+ servers of the AAA tier.
+//
+// Servers are ranked per request: healthy servers first, ordered by their
+// moving-average round trip time divided by their weight, then servers whose
+// circuit breaker is open. A little jitter spreads load across servers of
+// similar cost, and as load piles up on one server its RTT grows and the
+// others move ahead. Callers try the servers in the ranked order until one
+// of them answers.
+class TacacsServerGroup {
+    public:
+    typedef std::function<TacacsConnectionPool*(const struct addrinfo*, const char*)> PoolFactory;
+
+    private:
+    std::vector<TacacsServer*> servers;
+    PoolFactory poolFactory;
+    std::mutex lock;
+
+    struct addrinfo* Resolve(TacacsServer* server);
+
+    public:
+    // addresses is a comma separated list of host[:port]. keys is either a
+    // single key for every server or a comma separated list matching the
+    // addresses, weights an optional comma separated list of positive
+    // integers defaulting to 1.
+    TacacsServerGroup(const char* addresses, const char* keys, const char* weights, PoolFactory pool_factory);
+    ~TacacsServerGroup();
+
+    size_t Size() const { return servers.size(); }
+    TacacsServer* Server(size_t index) const { return servers[index]; }
+
+    // Connection pool of the server, NULL if its name does not resolve
+    TacacsConnectionPool* GetPool(TacacsServer* server);
+
+    // Servers with a usable pool, in the order they should be tried
+    std::vector<TacacsServer*> Rank();
+};
+
+#endif
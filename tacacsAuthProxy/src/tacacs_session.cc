@@ -0,0 +1,138 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <chrono>
+#include <functional>
+#include <random>
+#include <thread>
+
+#include "tacacs_session.h"
+#include "logger.h"
+
+static uint32_t RandomSeed() {
+    std::random_device device;
+    return device() ^ (uint32_t)std::hash<std::thread::id>()(std::this_thread::get_id());
+}
+
+// Milliseconds left until deadline, rounded up so that a wait for them
+// does not end before it
+static int RemainingMs(std::chrono::steady_clock::time_point deadline) {
+    long long us = std::chrono::duration_cast<std::chrono::microseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+    return us > 0 ? (int)((us + 999) / 1000) : 0;
+}
+
+uint32_t TacacsRandom() {
+    static thread_local std::mt19937 generator(RandomSeed());
+    return generator();
+}
+
+TacacsSession::TacacsSession(TacacsConnectionPool* conn_pool, const char* secure_key, uint8_t session_type,
+        uint8_t minor_version) :
+    pool(conn_pool), conn(NULL), key(secure_key), version(TAC_PLUS_MAJOR_VER | minor_version),
+    type(session_type), seq_no(0), finished(false) {
+    // Zero is valid but easily confused with an unset field in server logs
+    do {
+        session_id = TacacsRandom();
+    } while (session_id == 0);
+}
+
+TacacsSession::~TacacsSession() {
+    if (conn != NULL) {
+        pool->Release(conn, finished);
+    }
+}
+
+bool TacacsSession::Connect() {
+    conn = pool->Acquire();
+    return conn != NULL;
+}
+
+bool TacacsSession::Adopt(TacacsSession* previous) {
+    if (conn != NULL || previous->pool != pool || previous->conn == NULL || !previous->finished ||
+            !previous->conn->single_connect) {
+        return false;
+    }
+    conn = previous->conn;
+    previous->conn = NULL;
+    return true;
+}
+
+void TacacsSession::AddAttribute(const char* name, const std::string& value) {
+    attributes.push_back(std::string(name) + "=" + value);
+}
+
+int TacacsSession::Send(const std::string& body, TacacsReply* reply, int timeout_ms, bool blame_timeout) {
+    if (conn == NULL) {
+        return -1;
+    }
+
+    // The write and the read share the timeout
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point deadline = start + std::chrono::milliseconds(timeout_ms);
+    int ret = Exchange(body, reply, deadline);
+    if (ret < 0) {
+        if (blame_timeout || std::chrono::steady_clock::now() < deadline) {
+            pool->breaker.RecordFailure();
+        }
+    } else {
+        long rtt_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start).count();
+        pool->breaker.RecordSuccess(rtt_us / 1000);
+        pool->RecordRtt(rtt_us);
+    }
+    return ret;
+}
+
+int TacacsSession::Exchange(const std::string& body, TacacsReply* reply,
+        std::chrono::steady_clock::time_point deadline) {
+    // Client packets carry odd sequence numbers, the first one on a new
+    // connection asks for single-connect mode
+    TacacsHeader hdr;
+    hdr.version = version;
+    hdr.type = type;
+    hdr.seq_no = seq_no + 1;
+    hdr.flags = (hdr.seq_no == 1 && !conn->negotiated) ? TAC_PLUS_SINGLE_CONNECT_FLAG : 0;
+    hdr.session_id = session_id;
+
+    if (TacacsWriteAll(conn->fd, TacacsEncodePacket(hdr, body, key), RemainingMs(deadline)) < 0) {
+        return -1;
+    }
+    seq_no = hdr.seq_no;
+
+    TacacsHeader rhdr;
+    std::string rbody;
+    if (TacacsReadPacket(conn->fd, &rhdr, &rbody, key, RemainingMs(deadline)) < 0) {
+        return -1;
+    }
+
+    if (rhdr.type != type || rhdr.session_id != session_id || rhdr.seq_no != seq_no + 1) {
+        LOG_F(WARNING, "Reply does not belong to TACACS+ session %08x: session %08x, type %d, seq_no %d",
+                session_id, rhdr.session_id, rhdr.type, rhdr.seq_no);
+        return -1;
+    }
+    seq_no = rhdr.seq_no;
+
+    if (!TacacsParseReply(type, rbody, reply)) {
+        LOG_F(WARNING, "Malformed reply in TACACS+ session %08x", session_id);
+        return -1;
+    }
+
+    reply->flags = rhdr.flags;
+    // Settled once per connection, later replies need not repeat the flag
+    if (!conn->negotiated && rhdr.seq_no == 2) {
+        conn->single_connect = (rhdr.flags & TAC_PLUS_SINGLE_CONNECT_FLAG) != 0;
+        conn->negotiated = true;
+    }
+    return 0;
+}
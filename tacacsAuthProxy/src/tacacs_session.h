@@ -0,0 +1,74 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TACACS_SESSION_H_
+#define TACACS_SESSION_H_
+
+#include <stdint.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "tacacs_packet.h"
+#include "tacacs_connection_pool.h"
+
+// Random number from a per-thread generator, safe to call from any thread
+uint32_t TacacsRandom();
+
+// State of one TACACS+ session: a single authentication, authorization or
+// accounting exchange. Each request creates its own sessions, so concurrent
+// requests never share a socket, a sequence number or a session id.
+class TacacsSession {
+    TacacsConnectionPool* pool;
+    TacacsConnection* conn;
+    std::string key;
+    uint8_t version;
+    uint8_t type;
+    uint32_t session_id;
+    uint8_t seq_no;             // sequence number of the last packet sent
+    bool finished;
+    std::vector<std::string> attributes;
+
+    int Exchange(const std::string& body, TacacsReply* reply, std::chrono::steady_clock::time_point deadline);
+
+    public:
+    TacacsSession(TacacsConnectionPool* pool, const char* key, uint8_t type,
+            uint8_t minor_version = TAC_PLUS_MINOR_VER_DEFAULT);
+    // Hands the connection back to the pool, for reuse if the session finished
+    ~TacacsSession();
+
+    // Takes a connection from the pool. False if the server is unreachable
+    // or its circuit breaker is open.
+    bool Connect();
+
+    // Runs this session on the connection of a finished one, back-to-back
+    // without a trip through the pool. False if that connection cannot carry
+    // another session, Connect() is needed then.
+    bool Adopt(TacacsSession* previous);
+
+    void AddAttribute(const char* name, const std::string& value);
+    const std::vector<std::string>& Attributes() const { return attributes; }
+    uint32_t SessionId() const { return session_id; }
+
+    // Sends the next packet of the session and reads the reply to it. Replies
+    // that belong to another session or arrive out of sequence are rejected.
+    // Returns -1 on error or timeout. The outcome feeds the circuit breaker,
+    // a timeout only with blame_timeout: a wait the caller cut short says
+    // nothing about the server.
+    int Send(const std::string& body, TacacsReply* reply, int timeout_ms, bool blame_timeout = true);
+
+    // Marks the exchange as complete so the connection may serve another session
+    void Finish() { finished = true; }
+};
+
+#endif
@@ -0,0 +1,66 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(int num_threads) : stopping(false) {
+    if (num_threads < 1) {
+        num_threads = 1;
+    }
+    for (int i = 0; i < num_threads; i++) {
+        workers.push_back(std::thread(&ThreadPool::WorkerLoop, this));
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    Stop();
+}
+
+void ThreadPool::Submit(std::function<void()> task) {
+    std::unique_lock<std::mutex> guard(lock);
+    tasks.push(task);
+    guard.unlock();
+    cond.notify_one();
+}
+
+void ThreadPool::Stop() {
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        if (stopping) {
+            return;
+        }
+        stopping = true;
+    }
+    cond.notify_all();
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i].join();
+    }
+}
+
+void ThreadPool::WorkerLoop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            while (tasks.empty() && !stopping) {
+                cond.wait(guard);
+            }
+            if (tasks.empty()) {
+                return;
+            }
+            task = tasks.front();
+            tasks.pop();
+        }
+        task();
+    }
+}
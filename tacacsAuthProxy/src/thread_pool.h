@@ -0,0 +1,43 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed size pool of worker threads draining a FIFO of tasks
+class ThreadPool {
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()> > tasks;
+    std::mutex lock;
+    std::condition_variable cond;
+    bool stopping;
+
+    void WorkerLoop();
+
+    public:
+    ThreadPool(int num_threads);
+    ~ThreadPool();
+
+    void Submit(std::function<void()> task);
+    // Lets queued tasks run to completion and joins the workers
+    void Stop();
+};
+
+#endif
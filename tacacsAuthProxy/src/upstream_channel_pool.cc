@@ -0,0 +1,123 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <climits>
+#include <functional>
+
+#include "upstream_channel_pool.h"
+#include "metrics.h"
+#include "logger.h"
+
+UpstreamChannel::UpstreamChannel(const char* addr, const std::string& channel_name, int index) :
+    name(channel_name), inflight(0), calls(0) {
+    // Channels with identical arguments would share one connection
+    grpc::ChannelArguments args;
+    args.SetInt("tacacs_proxy.upstream_channel", index);
+    channel = grpc::CreateCustomChannel(addr, grpc::InsecureChannelCredentials(), args);
+    stub = openolt::Openolt::NewStub(channel);
+    genericStub.reset(new grpc::GenericStub(channel));
+}
+
+UpstreamLease::UpstreamLease(UpstreamChannel* leased) : channel(leased) {
+    channel->inflight++;
+    channel->calls++;
+}
+
+UpstreamLease& UpstreamLease::operator=(UpstreamLease&& other) {
+    if (this != &other) {
+        Release();
+        channel = other.channel;
+        other.channel = NULL;
+    }
+    return *this;
+}
+
+void UpstreamLease::Release() {
+    if (channel != NULL) {
+        channel->inflight--;
+        channel = NULL;
+    }
+}
+
+UpstreamChannelPool::UpstreamChannelPool(const char* addr, int unary_channels) : nextPick(0) {
+    int count = unary_channels > 0 ? unary_channels : 1;
+    LOG_F(INFO, "Creating %d GRPC Channels to Openolt Agent on %s, and one for streaming calls", count, addr);
+    for (int i = 0; i < count; i++) {
+        unary.push_back(std::unique_ptr<UpstreamChannel>(new UpstreamChannel(addr, "unary-" + std::to_string(i), i)));
+    }
+    streaming.reset(new UpstreamChannel(addr, "streaming", count));
+    metricsCollector = ProxyMetrics::Instance().AddCollector(
+            std::bind(&UpstreamChannelPool::CollectMetrics, this, std::placeholders::_1));
+}
+
+UpstreamChannelPool::~UpstreamChannelPool() {
+    ProxyMetrics::Instance().RemoveCollector(metricsCollector);
+}
+
+UpstreamLease UpstreamChannelPool::Acquire() {
+    // Scanning from a rotating start spreads the calls over equally loaded channels
+    size_t start = nextPick++ % unary.size();
+    UpstreamChannel* best = NULL;
+    int bestLoad = INT_MAX;
+    for (size_t i = 0; i < unary.size(); i++) {
+        UpstreamChannel* channel = unary[(start + i) % unary.size()].get();
+        int load = channel->inflight.load(std::memory_order_relaxed);
+        if (load < bestLoad) {
+            best = channel;
+            bestLoad = load;
+            if (load == 0) {
+                break;
+            }
+        }
+    }
+    return UpstreamLease(best);
+}
+
+UpstreamLease UpstreamChannelPool::AcquireStreaming() {
+    return UpstreamLease(streaming.get());
+}
+
+void UpstreamChannelPool::CollectMetrics(std::string* out) {
+    typedef std::vector<std::pair<const char*, std::string> > Labels;
+    std::vector<UpstreamChannel*> all;
+    for (size_t i = 0; i < unary.size(); i++) {
+        all.push_back(unary[i].get());
+    }
+    all.push_back(streaming.get());
+
+    static const char* families[][3] = {
+        { "tacacs_proxy_upstream_channel_inflight", "gauge", "Calls in flight on the channel to the openolt agent" },
+        { "tacacs_proxy_upstream_channel_calls_total", "counter", "Calls made on the channel to the openolt agent" },
+        { "tacacs_proxy_upstream_channel_ready", "gauge", "Whether the channel to the openolt agent is connected" },
+    };
+    for (int f = 0; f < 3; f++) {
+        MetricsFamily(out, families[f][0], families[f][1], families[f][2]);
+        for (size_t i = 0; i < all.size(); i++) {
+            double values[] = { (double)all[i]->inflight, (double)all[i]->calls,
+                all[i]->channel->GetState(false) == GRPC_CHANNEL_READY ? 1.0 : 0.0 };
+            MetricsSample(out, families[f][0], Labels(1, std::make_pair("channel", all[i]->name)), values[f]);
+        }
+    }
+    int busy = 0;
+    for (size_t i = 0; i < unary.size(); i++) {
+        if (unary[i]->inflight > 0) {
+            busy++;
+        }
+    }
+    MetricsFamily(out, "tacacs_proxy_upstream_unary_channels_busy", "gauge",
+            "Unary channels to the openolt agent with calls in flight");
+    MetricsSample(out, "tacacs_proxy_upstream_unary_channels_busy", Labels(), busy);
+    MetricsFamily(out, "tacacs_proxy_upstream_unary_channels", "gauge", "Unary channels to the openolt agent");
+    MetricsSample(out, "tacacs_proxy_upstream_unary_channels", Labels(), unary.size());
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef UPSTREAM_CHANNEL_POOL_H_
+#define UPSTREAM_CHANNEL_POOL_H_
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <grpcpp/grpcpp.h>
+#include <grpcpp/generic/generic_stub.h>
+
+#include <voltha_protos/openolt.grpc.pb.h>
+
+class UpstreamChannel {
+    public:
+    std::string name;
+    std::shared_ptr<grpc::Channel> channel;
+    std::unique_ptr<openolt::Openolt::Stub> stub;
+    std::unique_ptr<grpc::GenericStub> genericStub;
+    std::atomic<int> inflight;
+    std::atomic<unsigned long> calls;
+
+    UpstreamChannel(const char* addr, const std::string& channel_name, int index);
+};
+
+// A call's claim on an upstream channel, counted as in flight until the
+// lease goes away. A temporary lease covers a whole blocking call made
+// through it: Acquire().Stub()->Method(...)
+class UpstreamLease {
+    UpstreamChannel* channel;
+
+    public:
+    UpstreamLease() : channel(NULL) {}
+    explicit UpstreamLease(UpstreamChannel* leased);
+    UpstreamLease(UpstreamLease&& other) : channel(other.channel) { other.channel = NULL; }
+    UpstreamLease& operator=(UpstreamLease&& other);
+    ~UpstreamLease() { Release(); }
+
+    void Release();
+
+    openolt::Openolt::Stub* Stub() { return channel->stub.get(); }
+    grpc::GenericStub* GenericStub() { return channel->genericStub.get(); }
+};
+
+// Connections to the openolt agent.
+//
+// A single HTTP/2 connection caps the concurrent streams and makes every
+// call queue behind the large messages of the others. Unary calls are
+// spread over several channels, each on its own connection, and go to the
+// one with the fewest calls in flight. Streaming calls, the long-lived
+// indication stream above all, get a channel of their own so that they
+// neither take a slot nor share a connection with the unary bursts.
+class UpstreamChannelPool {
+    std::vector<std::unique_ptr<UpstreamChannel> > unary;
+    std::unique_ptr<UpstreamChannel> streaming;
+    std::atomic<unsigned> nextPick;
+    int metricsCollector;
+
+    public:
+    UpstreamChannelPool(const char* addr, int unary_channels);
+    ~UpstreamChannelPool();
+
+    // Least loaded channel for a unary call
+    UpstreamLease Acquire();
+    // Channel for a streaming call
+    UpstreamLease AcquireStreaming();
+    std::shared_ptr<grpc::Channel> StreamingChannel() { return streaming->channel; }
+
+    void CollectMetrics(std::string* out);
+};
+
+#endif
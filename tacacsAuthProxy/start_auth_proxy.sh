@@ -6,11 +6,13 @@ TACACS_SECURE_KEY=tacacs
 TACACS_FALLBACK_PASS=0
 INTERFACE_ADDRESS=192.168.10.243:19191
 OPENOLT_AGENT_ADDRESS=192.168.10.243:50060
+PROXY_MODE=sync
 
 [ -z "$TACACS_SERVER_ADDRESS" ] || APPARGS="--tacacs_server_address $TACACS_SERVER_ADDRESS"
 [ -z "$TACACS_SECURE_KEY" ] || APPARGS="$APPARGS --tacacs_secure_key $TACACS_SECURE_KEY"
 [ -z "$TACACS_FALLBACK_PASS" ] || APPARGS="$APPARGS --tacacs_fallback_pass $TACACS_FALLBACK_PASS"
 [ -z "$INTERFACE_ADDRESS" ] || APPARGS="$APPARGS --interface_address $INTERFACE_ADDRESS"
 [ -z "$OPENOLT_AGENT_ADDRESS" ] || APPARGS="$APPARGS --openolt_agent_address $OPENOLT_AGENT_ADDRESS"
+[ -z "$PROXY_MODE" ] || APPARGS="$APPARGS --proxy_mode $PROXY_MODE"
 
 $SCRIPTDIR/build/tacacsproxy $APPARGS $@ -v 9
@@ -0,0 +1,116 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+// Token buckets of the admission control
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "admission_control.h"
+
+TEST(AdmissionControlTest, BurstThenRate) {
+    AdmissionOptions options;
+    options.limits[ADMISSION_USER].rate[PRIORITY_BULK] = 10;
+    options.limits[ADMISSION_USER].burst[PRIORITY_BULK] = 5;
+    AdmissionControl admission(options);
+    ASSERT_TRUE(admission.Enabled(ADMISSION_USER));
+    EXPECT_FALSE(admission.Enabled(ADMISSION_PEER));
+
+    for (int i = 0; i < 5; i++) {
+        EXPECT_TRUE(admission.Admit(ADMISSION_USER, "alice", PRIORITY_BULK));
+    }
+    EXPECT_FALSE(admission.Admit(ADMISSION_USER, "alice", PRIORITY_BULK));
+
+    // Other users, classes and keys have buckets of their own
+    EXPECT_TRUE(admission.Admit(ADMISSION_USER, "bob", PRIORITY_BULK));
+    EXPECT_TRUE(admission.Admit(ADMISSION_USER, "alice", PRIORITY_CRITICAL));
+    EXPECT_TRUE(admission.Admit(ADMISSION_PEER, "ipv4:10.0.0.1", PRIORITY_BULK));
+
+    // One token every 100 ms
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    EXPECT_TRUE(admission.Admit(ADMISSION_USER, "alice", PRIORITY_BULK));
+    EXPECT_FALSE(admission.Admit(ADMISSION_USER, "alice", PRIORITY_BULK));
+}
+
+TEST(AdmissionControlTest, ConcurrentCallersShareTheBurst) {
+    AdmissionOptions options;
+    options.limits[ADMISSION_PEER].rate[PRIORITY_NORMAL] = 1;
+    options.limits[ADMISSION_PEER].burst[PRIORITY_NORMAL] = 1000;
+    AdmissionControl admission(options);
+
+    std::atomic<int> admitted(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; t++) {
+        threads.push_back(std::thread([&]() {
+            for (int i = 0; i < 500; i++) {
+                if (admission.Admit(ADMISSION_PEER, "ipv4:10.0.0.1", PRIORITY_NORMAL)) {
+                    admitted++;
+                }
+            }
+        }));
+    }
+    for (size_t t = 0; t < threads.size(); t++) {
+        threads[t].join();
+    }
+    // The slow rate may refill a token meanwhile
+    EXPECT_GE(admitted.load(), 1000);
+    EXPECT_LE(admitted.load(), 1001);
+}
+
+TEST(AdmissionControlTest, FullTableSharesOverflowBucket) {
+    AdmissionOptions options;
+    options.limits[ADMISSION_USER].rate[PRIORITY_NORMAL] = 1;
+    options.max_keys = 16;
+    AdmissionControl admission(options);
+
+    for (int i = 0; i < 16; i++) {
+        EXPECT_TRUE(admission.Admit(ADMISSION_USER, "user" + std::to_string(i), PRIORITY_NORMAL));
+    }
+    // No slot is free and none refilled, new users take turns at one bucket
+    EXPECT_TRUE(admission.Admit(ADMISSION_USER, "user16", PRIORITY_NORMAL));
+    EXPECT_FALSE(admission.Admit(ADMISSION_USER, "user17", PRIORITY_NORMAL));
+    EXPECT_FALSE(admission.Admit(ADMISSION_USER, "user0", PRIORITY_NORMAL));
+    std::string metrics;
+    admission.CollectMetrics(&metrics);
+    EXPECT_NE(std::string::npos, metrics.find("tacacs_proxy_admission_tracked_keys{key=\"user\"} 16"));
+    EXPECT_NE(std::string::npos, metrics.find("tacacs_proxy_admission_untracked_total{key=\"user\"} 2"));
+}
+
+TEST(AdmissionControlTest, IdleSlotsAreReclaimed) {
+    AdmissionOptions options;
+    options.limits[ADMISSION_USER].rate[PRIORITY_NORMAL] = 100;
+    options.limits[ADMISSION_USER].burst[PRIORITY_NORMAL] = 1;
+    options.max_keys = 16;
+    AdmissionControl admission(options);
+
+    for (int i = 0; i < 16; i++) {
+        EXPECT_TRUE(admission.Admit(ADMISSION_USER, "user" + std::to_string(i), PRIORITY_NORMAL));
+    }
+    // Every bucket refills within 10 ms, after which new users get slots of their own
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    for (int i = 16; i < 32; i++) {
+        std::string user = "user" + std::to_string(i);
+        EXPECT_TRUE(admission.Admit(ADMISSION_USER, user, PRIORITY_NORMAL));
+        EXPECT_FALSE(admission.Admit(ADMISSION_USER, user, PRIORITY_NORMAL));
+    }
+    std::string metrics;
+    admission.CollectMetrics(&metrics);
+    EXPECT_NE(std::string::npos, metrics.find("tacacs_proxy_admission_reclaimed_total{key=\"user\"} 16"));
+    EXPECT_NE(std::string::npos, metrics.find("tacacs_proxy_admission_untracked_total{key=\"user\"} 0"));
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <functional>
+#include <random>
+#include <thread>
+
+#include "fake_behavior.h"
+
+static unsigned NewSeed() {
+    std::random_device seed;
+    return seed() ^ (unsigned)std::hash<std::thread::id>()(std::this_thread::get_id());
+}
+
+// One generator per thread, the fakes serve many threads at once
+static std::mt19937& Generator() {
+    static thread_local std::mt19937 generator(NewSeed());
+    return generator;
+}
+
+std::chrono::microseconds FakeBehavior::Delay() const {
+    double us = latency_ms * 1000;
+    if (jitter_ms > 0) {
+        std::uniform_real_distribution<double> jitter(-jitter_ms * 1000, jitter_ms * 1000);
+        us += jitter(Generator());
+    }
+    return std::chrono::microseconds(us > 0 ? (long)us : 0);
+}
+
+bool FakeBehavior::Fail() const {
+    if (error_rate <= 0) {
+        return false;
+    }
+    std::uniform_real_distribution<double> draw(0, 1);
+    return draw(Generator()) < error_rate;
+}
@@ -0,0 +1,34 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef FAKE_BEHAVIOR_H_
+#define FAKE_BEHAVIOR_H_
+
+#include <chrono>
+
+// Latency and failures injected by the fake backends of the benchmark
+struct FakeBehavior {
+    double latency_ms;
+    double jitter_ms;       // the latency varies uniformly by up to this much either way
+    double error_rate;      // share of requests failing, from 0 to 1
+
+    FakeBehavior() : latency_ms(0), jitter_ms(0), error_rate(0) {}
+
+    // Delay of one reply
+    std::chrono::microseconds Delay() const;
+    // Whether one request fails
+    bool Fail() const;
+};
+
+#endif
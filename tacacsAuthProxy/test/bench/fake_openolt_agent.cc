@@ -0,0 +1,113 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <chrono>
+#include <thread>
+
+#include "fake_openolt_agent.h"
+#include "logger.h"
+
+// Wait between looks at a cancelled call while no indications are due
+#define FAKE_AGENT_IDLE_MS 100
+// Calls still running at shutdown are cancelled after this
+#define FAKE_AGENT_SHUTDOWN_MS 1000
+
+FakeOpenoltAgent::FakeOpenoltAgent(const FakeBehavior& fake_behavior, double indication_rate) :
+    behavior(fake_behavior), indicationRate(indication_rate), port(0), calls(0), errors(0), indications(0) {}
+
+FakeOpenoltAgent::~FakeOpenoltAgent() {
+    Stop();
+}
+
+bool FakeOpenoltAgent::Start(const char* address) {
+    grpc::ServerBuilder builder;
+    builder.AddListeningPort(address, grpc::InsecureServerCredentials(), &port);
+    builder.RegisterService(this);
+    server = builder.BuildAndStart();
+    if (!server || port == 0) {
+        LOG_F(ERROR, "Unable to serve the fake openolt agent on %s", address);
+        server.reset();
+        return false;
+    }
+    LOG_F(INFO, "Fake openolt agent listening on port %d", port);
+    return true;
+}
+
+void FakeOpenoltAgent::Stop() {
+    if (server) {
+        server->Shutdown(std::chrono::system_clock::now() + std::chrono::milliseconds(FAKE_AGENT_SHUTDOWN_MS));
+        server.reset();
+    }
+}
+
+grpc::Status FakeOpenoltAgent::Respond(grpc::ServerContext* context) {
+    calls++;
+    std::this_thread::sleep_for(behavior.Delay());
+    if (behavior.Fail()) {
+        errors++;
+        return grpc::Status(grpc::UNAVAILABLE, "Injected error");
+    }
+    return grpc::Status::OK;
+}
+
+grpc::Status FakeOpenoltAgent::EnableIndication(grpc::ServerContext* context, const openolt::Empty* request,
+        grpc::ServerWriter<openolt::Indication>* writer) {
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+    openolt::Indication indication;
+    while (!context->IsCancelled()) {
+        if (indicationRate <= 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(FAKE_AGENT_IDLE_MS));
+            continue;
+        }
+        next += std::chrono::microseconds((long)(1e6 / indicationRate));
+        std::this_thread::sleep_until(next);
+        if (!writer->Write(indication)) {
+            break;
+        }
+        indications++;
+    }
+    return grpc::Status::OK;
+}
+
+#define FAKE_UNARY(method, request_type, response_type) \
+    grpc::Status FakeOpenoltAgent::method(grpc::ServerContext* context, const request_type* request, \
+            response_type* response) { \
+        return Respond(context); \
+    }
+
+FAKE_UNARY(DisableOlt, openolt::Empty, openolt::Empty)
+FAKE_UNARY(ReenableOlt, openolt::Empty, openolt::Empty)
+FAKE_UNARY(ActivateOnu, openolt::Onu, openolt::Empty)
+FAKE_UNARY(DeactivateOnu, openolt::Onu, openolt::Empty)
+FAKE_UNARY(DeleteOnu, openolt::Onu, openolt::Empty)
+FAKE_UNARY(OmciMsgOut, openolt::OmciMsg, openolt::Empty)
+FAKE_UNARY(OnuPacketOut, openolt::OnuPacket, openolt::Empty)
+FAKE_UNARY(UplinkPacketOut, openolt::UplinkPacket, openolt::Empty)
+FAKE_UNARY(FlowAdd, openolt::Flow, openolt::Empty)
+FAKE_UNARY(FlowRemove, openolt::Flow, openolt::Empty)
+FAKE_UNARY(HeartbeatCheck, openolt::Empty, openolt::Heartbeat)
+FAKE_UNARY(EnablePonIf, openolt::Interface, openolt::Empty)
+FAKE_UNARY(DisablePonIf, openolt::Interface, openolt::Empty)
+FAKE_UNARY(GetDeviceInfo, openolt::Empty, openolt::DeviceInfo)
+FAKE_UNARY(Reboot, openolt::Empty, openolt::Empty)
+FAKE_UNARY(CollectStatistics, openolt::Empty, openolt::Empty)
+FAKE_UNARY(CreateTrafficSchedulers, tech_profile::TrafficSchedulers, openolt::Empty)
+FAKE_UNARY(RemoveTrafficSchedulers, tech_profile::TrafficSchedulers, openolt::Empty)
+FAKE_UNARY(CreateTrafficQueues, tech_profile::TrafficQueues, openolt::Empty)
+FAKE_UNARY(RemoveTrafficQueues, tech_profile::TrafficQueues, openolt::Empty)
+FAKE_UNARY(PerformGroupOperation, openolt::Group, openolt::Empty)
+FAKE_UNARY(DeleteGroup, openolt::Group, openolt::Empty)
+FAKE_UNARY(OnuItuPonAlarmSet, config::OnuItuPonAlarm, openolt::Empty)
+FAKE_UNARY(GetLogicalOnuDistanceZero, openolt::Onu, openolt::OnuLogicalDistance)
+FAKE_UNARY(GetLogicalOnuDistance, openolt::Onu, openolt::OnuLogicalDistance)
@@ -0,0 +1,91 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef FAKE_OPENOLT_AGENT_H_
+#define FAKE_OPENOLT_AGENT_H_
+
+#include <atomic>
+#include <memory>
+#include <grpcpp/grpcpp.h>
+
+#include <voltha_protos/openolt.grpc.pb.h>
+
+#include "fake_behavior.h"
+
+// Openolt agent stand-in for the benchmark.
+//
+// Every unary method answers an empty response after the latency of the
+// behavior, or fails with UNAVAILABLE for the configured share of calls.
+// EnableIndication streams empty indications at indication_rate per second
+// until the caller goes away.
+class FakeOpenoltAgent : public openolt::Openolt::Service {
+    FakeBehavior behavior;
+    double indicationRate;
+    std::unique_ptr<grpc::Server> server;
+    int port;
+
+    grpc::Status Respond(grpc::ServerContext* context);
+
+    public:
+    std::atomic<unsigned long> calls;
+    std::atomic<unsigned long> errors;
+    std::atomic<unsigned long> indications;
+
+    FakeOpenoltAgent(const FakeBehavior& fake_behavior, double indication_rate);
+    ~FakeOpenoltAgent();
+
+    // address is host:port, port 0 picks a free one. False if it cannot be listened on.
+    bool Start(const char* address);
+    void Stop();
+
+    // Port listened on, once started
+    int Port() { return port; }
+
+    grpc::Status DisableOlt(grpc::ServerContext* context, const openolt::Empty* request, openolt::Empty* response) override;
+    grpc::Status ReenableOlt(grpc::ServerContext* context, const openolt::Empty* request, openolt::Empty* response) override;
+    grpc::Status ActivateOnu(grpc::ServerContext* context, const openolt::Onu* request, openolt::Empty* response) override;
+    grpc::Status DeactivateOnu(grpc::ServerContext* context, const openolt::Onu* request, openolt::Empty* response) override;
+    grpc::Status DeleteOnu(grpc::ServerContext* context, const openolt::Onu* request, openolt::Empty* response) override;
+    grpc::Status OmciMsgOut(grpc::ServerContext* context, const openolt::OmciMsg* request, openolt::Empty* response) override;
+    grpc::Status OnuPacketOut(grpc::ServerContext* context, const openolt::OnuPacket* request, openolt::Empty* response) override;
+    grpc::Status UplinkPacketOut(grpc::ServerContext* context, const openolt::UplinkPacket* request, openolt::Empty* response) override;
+    grpc::Status FlowAdd(grpc::ServerContext* context, const openolt::Flow* request, openolt::Empty* response) override;
+    grpc::Status FlowRemove(grpc::ServerContext* context, const openolt::Flow* request, openolt::Empty* response) override;
+    grpc::Status EnableIndication(grpc::ServerContext* context, const openolt::Empty* request,
+            grpc::ServerWriter<openolt::Indication>* writer) override;
+    grpc::Status HeartbeatCheck(grpc::ServerContext* context, const openolt::Empty* request, openolt::Heartbeat* response) override;
+    grpc::Status EnablePonIf(grpc::ServerContext* context, const openolt::Interface* request, openolt::Empty* response) override;
+    grpc::Status DisablePonIf(grpc::ServerContext* context, const openolt::Interface* request, openolt::Empty* response) override;
+    grpc::Status GetDeviceInfo(grpc::ServerContext* context, const openolt::Empty* request, openolt::DeviceInfo* response) override;
+    grpc::Status Reboot(grpc::ServerContext* context, const openolt::Empty* request, openolt::Empty* response) override;
+    grpc::Status CollectStatistics(grpc::ServerContext* context, const openolt::Empty* request, openolt::Empty* response) override;
+    grpc::Status CreateTrafficSchedulers(grpc::ServerContext* context, const tech_profile::TrafficSchedulers* request,
+            openolt::Empty* response) override;
+    grpc::Status RemoveTrafficSchedulers(grpc::ServerContext* context, const tech_profile::TrafficSchedulers* request,
+            openolt::Empty* response) override;
+    grpc::Status CreateTrafficQueues(grpc::ServerContext* context, const tech_profile::TrafficQueues* request,
+            openolt::Empty* response) override;
+    grpc::Status RemoveTrafficQueues(grpc::ServerContext* context, const tech_profile::TrafficQueues* request,
+            openolt::Empty* response) override;
+    grpc::Status PerformGroupOperation(grpc::ServerContext* context, const openolt::Group* request, openolt::Empty* response) override;
+    grpc::Status DeleteGroup(grpc::ServerContext* context, const openolt::Group* request, openolt::Empty* response) override;
+    grpc::Status OnuItuPonAlarmSet(grpc::ServerContext* context, const config::OnuItuPonAlarm* request,
+            openolt::Empty* response) override;
+    grpc::Status GetLogicalOnuDistanceZero(grpc::ServerContext* context, const openolt::Onu* request,
+            openolt::OnuLogicalDistance* response) override;
+    grpc::Status GetLogicalOnuDistance(grpc::ServerContext* context, const openolt::Onu* request,
+            openolt::OnuLogicalDistance* response) override;
+};
+
+#endif
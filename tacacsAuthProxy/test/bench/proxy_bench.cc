@@ -0,0 +1,538 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// Load test of the proxy against in-process fakes of its backends.
+//
+// The proxy runs in this process exactly as tacacsproxy would, pointed at a
+// fake TACACS+ server and a fake openolt agent whose latency, jitter and
+// error rate are set on the command line. A closed-loop generator keeps a
+// fixed number of calls outstanding; an open-loop one starts calls at a
+// fixed rate whatever the proxy's latency, and times every call from the
+// moment it was due, so a stalled proxy shows up in the tail instead of
+// slowing the generator down. Throughput and latency percentiles of the
+// successful calls are reported per method of the RPC mix, failed calls are
+// counted by status code.
+//
+// Arguments after -- are passed on to the proxy, e.g.
+//   proxybench --proxy_mode async --mix HeartbeatCheck=4,FlowAdd=1 -- --tacacs_engine_threads 2
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <grpcpp/grpcpp.h>
+#include <grpcpp/generic/generic_stub.h>
+
+#include "logger.h"
+#include "proxy_methods.h"
+#include "proxy_server.h"
+#include "fake_openolt_agent.h"
+#include "tacacs_test_server.h"
+
+// Longest wait for the proxy to listen after it was started
+#define BENCH_STARTUP_SEC 10
+// Shared secret between the proxy and the fake TACACS+ server
+#define BENCH_TACACS_KEY "proxybench"
+// gRPC status codes run from OK to UNAUTHENTICATED
+#define BENCH_STATUS_CODES 17
+
+typedef std::chrono::steady_clock BenchClock;
+
+struct BenchOptions {
+    const char* proxyMode;
+    const char* proxyAddress;
+    const char* loop;           // closed or open
+    int concurrency;            // closed loop: calls outstanding, open loop: completion threads
+    double rate;                // open loop: calls started per second
+    int durationSec;
+    int warmupSec;              // calls started before this are not measured
+    int timeoutMs;
+    const char* mix;
+    const char* username;
+    const char* password;
+    double indicationRate;      // indications per second streamed by the agent, 0 disables
+    FakeBehavior tacacs;
+    FakeBehavior agent;
+
+    BenchOptions() : proxyMode("sync"), proxyAddress("127.0.0.1:19291"), loop("closed"), concurrency(16),
+        rate(1000), durationSec(10), warmupSec(1), timeoutMs(5000), mix("HeartbeatCheck=1"), username("bench"),
+        password("bench"), indicationRate(0) {}
+};
+
+struct MixEntry {
+    const ProxyMethod* method;
+    double cumulativeWeight;
+};
+
+// Latencies in microseconds and failures by status code of one method, per thread
+struct MethodSamples {
+    std::vector<long> latencies;
+    unsigned long errors;
+    unsigned long codes[BENCH_STATUS_CODES];
+
+    MethodSamples() : errors(0) { memset(codes, 0, sizeof codes); }
+};
+
+typedef std::vector<MethodSamples> ThreadSamples;
+
+// State shared by the generator threads
+struct BenchRun {
+    BenchOptions options;
+    std::vector<MixEntry> mix;
+    std::unique_ptr<grpc::GenericStub> stub;
+    std::string authorization;
+    grpc::ByteBuffer request;
+    BenchClock::time_point measureStart;
+    BenchClock::time_point measureEnd;
+};
+
+// One open-loop call in flight, its own completion queue tag
+struct OpenLoopCall {
+    int methodIndex;
+    BenchClock::time_point due;
+    grpc::ClientContext ctx;
+    grpc::ByteBuffer response;
+    grpc::Status status;
+    std::unique_ptr<grpc::GenericClientAsyncResponseReader> reader;
+};
+
+static std::string Base64Encode(const std::string& in) {
+    static const char chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    size_t i = 0;
+    for (; i + 2 < in.size(); i += 3) {
+        uint32_t v = ((uint8_t)in[i] << 16) | ((uint8_t)in[i + 1] << 8) | (uint8_t)in[i + 2];
+        out.push_back(chars[(v >> 18) & 0x3f]);
+        out.push_back(chars[(v >> 12) & 0x3f]);
+        out.push_back(chars[(v >> 6) & 0x3f]);
+        out.push_back(chars[v & 0x3f]);
+    }
+    if (i + 1 == in.size()) {
+        uint32_t v = (uint8_t)in[i] << 16;
+        out.push_back(chars[(v >> 18) & 0x3f]);
+        out.push_back(chars[(v >> 12) & 0x3f]);
+        out += "==";
+    } else if (i + 2 == in.size()) {
+        uint32_t v = ((uint8_t)in[i] << 16) | ((uint8_t)in[i + 1] << 8);
+        out.push_back(chars[(v >> 18) & 0x3f]);
+        out.push_back(chars[(v >> 12) & 0x3f]);
+        out.push_back(chars[(v >> 6) & 0x3f]);
+        out.push_back('=');
+    }
+    return out;
+}
+
+// Parses Method=weight,... into cumulative weights. A method without a weight weighs 1.
+static bool ParseMix(const char* spec, std::vector<MixEntry>* mix) {
+    std::istringstream in(spec);
+    std::string item;
+    double total = 0;
+    while (std::getline(in, item, ',')) {
+        size_t eq = item.find('=');
+        std::string name = item.substr(0, eq);
+        double weight = (eq == std::string::npos) ? 1 : atof(item.c_str() + eq + 1);
+        const ProxyMethod* method = FindProxyMethod(name);
+        if (method == NULL || method->server_streaming || weight <= 0) {
+            fprintf(stderr, "Invalid RPC mix entry %s, unary proxied methods only\n", item.c_str());
+            return false;
+        }
+        total += weight;
+        MixEntry entry;
+        entry.method = method;
+        entry.cumulativeWeight = total;
+        mix->push_back(entry);
+    }
+    return !mix->empty();
+}
+
+static int PickMethod(const std::vector<MixEntry>& mix, std::mt19937* generator) {
+    std::uniform_real_distribution<double> draw(0, mix.back().cumulativeWeight);
+    double value = draw(*generator);
+    for (size_t i = 0; i + 1 < mix.size(); i++) {
+        if (value < mix[i].cumulativeWeight) {
+            return i;
+        }
+    }
+    return mix.size() - 1;
+}
+
+static void DrainQueue(grpc::CompletionQueue* cq) {
+    void* tag;
+    bool ok;
+    cq->Shutdown();
+    while (cq->Next(&tag, &ok)) {
+    }
+}
+
+static void PrepareContext(BenchRun* run, grpc::ClientContext* ctx) {
+    ctx->set_deadline(std::chrono::system_clock::now() + std::chrono::milliseconds(run->options.timeoutMs));
+    ctx->AddMetadata("authorization", run->authorization);
+}
+
+static void Record(BenchRun* run, ThreadSamples* samples, int method_index, BenchClock::time_point start,
+        const grpc::Status& status) {
+    if (start < run->measureStart || start >= run->measureEnd) {
+        return;
+    }
+    MethodSamples& method = (*samples)[method_index];
+    if (status.ok()) {
+        method.latencies.push_back(
+            std::chrono::duration_cast<std::chrono::microseconds>(BenchClock::now() - start).count());
+    } else {
+        method.errors++;
+        method.codes[status.error_code() < BENCH_STATUS_CODES ? status.error_code() : grpc::UNKNOWN]++;
+    }
+}
+
+// Each worker has one call outstanding at a time
+static void ClosedLoopWorker(BenchRun* run, ThreadSamples* samples) {
+    std::random_device seed;
+    std::mt19937 generator(seed());
+    grpc::CompletionQueue cq;
+    while (BenchClock::now() < run->measureEnd) {
+        int index = PickMethod(run->mix, &generator);
+        grpc::ClientContext ctx;
+        PrepareContext(run, &ctx);
+        grpc::ByteBuffer response;
+        grpc::Status status;
+        BenchClock::time_point start = BenchClock::now();
+        std::unique_ptr<grpc::GenericClientAsyncResponseReader> reader =
+            run->stub->PrepareUnaryCall(&ctx, run->mix[index].method->path, run->request, &cq);
+        reader->StartCall();
+        reader->Finish(&response, &status, reader.get());
+        void* tag;
+        bool ok;
+        cq.Next(&tag, &ok);
+        Record(run, samples, index, start, status);
+    }
+    DrainQueue(&cq);
+}
+
+static void OpenLoopCompleter(BenchRun* run, grpc::CompletionQueue* cq, ThreadSamples* samples) {
+    void* tag;
+    bool ok;
+    while (cq->Next(&tag, &ok)) {
+        OpenLoopCall* call = static_cast<OpenLoopCall*>(tag);
+        Record(run, samples, call->methodIndex, call->due, call->status);
+        delete call;
+    }
+}
+
+// Starts calls on schedule, never waiting for earlier ones to complete
+static void OpenLoopIssuer(BenchRun* run, grpc::CompletionQueue* cq, BenchClock::time_point start) {
+    std::random_device seed;
+    std::mt19937 generator(seed());
+    BenchClock::duration interval = std::chrono::duration_cast<BenchClock::duration>(
+            std::chrono::duration<double>(1.0 / run->options.rate));
+    for (long n = 0; ; n++) {
+        BenchClock::time_point due = start + interval * n;
+        if (due >= run->measureEnd) {
+            break;
+        }
+        std::this_thread::sleep_until(due);
+        OpenLoopCall* call = new OpenLoopCall();
+        call->methodIndex = PickMethod(run->mix, &generator);
+        call->due = due;
+        PrepareContext(run, &call->ctx);
+        call->reader = run->stub->PrepareUnaryCall(&call->ctx, run->mix[call->methodIndex].method->path,
+                run->request, cq);
+        call->reader->StartCall();
+        call->reader->Finish(&call->response, &call->status, call);
+    }
+}
+
+// Keeps one EnableIndication stream open through the proxy, counting what arrives
+static void IndicationReader(BenchRun* run, grpc::ClientContext* ctx, std::atomic<unsigned long>* received) {
+    grpc::CompletionQueue cq;
+    void* tag;
+    bool ok;
+    ctx->AddMetadata("authorization", run->authorization);
+    std::unique_ptr<grpc::GenericClientAsyncReaderWriter> stream =
+        run->stub->PrepareCall(ctx, "/openolt.Openolt/EnableIndication", &cq);
+    stream->StartCall(NULL);
+    cq.Next(&tag, &ok);
+    if (ok) {
+        stream->WriteLast(run->request, grpc::WriteOptions(), NULL);
+        cq.Next(&tag, &ok);
+    }
+    grpc::ByteBuffer indication;
+    while (ok) {
+        stream->Read(&indication, NULL);
+        cq.Next(&tag, &ok);
+        if (ok && BenchClock::now() >= run->measureStart && BenchClock::now() < run->measureEnd) {
+            (*received)++;
+        }
+    }
+    grpc::Status status;
+    stream->Finish(&status, NULL);
+    cq.Next(&tag, &ok);
+    DrainQueue(&cq);
+}
+
+static long Percentile(const std::vector<long>& sorted, double q) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t rank = (size_t)std::ceil(q * sorted.size());
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+static void Report(BenchRun* run, const std::vector<ThreadSamples>& samples) {
+    double seconds = run->options.durationSec;
+    std::vector<long> all;
+    unsigned long allErrors = 0;
+    unsigned long codes[BENCH_STATUS_CODES] = { 0 };
+    printf("%-28s %10s %8s %10s %9s %9s %9s\n", "method", "ok", "errors", "ok/s", "p50 ms", "p99 ms",
+            "p999 ms");
+    for (size_t m = 0; m < run->mix.size(); m++) {
+        std::vector<long> latencies;
+        unsigned long errors = 0;
+        for (size_t t = 0; t < samples.size(); t++) {
+            latencies.insert(latencies.end(), samples[t][m].latencies.begin(), samples[t][m].latencies.end());
+            errors += samples[t][m].errors;
+            for (int c = 0; c < BENCH_STATUS_CODES; c++) {
+                codes[c] += samples[t][m].codes[c];
+            }
+        }
+        std::sort(latencies.begin(), latencies.end());
+        printf("%-28s %10zu %8lu %10.1f %9.3f %9.3f %9.3f\n", run->mix[m].method->name, latencies.size(), errors,
+                latencies.size() / seconds, Percentile(latencies, 0.5) / 1e3, Percentile(latencies, 0.99) / 1e3,
+                Percentile(latencies, 0.999) / 1e3);
+        all.insert(all.end(), latencies.begin(), latencies.end());
+        allErrors += errors;
+    }
+    if (run->mix.size() > 1) {
+        std::sort(all.begin(), all.end());
+        printf("%-28s %10zu %8lu %10.1f %9.3f %9.3f %9.3f\n", "total", all.size(), allErrors, all.size() / seconds,
+                Percentile(all, 0.5) / 1e3, Percentile(all, 0.99) / 1e3, Percentile(all, 0.999) / 1e3);
+    }
+    if (allErrors > 0) {
+        printf("errors by status code:");
+        for (int c = 0; c < BENCH_STATUS_CODES; c++) {
+            if (codes[c] > 0) {
+                printf(" %d=%lu", c, codes[c]);
+            }
+        }
+        printf("\n");
+    }
+}
+
+// Upper bound of the bucket holding the q quantile, in microseconds
+static uint64_t HistogramPercentile(const LatencyHistogram::Snapshot& snapshot, double q) {
+    uint64_t rank = (uint64_t)std::ceil(q * snapshot.count);
+    uint64_t seen = 0;
+    for (int i = 0; i < LatencyHistogram::BUCKETS; i++) {
+        seen += snapshot.buckets[i];
+        if (seen >= rank && seen > 0) {
+            return LatencyHistogram::BucketUpperBound(i);
+        }
+    }
+    return 0;
+}
+
+static void ReportTacacsServer(TacacsTestServer* server, unsigned long injected) {
+    static const char* names[] = { NULL, "authentication", "authorization", "accounting" };
+    printf("fake TACACS+ server: %lu connections, %lu resets, %lu errors injected\n", server->accepted.load(),
+            server->resets.load(), injected);
+    for (int type = TAC_PLUS_AUTHEN; type <= TAC_PLUS_ACCT; type++) {
+        LatencyHistogram::Snapshot snapshot;
+        server->sessionTime[type].Read(&snapshot);
+        printf("  %-16s %10lu sessions, p50 %.3f ms, p99 %.3f ms\n", names[type], (unsigned long)snapshot.count,
+                HistogramPercentile(snapshot, 0.5) / 1e3, HistogramPercentile(snapshot, 0.99) / 1e3);
+    }
+}
+
+static void ParseBehavior(const char* prefix, const char* name, const char* value, FakeBehavior* behavior) {
+    size_t len = strlen(prefix);
+    if (strncmp(name, prefix, len) != 0) {
+        return;
+    }
+    if (strcmp(name + len, "_latency_ms") == 0) {
+        behavior->latency_ms = atof(value);
+    } else if (strcmp(name + len, "_jitter_ms") == 0) {
+        behavior->jitter_ms = atof(value);
+    } else if (strcmp(name + len, "_error_rate") == 0) {
+        behavior->error_rate = atof(value);
+    }
+}
+
+int main(int argc, char** argv) {
+    loguru::g_stderr_verbosity = loguru::Verbosity_WARNING;
+    loguru::init(argc, argv);
+
+    BenchOptions options;
+    int proxy_argc = argc;
+    for (int i = 1; i < argc; ++i) {
+        if(strcmp(argv[i], "--") == 0 ) {
+            proxy_argc = i + 1;
+            break;
+        }
+        if(strcmp(argv[i-1], "--proxy_mode") == 0 ) {
+            options.proxyMode = argv[i];
+        } else if(strcmp(argv[i-1], "--proxy_address") == 0 ) {
+            options.proxyAddress = argv[i];
+        } else if(strcmp(argv[i-1], "--loop") == 0 ) {
+            options.loop = argv[i];
+        } else if(strcmp(argv[i-1], "--concurrency") == 0 ) {
+            options.concurrency = atoi(argv[i]);
+        } else if(strcmp(argv[i-1], "--rate") == 0 ) {
+            options.rate = atof(argv[i]);
+        } else if(strcmp(argv[i-1], "--duration_sec") == 0 ) {
+            options.durationSec = atoi(argv[i]);
+        } else if(strcmp(argv[i-1], "--warmup_sec") == 0 ) {
+            options.warmupSec = atoi(argv[i]);
+        } else if(strcmp(argv[i-1], "--timeout_ms") == 0 ) {
+            options.timeoutMs = atoi(argv[i]);
+        } else if(strcmp(argv[i-1], "--mix") == 0 ) {
+            options.mix = argv[i];
+        } else if(strcmp(argv[i-1], "--username") == 0 ) {
+            options.username = argv[i];
+        } else if(strcmp(argv[i-1], "--password") == 0 ) {
+            options.password = argv[i];
+        } else if(strcmp(argv[i-1], "--indication_rate") == 0 ) {
+            options.indicationRate = atof(argv[i]);
+        } else if(strncmp(argv[i-1], "--tacacs_", 9) == 0 ) {
+            ParseBehavior("tacacs", argv[i-1] + 2, argv[i], &options.tacacs);
+        } else if(strncmp(argv[i-1], "--agent_", 8) == 0 ) {
+            ParseBehavior("agent", argv[i-1] + 2, argv[i], &options.agent);
+        }
+    }
+
+    BenchRun run;
+    run.options = options;
+    bool open_loop = strcmp(options.loop, "open") == 0;
+    if (!ParseMix(options.mix, &run.mix) || options.concurrency < 1 || options.durationSec < 1 ||
+            (open_loop && options.rate <= 0)) {
+        fprintf(stderr, "Invalid benchmark options\n");
+        return 1;
+    }
+
+    // The fake TACACS+ server accepts the bench user, after the configured
+    // delay, and fails its share of requests with an ERROR status
+    TacacsTestServer tacacsServer(BENCH_TACACS_KEY);
+    std::atomic<unsigned long> tacacsErrors(0);
+    tacacsServer.AddUser(options.username, options.password);
+    tacacsServer.SetHandler([&](const TacacsTestRequest& request) {
+        TacacsTestReply reply = tacacsServer.DefaultReply(request);
+        reply.delay = options.tacacs.Delay();
+        if (options.tacacs.Fail()) {
+            tacacsErrors++;
+            reply.status = TacacsTestServer::ErrorStatus(request.header.type);
+        }
+        return reply;
+    });
+    FakeOpenoltAgent agent(options.agent, options.indicationRate);
+    if (!tacacsServer.Start("127.0.0.1:0") || !agent.Start("127.0.0.1:0")) {
+        return 1;
+    }
+
+    // The proxy keeps pointers into its arguments for as long as it runs
+    static std::vector<std::string> proxy_args;
+    proxy_args.push_back(argv[0]);
+    proxy_args.push_back("--interface_address");
+    proxy_args.push_back(options.proxyAddress);
+    proxy_args.push_back("--openolt_agent_address");
+    proxy_args.push_back("127.0.0.1:" + std::to_string(agent.Port()));
+    proxy_args.push_back("--tacacs_server_address");
+    proxy_args.push_back("127.0.0.1:" + std::to_string(tacacsServer.Port()));
+    proxy_args.push_back("--tacacs_secure_key");
+    proxy_args.push_back(BENCH_TACACS_KEY);
+    proxy_args.push_back("--proxy_mode");
+    proxy_args.push_back(options.proxyMode);
+    for (int i = proxy_argc; i < argc; i++) {
+        proxy_args.push_back(argv[i]);
+    }
+    static std::vector<char*> proxy_argv;
+    for (size_t i = 0; i < proxy_args.size(); i++) {
+        proxy_argv.push_back(&proxy_args[i][0]);
+    }
+    std::thread(RunServer, (int)proxy_argv.size(), proxy_argv.data()).detach();
+
+    std::shared_ptr<grpc::Channel> channel = grpc::CreateChannel(options.proxyAddress,
+            grpc::InsecureChannelCredentials());
+    if (!channel->WaitForConnected(std::chrono::system_clock::now() + std::chrono::seconds(BENCH_STARTUP_SEC))) {
+        fprintf(stderr, "Proxy did not start listening on %s\n", options.proxyAddress);
+        return 1;
+    }
+    run.stub.reset(new grpc::GenericStub(channel));
+    run.authorization = "Basic " + Base64Encode(std::string(options.username) + ":" + options.password);
+    grpc::Slice empty("", 0);
+    run.request = grpc::ByteBuffer(&empty, 1);
+
+    BenchClock::time_point start = BenchClock::now();
+    run.measureStart = start + std::chrono::seconds(options.warmupSec);
+    run.measureEnd = run.measureStart + std::chrono::seconds(options.durationSec);
+
+    std::atomic<unsigned long> indications(0);
+    grpc::ClientContext indicationCtx;
+    std::thread indicationReader;
+    if (options.indicationRate > 0) {
+        indicationReader = std::thread(IndicationReader, &run, &indicationCtx, &indications);
+    }
+
+    std::vector<ThreadSamples> samples(options.concurrency, ThreadSamples(run.mix.size()));
+    std::vector<std::thread> workers;
+    if (open_loop) {
+        grpc::CompletionQueue cq;
+        for (int i = 0; i < options.concurrency; i++) {
+            workers.push_back(std::thread(OpenLoopCompleter, &run, &cq, &samples[i]));
+        }
+        OpenLoopIssuer(&run, &cq, start);
+        // Calls still outstanding end by their deadline at the latest
+        cq.Shutdown();
+        for (size_t i = 0; i < workers.size(); i++) {
+            workers[i].join();
+        }
+    } else {
+        for (int i = 0; i < options.concurrency; i++) {
+            workers.push_back(std::thread(ClosedLoopWorker, &run, &samples[i]));
+        }
+        for (size_t i = 0; i < workers.size(); i++) {
+            workers[i].join();
+        }
+    }
+
+    if (indicationReader.joinable()) {
+        indicationCtx.TryCancel();
+        indicationReader.join();
+    }
+
+    if (open_loop) {
+        printf("proxy mode %s, open loop at %.0f calls/s, %d s\n", options.proxyMode, options.rate,
+                options.durationSec);
+    } else {
+        printf("proxy mode %s, closed loop with %d calls outstanding, %d s\n", options.proxyMode,
+                options.concurrency, options.durationSec);
+    }
+    Report(&run, samples);
+    ReportTacacsServer(&tacacsServer, tacacsErrors);
+    printf("fake openolt agent: %lu calls, %lu errors injected\n", agent.calls.load(), agent.errors.load());
+    if (options.indicationRate > 0) {
+        printf("indications: %lu received, %.1f/s\n", indications.load(), indications / (double)options.durationSec);
+    }
+    fflush(stdout);
+
+    // The proxy has no way to stop short of the process exiting, and its
+    // threads still use the objects torn down by a normal exit
+    _exit(0);
+}
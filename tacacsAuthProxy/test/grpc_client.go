@@ -24,14 +24,20 @@ import (
         "log"
         "flag"
         "encoding/base64"
+        "sync"
+        "sync/atomic"
         "time"
 
         "google.golang.org/grpc"
+        "google.golang.org/grpc/codes"
+        "google.golang.org/grpc/status"
         pb "github.com/opencord/voltha-protos/go/openolt"
 )
 
 var host, port string
 var username, password string
+var badPassword string
+var parallel, requests int
 
 const (
         defaultHost     = "192.168.10.243"
@@ -45,6 +51,9 @@ func init() {
         flag.StringVar(&port, "server_port", defaultPort, "Listen Port of Remote Server")
         flag.StringVar(&username, "username", defaultUsername, "Username for authentication")
         flag.StringVar(&password, "password", defaultPassword, "Password for authentication")
+        flag.IntVar(&parallel, "parallel", 0, "Stress test: number of concurrent clients sending HeartbeatCheck calls")
+        flag.IntVar(&requests, "requests", 100, "Stress test: number of calls per client")
+        flag.StringVar(&badPassword, "bad_password", "", "Stress test: wrong password used by every other client, whose calls must fail authentication")
 }
 
 type basicAuthRpcCreds struct {
@@ -63,14 +72,69 @@ func (cred *basicAuthRpcCreds) RequireTransportSecurity() bool {
         return false
 }
 
+func dial(user string, secret string) *grpc.ClientConn {
+        conn, err := grpc.Dial(host + ":" + port, grpc.WithInsecure(), grpc.WithBlock(), grpc.WithPerRPCCredentials(&basicAuthRpcCreds{user: user, secret: secret}))
+        if err != nil {
+                log.Fatalf("did not connect: %v", err)
+        }
+        return conn
+}
+
+// Runs concurrent calls with valid and, optionally, invalid credentials. A
+// call whose authentication result does not match its own credentials means
+// TACACS+ replies were crossed between requests.
+func stress() {
+        var wg sync.WaitGroup
+        var crossed, failed int64
+        start := time.Now()
+
+        for i := 0; i < parallel; i++ {
+                expectFail := badPassword != "" && i % 2 == 1
+                secret := password
+                if expectFail {
+                        secret = badPassword
+                }
+                conn := dial(username, secret)
+                defer conn.Close()
+                c := pb.NewOpenoltClient(conn)
+
+                wg.Add(1)
+                go func() {
+                        defer wg.Done()
+                        for j := 0; j < requests; j++ {
+                                ctx, cancel := context.WithTimeout(context.Background(), 10 * time.Second)
+                                _, err := c.HeartbeatCheck(ctx, new(pb.Empty))
+                                cancel()
+                                // Only a verdict meant for the other password is crossed,
+                                // timeouts and unavailable servers are plain errors
+                                code := status.Code(err)
+                                if (expectFail && code == codes.OK) || (!expectFail && code == codes.Unauthenticated) {
+                                        atomic.AddInt64(&crossed, 1)
+                                } else if code != codes.OK && code != codes.Unauthenticated {
+                                        atomic.AddInt64(&failed, 1)
+                                }
+                        }
+                }()
+        }
+        wg.Wait()
+
+        total := parallel * requests
+        log.Printf("%d calls in %v, %d with crossed auth results, %d other errors", total, time.Since(start), crossed, failed)
+        if crossed != 0 {
+                log.Fatalf("stress test FAILED")
+        }
+}
+
 func main() {
         flag.Parse()
 
-        // Set up a connection to the server.
-        conn, err := grpc.Dial(host + ":" + port, grpc.WithInsecure(), grpc.WithBlock(), grpc.WithPerRPCCredentials(&basicAuthRpcCreds{user: username, secret: password}))
-        if err != nil {
-                log.Fatalf("did not connect: %v", err)
+        if parallel > 0 {
+                stress()
+                return
         }
+
+        // Set up a connection to the server.
+        conn := dial(username, password)
         defer conn.Close()
 
         c := pb.NewOpenoltClient(conn)
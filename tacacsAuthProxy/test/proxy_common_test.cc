@@ -0,0 +1,69 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+// Parsing of the Basic credentials of a call
+
+#include <string>
+#include <gtest/gtest.h>
+
+#include "proxy_common.h"
+
+static bool Parse(const std::string& header, std::string* username, std::string* password) {
+    BasicCredentials credentials;
+    if (!ParseBasicCredentials(grpc::string_ref(header.data(), header.size()), &credentials)) {
+        return false;
+    }
+    username->assign(credentials.username, credentials.username_len);
+    password->assign(credentials.password, credentials.password_len);
+    return true;
+}
+
+TEST(BasicCredentialsTest, Decodes) {
+    std::string username;
+    std::string password;
+
+    // alice:secret
+    ASSERT_TRUE(Parse("Basic YWxpY2U6c2VjcmV0", &username, &password));
+    EXPECT_EQ("alice", username);
+    EXPECT_EQ("secret", password);
+
+    // bob:pw, padded and not
+    ASSERT_TRUE(Parse("Basic Ym9iOnB3", &username, &password));
+    EXPECT_EQ("bob", username);
+    ASSERT_TRUE(Parse("basic Ym9iOnB3Pw==", &username, &password));
+    EXPECT_EQ("pw?", password);
+    ASSERT_TRUE(Parse("Basic Ym9iOnB3Pw", &username, &password));
+    EXPECT_EQ("pw?", password);
+
+    // Only the first colon separates, a:b:c
+    ASSERT_TRUE(Parse("Basic YTpiOmM=", &username, &password));
+    EXPECT_EQ("a", username);
+    EXPECT_EQ("b:c", password);
+}
+
+TEST(BasicCredentialsTest, Rejects) {
+    std::string username;
+    std::string password;
+
+    EXPECT_FALSE(Parse("", &username, &password));
+    EXPECT_FALSE(Parse("Basic ", &username, &password));
+    EXPECT_FALSE(Parse("Bearer YWxpY2U6c2VjcmV0", &username, &password));
+    EXPECT_FALSE(Parse("BasicYWxpY2U6c2VjcmV0", &username, &password));
+    // alicesecret, no separator
+    EXPECT_FALSE(Parse("Basic YWxpY2VzZWNyZXQ=", &username, &password));
+    EXPECT_FALSE(Parse("Basic YWxp!2U6c2VjcmV0", &username, &password));
+    EXPECT_FALSE(Parse("Basic YWxpY2U6c2VjcmV0=", &username, &password));
+    EXPECT_FALSE(Parse("Basic " + std::string(1024, 'Q'), &username, &password));
+}
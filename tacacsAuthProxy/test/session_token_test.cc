@@ -0,0 +1,97 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+// Issuing and validating session tokens
+
+#include <fstream>
+#include <gtest/gtest.h>
+
+#include "session_token.h"
+
+#define TEST_PEER "ipv4:10.0.0.1:50312"
+
+static SessionTokenClaims Claims(const char* username, time_t expiry) {
+    SessionTokenClaims claims;
+    claims.username = username;
+    claims.expiry = expiry;
+    claims.commands.push_back("heartbeat");
+    claims.commands.push_back("reboot");
+    return claims;
+}
+
+TEST(SessionTokensTest, RoundTrip) {
+    SessionTokens tokens(60, NULL);
+    std::string token = tokens.Issue(TEST_PEER, Claims("alice", 0));
+    ASSERT_FALSE(token.empty());
+
+    // Another connection from the same host
+    SessionTokenClaims claims;
+    ASSERT_TRUE(tokens.Validate(token, "ipv4:10.0.0.1:40000", &claims));
+    EXPECT_EQ("alice", claims.username);
+    EXPECT_GT(claims.expiry, time(NULL));
+    EXPECT_LE(claims.expiry, time(NULL) + 60);
+    ASSERT_EQ(2u, claims.commands.size());
+    EXPECT_EQ("reboot", claims.commands[1]);
+    EXPECT_EQ(1u, tokens.accepted.load());
+}
+
+TEST(SessionTokensTest, Rejections) {
+    SessionTokens tokens(60, NULL);
+    SessionTokens other(60, NULL);
+    std::string token = tokens.Issue(TEST_PEER, Claims("alice", 0));
+    std::string tampered = token;
+    tampered[2] = (tampered[2] == 'A') ? 'B' : 'A';
+    SessionTokenClaims claims;
+
+    EXPECT_FALSE(tokens.Validate(tampered, TEST_PEER, &claims));
+    EXPECT_FALSE(other.Validate(token, TEST_PEER, &claims));
+    EXPECT_EQ(1u, tokens.rejected[SESSION_TOKEN_BAD_SIGNATURE].load());
+
+    EXPECT_FALSE(tokens.Validate("not a token", TEST_PEER, &claims));
+    EXPECT_FALSE(tokens.Validate(token.substr(0, token.find('.')), TEST_PEER, &claims));
+    EXPECT_EQ(2u, tokens.rejected[SESSION_TOKEN_MALFORMED].load());
+
+    EXPECT_FALSE(tokens.Validate(token, "ipv4:10.0.0.2:50312", &claims));
+    EXPECT_EQ(1u, tokens.rejected[SESSION_TOKEN_WRONG_PEER].load());
+
+    EXPECT_FALSE(tokens.Validate(tokens.Issue(TEST_PEER, Claims("alice", time(NULL) - 1)), TEST_PEER, &claims));
+    EXPECT_EQ(1u, tokens.rejected[SESSION_TOKEN_EXPIRED].load());
+    EXPECT_EQ(0u, tokens.accepted.load());
+}
+
+TEST(SessionTokensTest, SharedKeyFile) {
+    char path[] = "/tmp/session_token_testXXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    close(fd);
+    std::ofstream(path) << "0123456789abcdef0123456789abcdef";
+
+    SessionTokens first(60, path);
+    SessionTokens second(60, path);
+    SessionTokenClaims claims;
+    EXPECT_TRUE(second.Validate(first.Issue(TEST_PEER, Claims("alice", 0)), TEST_PEER, &claims));
+
+    // Too short a key disables tokens rather than weakening them
+    std::ofstream(path) << "short";
+    SessionTokens weak(60, path);
+    EXPECT_FALSE(weak.Enabled());
+    unlink(path);
+}
+
+TEST(SessionTokensTest, PeerHost) {
+    EXPECT_EQ("ipv4:10.0.0.1", SessionTokens::PeerHost("ipv4:10.0.0.1:50312"));
+    EXPECT_EQ("ipv6:[::1]", SessionTokens::PeerHost("ipv6:[::1]:50312"));
+    EXPECT_EQ("unix:/tmp/socket", SessionTokens::PeerHost("unix:/tmp/socket"));
+}
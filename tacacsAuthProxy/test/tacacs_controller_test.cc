@@ -0,0 +1,527 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// TaccController against the embedded test server: outcomes of the
+// TACACS+ exchanges, then pooling, caching, failover and circuit breaking
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <gtest/gtest.h>
+
+#include "metrics.h"
+#include "proxy_methods.h"
+#include "tacacs_controller.h"
+#include "tacacs_test_server.h"
+
+#define TEST_KEY "testkey"
+
+// Counts the verdicts of calls run on the engine
+struct AsyncVerdicts {
+    std::mutex lock;
+    std::condition_variable cond;
+    int done;
+    int passed;
+
+    AsyncVerdicts() : done(0), passed(0) {}
+
+    TaccCallback Callback() {
+        return [this](const Status& status) {
+            std::lock_guard<std::mutex> guard(lock);
+            done++;
+            passed += status.ok() ? 1 : 0;
+            cond.notify_all();
+        };
+    }
+
+    // False if fewer than calls are done within timeout
+    bool WaitFor(int calls, std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> guard(lock);
+        return cond.wait_for(guard, timeout, [this, calls] { return done >= calls; });
+    }
+};
+
+class TaccControllerTest : public ::testing::Test {
+    protected:
+    TacacsTestServer server;
+    TaccOptions options;
+    // Controllers keep a pointer to their addresses, and go first
+    std::list<std::string> addresses;
+    std::vector<std::unique_ptr<TaccController> > controllers;
+
+    TaccControllerTest() : server(TEST_KEY) {}
+
+    void SetUp() override {
+        ASSERT_TRUE(server.Start());
+        server.AddUser("alice", "secret");
+        server.DenyCommand("reboot");
+        options.auth_cache_ttl = 0;
+        options.auth_cache_negative_ttl = 0;
+        options.author_cache_ttl = 0;
+        options.author_cache_negative_ttl = 0;
+        options.engine_threads = 0;
+        options.pool_warm_connections = 0;
+    }
+
+    TaccController* NewController(const std::string& servers, bool fallback_pass = false) {
+        addresses.push_back(servers);
+        controllers.emplace_back(new TaccController(addresses.back().c_str(), TEST_KEY, fallback_pass, options));
+        return controllers.back().get();
+    }
+
+    // The server records a session once its reply is written, which may be
+    // just after the client read it
+    std::vector<TacacsTestSession> WaitForSessions(size_t count) {
+        std::vector<TacacsTestSession> sessions = server.Sessions();
+        for (int i = 0; i < 100 && sessions.size() < count; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            sessions = server.Sessions();
+        }
+        return sessions;
+    }
+
+    static TacacsContext Context(const char* username, const char* password, const char* method) {
+        TacacsContext tacCtx;
+        tacCtx.username = username;
+        tacCtx.password = password;
+        tacCtx.remote_addr = "127.0.0.1:50000";
+        tacCtx.method_name = TacacsCommand(method);
+        return tacCtx;
+    }
+};
+
+TEST_F(TaccControllerTest, PapPassAndFail) {
+    TaccController* controller = NewController(server.Address());
+    TacacsContext good = Context("alice", "secret", "HeartbeatCheck");
+    TacacsContext bad = Context("alice", "wrong", "HeartbeatCheck");
+    TacacsContext unknown = Context("bob", "secret", "HeartbeatCheck");
+
+    EXPECT_EQ(grpc::OK, controller->AuthenticateAndAuthorize(&good).error_code());
+    EXPECT_EQ(grpc::UNAUTHENTICATED, controller->Authenticate(&bad).error_code());
+    EXPECT_EQ(grpc::UNAUTHENTICATED, controller->Authenticate(&unknown).error_code());
+}
+
+TEST_F(TaccControllerTest, PasswordPrompt) {
+    server.PromptPassword(true);
+    server.RecordSessions(true);
+    TaccController* controller = NewController(server.Address());
+    TacacsContext tacCtx = Context("alice", "secret", "HeartbeatCheck");
+
+    EXPECT_EQ(grpc::OK, controller->Authenticate(&tacCtx).error_code());
+    std::vector<TacacsTestSession> sessions = WaitForSessions(1);
+    ASSERT_EQ(1u, sessions.size());
+    EXPECT_EQ(TAC_PLUS_AUTHEN, sessions[0].type);
+    EXPECT_EQ(2, sessions[0].packets);
+    EXPECT_EQ(TAC_PLUS_AUTHEN_STATUS_PASS, sessions[0].status);
+}
+
+TEST_F(TaccControllerTest, DeniedCommand) {
+    server.RecordSessions(true);
+    TaccController* controller = NewController(server.Address());
+    TacacsContext tacCtx = Context("alice", "secret", "Reboot");
+
+    EXPECT_EQ(grpc::PERMISSION_DENIED, controller->AuthenticateAndAuthorize(&tacCtx).error_code());
+    std::vector<TacacsTestSession> sessions = WaitForSessions(2);
+    ASSERT_EQ(2u, sessions.size());
+    EXPECT_EQ(TAC_PLUS_AUTHOR, sessions[1].type);
+    EXPECT_EQ("reboot", sessions[1].cmd);
+    EXPECT_EQ(TAC_PLUS_AUTHOR_STATUS_FAIL, sessions[1].status);
+}
+
+TEST_F(TaccControllerTest, ConcurrentCallsKeepTheirVerdicts) {
+    const int threads = 8;
+    const int calls = 25;
+    server.AddUser("bob", "hunter2");
+    TaccController* controller = NewController(server.Address());
+
+    // Odd threads use a wrong password, no call may get the other one's answer
+    std::atomic<int> crossed(0);
+    std::atomic<int> errors(0);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.push_back(std::thread([&, t] {
+            bool good = t % 2 == 0;
+            for (int i = 0; i < calls; i++) {
+                TacacsContext tacCtx = good ? Context("alice", "secret", "HeartbeatCheck") :
+                    Context("bob", "wrong", "HeartbeatCheck");
+                grpc::StatusCode code = controller->AuthenticateAndAuthorize(&tacCtx).error_code();
+                if ((good && code == grpc::UNAUTHENTICATED) || (!good && code == grpc::OK)) {
+                    crossed++;
+                } else if (code != (good ? grpc::OK : grpc::UNAUTHENTICATED)) {
+                    errors++;
+                }
+            }
+        }));
+    }
+    for (size_t t = 0; t < workers.size(); t++) {
+        workers[t].join();
+    }
+    EXPECT_EQ(0, crossed.load());
+    EXPECT_EQ(0, errors.load());
+    EXPECT_EQ((unsigned long)(threads * calls), server.requests[TAC_PLUS_AUTHEN].load());
+}
+
+TEST_F(TaccControllerTest, SessionTiming) {
+    server.RecordSessions(true);
+    server.SetHandler([this](const TacacsTestRequest& request) {
+        TacacsTestReply reply = server.DefaultReply(request);
+        reply.delay = std::chrono::milliseconds(50);
+        return reply;
+    });
+    TaccController* controller = NewController(server.Address());
+    TacacsContext tacCtx = Context("alice", "secret", "HeartbeatCheck");
+
+    EXPECT_EQ(grpc::OK, controller->Authenticate(&tacCtx).error_code());
+    std::vector<TacacsTestSession> sessions = WaitForSessions(1);
+    ASSERT_EQ(1u, sessions.size());
+    EXPECT_GE(sessions[0].end - sessions[0].start, std::chrono::milliseconds(50));
+    LatencyHistogram::Snapshot snapshot;
+    server.sessionTime[TAC_PLUS_AUTHEN].Read(&snapshot);
+    EXPECT_EQ(1u, snapshot.count);
+}
+
+TEST_F(TaccControllerTest, AuthCacheSkipsServer) {
+    options.auth_cache_ttl = 60;
+    TaccController* controller = NewController(server.Address());
+
+    for (int i = 0; i < 5; i++) {
+        TacacsContext tacCtx = Context("alice", "secret", "HeartbeatCheck");
+        EXPECT_EQ(grpc::OK, controller->Authenticate(&tacCtx).error_code());
+    }
+    EXPECT_EQ(1u, server.requests[TAC_PLUS_AUTHEN].load());
+}
+
+TEST_F(TaccControllerTest, SessionTokenSkipsServer) {
+    TaccController* controller = NewController(server.Address());
+    TacacsContext tacCtx = Context("alice", "", "HeartbeatCheck");
+    tacCtx.token_authenticated = true;
+    tacCtx.token_commands.push_back(TacacsCommand("HeartbeatCheck"));
+
+    EXPECT_EQ(grpc::OK, controller->AuthenticateAndAuthorize(&tacCtx).error_code());
+    EXPECT_EQ(0u, server.requests[TAC_PLUS_AUTHEN].load());
+    EXPECT_EQ(0u, server.requests[TAC_PLUS_AUTHOR].load());
+
+    // Commands the token does not carry still go to the server
+    tacCtx.method_name = TacacsCommand("Reboot");
+    EXPECT_EQ(grpc::PERMISSION_DENIED, controller->AuthenticateAndAuthorize(&tacCtx).error_code());
+    EXPECT_EQ(0u, server.requests[TAC_PLUS_AUTHEN].load());
+    EXPECT_EQ(1u, server.requests[TAC_PLUS_AUTHOR].load());
+    EXPECT_FALSE(tacCtx.unverified_pass);
+}
+
+TEST_F(TaccControllerTest, FallbackPassIsUnverified) {
+    server.Stop();
+    TaccController* controller = NewController(server.Address(), true);
+    TacacsContext tacCtx = Context("alice", "secret", "HeartbeatCheck");
+
+    EXPECT_EQ(grpc::OK, controller->AuthenticateAndAuthorize(&tacCtx).error_code());
+    EXPECT_TRUE(tacCtx.unverified_pass);
+}
+
+TEST_F(TaccControllerTest, ShortDeadlineNeverFallsBack) {
+    server.SetHandler([this](const TacacsTestRequest& request) {
+        TacacsTestReply reply = server.DefaultReply(request);
+        reply.delay = std::chrono::milliseconds(300);
+        return reply;
+    });
+    TaccController* blocking = NewController(server.Address(), true);
+    options.engine_threads = 1;
+    TaccController* engine = NewController(server.Address(), true);
+
+    // The budget runs out long before the configured timeout
+    TacacsContext tacCtx = Context("alice", "wrong", "HeartbeatCheck");
+    tacCtx.deadline = TaccClock::now() + std::chrono::milliseconds(200);
+    blocking->AllotBudget(&tacCtx);
+    EXPECT_EQ(grpc::DEADLINE_EXCEEDED, blocking->Authenticate(&tacCtx).error_code());
+    EXPECT_FALSE(tacCtx.unverified_pass);
+
+    tacCtx = Context("alice", "wrong", "HeartbeatCheck");
+    tacCtx.deadline = TaccClock::now() + std::chrono::milliseconds(200);
+    engine->AllotBudget(&tacCtx);
+    std::promise<Status> status;
+    engine->AuthenticateAsync(&tacCtx, [&status](const Status& result) { status.set_value(result); });
+    std::future<Status> result = status.get_future();
+    ASSERT_EQ(std::future_status::ready, result.wait_for(std::chrono::seconds(10)));
+    EXPECT_EQ(grpc::DEADLINE_EXCEEDED, result.get().error_code());
+    EXPECT_FALSE(tacCtx.unverified_pass);
+}
+
+TEST_F(TaccControllerTest, CleartextReplyRejected) {
+    server.SendCleartext(true);
+    TaccController* blocking = NewController(server.Address());
+    options.engine_threads = 1;
+    TaccController* engine = NewController(server.Address());
+
+    TacacsContext tacCtx = Context("alice", "secret", "HeartbeatCheck");
+    EXPECT_EQ(grpc::UNAVAILABLE, blocking->Authenticate(&tacCtx).error_code());
+    tacCtx = Context("alice", "secret", "HeartbeatCheck");
+    std::promise<Status> status;
+    engine->AuthenticateAsync(&tacCtx, [&status](const Status& result) { status.set_value(result); });
+    std::future<Status> result = status.get_future();
+    ASSERT_EQ(std::future_status::ready, result.wait_for(std::chrono::seconds(10)));
+    EXPECT_EQ(grpc::UNAVAILABLE, result.get().error_code());
+    EXPECT_EQ(2u, server.requests[TAC_PLUS_AUTHEN].load());
+}
+
+TEST_F(TaccControllerTest, SingleConnectReusesConnection) {
+    TaccController* controller = NewController(server.Address());
+
+    for (int i = 0; i < 10; i++) {
+        TacacsContext tacCtx = Context("alice", "secret", "HeartbeatCheck");
+        EXPECT_EQ(grpc::OK, controller->Authenticate(&tacCtx).error_code());
+    }
+    EXPECT_EQ(10u, server.requests[TAC_PLUS_AUTHEN].load());
+    EXPECT_EQ(1u, server.accepted.load());
+}
+
+TEST_F(TaccControllerTest, ConnectionPerSessionWithoutSingleConnect) {
+    server.AcceptSingleConnect(false);
+    TaccController* controller = NewController(server.Address());
+
+    for (int i = 0; i < 10; i++) {
+        TacacsContext tacCtx = Context("alice", "secret", "HeartbeatCheck");
+        EXPECT_EQ(grpc::OK, controller->Authenticate(&tacCtx).error_code());
+    }
+    EXPECT_EQ(10u, server.accepted.load());
+}
+
+TEST_F(TaccControllerTest, ResetFailsOver) {
+    TacacsTestServer broken(TEST_KEY);
+    ASSERT_TRUE(broken.Start());
+    broken.SetHandler([](const TacacsTestRequest& request) {
+        TacacsTestReply reply;
+        reply.action = TACACS_TEST_RESET;
+        return reply;
+    });
+    TaccController* controller = NewController(broken.Address() + "," + server.Address());
+
+    for (int i = 0; i < 3; i++) {
+        TacacsContext tacCtx = Context("alice", "secret", "HeartbeatCheck");
+        EXPECT_EQ(grpc::OK, controller->Authenticate(&tacCtx).error_code());
+    }
+    EXPECT_EQ(3u, server.requests[TAC_PLUS_AUTHEN].load());
+    EXPECT_EQ(broken.requests[TAC_PLUS_AUTHEN].load(), broken.resets.load());
+}
+
+TEST_F(TaccControllerTest, BreakerStopsAskingUnresponsiveServer) {
+    server.SetHandler([](const TacacsTestRequest& request) {
+        TacacsTestReply reply;
+        reply.action = TACACS_TEST_IGNORE;
+        return reply;
+    });
+    options.authen_timeout_ms = 200;
+    options.breaker_failures = 2;
+    options.breaker_open_sec = 60;
+    TaccController* controller = NewController(server.Address());
+
+    for (int i = 0; i < 5; i++) {
+        TacacsContext tacCtx = Context("alice", "secret", "HeartbeatCheck");
+        EXPECT_EQ(grpc::UNAVAILABLE, controller->Authenticate(&tacCtx).error_code());
+    }
+    EXPECT_EQ(2u, server.requests[TAC_PLUS_AUTHEN].load());
+    std::string metrics = ProxyMetrics::Instance().Render();
+    std::string labels = "{server=\"" + server.Address() + "\"";
+    EXPECT_NE(std::string::npos, metrics.find("tacacs_proxy_server_breaker_rejected_total" + labels + "} 3"));
+    EXPECT_NE(std::string::npos, metrics.find("tacacs_proxy_server_breaker_transitions_total" + labels + ",to=\"open\"} 1"));
+    EXPECT_NE(std::string::npos, metrics.find("tacacs_proxy_server_breaker_transitions_total" + labels + ",to=\"closed\"} 0"));
+}
+
+TEST_F(TaccControllerTest, ShortDeadlinesDoNotOpenBreaker) {
+    server.AddUser("bob", "hunter2");
+    server.SetHandler([this](const TacacsTestRequest& request) {
+        TacacsTestReply reply = server.DefaultReply(request);
+        if (request.user == "alice") {
+            reply.delay = std::chrono::milliseconds(300);
+        }
+        return reply;
+    });
+    options.breaker_failures = 1;
+    options.breaker_open_sec = 60;
+    TaccController* blocking = NewController(server.Address());
+    options.engine_threads = 1;
+    options.engine_connections = 1;
+    TaccController* engine = NewController(server.Address());
+
+    TacacsContext tacCtx = Context("alice", "secret", "HeartbeatCheck");
+    tacCtx.deadline = TaccClock::now() + std::chrono::milliseconds(200);
+    blocking->AllotBudget(&tacCtx);
+    EXPECT_EQ(grpc::DEADLINE_EXCEEDED, blocking->Authenticate(&tacCtx).error_code());
+    tacCtx = Context("alice", "secret", "HeartbeatCheck");
+    EXPECT_EQ(grpc::OK, blocking->Authenticate(&tacCtx).error_code());
+
+    // Bob is answered at once and settles single-connect for the others
+    const int calls = 4;
+    std::vector<TacacsContext> contexts(calls, Context("alice", "secret", "HeartbeatCheck"));
+    contexts[0] = Context("bob", "hunter2", "HeartbeatCheck");
+    std::vector<std::promise<Status> > statuses(calls);
+    for (int i = 0; i < calls; i++) {
+        // Odd calls give up long before the server answers
+        if (i % 2 == 1) {
+            contexts[i].deadline = TaccClock::now() + std::chrono::milliseconds(200);
+            engine->AllotBudget(&contexts[i]);
+        }
+        engine->AuthenticateAsync(&contexts[i], [&statuses, i](const Status& result) {
+            statuses[i].set_value(result);
+        });
+        if (i == 0) {
+            ASSERT_EQ(std::future_status::ready, statuses[0].get_future().wait_for(std::chrono::seconds(10)));
+        }
+    }
+    for (int i = 1; i < calls; i++) {
+        std::future<Status> result = statuses[i].get_future();
+        ASSERT_EQ(std::future_status::ready, result.wait_for(std::chrono::seconds(10)));
+        EXPECT_EQ(i % 2 == 1 ? grpc::DEADLINE_EXCEEDED : grpc::OK, result.get().error_code());
+    }
+    // A blocking session left unanswered takes its connection with it, the
+    // engine kept its one
+    EXPECT_EQ(3u, server.accepted.load());
+}
+
+TEST_F(TaccControllerTest, EngineMultiplexesSessions) {
+    const int calls = 50;
+    // Sessions the server holds a reply for as each request comes in
+    std::mutex lock;
+    std::vector<std::chrono::steady_clock::time_point> due;
+    size_t overlap = 0;
+    server.SetHandler([&](const TacacsTestRequest& request) {
+        TacacsTestReply reply = server.DefaultReply(request);
+        reply.delay = std::chrono::milliseconds(20);
+        std::lock_guard<std::mutex> guard(lock);
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        due.erase(std::remove_if(due.begin(), due.end(),
+                    [now](std::chrono::steady_clock::time_point t) { return t <= now; }), due.end());
+        due.push_back(now + reply.delay);
+        overlap = std::max(overlap, due.size());
+        return reply;
+    });
+    options.engine_threads = 1;
+    options.engine_connections = 1;
+    TaccController* controller = NewController(server.Address());
+
+    std::vector<TacacsContext> contexts(calls, Context("alice", "secret", "HeartbeatCheck"));
+    AsyncVerdicts verdicts;
+    for (int i = 0; i < calls; i++) {
+        controller->AuthenticateAsync(&contexts[i], verdicts.Callback());
+    }
+    ASSERT_TRUE(verdicts.WaitFor(calls, std::chrono::seconds(10)));
+    EXPECT_EQ(calls, verdicts.passed);
+    // Sequential sessions would never have more than one waiting for its reply
+    std::lock_guard<std::mutex> guard(lock);
+    EXPECT_GT(overlap, 1u);
+    EXPECT_LE(server.accepted.load(), 2u);
+}
+
+TEST_F(TaccControllerTest, EngineSurvivesResetAfterSingleConnectReply) {
+    const int calls = 5;
+    std::atomic<int> answered(0);
+    server.SetHandler([this, &answered](const TacacsTestRequest& request) {
+        TacacsTestReply reply = server.DefaultReply(request);
+        if (answered++ == 0) {
+            // Gives the other sessions time to queue up behind the negotiation
+            reply.action = TACACS_TEST_REPLY_RESET;
+            reply.delay = std::chrono::milliseconds(100);
+        }
+        return reply;
+    });
+    options.engine_threads = 1;
+    options.engine_connections = 1;
+    TaccController* controller = NewController(server.Address());
+
+    std::vector<TacacsContext> contexts(calls, Context("alice", "secret", "HeartbeatCheck"));
+    std::mutex lock;
+    std::condition_variable cond;
+    int done = 0;
+    for (int i = 0; i < calls; i++) {
+        controller->AuthenticateAsync(&contexts[i], [&](const Status& status) {
+            std::unique_lock<std::mutex> guard(lock);
+            bool first = done++ == 0;
+            cond.notify_all();
+            guard.unlock();
+            if (first) {
+                EXPECT_TRUE(status.ok());
+                // Holds the I/O thread until the reset is in, so starting
+                // the held back sessions hits a send error
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+        });
+    }
+    std::unique_lock<std::mutex> guard(lock);
+    ASSERT_TRUE(cond.wait_for(guard, std::chrono::seconds(10), [&] { return done == calls; }));
+    // Every call is answered exactly once
+    EXPECT_FALSE(cond.wait_for(guard, std::chrono::milliseconds(300), [&] { return done > calls; }));
+    EXPECT_EQ(1u, server.resets.load());
+}
+
+TEST_F(TaccControllerTest, EngineRemembersRefusedSingleConnect) {
+    const int calls = 10;
+    std::atomic<int> asked(0);
+    server.AcceptSingleConnect(false);
+    server.SetHandler([this, &asked](const TacacsTestRequest& request) {
+        if (request.header.flags & TAC_PLUS_SINGLE_CONNECT_FLAG) {
+            asked++;
+        }
+        TacacsTestReply reply = server.DefaultReply(request);
+        reply.delay = std::chrono::milliseconds(20);
+        return reply;
+    });
+    options.engine_threads = 1;
+    options.engine_connections = 1;
+    TaccController* controller = NewController(server.Address());
+
+    for (int round = 0; round < 2; round++) {
+        std::vector<TacacsContext> contexts(calls, Context("alice", "secret", "HeartbeatCheck"));
+        AsyncVerdicts verdicts;
+        for (int i = 0; i < calls; i++) {
+            controller->AuthenticateAsync(&contexts[i], verdicts.Callback());
+        }
+        ASSERT_TRUE(verdicts.WaitFor(calls, std::chrono::seconds(10)));
+        EXPECT_EQ(calls, verdicts.passed);
+    }
+    // Only the first connection asked, the others went without
+    EXPECT_EQ(1, asked.load());
+    EXPECT_EQ(2u * calls, server.accepted.load());
+}
+
+TEST_F(TaccControllerTest, EngineRedispatchesAfterInvalidNegotiation) {
+    const int calls = 5;
+    std::atomic<int> answered(0);
+    server.SetHandler([this, &answered](const TacacsTestRequest& request) {
+        TacacsTestReply reply = server.DefaultReply(request);
+        bool first = answered++ == 0;
+        // The first reply is forged, the sessions queued behind it must not wait for their deadline
+        server.SendCleartext(first);
+        if (first) {
+            reply.delay = std::chrono::milliseconds(100);
+        }
+        return reply;
+    });
+    options.authen_timeout_ms = 5000;
+    options.engine_threads = 1;
+    options.engine_connections = 1;
+    TaccController* controller = NewController(server.Address());
+
+    std::vector<TacacsContext> contexts(calls, Context("alice", "secret", "HeartbeatCheck"));
+    AsyncVerdicts verdicts;
+    for (int i = 0; i < calls; i++) {
+        controller->AuthenticateAsync(&contexts[i], verdicts.Callback());
+    }
+    ASSERT_TRUE(verdicts.WaitFor(calls, std::chrono::seconds(2)));
+    EXPECT_EQ(calls - 1, verdicts.passed);
+}
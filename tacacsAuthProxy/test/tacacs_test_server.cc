@@ -0,0 +1,617 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <condition_variable>
+#include <cstring>
+#include <queue>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "tacacs_test_server.h"
+#include "logger.h"
+
+// Interval at which blocked threads look at the stopping flag
+#define TACACS_TEST_POLL_MS 200
+// Bound on reading the rest of a packet once it started arriving, and on writing a reply
+#define TACACS_TEST_IO_TIMEOUT_MS 5000
+
+typedef std::chrono::steady_clock TestClock;
+
+static void PutShort(std::string* out, uint16_t value) {
+    out->push_back((char)((value >> 8) & 0xff));
+    out->push_back((char)(value & 0xff));
+}
+
+static uint16_t GetShort(const std::string& in, size_t pos) {
+    return (uint16_t)(((uint8_t)in[pos] << 8) | (uint8_t)in[pos + 1]);
+}
+
+static std::string Truncate(const std::string& field, size_t max) {
+    return field.size() > max ? field.substr(0, max) : field;
+}
+
+static std::string AuthenReplyBody(const TacacsTestReply& reply) {
+    std::string msg = Truncate(reply.serverMsg, 0xffff);
+    std::string body;
+    body.push_back((char)reply.status);
+    body.push_back(0);
+    PutShort(&body, (uint16_t)msg.size());
+    PutShort(&body, 0);
+    body += msg;
+    return body;
+}
+
+static std::string AuthorReplyBody(const TacacsTestReply& reply) {
+    std::string msg = Truncate(reply.serverMsg, 0xffff);
+    size_t arg_cnt = reply.args.size() > 255 ? 255 : reply.args.size();
+    std::string body;
+    body.push_back((char)reply.status);
+    body.push_back((char)arg_cnt);
+    PutShort(&body, (uint16_t)msg.size());
+    PutShort(&body, 0);
+    for (size_t i = 0; i < arg_cnt; i++) {
+        body.push_back((char)Truncate(reply.args[i], 255).size());
+    }
+    body += msg;
+    for (size_t i = 0; i < arg_cnt; i++) {
+        body += Truncate(reply.args[i], 255);
+    }
+    return body;
+}
+
+static std::string AcctReplyBody(const TacacsTestReply& reply) {
+    std::string msg = Truncate(reply.serverMsg, 0xffff);
+    std::string body;
+    PutShort(&body, (uint16_t)msg.size());
+    PutShort(&body, 0);
+    body.push_back((char)reply.status);
+    body += msg;
+    return body;
+}
+
+// Fields of an authentication START. False if malformed.
+static bool ParseAuthenStart(const std::string& body, TacacsTestRequest* request) {
+    if (body.size() < 8) {
+        return false;
+    }
+    size_t lens[4] = { (uint8_t)body[4], (uint8_t)body[5], (uint8_t)body[6], (uint8_t)body[7] };
+    if (8 + lens[0] + lens[1] + lens[2] + lens[3] > body.size()) {
+        return false;
+    }
+    request->action = (uint8_t)body[0];
+    request->authenType = (uint8_t)body[2];
+    size_t pos = 8;
+    request->user = body.substr(pos, lens[0]);
+    pos += lens[0];
+    request->port = body.substr(pos, lens[1]);
+    pos += lens[1];
+    request->remAddr = body.substr(pos, lens[2]);
+    pos += lens[2];
+    request->data = body.substr(pos, lens[3]);
+    return true;
+}
+
+static bool ParseAuthenContinue(const std::string& body, TacacsTestRequest* request) {
+    if (body.size() < 5) {
+        return false;
+    }
+    size_t msg_len = GetShort(body, 0);
+    if (5 + msg_len + GetShort(body, 2) > body.size()) {
+        return false;
+    }
+    request->data = body.substr(5, msg_len);
+    return true;
+}
+
+// Authorization request, or accounting request past its flags byte
+static bool ParseArgsRequest(const std::string& body, size_t offset, TacacsTestRequest* request) {
+    if (body.size() < offset + 8) {
+        return false;
+    }
+    size_t user_len = (uint8_t)body[offset + 4];
+    size_t port_len = (uint8_t)body[offset + 5];
+    size_t rem_len = (uint8_t)body[offset + 6];
+    size_t arg_cnt = (uint8_t)body[offset + 7];
+    size_t pos = offset + 8 + arg_cnt;
+    if (pos + user_len + port_len + rem_len > body.size()) {
+        return false;
+    }
+    request->user = body.substr(pos, user_len);
+    pos += user_len;
+    request->port = body.substr(pos, port_len);
+    pos += port_len;
+    request->remAddr = body.substr(pos, rem_len);
+    pos += rem_len;
+    for (size_t i = 0; i < arg_cnt; i++) {
+        size_t len = (uint8_t)body[offset + 8 + i];
+        if (pos + len > body.size()) {
+            return false;
+        }
+        request->args.push_back(body.substr(pos, len));
+        pos += len;
+    }
+    return true;
+}
+
+std::string TacacsTestRequest::Arg(const std::string& name) const {
+    for (size_t i = 0; i < args.size(); i++) {
+        if (args[i].size() > name.size() && args[i].compare(0, name.size(), name) == 0 &&
+                (args[i][name.size()] == '=' || args[i][name.size()] == '*')) {
+            return args[i].substr(name.size() + 1);
+        }
+    }
+    return std::string();
+}
+
+// Reply due to be written, or reset due to happen
+struct TacacsTestOutgoing {
+    TestClock::time_point due;
+    TacacsTestAction action;
+    std::string packet;
+    int status;
+    bool endsSession;
+    bool last;                  // the connection closes once it is written
+    TacacsTestSession session;
+
+    bool operator<(const TacacsTestOutgoing& other) const { return due > other.due; }
+};
+
+// One client connection: the reader answers requests as they arrive, the
+// writer sends each answer once its delay expired
+class TacacsTestConnection {
+    TacacsTestServer* server;
+    int id;
+    std::mutex lock;
+    int fd;
+    bool singleConnect;
+    std::condition_variable cond;
+    std::priority_queue<TacacsTestOutgoing> outgoing;
+    bool readerDone;
+    std::map<uint32_t, TacacsTestSession> sessions;
+    std::thread reader;
+    std::thread writer;
+
+    void Read();
+    void Write();
+    // Decodes a request and queues what the handler makes of it
+    void Handle(const TacacsHeader& hdr, const std::string& body, TestClock::time_point arrived);
+    void Reset();
+
+    public:
+    std::atomic<int> finished;
+
+    TacacsTestConnection(TacacsTestServer* test_server, int connection_id, int client_fd);
+    ~TacacsTestConnection();
+
+    void Shutdown();
+};
+
+TacacsTestConnection::TacacsTestConnection(TacacsTestServer* test_server, int connection_id, int client_fd) :
+    server(test_server), id(connection_id), fd(client_fd), singleConnect(false), readerDone(false), finished(0) {
+    reader = std::thread(&TacacsTestConnection::Read, this);
+    writer = std::thread(&TacacsTestConnection::Write, this);
+}
+
+TacacsTestConnection::~TacacsTestConnection() {
+    reader.join();
+    writer.join();
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+void TacacsTestConnection::Shutdown() {
+    std::lock_guard<std::mutex> guard(lock);
+    if (fd >= 0) {
+        shutdown(fd, SHUT_RDWR);
+    }
+}
+
+void TacacsTestConnection::Read() {
+    bool first = true;
+    while (!server->stopping) {
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        if (poll(&pfd, 1, TACACS_TEST_POLL_MS) <= 0) {
+            continue;
+        }
+        TestClock::time_point arrived = TestClock::now();
+        TacacsHeader hdr;
+        std::string body;
+        if (TacacsReadPacket(fd, &hdr, &body, server->key, TACACS_TEST_IO_TIMEOUT_MS) < 0) {
+            break;
+        }
+        if (first) {
+            // Single-connect is settled by the first packet of a connection
+            singleConnect = (hdr.flags & TAC_PLUS_SINGLE_CONNECT_FLAG) != 0 && server->singleConnect;
+            first = false;
+        }
+        Handle(hdr, body, arrived);
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    readerDone = true;
+    cond.notify_all();
+    finished++;
+}
+
+void TacacsTestConnection::Handle(const TacacsHeader& hdr, const std::string& body, TestClock::time_point arrived) {
+    std::map<uint32_t, TacacsTestSession>::iterator it = sessions.find(hdr.session_id);
+    if (it == sessions.end()) {
+        TacacsTestSession session;
+        session.type = hdr.type;
+        session.sessionId = hdr.session_id;
+        session.connection = id;
+        session.packets = 0;
+        session.status = -1;
+        session.start = arrived;
+        it = sessions.insert(std::make_pair(hdr.session_id, session)).first;
+    }
+    TacacsTestSession& session = it->second;
+    session.packets++;
+
+    TacacsTestRequest request;
+    request.header = hdr;
+    request.connection = id;
+    request.action = 0;
+    request.authenType = 0;
+    request.acctFlags = 0;
+    bool parsed;
+    if (hdr.type == TAC_PLUS_AUTHEN && hdr.seq_no == 1) {
+        parsed = ParseAuthenStart(body, &request);
+        session.user = request.user;
+    } else if (hdr.type == TAC_PLUS_AUTHEN) {
+        parsed = ParseAuthenContinue(body, &request);
+        request.user = session.user;
+    } else if (hdr.type == TAC_PLUS_AUTHOR) {
+        parsed = ParseArgsRequest(body, 0, &request);
+    } else if (hdr.type == TAC_PLUS_ACCT && !body.empty()) {
+        request.acctFlags = (uint8_t)body[0];
+        parsed = ParseArgsRequest(body, 1, &request);
+    } else {
+        parsed = false;
+    }
+    if (hdr.type != TAC_PLUS_AUTHEN) {
+        session.user = request.user;
+        session.cmd = request.Arg("cmd");
+    }
+
+    TacacsTestReply reply;
+    if (parsed) {
+        reply = server->Reply(request);
+    } else {
+        reply.status = TacacsTestServer::ErrorStatus(hdr.type);
+        reply.serverMsg = "malformed request";
+    }
+    if (hdr.type >= TAC_PLUS_AUTHEN && hdr.type <= TAC_PLUS_ACCT) {
+        server->requests[hdr.type]++;
+    }
+
+    if (reply.action == TACACS_TEST_IGNORE) {
+        session.end = TestClock::now();
+        server->Finished(session);
+        sessions.erase(it);
+        return;
+    }
+
+    TacacsTestOutgoing out;
+    out.due = TestClock::now() + reply.delay;
+    out.action = reply.action;
+    out.status = reply.status;
+    out.endsSession = reply.action == TACACS_TEST_RESET || hdr.type != TAC_PLUS_AUTHEN ||
+        (reply.status != TAC_PLUS_AUTHEN_STATUS_GETPASS && reply.status != TAC_PLUS_AUTHEN_STATUS_GETDATA &&
+         reply.status != TAC_PLUS_AUTHEN_STATUS_GETUSER);
+    out.last = out.endsSession && !singleConnect;
+    if (reply.action != TACACS_TEST_RESET) {
+        std::string reply_body;
+        if (hdr.type == TAC_PLUS_AUTHEN) {
+            reply_body = AuthenReplyBody(reply);
+        } else if (hdr.type == TAC_PLUS_AUTHOR) {
+            reply_body = AuthorReplyBody(reply);
+        } else {
+            reply_body = AcctReplyBody(reply);
+        }
+        bool unencrypted = (hdr.flags & TAC_PLUS_UNENCRYPTED_FLAG) != 0 || server->cleartext;
+        TacacsHeader reply_hdr = hdr;
+        reply_hdr.seq_no = hdr.seq_no + 1;
+        reply_hdr.flags = (singleConnect ? TAC_PLUS_SINGLE_CONNECT_FLAG : 0) |
+            (unencrypted ? TAC_PLUS_UNENCRYPTED_FLAG : 0);
+        out.packet = TacacsEncodePacket(reply_hdr, reply_body, unencrypted ? std::string() : server->key);
+    }
+    if (out.endsSession) {
+        out.session = session;
+        sessions.erase(it);
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    outgoing.push(out);
+    cond.notify_all();
+}
+
+// Aborts the connection with a RST once the reader let go of the socket
+void TacacsTestConnection::Reset() {
+    std::unique_lock<std::mutex> guard(lock);
+    struct linger abort_close;
+    abort_close.l_onoff = 1;
+    abort_close.l_linger = 0;
+    setsockopt(fd, SOL_SOCKET, SO_LINGER, &abort_close, sizeof abort_close);
+    shutdown(fd, SHUT_RD);
+    cond.wait(guard, [this] { return readerDone; });
+    close(fd);
+    fd = -1;
+    server->resets++;
+}
+
+void TacacsTestConnection::Write() {
+    std::unique_lock<std::mutex> guard(lock);
+    for (;;) {
+        if (outgoing.empty()) {
+            if (readerDone) {
+                break;
+            }
+            cond.wait(guard);
+            continue;
+        }
+        TestClock::time_point due = outgoing.top().due;
+        if (TestClock::now() < due) {
+            cond.wait_until(guard, due);
+            continue;
+        }
+        TacacsTestOutgoing out = outgoing.top();
+        outgoing.pop();
+        guard.unlock();
+
+        if (out.action == TACACS_TEST_RESET) {
+            out.session.end = TestClock::now();
+            server->Finished(out.session);
+            Reset();
+            guard.lock();
+            break;
+        }
+        bool written = TacacsWriteAll(fd, out.packet, TACACS_TEST_IO_TIMEOUT_MS) == 0;
+        if (written && out.endsSession) {
+            out.session.status = out.status;
+            out.session.end = TestClock::now();
+            server->Finished(out.session);
+        }
+        if (written && out.action == TACACS_TEST_REPLY_RESET) {
+            Reset();
+            guard.lock();
+            break;
+        }
+        if (!written || out.last) {
+            // Ends the reader too
+            Shutdown();
+        }
+        guard.lock();
+    }
+    finished++;
+}
+
+TacacsTestServer::TacacsTestServer(const std::string& secret_key) :
+    key(secret_key), fd(-1), port(0), stopping(false), nextConnection(1), singleConnect(true),
+    cleartext(false), promptPassword(false), recordSessions(false), accepted(0), resets(0) {
+    for (int i = 0; i <= TAC_PLUS_ACCT; i++) {
+        requests[i] = 0;
+    }
+}
+
+TacacsTestServer::~TacacsTestServer() {
+    Stop();
+}
+
+bool TacacsTestServer::Start(const char* address) {
+    std::string s(address);
+    size_t pos = s.rfind(':');
+    if (pos == std::string::npos) {
+        LOG_F(ERROR, "Test TACACS+ server address %s is not host:port", address);
+        return false;
+    }
+    std::string host = s.substr(0, pos);
+    std::string service = s.substr(pos + 1);
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof hints);
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    struct addrinfo* res = NULL;
+    int ret = getaddrinfo(host.empty() ? NULL : host.c_str(), service.c_str(), &hints, &res);
+    if (ret != 0) {
+        LOG_F(ERROR, "Error: resolving test TACACS+ server address %s: %s", address, gai_strerror(ret));
+        return false;
+    }
+
+    fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    int one = 1;
+    if (fd < 0 || setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one) < 0 ||
+            bind(fd, res->ai_addr, res->ai_addrlen) < 0 || listen(fd, 128) < 0) {
+        LOG_F(ERROR, "Unable to serve test TACACS+ on %s: %s", address, strerror(errno));
+        freeaddrinfo(res);
+        if (fd >= 0) {
+            close(fd);
+            fd = -1;
+        }
+        return false;
+    }
+    freeaddrinfo(res);
+
+    struct sockaddr_storage bound;
+    socklen_t len = sizeof bound;
+    getsockname(fd, (struct sockaddr*)&bound, &len);
+    if (bound.ss_family == AF_INET6) {
+        port = ntohs(((struct sockaddr_in6*)&bound)->sin6_port);
+    } else {
+        port = ntohs(((struct sockaddr_in*)&bound)->sin_port);
+    }
+
+    stopping = false;
+    acceptor = std::thread(&TacacsTestServer::Serve, this);
+    LOG_F(INFO, "Test TACACS+ server listening on port %d", port);
+    return true;
+}
+
+void TacacsTestServer::Stop() {
+    stopping = true;
+    if (acceptor.joinable()) {
+        acceptor.join();
+    }
+    Reap(true);
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+std::string TacacsTestServer::Address() {
+    return "127.0.0.1:" + std::to_string(port);
+}
+
+void TacacsTestServer::Serve() {
+    while (!stopping) {
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        if (poll(&pfd, 1, TACACS_TEST_POLL_MS) <= 0) {
+            Reap(false);
+            continue;
+        }
+        int client = accept(fd, NULL, NULL);
+        if (client < 0) {
+            continue;
+        }
+        int one = 1;
+        setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+        accepted++;
+        std::lock_guard<std::mutex> guard(lock);
+        connections.push_back(new TacacsTestConnection(this, nextConnection++, client));
+    }
+}
+
+void TacacsTestServer::Reap(bool all) {
+    std::vector<TacacsTestConnection*> done;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        for (size_t i = 0; i < connections.size(); ) {
+            if (all || connections[i]->finished == 2) {
+                done.push_back(connections[i]);
+                connections.erase(connections.begin() + i);
+            } else {
+                i++;
+            }
+        }
+    }
+    for (size_t i = 0; i < done.size(); i++) {
+        done[i]->Shutdown();
+        delete done[i];
+    }
+}
+
+void TacacsTestServer::AddUser(const std::string& user, const std::string& password) {
+    std::lock_guard<std::mutex> guard(lock);
+    users[user] = password;
+}
+
+void TacacsTestServer::DenyCommand(const std::string& cmd) {
+    std::lock_guard<std::mutex> guard(lock);
+    deniedCommands.insert(cmd);
+}
+
+void TacacsTestServer::PromptPassword(bool prompt) {
+    std::lock_guard<std::mutex> guard(lock);
+    promptPassword = prompt;
+}
+
+void TacacsTestServer::AcceptSingleConnect(bool accept) {
+    std::lock_guard<std::mutex> guard(lock);
+    singleConnect = accept;
+}
+
+void TacacsTestServer::SendCleartext(bool send_cleartext) {
+    cleartext = send_cleartext;
+}
+
+void TacacsTestServer::SetHandler(TacacsTestHandler custom_handler) {
+    std::lock_guard<std::mutex> guard(lock);
+    handler = custom_handler;
+}
+
+void TacacsTestServer::RecordSessions(bool record) {
+    std::lock_guard<std::mutex> guard(lock);
+    recordSessions = record;
+}
+
+TacacsTestReply TacacsTestServer::Reply(const TacacsTestRequest& request) {
+    TacacsTestHandler custom;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        custom = handler;
+    }
+    return custom ? custom(request) : DefaultReply(request);
+}
+
+TacacsTestReply TacacsTestServer::DefaultReply(const TacacsTestRequest& request) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (request.header.type == TAC_PLUS_AUTHEN) {
+        bool start = request.header.seq_no == 1;
+        if (start && (promptPassword || request.data.empty())) {
+            TacacsTestReply reply(TAC_PLUS_AUTHEN_STATUS_GETPASS);
+            reply.serverMsg = "Password: ";
+            return reply;
+        }
+        std::map<std::string, std::string>::const_iterator user = users.find(request.user);
+        bool pass = users.empty() || (user != users.end() && user->second == request.data);
+        return TacacsTestReply(pass ? TAC_PLUS_AUTHEN_STATUS_PASS : TAC_PLUS_AUTHEN_STATUS_FAIL);
+    } else if (request.header.type == TAC_PLUS_AUTHOR) {
+        bool denied = deniedCommands.count(request.Arg("cmd")) > 0;
+        return TacacsTestReply(denied ? TAC_PLUS_AUTHOR_STATUS_FAIL : TAC_PLUS_AUTHOR_STATUS_PASS_ADD);
+    }
+    return TacacsTestReply(TAC_PLUS_ACCT_STATUS_SUCCESS);
+}
+
+int TacacsTestServer::ErrorStatus(uint8_t type) {
+    if (type == TAC_PLUS_AUTHEN) {
+        return TAC_PLUS_AUTHEN_STATUS_ERROR;
+    } else if (type == TAC_PLUS_AUTHOR) {
+        return TAC_PLUS_AUTHOR_STATUS_ERROR;
+    }
+    return TAC_PLUS_ACCT_STATUS_ERROR;
+}
+
+void TacacsTestServer::Finished(const TacacsTestSession& session) {
+    if (session.type >= TAC_PLUS_AUTHEN && session.type <= TAC_PLUS_ACCT) {
+        sessionTime[session.type].Record(
+            std::chrono::duration_cast<std::chrono::microseconds>(session.end - session.start).count());
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    if (recordSessions) {
+        sessions.push_back(session);
+    }
+}
+
+std::vector<TacacsTestSession> TacacsTestServer::Sessions() {
+    std::lock_guard<std::mutex> guard(lock);
+    return sessions;
+}
+
+void TacacsTestServer::ClearSessions() {
+    std::lock_guard<std::mutex> guard(lock);
+    sessions.clear();
+}
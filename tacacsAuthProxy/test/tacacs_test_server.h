@@ -0,0 +1,168 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef TACACS_TEST_SERVER_H_
+#define TACACS_TEST_SERVER_H_
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tacacs_packet.h"
+#include "metrics.h"
+
+// What the test server does with a request
+enum TacacsTestAction {
+    TACACS_TEST_REPLY,          // answers with the status of the reply
+    TACACS_TEST_RESET,          // resets the connection instead, sessions on it are lost
+    TACACS_TEST_REPLY_RESET,    // answers, then resets the connection
+    TACACS_TEST_IGNORE          // never answers, the client times out
+};
+
+// One decoded request packet
+struct TacacsTestRequest {
+    TacacsHeader header;
+    int connection;             // id of the connection, in order of acceptance from 1
+    uint8_t action;             // authentication START
+    uint8_t authenType;         // authentication START
+    uint8_t acctFlags;          // accounting
+    std::string user;           // also set on an authentication CONTINUE, from its START
+    std::string port;
+    std::string remAddr;
+    std::string data;           // PAP password of a START or user message of a CONTINUE
+    std::vector<std::string> args;
+
+    // Value of the first attribute named name, empty if absent
+    std::string Arg(const std::string& name) const;
+};
+
+// Answer to a request, held back by delay
+struct TacacsTestReply {
+    TacacsTestAction action;
+    int status;
+    std::string serverMsg;
+    std::vector<std::string> args;  // authorization attributes
+    std::chrono::microseconds delay;
+
+    TacacsTestReply(int reply_status = 0) : action(TACACS_TEST_REPLY), status(reply_status), delay(0) {}
+};
+
+// Timing and outcome of one session, as seen by the server
+struct TacacsTestSession {
+    uint8_t type;
+    uint32_t sessionId;
+    int connection;
+    std::string user;
+    std::string cmd;            // authorization and accounting
+    int packets;                // requests received in the session
+    int status;                 // of the last reply, -1 if reset or ignored
+    std::chrono::steady_clock::time_point start;    // first request read
+    std::chrono::steady_clock::time_point end;      // last reply written
+};
+
+typedef std::function<TacacsTestReply(const TacacsTestRequest&)> TacacsTestHandler;
+
+class TacacsTestConnection;
+
+// Scriptable TACACS+ server for tests and benchmarks.
+//
+// Speaks the RFC 8907 wire format, obfuscated with the shared key, on a
+// loopback port. Every connection gets a reader thread, which decodes the
+// requests and asks the handler for the replies, and a writer thread, which
+// sends each reply once its delay expired. On a single-connect connection
+// replies of multiplexed sessions are written in the order their delays
+// expire, like a loaded server would.
+//
+// The default handler authenticates against the user table, PAP or with a
+// GETPASS prompt, permits every command but the denied ones and acknowledges
+// accounting records. A custom handler can script anything else and fall
+// back on DefaultReply. Handlers run on the reader threads, concurrently.
+class TacacsTestServer {
+    friend class TacacsTestConnection;
+
+    std::string key;
+    int fd;
+    int port;
+    std::atomic<bool> stopping;
+    std::thread acceptor;
+
+    std::mutex lock;
+    std::vector<TacacsTestConnection*> connections;
+    int nextConnection;
+    std::map<std::string, std::string> users;
+    std::set<std::string> deniedCommands;
+    TacacsTestHandler handler;
+    std::atomic<bool> singleConnect;
+    std::atomic<bool> cleartext;
+    bool promptPassword;
+    bool recordSessions;
+    std::vector<TacacsTestSession> sessions;
+
+    void Serve();
+    // Joins and frees the connections whose client went away
+    void Reap(bool all);
+    TacacsTestReply Reply(const TacacsTestRequest& request);
+    void Finished(const TacacsTestSession& session);
+
+    public:
+    std::atomic<unsigned long> accepted;
+    std::atomic<unsigned long> requests[TAC_PLUS_ACCT + 1];     // by packet type
+    std::atomic<unsigned long> resets;
+    // Session durations by packet type, from first request read to last reply written
+    LatencyHistogram sessionTime[TAC_PLUS_ACCT + 1];
+
+    TacacsTestServer(const std::string& secret_key);
+    ~TacacsTestServer();
+
+    // address is host:port, port 0 picks a free one. False if it cannot be listened on.
+    bool Start(const char* address = "127.0.0.1:0");
+    void Stop();
+
+    // Port listened on, once started
+    int Port() { return port; }
+    // 127.0.0.1:port, to configure the client with
+    std::string Address();
+
+    // Without users, any user and password pass
+    void AddUser(const std::string& user, const std::string& password);
+    // Authorization of the cmd attribute fails
+    void DenyCommand(const std::string& cmd);
+    // Answers authentication START with GETPASS, the password comes in a CONTINUE
+    void PromptPassword(bool prompt);
+    // Whether single-connect is accepted when asked for, it is by default
+    void AcceptSingleConnect(bool accept);
+    // Replies flagged unencrypted and sent in the clear, like a forger
+    // without the key would, off by default
+    void SendCleartext(bool send_cleartext);
+    // Replaces the default handler, NULL restores it
+    void SetHandler(TacacsTestHandler custom_handler);
+    // Keeps every finished session for Sessions(), off by default
+    void RecordSessions(bool record);
+
+    TacacsTestReply DefaultReply(const TacacsTestRequest& request);
+    // ERROR status of a packet type
+    static int ErrorStatus(uint8_t type);
+
+    // Finished sessions, in the order they finished
+    std::vector<TacacsTestSession> Sessions();
+    void ClearSessions();
+};
+
+#endif